@@ -0,0 +1,83 @@
+//
+// AMBundleTool : writes the binary bundle (AlgoMarkerBundle) of an AlgoMarker config,
+// so that AM_API_Load reads one file instead of parsing the signals, dictionaries and model files.
+// the bundle is used by Load when the config has a BUNDLE line, and is not stale.
+//
+
+#include <string>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <AlgoMarker/AlgoMarker/AlgoMarker.h>
+#include <AlgoMarker/AlgoMarker/AlgoMarkerBundle.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+using namespace std;
+namespace po = boost::program_options;
+
+//=========================================================================================================
+int read_run_params(int argc, char *argv[], po::variables_map& vm) {
+	po::options_description desc("Program options");
+
+	try {
+		desc.add_options()
+			("help", "produce help message")
+			("amconfig", po::value<string>()->required(), "AlgoMarker config file")
+			("out", po::value<string>()->default_value(""), "bundle file to write, default is the BUNDLE file in the config")
+			("check", "only check that the bundle given in --out is valid and not stale")
+			;
+
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		if (vm.count("help")) {
+			cerr << desc << "\n";
+			exit(-1);
+		}
+		po::notify(vm);
+	}
+	catch (exception& e) {
+		cerr << "error: " << e.what() << "; run with --help for usage information\n";
+		return -1;
+	}
+	catch (...) {
+		cerr << "Exception of unknown type!\n";
+		return -1;
+	}
+
+	return 0;
+}
+
+//========================================================================================
+// MAIN
+//========================================================================================
+int main(int argc, char *argv[])
+{
+	po::variables_map vm;
+	if (read_run_params(argc, argv, vm) < 0)
+		return -1;
+
+	string amconfig = vm["amconfig"].as<string>();
+	string out = vm["out"].as<string>();
+
+	if (vm.count("check")) {
+		if (out == "") {
+			MERR("--check needs the bundle file in --out\n");
+			return -1;
+		}
+		AlgoMarkerBundle bundle;
+		if (bundle.read_from_file(out) < 0 || bundle.is_stale()) {
+			MLOG("bundle %s can't be used\n", out.c_str());
+			return -1;
+		}
+		MLOG("bundle %s is valid\n", out.c_str());
+		return 0;
+	}
+
+	MedialInfraAlgoMarker am;
+	int rc = am.WriteBundle(amconfig.c_str(), out.c_str());
+	if (rc != AM_OK_RC) {
+		MERR("failed writing bundle for %s (rc %d)\n", amconfig.c_str(), rc);
+		return -1;
+	}
+	return 0;
+}
@@ -436,6 +436,46 @@ void AM_API_DisposeAlgoMarker(AlgoMarker *pAlgoMarker)
 }
 //-----------------------------------------------------------------------------------------------------------
 
+//-----------------------------------------------------------------------------------------------------------
+// create a scoring session with a copy of the model of a loaded AlgoMarker
+//-----------------------------------------------------------------------------------------------------------
+int AM_API_CreateSession(AlgoMarker *pAlgoMarker, AlgoMarker **new_session)
+{
+	try {
+		if (pAlgoMarker == NULL || new_session == NULL)
+			return AM_FAIL_RC;
+
+		*new_session = pAlgoMarker->CreateSession();
+		if (*new_session == NULL)
+			return AM_ERROR_MUST_BE_LOADED;
+
+		return AM_OK_RC;
+	}
+	catch (...) {
+		return AM_FAIL_RC;
+	}
+}
+//-----------------------------------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------------------------------------
+// Dispose of a session - frees its data and its copy of the model
+//-----------------------------------------------------------------------------------------------------------
+void AM_API_DisposeSession(AlgoMarker *pSession)
+{
+	try {
+		if (pSession == NULL)
+			return;
+
+		pSession->Unload();
+
+		delete pSession;
+	}
+	catch (...) {
+
+	}
+}
+//-----------------------------------------------------------------------------------------------------------
+
 //-----------------------------------------------------------------------------------------------------------
 // Dispose of AMRequest - free all memory 
 //-----------------------------------------------------------------------------------------------------------
@@ -300,6 +300,9 @@ public:
 	//Discovery api
 	virtual int Discovery(char **response) { *response = NULL; return 0; }
 
+	// Sessions : a new AlgoMarker with a copy of the loaded model of this one and its own data. NULL if not supported/loaded
+	virtual AlgoMarker *CreateSession() { return NULL; }
+
 	// check supported score types in the supported_score_types vector
 	int IsScoreTypeSupported(const char *_stype);
 
@@ -344,6 +347,7 @@ private:
 	string type_in_config_file = "";
 	string rep_fname = "";
 	string model_fname = "";
+	string bundle_fname = ""; // optional AlgoMarkerBundle of the repository config and model, used when not stale
 	string input_tester_config_file = "";
 	bool allow_rep_adjustments = false;
 
@@ -355,17 +359,19 @@ private:
 	string am_matrix = ""; // for debugging : if not empty will write matrix to given file name
 	bool first_write = true; ///< in debug mode - mark first write flag
 	int model_end_stage = MED_MDL_END;
+	int batch_window_ms = 0; // when > 0 concurrent CalculateByType calls of sessions are scored in batches collected over this window
+	int batch_max_samples = 1000; // maximal number of samples waiting before a batch is scored
 	vector<string> extended_result_fields;
 	bool is_loaded = false;
 
 	void get_jsons_locations(const char *data, vector<size_t> &j_start, vector<size_t> &j_len); // helper to split given string to jsons within it. Used in batch json mode.
-	int AddJsonData(int patient_id, json &j_data, vector<string> &messages, map<pair<int, int>, pair<int, vector<char>>> *data = NULL);
+	int AddJsonData(int patient_id, json &j_data, vector<string> &messages, InMemDataBuffer *data = NULL);
 	int rec_AddDataByType(int DataType, const char *data, vector<string> &messages);
 	void clear_patients_data(const vector<int> &pids);
 	int AddDataStr_data(int patient_id, const char *signalName, int TimeStamps_len, long long* TimeStamps, int Values_len, char** Values, 
-	map<pair<int, int>, pair<int, vector<char>>> *data);
+	InMemDataBuffer *data);
 	int AddData_data(int patient_id, const char *signalName, int TimeStamps_len, long long* TimeStamps, int Values_len, float* Values, 
-	map<pair<int, int>, pair<int, vector<char>>> *data);
+	InMemDataBuffer *data);
 public:
 	MedialInfraAlgoMarker() { set_type((int)AM_TYPE_MEDIAL_INFRA); add_supported_stype("Raw"); }
 
@@ -379,6 +385,8 @@ public:
 	int AddDataByType(const char *data, char **messages);
 	int CalculateByType(int CalculateType, char *request, char **response); // options: JSON_REQ_JSON_RESP
 	int Discovery(char **response);
+	AlgoMarker *CreateSession();
+	int WriteBundle(const char *config_f, const char *bundle_f); // writes the bundle of a config (to its BUNDLE file if bundle_f is empty)
 
 	int set_sort(int s) { sort_needed = s; return 0; } // use only for debug modes.
 	void set_am_matrix(string s) { am_matrix = s; }
@@ -501,6 +509,14 @@ extern "C" DLL_WORK_MODE int AM_API_GetName(AlgoMarker *pAlgoMArker, char **name
 // Dispose of AlgoMarker - free all memory 
 extern "C" DLL_WORK_MODE void AM_API_DisposeAlgoMarker(AlgoMarker *pAlgoMarker);
 
+// create a scoring session on a loaded AlgoMarker : the session shares the model and dictionaries of pAlgoMarker
+// and has its own data, so different sessions can be used at the same time from different threads.
+// the session is used with the regular AddData/Calculate/ClearData APIs and must be disposed before pAlgoMarker
+extern "C" DLL_WORK_MODE int AM_API_CreateSession(AlgoMarker *pAlgoMarker, AlgoMarker **new_session);
+
+// Dispose of a session - free its data
+extern "C" DLL_WORK_MODE void AM_API_DisposeSession(AlgoMarker *pSession);
+
 // Dispose of AMRequest - free all memory 
 extern "C" DLL_WORK_MODE void AM_API_DisposeRequest(AMRequest *pRequest);
 
@@ -0,0 +1,295 @@
+#include "AlgoMarkerBundle.h"
+#include <InfraMed/InfraMed/Utils.h>
+#include <Logger/Logger/Logger.h>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+struct AlgoMarkerBundleHeader {
+	char magic[8];
+	int version;
+	unsigned int crc;				// crc32 of everything after the header
+	unsigned long long fields_size;	// serialized fields (padded to 8 bytes in the file)
+	unsigned long long data_size;	// dictionaries and model
+};
+
+static inline unsigned long long bundle_pad8(unsigned long long n) { return (n + 7) & ~7ULL; }
+
+//-------------------------------------------------------------------------------------------------------------------------
+static int get_file_time(const string &fname, long long &t)
+{
+	try {
+		t = (long long)boost::filesystem::last_write_time(fname);
+	}
+	catch (...) {
+		return -1;
+	}
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+void AlgoMarkerBundle::clear()
+{
+	source_fnames.clear(); source_sizes.clear(); source_times.clear();
+	signals_fnames.clear(); signals_texts.clear();
+	dict_sections.clear(); dict_sizes.clear();
+	model_size = 0;
+	bundle_fname = "";
+	if (file_data != NULL)
+		delete[] file_data;
+	file_data = NULL;
+	file_size = 0;
+	blobs.clear();
+	data = NULL;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+int AlgoMarkerBundle::add_source(const string &fname)
+{
+	for (const string &f : source_fnames)
+		if (f == fname)
+			return 0;
+
+	long long t;
+	if (!file_exists_IM(fname) || get_file_time(fname, t) < 0) {
+		MERR("AlgoMarkerBundle: can't stat source file %s\n", fname.c_str());
+		return -1;
+	}
+	source_fnames.push_back(fname);
+	source_sizes.push_back(get_file_size_IM(fname));
+	source_times.push_back(t);
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+const unsigned char *AlgoMarkerBundle::model_data() const
+{
+	unsigned long long pos = 0;
+	for (unsigned long long size : dict_sizes)
+		pos += bundle_pad8(size);
+	return data + pos;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+int AlgoMarkerBundle::create(const string &rep_config_fname, const string &model_fname)
+{
+	clear();
+
+	MedPidRepository rep;
+	rep.switch_to_in_mem_mode();
+	if (rep.MedRepository::init(rep_config_fname) < 0) {
+		MERR("AlgoMarkerBundle: failed reading repository config %s\n", rep_config_fname.c_str());
+		return -1;
+	}
+
+	// sources (signals files are also listed as dictionaries)
+	if (add_source(rep_config_fname) < 0) return -1;
+	for (const string &f : rep.dictionary_fnames)
+		if (add_source(f) < 0) return -1;
+	if (add_source(model_fname) < 0) return -1;
+
+	for (const string &f : rep.signal_fnames) {
+		ifstream inf(f, ios::in | ios::binary);
+		if (!inf) {
+			MERR("AlgoMarkerBundle: can't open signals file %s\n", f.c_str());
+			return -1;
+		}
+		stringstream ss;
+		ss << inf.rdbuf();
+		signals_fnames.push_back(f);
+		signals_texts.push_back(ss.str());
+	}
+
+	// dictionaries, one compiled dictionary per section, in section id order
+	rep.dict.compile();
+	for (size_t i = 0; i < rep.dict.sections_names.size(); i++) {
+		string names = rep.dict.sections_names[i];
+		for (const string &s : rep.dict.dicts[i].section_name)
+			if (s != rep.dict.sections_names[i])
+				names += "," + s;
+		const MedCompiledDictionary &cdict = rep.dict.dicts[i].compiled;
+		dict_sections.push_back(names);
+		dict_sizes.push_back(cdict.size());
+		if (cdict.size() > 0)
+			blobs.insert(blobs.end(), cdict.data(), cdict.data() + cdict.size());
+		blobs.resize(bundle_pad8(blobs.size()), 0);
+	}
+
+	// model file as is (version + serialized model)
+	unsigned char *mdata = NULL;
+	string mf = model_fname;
+	if (read_bin_file_IM(mf, mdata, model_size) < 0) {
+		MERR("AlgoMarkerBundle: failed reading model file %s\n", model_fname.c_str());
+		return -1;
+	}
+	blobs.insert(blobs.end(), mdata, mdata + model_size);
+	delete[] mdata;
+	data = blobs.data();
+
+	MLOG("AlgoMarkerBundle: created from %s and %s : %d signals files, %d dictionary sections, model of %llu bytes\n",
+		rep_config_fname.c_str(), model_fname.c_str(), (int)signals_fnames.size(), (int)dict_sections.size(), model_size);
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+int AlgoMarkerBundle::write_to_file(const string &fname)
+{
+	if (data == NULL) {
+		MERR("AlgoMarkerBundle: nothing to write to %s\n", fname.c_str());
+		return -1;
+	}
+
+	unsigned long long data_size = (unsigned long long)(model_data() - data) + model_size;
+	size_t fields_size = get_size();
+	vector<unsigned char> out(sizeof(AlgoMarkerBundleHeader) + bundle_pad8(fields_size) + data_size, 0);
+	unsigned char *fields = &out[sizeof(AlgoMarkerBundleHeader)];
+	if (serialize(fields) != fields_size) {
+		MERR("AlgoMarkerBundle: serialization size mismatch\n");
+		return -1;
+	}
+	memcpy(fields + bundle_pad8(fields_size), data, data_size);
+
+	AlgoMarkerBundleHeader *hdr = (AlgoMarkerBundleHeader *)out.data();
+	memcpy(hdr->magic, AM_BUNDLE_MAGIC, 8);
+	hdr->version = AM_BUNDLE_VERSION;
+	hdr->fields_size = fields_size;
+	hdr->data_size = data_size;
+	boost::crc_32_type checksum_agent;
+	checksum_agent.process_bytes(fields, out.size() - sizeof(AlgoMarkerBundleHeader));
+	hdr->crc = checksum_agent.checksum();
+
+	string f = fname;
+	if (write_bin_file_IM(f, out.data(), out.size()) < 0) {
+		MERR("AlgoMarkerBundle: failed writing %s\n", fname.c_str());
+		return -1;
+	}
+	MLOG("AlgoMarkerBundle: wrote %s (%llu bytes) with crc32 [%u]\n", fname.c_str(), (unsigned long long)out.size(), hdr->crc);
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+int AlgoMarkerBundle::read_from_file(const string &fname)
+{
+	clear();
+
+	string f = fname;
+	if (read_bin_file_IM(f, file_data, file_size) < 0) {
+		MERR("AlgoMarkerBundle: failed reading %s\n", fname.c_str());
+		clear();
+		return -1;
+	}
+
+	const AlgoMarkerBundleHeader *hdr = (const AlgoMarkerBundleHeader *)file_data;
+	if (file_size < sizeof(AlgoMarkerBundleHeader) || memcmp(hdr->magic, AM_BUNDLE_MAGIC, 8) != 0 || hdr->version != AM_BUNDLE_VERSION ||
+		sizeof(AlgoMarkerBundleHeader) + bundle_pad8(hdr->fields_size) + hdr->data_size != file_size) {
+		MERR("AlgoMarkerBundle: %s is not a valid bundle (version %d)\n", fname.c_str(), AM_BUNDLE_VERSION);
+		clear();
+		return -1;
+	}
+
+	unsigned char *fields = file_data + sizeof(AlgoMarkerBundleHeader);
+	boost::crc_32_type checksum_agent;
+	checksum_agent.process_bytes(fields, file_size - sizeof(AlgoMarkerBundleHeader));
+	if (checksum_agent.checksum() != hdr->crc) {
+		MERR("AlgoMarkerBundle: %s failed crc check\n", fname.c_str());
+		clear();
+		return -1;
+	}
+
+	unsigned long long fields_size = hdr->fields_size, data_size = hdr->data_size;
+	if (deserialize(fields) != fields_size || signals_fnames.size() != signals_texts.size() || dict_sections.size() != dict_sizes.size()) {
+		MERR("AlgoMarkerBundle: %s has inconsistent fields\n", fname.c_str());
+		clear();
+		return -1;
+	}
+	bundle_fname = fname;
+	data = fields + bundle_pad8(fields_size);
+	if ((unsigned long long)(model_data() - data) + model_size != data_size) {
+		MERR("AlgoMarkerBundle: %s has inconsistent data sizes\n", fname.c_str());
+		clear();
+		return -1;
+	}
+
+	MLOG("AlgoMarkerBundle: read %s (%llu bytes)\n", fname.c_str(), file_size);
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+// a source that was changed or removed makes the bundle stale
+bool AlgoMarkerBundle::is_stale() const
+{
+	for (size_t i = 0; i < source_fnames.size(); i++) {
+		const string &f = source_fnames[i];
+		if (!file_exists_IM(f)) {
+			MLOG("AlgoMarkerBundle: %s is stale, %s is missing\n", bundle_fname.c_str(), f.c_str());
+			return true;
+		}
+		long long t;
+		if (get_file_size_IM(f) != source_sizes[i] || get_file_time(f, t) < 0 || t != source_times[i]) {
+			MLOG("AlgoMarkerBundle: %s is stale, %s was changed\n", bundle_fname.c_str(), f.c_str());
+			return true;
+		}
+	}
+	return false;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+int AlgoMarkerBundle::init_rep(MedPidRepository &rep, const string &rep_config_fname)
+{
+	if (data == NULL) {
+		MERR("AlgoMarkerBundle: init_rep() called before reading a bundle\n");
+		return -1;
+	}
+
+	rep.switch_to_in_mem_mode();
+
+	// dictionaries are loaded first and kept by read_config()
+	rep.dict.clear();
+	const unsigned char *p = data;
+	for (size_t i = 0; i < dict_sections.size(); i++) {
+		MedCompiledDictionary cdict;
+		if (dict_sizes[i] > 0 && cdict.read(p, dict_sizes[i], bundle_fname) < 0)
+			return -1;
+		if (rep.dict.read_compiled(cdict, dict_sections[i], bundle_fname) < 0)
+			return -1;
+		p += bundle_pad8(dict_sizes[i]);
+	}
+	rep.dict.read_state = 1;
+
+	// signals files are read from the bundle texts by the regular init()
+	for (size_t i = 0; i < signals_texts.size(); i++)
+		rep.sigs.preloaded[signals_fnames[i]] = signals_texts[i];
+
+	int rc = rep.MedRepository::init(rep_config_fname);
+	rep.sigs.preloaded.clear();
+	if (rc < 0) {
+		MERR("AlgoMarkerBundle: init of repository %s failed\n", rep_config_fname.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+int AlgoMarkerBundle::init_model(MedModel &model)
+{
+	if (data == NULL || model_size < sizeof(int)) {
+		MERR("AlgoMarkerBundle: no model in bundle %s\n", bundle_fname.c_str());
+		return -1;
+	}
+
+	unsigned char *blob = (unsigned char *)model_data();
+	int vers = *((int *)blob);
+	if (vers != model.version()) {
+		MERR("AlgoMarkerBundle: model in %s has version %d, code version is %d\n", bundle_fname.c_str(), vers, model.version());
+		return -1;
+	}
+	size_t size = model.deserialize(blob + sizeof(int));
+	if (size + sizeof(int) != model_size) {
+		MERR("AlgoMarkerBundle: model in %s has %llu bytes, deserialized %zu\n", bundle_fname.c_str(), model_size, size + sizeof(int));
+		return -1;
+	}
+	return 0;
+}
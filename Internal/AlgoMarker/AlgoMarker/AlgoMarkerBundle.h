@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <SerializableObject/SerializableObject/SerializableObject.h>
+#include <InfraMed/InfraMed/MedPidRepository.h>
+#include <MedProcessTools/MedProcessTools/MedModel.h>
+
+//===============================================================================
+// AlgoMarkerBundle - a single binary file with everything an AlgoMarker parses at Load:
+// the signals files, the dictionaries (compiled, see MedCompiledDictionary) and the model file.
+// Loading it is one file read and a crc check, with no text parsing.
+// The bundle keeps the size and modification time of the files it was made from, and is stale
+// if any of them was changed or removed. The repository config itself is still read as text.
+//
+// file layout : header | serialized bundle fields | compiled dictionaries (8 bytes aligned) | model file
+//===============================================================================
+#define AM_BUNDLE_MAGIC		"MEDAMBDL"
+#define AM_BUNDLE_VERSION	1
+
+class AlgoMarkerBundle : public SerializableObject {
+public:
+	// files the bundle was made from : repository config, signals, dictionaries and model
+	vector<string> source_fnames;
+	vector<unsigned long long> source_sizes;
+	vector<long long> source_times;
+
+	vector<string> signals_fnames;
+	vector<string> signals_texts;		///< contents of the signals files
+
+	vector<string> dict_sections;		///< names of each dictionary section, the first is the section name
+	vector<unsigned long long> dict_sizes;	///< size of the compiled dictionary of each section, 0 for an empty section
+	unsigned long long model_size = 0;
+
+	// build from the files an AlgoMarker uses
+	int create(const string &rep_config_fname, const string &model_fname);
+
+	int write_to_file(const string &fname);
+	int read_from_file(const string &fname);	///< reads and checks the crc, staleness is checked by is_stale()
+	bool is_stale() const;
+
+	// load into a repository (in mem mode, with MedRepository::init() taking the dictionaries and signals from the bundle) and a model
+	int init_rep(MedPidRepository &rep, const string &rep_config_fname);
+	int init_model(MedModel &model);
+
+	void clear();
+
+	ADD_CLASS_NAME(AlgoMarkerBundle)
+	ADD_SERIALIZATION_FUNCS(source_fnames, source_sizes, source_times, signals_fnames, signals_texts, dict_sections, dict_sizes, model_size)
+
+private:
+	string bundle_fname;
+	unsigned char *file_data = NULL;		///< whole file after read_from_file()
+	unsigned long long file_size = 0;
+	vector<unsigned char> blobs;			///< dictionaries and model data after create()
+	const unsigned char *data = NULL;		///< start of the dictionaries and model data
+
+	int add_source(const string &fname);
+	const unsigned char *model_data() const;
+
+public:
+	AlgoMarkerBundle() {}
+	AlgoMarkerBundle(const AlgoMarkerBundle &) = delete;
+	AlgoMarkerBundle &operator=(const AlgoMarkerBundle &) = delete;
+	~AlgoMarkerBundle() { clear(); }
+};
@@ -3,6 +3,7 @@
 #include <Logger/Logger/Logger.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <chrono>
 #define LOCAL_SECTION LOG_APP
 #define LOCAL_LEVEL	LOG_DEF_LEVEL
 
@@ -164,7 +165,7 @@ int InputTesterJsonFeature::test_if_ok(MedPidRepository &rep, int pid, long long
 		if (allow_missing_signals.find(req_s) == allow_missing_signals.end())
 
 			if ((!rep.in_mem_mode_active() && !rep.index.index_table[sid].full_load) ||
-				(rep.in_mem_mode_active() && rep.in_mem_rep.data.find(pair<int, int>(pid, sid)) == rep.in_mem_rep.data.end())) {
+				(rep.in_mem_mode_active() && !rep.in_mem_rep.data.contains(pid, sid))) {
 				fail_signals = true;
 				get_current_time(current_time);
 				MLOG("%s:: Signal %s not loaded for model eligibility testing\n", current_time.c_str(), req_s.c_str());
@@ -564,4 +565,162 @@ int InputSanityTester::test_if_ok(int pid, long long timestamp,
 		return 0;
 
 	return 1;
-}
\ No newline at end of file
+}
+//=========================================================================================================================
+// AMApplyBatcher
+//=========================================================================================================================
+int AMApplyBatcher::apply(const MedModel &model, MedModelApplyContext &ctx, MedPidRepository &rep, MedSamples &samples, const vector<Effected_Field> &requested_fields)
+{
+	Job job;
+	job.rep = &rep;
+	job.samples = &samples;
+	job.requested_fields = &requested_fields;
+
+	unique_lock<mutex> lock(jobs_mutex);
+	pending.push_back(&job);
+	n_pending_samples += samples.nSamples();
+
+	if (collecting) {
+		// a leader is collecting - wake it if the batch is full (or no other request may join) and wait for our results
+		if (batch_ready())
+			cv_collect.notify_all();
+		cv_done.wait(lock, [&job] { return job.done; });
+		return job.rc;
+	}
+
+	// we are the leader of this batch
+	collecting = true;
+	cv_collect.wait_for(lock, chrono::milliseconds(window_ms), [this] { return batch_ready(); });
+	vector<Job *> batch;
+	batch.swap(pending);
+	n_pending_samples = 0;
+	n_scoring += (int)batch.size();
+	collecting = false;
+	unique_ptr<MedPidRepository> batch_rep;
+	if (!free_batch_reps.empty()) {
+		batch_rep = move(free_batch_reps.back());
+		free_batch_reps.pop_back();
+	}
+	lock.unlock();
+
+	// whatever happens here, the jobs of the batch must be marked done, or their sessions would wait forever
+	try {
+		if (batch_rep == NULL) {
+			// the dictionaries are shared with the repository of the sessions (which share those of their parent)
+			batch_rep.reset(new MedPidRepository(rep.dict));
+			batch_rep->sigs = rep.sigs;
+			batch_rep->sigs.my_repo = batch_rep.get();
+			batch_rep->time_unit = rep.time_unit;
+			batch_rep->switch_to_in_mem_mode();
+		}
+		apply_batch(model, ctx, *batch_rep, batch);
+	}
+	catch (...) {
+		MERR("AMApplyBatcher::apply : failed scoring a batch of %d requests\n", (int)batch.size());
+		for (Job *j : batch)
+			j->rc = -1;
+		if (batch_rep != NULL)
+			batch_rep->in_mem_rep.clear();
+	}
+
+	lock.lock();
+	if (batch_rep != NULL)
+		free_batch_reps.push_back(move(batch_rep));
+	n_scoring -= (int)batch.size();
+	for (Job *j : batch)
+		j->done = true;
+	cv_done.notify_all();
+
+	return job.rc;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+void AMApplyBatcher::enter()
+{
+	lock_guard<mutex> lock(jobs_mutex);
+	n_active++;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+void AMApplyBatcher::leave()
+{
+	lock_guard<mutex> lock(jobs_mutex);
+	n_active--;
+	// a request that ended without reaching apply() (failed, or nothing to score) may be the one the leader waits for
+	if (collecting && batch_ready())
+		cv_collect.notify_all();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+void AMApplyBatcher::apply_batch(const MedModel &model, MedModelApplyContext &ctx, MedPidRepository &batch_rep, vector<Job *> &batch)
+{
+	if (batch.size() == 1) {
+		Job &job = *batch[0];
+		try {
+			model.no_init_apply_partial(ctx, *job.rep, *job.samples, *job.requested_fields);
+		}
+		catch (...) {
+			job.rc = -1;
+		}
+		return;
+	}
+
+	// merge : pids are renumbered 1..n over the batch, data of each job is copied to batch_rep
+	batch_rep.in_mem_rep.clear();
+
+	MedSamples batch_samples;
+	batch_samples.time_unit = batch[0]->samples->time_unit;
+	unordered_set<Effected_Field, Effected_Field::HashFunction> fields;
+	int n_pids = 0;
+	for (size_t k = 0; k < batch.size(); k++) {
+		Job &job = *batch[k];
+		fields.insert(job.requested_fields->begin(), job.requested_fields->end());
+
+		unordered_map<int, int> new_pid;
+		for (MedIdSamples &ids : job.samples->idSamples) {
+			auto ins = new_pid.insert({ ids.id, n_pids + 1 });
+			if (ins.second) n_pids++;
+			batch_samples.idSamples.push_back(ids);
+			MedIdSamples &b_ids = batch_samples.idSamples.back();
+			b_ids.id = ins.first->second;
+			for (MedSample &s : b_ids.samples)
+				s.id = b_ids.id;
+		}
+
+		InMemDataBuffer &data = job.rep->in_mem_rep.data;
+		for (auto &e : data.get_entries()) {
+			auto it = new_pid.find(e.pid);
+			if (it == new_pid.end())
+				continue;
+			int len;
+			void *src = data.get(e.pid, e.sid, len);
+			char *dst = batch_rep.in_mem_rep.data.append(it->second, e.sid, e.n_elem, e.n_bytes);
+			if (e.n_bytes > 0)
+				memcpy(dst, src, e.n_bytes);
+		}
+	}
+
+	vector<Effected_Field> batch_fields(fields.begin(), fields.end());
+	int rc = 0;
+	try {
+		model.no_init_apply_partial(ctx, batch_rep, batch_samples, batch_fields);
+	}
+	catch (...) {
+		rc = -1;
+	}
+
+	// split back, restoring the original pids
+	size_t pos = 0;
+	for (size_t k = 0; k < batch.size(); k++) {
+		Job &job = *batch[k];
+		job.rc = rc;
+		for (MedIdSamples &ids : job.samples->idSamples) {
+			int orig_pid = ids.id;
+			ids = batch_samples.idSamples[pos++];
+			ids.id = orig_pid;
+			for (MedSample &s : ids.samples)
+				s.id = orig_pid;
+		}
+	}
+	batch_rep.in_mem_rep.clear();
+}
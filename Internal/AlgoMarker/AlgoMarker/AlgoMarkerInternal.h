@@ -7,8 +7,11 @@
 #include <MedProcessTools/MedProcessTools/ExplainWrapper.h>
 #include <MedStat/MedStat/MedBootstrap.h>
 #include "InputTesters.h"
+#include "AlgoMarkerBundle.h"
 #include "AlgoMarkerErr.h"
 #include <cmath>
+#include <mutex>
+#include <condition_variable>
 
 #define LOCAL_SECTION LOG_APP
 #define LOCAL_LEVEL	LOG_DEF_LEVEL
@@ -145,6 +148,63 @@ public:
 		ADD_SERIALIZATION_FUNCS(max_threshold, num_groups, cfg, ignore_groups_list, total_max_reasons, total_max_pos_reasons, total_max_neg_reasons, threshold_abs, threshold_percentage, static_features_info)
 };
 
+//===============================================================================
+// AMApplyBatcher - micro batching of concurrent model applications.
+// Sessions of the same AlgoMarker that apply the model at about the same time are
+// collected for up to window_ms (or until max_samples samples are waiting) and are
+// scored together in a single model application, each getting back its own samples.
+//===============================================================================
+class AMApplyBatcher {
+public:
+	int window_ms = 0; ///< collection window. 0 : no batching
+	int max_samples = 1000; ///< a batch is started as soon as this many samples are waiting
+
+	bool active() const { return window_ms > 0; }
+
+	/// apply the model on samples (with the data of rep) as part of a batch, returns when the samples are scored.
+	/// a batch is scored with the model and apply context of the session that collected it.
+	int apply(const MedModel &model, MedModelApplyContext &ctx, MedPidRepository &rep, MedSamples &samples, const vector<Effected_Field> &requested_fields);
+
+	/// a request (of any session) is in progress : it may still reach apply(), hence a leader waits for it.
+	/// a leader stops waiting as soon as all requests in progress joined, so a lone request is not delayed.
+	void enter();
+	void leave();
+
+	/// RAII enter()/leave() around a request, does nothing when batching is off
+	class Request {
+	public:
+		Request(AMApplyBatcher *_b) : b(_b->active() ? _b : NULL) { if (b) b->enter(); }
+		~Request() { if (b) b->leave(); }
+	private:
+		AMApplyBatcher *b;
+	};
+
+private:
+	struct Job {
+		MedPidRepository *rep;
+		MedSamples *samples;
+		const vector<Effected_Field> *requested_fields;
+		int rc = 0;
+		bool done = false;
+	};
+
+	mutex jobs_mutex;
+	condition_variable cv_collect, cv_done;
+	vector<Job *> pending;
+	int n_pending_samples = 0;
+	bool collecting = false;
+	int n_active = 0; ///< requests in progress (see enter())
+	int n_scoring = 0; ///< requests taken by a leader and not done yet
+
+	/// called with jobs_mutex held
+	bool batch_ready() const { return n_pending_samples >= max_samples || (int)pending.size() + n_scoring >= n_active; }
+
+	/// repositories holding the data of all jobs of a batch (pids are renumbered), one per batch being scored
+	vector<unique_ptr<MedPidRepository>> free_batch_reps;
+
+	void apply_batch(const MedModel &model, MedModelApplyContext &ctx, MedPidRepository &batch_rep, vector<Job *> &batch);
+};
+
 //===============================================================================
 // MedAlgoMarkerInternal - a mid-way API class : hiding all details of 
 // implementation that are specific to the base classes (MedRepository, MedSamples, MedModel)
@@ -155,10 +215,19 @@ class  MedAlgoMarkerInternal {
 private:
 	// we force working ONLY using the API
 
-	MedPidRepository rep;
+	unique_ptr<MedPidRepository> rep = unique_ptr<MedPidRepository>(new MedPidRepository);
 	MedModel model;
 	MedSamples samples;
+
+	// the model is applied through apply_ctx, which keeps the state of an apply. Sessions (see init_session) apply the model of
+	// the AlgoMarker they were created from, each with its own context, unless that model keeps apply state in itself
+	const MedModel *apply_model = &model;
+	MedModelApplyContext apply_ctx;
+	mutex session_mutex;
+	AMApplyBatcher batcher;
+	AMApplyBatcher *p_batcher = &batcher;
 	unordered_map<int, unordered_map<string, unordered_set<string>>> unknown_codes;
+	AlgoMarkerBundle bundle; // held between init_rep_from_bundle() and init_model_from_bundle()
 	Explainer_parameters explainer_params;
 	//InputSanityTester ist;
 	map<string, map<string, float>> mbr; ///< read bootstrap cohort, then measure and then value
@@ -173,7 +242,7 @@ private:
 	bool model_rep_done = false;
 public:
 
-	MedPidRepository & get_rep() { return rep; }
+	MedPidRepository & get_rep() { return *rep; }
 	//========================================================
 	// Initializations
 	//========================================================
@@ -184,12 +253,30 @@ public:
 
 	// init repository config
 	int init_rep_config(const char *config_fname) {
-		rep.switch_to_in_mem_mode();
-		if (rep.MedRepository::init(string(config_fname)) < 0) return -1;
+		rep->switch_to_in_mem_mode();
+		if (rep->MedRepository::init(string(config_fname)) < 0) return -1;
 
 		return 0;
 	}
 
+	// init repository config from a bundle (see AlgoMarkerBundle). returns -1 if the bundle can't be used,
+	// in which case the repository is left for init_rep_config()
+	int init_rep_from_bundle(const char *bundle_fname, const char *config_fname) {
+		int rc = -1;
+		try {
+			if (bundle.read_from_file(string(bundle_fname)) == 0 && !bundle.is_stale())
+				rc = bundle.init_rep(*rep, string(config_fname));
+		}
+		catch (...) {
+			rc = -1;
+		}
+		if (rc < 0) {
+			bundle.clear();
+			rep->dict.clear();
+		}
+		return rc;
+	}
+
 	// set time_unit env for repositories and models
 	int set_time_unit_env(int time_unit) {
 		global_default_time_unit = time_unit;
@@ -201,20 +288,32 @@ public:
 
 	// init rep , model , samples
 	int init_rep_with_file_data(const char *_rep_fname) {
-		rep.clear();
+		rep->clear();
 		rep_fname = string(_rep_fname);
 		vector<string> sigs = {};
-		return (rep.read_all(rep_fname, pids, sigs));
+		return (rep->read_all(rep_fname, pids, sigs));
 	}
 
 	// init model
 	int init_model_from_file(const char *_model_fname) { model.clear();	model.verbosity = 0; return (model.read_from_file(string(_model_fname))); }
+	int init_model_from_bundle() {
+		int rc;
+		model.clear(); model.verbosity = 0;
+		try {
+			rc = bundle.init_model(model);
+		}
+		catch (...) {
+			rc = -1;
+		}
+		bundle.clear();
+		return rc;
+	}
 	int model_check_required_signals() {
 		int ret = 0;
 		vector<string> req_sigs;
 		model.get_required_signal_names(req_sigs);
 		for (const auto& s : req_sigs)
-			if (0 == rep.sigs.Name2Sid.count(s)) {
+			if (0 == rep->sigs.Name2Sid.count(s)) {
 				ret = -1;
 				fprintf(stderr, "ERROR: AM model requires signal '%s' but signal does not exist in AM repository .signals file\n", s.c_str());
 			}
@@ -225,18 +324,18 @@ public:
 	int init_model_for_apply() {
 		global_logger.log(LOG_APP, LOG_DEF_LEVEL, "Init MedModel for Apply\n");
 		model_init_done = true;
-		return model.init_model_for_apply(rep, MED_MDL_APPLY_FTR_GENERATORS, MED_MDL_END);
+		return model.init_model_for_apply(*rep, MED_MDL_APPLY_FTR_GENERATORS, MED_MDL_END);
 	}
 
 	void fit_model_to_rep() {
-		model.fit_for_repository(rep);
+		model.fit_for_repository(*rep);
 	}
 
 	int init_model_for_rep() {
 		//global_logger.log(LOG_APP, LOG_DEF_LEVEL, "Init MedModel for Rep\n");
 		if (!model_rep_done) {
 			model_rep_done = true;
-			return model.init_model_for_apply(rep, MED_MDL_APPLY_FTR_GENERATORS, MED_MDL_APPLY_FTR_PROCESSORS);
+			return model.init_model_for_apply(*rep, MED_MDL_APPLY_FTR_GENERATORS, MED_MDL_APPLY_FTR_PROCESSORS);
 		}
 		return 0;
 	}
@@ -251,46 +350,50 @@ public:
 	// init input_tester
 	//int init_input_tester(const char *_fname) { return ist.read_config(string(_fname)); }
 
-	void add_json_dict(json &js) { rep.dict.add_json(js); }
+	void add_json_dict(json &js) { rep->dict.add_json(js); }
 
 	bool model_initiated() { return model_init_done; }
 
+	// requests batching (applies to sessions, see AMApplyBatcher)
+	void set_batching(int window_ms, int max_samples) { batcher.window_ms = window_ms; batcher.max_samples = max_samples; }
+	AMApplyBatcher *get_batcher() { return p_batcher; }
+
 	//========================================================
 	// Loading data to rep
 	//========================================================
 
 	 // init loading : actions that must be taken BEFORE any loading starts
-	int data_load_init() { unknown_codes.clear(); rep.switch_to_in_mem_mode(); return 0; }
+	int data_load_init() { unknown_codes.clear(); rep->switch_to_in_mem_mode(); return 0; }
 
 	// load n_elems for a pid,sig
 	int data_load_pid_sig(int pid, const char *sig_name, int *times, float *vals, int n_elems) {
-		int sid = rep.sigs.Name2Sid[string(sig_name)];
+		int sid = rep->sigs.Name2Sid[string(sig_name)];
 		if (sid < 0) return -1; // no such signal
-		int n_times = n_elems * rep.sigs.Sid2Info[sid].n_time_channels, n_vals = n_elems * rep.sigs.Sid2Info[sid].n_val_channels;
+		int n_times = n_elems * rep->sigs.Sid2Info[sid].n_time_channels, n_vals = n_elems * rep->sigs.Sid2Info[sid].n_val_channels;
 		if (times == NULL) n_times = 0;
 		if (vals == NULL) n_vals = 0;
-		return rep.in_mem_rep.insertData(pid, sid, times, vals, n_times, n_vals);
+		return rep->in_mem_rep.insertData(pid, sid, times, vals, n_times, n_vals);
 	}
 
 	// load pid,sig with vectors of times and vals
 	int data_load_pid_sig(int pid, const char *sig_name, int *times, int n_times, float *vals, int n_vals,
-	map<pair<int, int>, pair<int, vector<char>>> *data = NULL) {
-		int sid = rep.sigs.Name2Sid[string(sig_name)];
+	InMemDataBuffer *data = NULL) {
+		int sid = rep->sigs.Name2Sid[string(sig_name)];
 		if (sid < 0) return -1; // no such signal
 		if (data == NULL)
-			data = &rep.in_mem_rep.data;
-		return rep.in_mem_rep.insertData_to_buffer(pid, sid, times, vals, n_times, n_vals, rep.sigs, *data);
+			data = &rep->in_mem_rep.data;
+		return rep->in_mem_rep.insertData_to_buffer(pid, sid, times, vals, n_times, n_vals, rep->sigs, *data);
 	}
 
 	// load a single element for a pid,sig
 	int data_load_pid_sig(int pid, const char *sig_name, int *times, float *vals) { return data_load_pid_sig(pid, sig_name, times, vals, 1); }
 
 	// end loading : actions that must be taken AFTER all loading was done, and BEFORE we calculate the predictions
-	int data_load_end() { return rep.in_mem_rep.sortData(); }
+	int data_load_end() { return rep->in_mem_rep.sortData(); }
 
 	void get_rep_signals(unordered_set<string> &sigs)
 	{
-		for (auto &sig : rep.sigs.signals_names)
+		for (auto &sig : rep->sigs.signals_names)
 		{
 			sigs.insert(sig);
 		}
@@ -338,7 +441,7 @@ public:
 		// init_samples
 		init_samples(_pids, times, n_samples);
 		if (_rep == NULL)
-			_rep = &this->rep;
+			_rep = rep.get();
 		return get_raw_preds(_pids, times, preds, requested_fields, _rep);
 	}
 
@@ -349,8 +452,14 @@ public:
 
 			try {
 				// run model to calculate predictions
-				if (!samples.idSamples.empty())
-					model.no_init_apply_partial(*_rep, samples, requested_fields);
+				if (!samples.idSamples.empty()) {
+					if (p_batcher->active()) {
+						if (p_batcher->apply(*apply_model, apply_ctx, *_rep, samples, requested_fields) < 0)
+							return -1;
+					}
+					else
+						apply_model->no_init_apply_partial(apply_ctx, *_rep, samples, requested_fields);
+				}
 			}
 			catch (...) {
 				fprintf(stderr, "Caught an exception in no_init_apply_partial\n");
@@ -389,7 +498,7 @@ public:
 			try {
 				// run model to calculate predictions
 				if (!samples.idSamples.empty())
-					if (model.no_init_apply(rep, samples, (MedModelStage)0, (MedModelStage)model_end_stage) < 0) {
+					if (apply_model->no_init_apply(apply_ctx, *rep, samples, (MedModelStage)0, (MedModelStage)model_end_stage) < 0) {
 						fprintf(stderr, "ERROR: MedAlgoMarkerInternal::get_preds FAILED.");
 						return -1;
 					}
@@ -428,7 +537,7 @@ public:
 		samples = _samples;
 
 		// run model to calculate predictions
-		if (model.no_init_apply(rep, samples, (MedModelStage)0, (MedModelStage)model_end_stage) < 0) {
+		if (apply_model->no_init_apply(apply_ctx, *rep, samples, (MedModelStage)0, (MedModelStage)model_end_stage) < 0) {
 			fprintf(stderr, "ERROR: MedAlgoMarkerInternal::get_preds FAILED.");
 			return -1;
 		}
@@ -445,14 +554,62 @@ public:
 	int get_pred(int *pid, int *time, float *pred) { return get_preds(pid, time, pred, 1); }
 
 
+	//========================================================
+	// Sessions
+	//========================================================
+
+	// init as a scoring session of a loaded parent : the model and dictionaries of the parent are shared (read only), the
+	// signals and explainer/threshold settings are copied, data, samples and the apply context are the session's own,
+	// so sessions apply in parallel with no shared lock. A model keeping apply state in its parts (see
+	// MedModel::supports_context_apply) is cloned instead. The model, dictionaries and batcher are the parent's, hence
+	// the parent must outlive its sessions. Returns -1 if the parent model could not be initialized for apply
+	int init_session(MedAlgoMarkerInternal &parent) {
+		name = parent.name;
+		model_fname = parent.model_fname;
+		rep_fname = parent.rep_fname;
+		model_end_stage = parent.model_end_stage;
+		explainer_params = parent.explainer_params;
+		mbr = parent.mbr;
+		default_threshold = parent.default_threshold;
+
+		p_batcher = parent.p_batcher;
+		model.clear();
+		apply_ctx.clear();
+		{
+			// the parent model is initialized once, by the first session (it may add virtual signals to the parent)
+			lock_guard<mutex> guard(parent.session_mutex);
+			if (!parent.model_init_done && parent.init_model_for_apply() < 0)
+				return -1;
+			if (parent.model.supports_context_apply()) {
+				apply_model = &parent.model;
+				model_init_done = true;
+				model_rep_done = true;
+			}
+			else {
+				parent.model.clone_model(model);
+				model.verbosity = parent.model.verbosity;
+				apply_model = &model;
+				model_init_done = false;
+				model_rep_done = false;
+			}
+		}
+
+		rep.reset(new MedPidRepository(parent.rep->dict));
+		rep->sigs = parent.rep->sigs;
+		rep->sigs.my_repo = rep.get();
+		rep->time_unit = parent.rep->time_unit;
+		data_load_init();
+		return 0;
+	}
+
 	//========================================================
 	// Clearing - freeing mem
 	//========================================================
-	void clear() { unknown_codes.clear(); pids.clear(); model.clear(); samples.clear(); rep.in_mem_rep.clear(); rep.clear(); }
+	void clear() { unknown_codes.clear(); pids.clear(); bundle.clear(); model.clear(); samples.clear(); rep->in_mem_rep.clear(); rep->clear(); apply_model = &model; apply_ctx.clear(); p_batcher = &batcher; }
 
 	// clear_data() : leave model up, leave repository config up, but get rid of data and samples
 	void clear_data() {
-		samples.clear(); rep.in_mem_rep.clear(); unknown_codes.clear();
+		samples.clear(); rep->in_mem_rep.clear(); unknown_codes.clear();
 	}
 
 
@@ -461,20 +618,20 @@ public:
 	//========================================================
 	const char *get_name() { return name.c_str(); }
 
-	void write_features_mat(const string &feat_mat) { model.write_feature_matrix(feat_mat); }
-	void add_features_mat(const string &feat_mat) { model.write_feature_matrix(feat_mat, false, true); }
+	void write_features_mat(const string &feat_mat) { apply_ctx.features.write_as_csv_mat(feat_mat, false); }
+	void add_features_mat(const string &feat_mat) { apply_ctx.features.add_to_csv_mat(feat_mat, false, 0); }
 
 	void get_signal_structure(string &sig, int &n_time_channels, int &n_val_channels, int* &is_categ)
 	{
-		int sid = this->rep.sigs.sid(sig);
+		int sid = this->rep->sigs.sid(sig);
 		if (sid <= 0) {
 			n_time_channels = 0;
 			n_val_channels = 0;
 		}
 		else {
-			n_time_channels = this->rep.sigs.Sid2Info[sid].n_time_channels;
-			n_val_channels = this->rep.sigs.Sid2Info[sid].n_val_channels;
-			is_categ = &(this->rep.sigs.Sid2Info[sid].is_categorical_per_val_channel[0]);
+			n_time_channels = this->rep->sigs.Sid2Info[sid].n_time_channels;
+			n_val_channels = this->rep->sigs.Sid2Info[sid].n_val_channels;
+			is_categ = &(this->rep->sigs.Sid2Info[sid].is_categorical_per_val_channel[0]);
 		}
 	}
 
@@ -492,13 +649,13 @@ public:
 	}
 
 	string model_version_info() const {
-		return model.version_info;
+		return apply_model->version_info;
 	}
 
 	void get_model_signals_info(vector<string> &sigs,
 		unordered_map<string, vector<string>> &res_categ) const {
-		model.get_required_signal_names(sigs);
-		model.get_required_signal_categories(res_categ);
+		apply_model->get_required_signal_names(sigs);
+		apply_model->get_required_signal_categories(res_categ);
 	}
 
 	void get_explainer_params(Explainer_parameters &out) const {
@@ -507,7 +664,7 @@ public:
 
 	void get_explainer_output_options(vector<string> &opts) {
 		vector<const PostProcessor *> flat;
-		for (const PostProcessor *pp : model.post_processors) {
+		for (const PostProcessor *pp : apply_model->post_processors) {
 			if (pp->processor_type == PostProcessorTypes::FTR_POSTPROCESS_MULTI)
 			{
 				const MultiPostProcessor *multi = static_cast<const MultiPostProcessor *>(pp);
@@ -123,10 +123,20 @@ int MedialInfraAlgoMarker::Load(const char *config_f)
 	// prepare internal ma for work: set name, rep and model
 	ma.set_name(get_name());
 	ma.set_model_end_stage(model_end_stage);
+	ma.set_batching(batch_window_ms, batch_max_samples);
+
+	// a bundle replaces parsing the repository and model files, unless it is missing or stale
+	bool from_bundle = false;
+	if (bundle_fname != "")
+	{
+		from_bundle = (ma.init_rep_from_bundle(bundle_fname.c_str(), rep_fname.c_str()) == 0);
+		if (!from_bundle)
+			MWARN("WARNING: can't use bundle %s, reading repository and model files\n", bundle_fname.c_str());
+	}
 
 	try
 	{
-		if (ma.init_rep_config(rep_fname.c_str()) < 0)
+		if (!from_bundle && ma.init_rep_config(rep_fname.c_str()) < 0)
 			return AM_ERROR_LOAD_READ_REP_ERR;
 	}
 	catch (...)
@@ -138,7 +148,12 @@ int MedialInfraAlgoMarker::Load(const char *config_f)
 
 	try
 	{
-		if (ma.init_model_from_file(model_fname.c_str()) < 0)
+		if (from_bundle && ma.init_model_from_bundle() < 0)
+		{
+			MWARN("WARNING: can't read model from bundle %s, reading model file\n", bundle_fname.c_str());
+			from_bundle = false;
+		}
+		if (!from_bundle && ma.init_model_from_file(model_fname.c_str()) < 0)
 			return AM_ERROR_LOAD_READ_MODEL_ERR;
 		if (allow_rep_adjustments)
 			ma.fit_model_to_rep();
@@ -175,6 +190,76 @@ int MedialInfraAlgoMarker::Unload()
 	return AM_OK_RC;
 }
 
+//-----------------------------------------------------------------------------------
+// CreateSession() - a new MedialInfraAlgoMarker sharing the model and dictionaries of this one, with its own
+// repository data and samples. Returns NULL if not loaded.
+//-----------------------------------------------------------------------------------
+AlgoMarker *MedialInfraAlgoMarker::CreateSession()
+{
+	if (!is_loaded)
+		return NULL;
+
+	MedialInfraAlgoMarker *session = new MedialInfraAlgoMarker;
+	*(AlgoMarker *)session = *(AlgoMarker *)this;
+	session->type_in_config_file = type_in_config_file;
+	session->rep_fname = rep_fname;
+	session->model_fname = model_fname;
+	session->bundle_fname = bundle_fname;
+	session->input_tester_config_file = input_tester_config_file;
+	session->allow_rep_adjustments = allow_rep_adjustments;
+	session->sort_needed = sort_needed;
+	session->model_end_stage = model_end_stage;
+	session->extended_result_fields = extended_result_fields;
+
+	if (input_tester_config_file != "" && session->ist.read_config(input_tester_config_file) < 0) {
+		MERR("ERROR: Could not read testers config file %s\n", input_tester_config_file.c_str());
+		delete session;
+		return NULL;
+	}
+
+	if (session->ma.init_session(ma) < 0) {
+		MERR("ERROR: Could not init the model for apply for a session\n");
+		delete session;
+		return NULL;
+	}
+	session->is_loaded = true;
+
+	return session;
+}
+
+//-----------------------------------------------------------------------------------
+// WriteBundle() - writes an AlgoMarkerBundle of the repository config and model of a
+// config file, to bundle_f or (if empty) to the BUNDLE file given in the config.
+//-----------------------------------------------------------------------------------
+int MedialInfraAlgoMarker::WriteBundle(const char *config_f, const char *bundle_f)
+{
+	int rc = read_config(string(config_f));
+	if (rc != AM_OK_RC)
+		return rc;
+
+	string out_fname = (bundle_f != NULL && bundle_f[0] != 0) ? string(bundle_f) : bundle_fname;
+	if (out_fname == "")
+	{
+		MERR("ERROR: no bundle file given and no BUNDLE in %s\n", config_f);
+		return AM_FAIL_RC;
+	}
+
+	AlgoMarkerBundle bundle;
+	try
+	{
+		if (bundle.create(rep_fname, model_fname) < 0)
+			return AM_ERROR_LOAD_READ_REP_ERR;
+	}
+	catch (...)
+	{
+		return AM_ERROR_LOAD_READ_REP_ERR;
+	}
+	if (bundle.write_to_file(out_fname) < 0)
+		return AM_FAIL_RC;
+
+	return AM_OK_RC;
+}
+
 //-----------------------------------------------------------------------------------
 // ClearData() - clearing current data inserted inside.
 //-----------------------------------------------------------------------------------
@@ -188,7 +273,7 @@ int MedialInfraAlgoMarker::ClearData()
 // AddData() - adding data for a signal with values and timestamps
 //-----------------------------------------------------------------------------------
 int MedialInfraAlgoMarker::AddData_data(int patient_id, const char *signalName, int TimeStamps_len, long long *TimeStamps, int Values_len, float *Values,
-										map<pair<int, int>, pair<int, vector<char>>> *data)
+										InMemDataBuffer *data)
 {
 	// At the moment MedialInfraAlgoMarker only loads timestamps given as ints.
 	// This may change in the future as needed.
@@ -224,7 +309,7 @@ int MedialInfraAlgoMarker::AddData_data(int patient_id, const char *signalName,
 int MedialInfraAlgoMarker::AddData(int patient_id, const char *signalName, int TimeStamps_len, long long *TimeStamps, int Values_len, float *Values)
 {
 	MedRepository &rep = ma.get_rep();
-	map<pair<int, int>, pair<int, vector<char>>> *data = &rep.in_mem_rep.data;
+	InMemDataBuffer *data = &rep.in_mem_rep.data;
 	return AddData_data(patient_id, signalName, TimeStamps_len, TimeStamps, Values_len, Values, data);
 }
 
@@ -232,7 +317,7 @@ int MedialInfraAlgoMarker::AddData(int patient_id, const char *signalName, int T
 // AddDatStr() - adding data for a signal with values and timestamps
 //-----------------------------------------------------------------------------------
 int MedialInfraAlgoMarker::AddDataStr_data(int patient_id, const char *signalName, int TimeStamps_len, long long *TimeStamps, int Values_len, char **Values,
-										   map<pair<int, int>, pair<int, vector<char>>> *data)
+										   InMemDataBuffer *data)
 {
 	vector<float> converted_Values;
 	vector<long long> final_tm;
@@ -312,7 +397,7 @@ int MedialInfraAlgoMarker::AddDataStr_data(int patient_id, const char *signalNam
 int MedialInfraAlgoMarker::AddDataStr(int patient_id, const char *signalName, int TimeStamps_len, long long *TimeStamps, int Values_len, char **Values)
 {
 	MedRepository &rep = ma.get_rep();
-	map<pair<int, int>, pair<int, vector<char>>> *data = &rep.in_mem_rep.data;
+	InMemDataBuffer *data = &rep.in_mem_rep.data;
 	return AddDataStr_data(patient_id, signalName, TimeStamps_len, TimeStamps, Values_len, Values, data);
 }
 
@@ -1065,6 +1150,7 @@ int MedialInfraAlgoMarker::CalculateByType(int CalculateType, char *request, cha
 {
 	if (CalculateType != JSON_REQ_JSON_RESP)
 		return AM_FAIL_RC;
+	AMApplyBatcher::Request batch_request(ma.get_batcher());
 
 #ifdef AM_TIMING_LOGS
 	ma.model_apply_verbose(true);
@@ -1151,7 +1237,7 @@ int MedialInfraAlgoMarker::CalculateByType(int CalculateType, char *request, cha
 
 	bool has_load_data = false;
 	MedPidRepository *rep = &ma.get_rep();
-	map<pair<int, int>, pair<int, vector<char>>> new_data;
+	InMemDataBuffer new_data;
 	vector<vector<string>> all_load_data_msgs(jreq["requests"].size());
 	int req_id = 0;
 	for (auto &jreq_i : jreq["requests"])
@@ -1195,9 +1281,8 @@ int MedialInfraAlgoMarker::CalculateByType(int CalculateType, char *request, cha
 		rep_copy.in_mem_rep.sortData();
 		rep = &rep_copy;
 		// Debug print new_data:
-		// for (auto &it : rep->in_mem_rep.data) {
-		//	MLOG("pid: %d, signal: %s, size: %zu\n", it.first.first, rep->sigs.name(it.first.second).c_str(),
-		//	it.second.second.size());
+		// for (auto &it : rep->in_mem_rep.data.get_entries()) {
+		//	MLOG("pid: %d, signal: %s, size: %d\n", it.pid, rep->sigs.name(it.sid).c_str(), it.n_bytes);
 		// }
 
 		// Test get BDATE
@@ -1560,6 +1645,8 @@ int MedialInfraAlgoMarker::read_config(const string &conf_f)
 					rep_fname = fields[1];
 				else if (fields[0] == "MODEL")
 					model_fname = fields[1];
+				else if (fields[0] == "BUNDLE")
+					bundle_fname = fields[1];
 				else if (fields[0] == "ALLOW_REP_ADJUSTMENTS")
 					allow_rep_adjustments = stoi(fields[1]) > 0;
 				else if (fields[0] == "MODEL_END_STAGE")
@@ -1581,6 +1668,10 @@ int MedialInfraAlgoMarker::read_config(const string &conf_f)
 				{
 					set_time_unit(med_time_converter.string_to_type(fields[1].c_str()));
 				}
+				else if (fields[0] == "BATCH_WINDOW_MS")
+					batch_window_ms = stoi(fields[1]);
+				else if (fields[0] == "BATCH_MAX_SAMPLES")
+					batch_max_samples = stoi(fields[1]);
 				else if (fields[0] == "DEBUG_MATRIX")
 					am_matrix = fields[1];
 				else if (fields[0] == "AM_UDI_DI")
@@ -1617,6 +1708,12 @@ int MedialInfraAlgoMarker::read_config(const string &conf_f)
 		model_fname = dir + "/" + model_fname;
 	}
 
+	if (bundle_fname != "" && bundle_fname[0] != '/' && bundle_fname[0] != '\\')
+	{
+		// relative path
+		bundle_fname = dir + "/" + bundle_fname;
+	}
+
 	if (input_tester_config_file == ".")
 	{
 		input_tester_config_file = conf_f; // option to use the general config file as the file to config the tester as well.
@@ -1682,7 +1779,7 @@ string construct_message(int code, const string &msg)
 }
 
 //-----------------------------------------------------------------------------------
-int MedialInfraAlgoMarker::AddJsonData(int patient_id, json &j_data, vector<string> &messages, map<pair<int, int>, pair<int, vector<char>>> *data)
+int MedialInfraAlgoMarker::AddJsonData(int patient_id, json &j_data, vector<string> &messages, InMemDataBuffer *data)
 {
 	string current_time = "";
 
@@ -2602,11 +2699,10 @@ void MedialInfraAlgoMarker::show_rep_data(char **response)
 	nlohmann::ordered_json js;
 	js["data"] = nlohmann::ordered_json::array();
 	unordered_map<int, unordered_set<string>> pid_to_signals;
-	for (auto &it : rep.in_mem_rep.data)
+	for (auto &it : rep.in_mem_rep.data.get_entries())
 	{
-		const pair<int, int> &pid_sig = it.first;
-		const string &sig_name = rep.sigs.name(pid_sig.second);
-		pid_to_signals[pid_sig.first].insert(sig_name);
+		const string &sig_name = rep.sigs.name(it.sid);
+		pid_to_signals[it.pid].insert(sig_name);
 	}
 	for (auto &it : pid_to_signals)
 	{
@@ -1517,14 +1517,11 @@ int main(int argc, char *argv[])
 			if (currect_section > 0)
 				rep.dict.connect_to_section(it.first, currect_section);
 
-			int add_section = rep.dict.section_id(it.first);
-			rep.dict.dicts[add_section].Name2Id[it.first] = source_sid;
-			rep.dict.dicts[0].Name2Id[it.first] = source_sid;
-			rep.dict.dicts[add_section].Id2Name[source_sid] = it.first;
-			rep.dict.dicts[add_section].Id2Names[source_sid] = {it.first};
+			rep.dict.push_new_signal_def(it.first, source_sid);
 			rep.sigs.Sid2Info[source_sid].time_unit = rep.sigs.my_repo->time_unit;
 		}
 	}
+	rep.dict.compile();
 
 	if (ignore_sig.size() > 0)
 	{
@@ -1553,13 +1550,10 @@ int main(int argc, char *argv[])
 			MLOG("Add virtual %s of type [%s]\n", it.second.c_str(), sig_spec.c_str());
 
 			int vsig_id = rep.sigs.insert_virtual_signal(it.second, sig_spec);
-			int add_section = rep.dict.section_id(it.second);
-			rep.dict.dicts[add_section].Name2Id[it.second] = vsig_id;
-			rep.dict.dicts[0].Name2Id[it.second] = vsig_id;
-			rep.dict.dicts[add_section].Id2Name[vsig_id] = it.second;
-			rep.dict.dicts[add_section].Id2Names[vsig_id] = {it.second};
+			rep.dict.push_new_signal_def(it.second, vsig_id);
 			rep.sigs.Sid2Info[vsig_id].time_unit = rep.sigs.my_repo->time_unit;
 		}
+		rep.dict.compile();
 	}
 
 	// apply model (+ print top 50 scores)
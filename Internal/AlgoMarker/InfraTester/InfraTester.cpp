@@ -0,0 +1,109 @@
+//
+// InfraTester : runs the infrastructure tests (all by default, or those given in --tests) and
+// returns non zero if any of them failed.
+//
+
+#include "InfraTester.h"
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+namespace po = boost::program_options;
+
+typedef int(*InfraTest)(const string &work_dir);
+
+static const vector<pair<string, InfraTest>> infra_tests = {
+	{ "typed_sig_view", test_typed_sig_view },
+	{ "tree_shap", test_tree_shap },
+	{ "serialization", test_serialization },
+	{ "overlays", test_overlays },
+	{ "sig_codec", test_sig_codec },
+	{ "values_multi", test_values_multi },
+	{ "window_index", test_window_index },
+	{ "value_sketch", test_value_sketch },
+	{ "knn_index", test_knn_index }
+};
+
+//=========================================================================================================
+int read_run_params(int argc, char *argv[], po::variables_map& vm) {
+	po::options_description desc("Program options");
+
+	try {
+		desc.add_options()
+			("help", "produce help message")
+			("tests", po::value<string>()->default_value("all"), "comma separated tests to run, or all")
+			("work_dir", po::value<string>()->default_value("/tmp/InfraTester"), "directory for the files written by the tests")
+			("list", "list the tests")
+			;
+
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		if (vm.count("help")) {
+			cerr << desc << "\n";
+			exit(-1);
+		}
+		po::notify(vm);
+	}
+	catch (exception& e) {
+		cerr << "error: " << e.what() << "; run with --help for usage information\n";
+		return -1;
+	}
+	catch (...) {
+		cerr << "Exception of unknown type!\n";
+		return -1;
+	}
+
+	return 0;
+}
+
+//========================================================================================
+// MAIN
+//========================================================================================
+int main(int argc, char *argv[])
+{
+	po::variables_map vm;
+	if (read_run_params(argc, argv, vm) < 0)
+		return -1;
+
+	if (vm.count("list")) {
+		for (auto &t : infra_tests)
+			cout << t.first << "\n";
+		return 0;
+	}
+
+	string work_dir = vm["work_dir"].as<string>();
+	vector<string> names;
+	boost::split(names, vm["tests"].as<string>(), boost::is_any_of(","));
+	bool all = (names.size() == 1 && names[0] == "all");
+	for (const string &name : names)
+		if (!all && find_if(infra_tests.begin(), infra_tests.end(), [&name](const pair<string, InfraTest> &t) { return t.first == name; }) == infra_tests.end()) {
+			MERR("unknown test %s, run with --list for the tests\n", name.c_str());
+			return -1;
+		}
+
+	boost::filesystem::create_directories(work_dir);
+
+	int n_failed = 0, n_run = 0;
+	for (auto &t : infra_tests) {
+		if (!all && find(names.begin(), names.end(), t.first) == names.end())
+			continue;
+		int rc;
+		try {
+			rc = t.second(work_dir);
+		}
+		catch (exception &e) {
+			MERR("test %s threw : %s\n", t.first.c_str(), e.what());
+			rc = -1;
+		}
+		n_run++;
+		if (rc < 0)
+			n_failed++;
+		MLOG("%s : %s\n", t.first.c_str(), rc < 0 ? "FAILED" : "PASSED");
+	}
+
+	MLOG("%d tests run, %d failed\n", n_run, n_failed);
+	return n_failed > 0 ? 1 : 0;
+}
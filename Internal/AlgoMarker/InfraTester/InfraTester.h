@@ -0,0 +1,44 @@
+#pragma once
+//
+// InfraTester : self checking tests of infrastructure code.
+// Each test builds its own data (repositories are converted from text files into the work directory),
+// so no repository or model is needed. A test returns 0 if passed, -1 otherwise.
+//
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+//=========================================================================================================
+// tests
+//=========================================================================================================
+int test_typed_sig_view(const string &work_dir);
+int test_tree_shap(const string &work_dir);
+int test_serialization(const string &work_dir);
+int test_overlays(const string &work_dir);
+int test_sig_codec(const string &work_dir);
+int test_values_multi(const string &work_dir);
+int test_window_index(const string &work_dir);
+int test_value_sketch(const string &work_dir);
+int test_knn_index(const string &work_dir);
+
+//=========================================================================================================
+// a small test repository, written as MedConvert input files and converted into a mode 3 repository
+//=========================================================================================================
+// records of a pid and signal : (time, value). signals without a time channel (GENDER) have time 0,
+// categorical values (DIAG) are dictionary ids, written to the data files by their names
+typedef map<int, map<string, vector<pair<int, float>>>> TestRecs;
+
+// signals of the test repository : GENDER (value), LAB and LAB2 (date,value), DIAG (date,categorical value)
+extern const vector<string> test_rep_signals;
+
+// writes the signals and dictionary files into dir (once per dir)
+int write_test_rep_defs(const string &dir);
+
+// converts recs into dir/name/name.repository. extra_config is added to the convert config (e.g. COMPRESS, DELTA_OF)
+int convert_test_rep(const string &dir, const string &name, const TestRecs &recs, const vector<string> &extra_config, string &rep_config);
+
+// checks that the repository returns exactly recs for the given pids and signals (all pids of recs if pids is empty)
+int check_test_rep(const string &rep_config, const TestRecs &recs, const vector<int> &pids, const vector<string> &signals);
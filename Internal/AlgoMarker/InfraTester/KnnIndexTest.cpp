@@ -0,0 +1,102 @@
+//
+// KnnIndexTest : MedKNN kd-tree searches against the brute-force find_nbrs, on continuous data and on a small grid
+// of values (many equal distances, broken by row index in both), before and after serializing the model.
+// The neighbours and their distances must be identical.
+//
+
+#include "InfraTester.h"
+#include <random>
+#include <algorithm>
+#include <MedAlgo/MedAlgo/MedKNN.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+//=========================================================================================================
+// rows x nftrs values, continuous or on a grid of 5 values per feature
+static void make_knn_data(int rows, int nftrs, bool grid, mt19937 &gen, vector<float> &x)
+{
+	normal_distribution<float> normal(0, 1);
+	x.resize((size_t)rows * nftrs);
+	for (float &v : x)
+		v = grid ? (float)(gen() % 5) : normal(gen);
+}
+
+// neighbours sorted by (distance, row), the order within nbrs depends on the replacements
+static vector<pair<double, int>> sorted_nbrs(const vector<int> &nbrs, const vector<double> &dists)
+{
+	vector<pair<double, int>> res(nbrs.size());
+	for (size_t i = 0; i < nbrs.size(); i++)
+		res[i] = { dists[i], nbrs[i] };
+	sort(res.begin(), res.end());
+	return res;
+}
+
+static int run_knn_index_case(const string &name, bool grid, knnMetric metric, int k, int leaf_size, mt19937 &gen)
+{
+	const int n_learn = 2000, n_test = 300, nftrs = 4;
+
+	vector<float> learn_x, test_x, learn_y(n_learn);
+	make_knn_data(n_learn, nftrs, grid, gen, learn_x);
+	make_knn_data(n_test, nftrs, grid, gen, test_x);
+	for (float &y : learn_y)
+		y = (float)(gen() % 2);
+
+	MedKNN knn;
+	knn.params.k = k;
+	knn.params.knnMetr = metric;
+	knn.params.knnIndex = KNN_INDEX_KDTREE;
+	knn.params.leaf_size = leaf_size;
+	if (knn.Learn(learn_x.data(), learn_y.data(), NULL, n_learn, nftrs) < 0) {
+		MERR("test_knn_index: case %s : learning failed\n", name.c_str());
+		return -1;
+	}
+
+	vector<unsigned char> blob;
+	knn.serialize_vec(blob);
+	MedKNN copy;
+	copy.deserialize_vec(blob);
+
+	vector<int> order(nftrs);
+	order_ftrs(knn.x.data(), n_learn, nftrs, knn.w.data(), order.data());
+
+	int n_diffs = 0, n_ties = 0;
+	vector<int> nbrs(k);
+	vector<double> dists(k);
+	MedKNNIndex::SearchBuffers buffers;
+	for (int i = 0; i < n_test; i++) {
+		find_nbrs(test_x.data(), i, k, knn.x.data(), n_learn, nftrs, order.data(), knn.w.data(), nbrs.data(), dists.data(), metric, -1);
+		vector<pair<double, int>> brute = sorted_nbrs(nbrs, dists);
+		if (brute.back().first == brute[k - 2].first)
+			n_ties++;
+
+		for (const MedKNN *m : { &knn, &copy }) {
+			m->index.search(test_x.data(), i, m->x.data(), nftrs, k, m->params.hnsw_ef, buffers, nbrs.data(), dists.data());
+			if (sorted_nbrs(nbrs, dists) != brute && n_diffs++ < 5)
+				MERR("test_knn_index: case %s : %s index neighbours of test row %d differ from the brute-force search\n", name.c_str(),
+					m == &knn ? "learned" : "deserialized", i);
+		}
+	}
+
+	// the grid cases must exercise ties at the k-th neighbour
+	if (grid && n_ties == 0) {
+		MERR("test_knn_index: case %s : no ties at the k-th neighbour\n", name.c_str());
+		return -1;
+	}
+	MLOG("test_knn_index: case %s : %d test rows (%d with ties at the k-th neighbour), %d differ\n", name.c_str(), n_test, n_ties, n_diffs);
+	return n_diffs > 0 ? -1 : 0;
+}
+
+//=========================================================================================================
+int test_knn_index(const string &work_dir)
+{
+	mt19937 gen(13);
+	int rc = 0;
+	if (run_knn_index_case("continuous L1", false, KNN_L1, 10, 16, gen) < 0 ||
+		run_knn_index_case("continuous L2", false, KNN_L2, 10, 16, gen) < 0 ||
+		run_knn_index_case("grid L1", true, KNN_L1, 10, 16, gen) < 0 ||
+		run_knn_index_case("grid L2 small leaves", true, KNN_L2, 25, 2, gen) < 0)
+		rc = -1;
+	return rc;
+}
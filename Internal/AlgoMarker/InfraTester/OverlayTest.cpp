@@ -0,0 +1,154 @@
+//
+// OverlayTest : a compressed base repository with an append and a replace overlay (see MedRepository::overlays).
+// Full and partial loads must return the merged records, and after fold_overlays() the base alone must return them.
+// By pid reads do not merge overlays, so MedPidRepository::init must fail until they are folded.
+//
+
+#include "InfraTester.h"
+#include <fstream>
+#include <random>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <InfraMed/InfraMed/InfraMed.h>
+#include <InfraMed/InfraMed/MedPidRepository.h>
+#include <InfraMed/InfraMed/MedSigCodec.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+// date of the i-th record of a pid, records of a signal are 20 days apart
+static inline int rec_date(int i) { return 20200101 + 100 * (i / 2) + 20 * (i % 2); }
+
+//=========================================================================================================
+static void make_base_recs(TestRecs &recs)
+{
+	mt19937 gen(25);
+	for (int pid = 1; pid <= 20; pid++) {
+		recs[pid]["GENDER"] = { { 0, (float)(1 + gen() % 2) } };
+		for (int i = 0; i < 4; i++)
+			recs[pid]["LAB"].push_back({ rec_date(2 * i), (float)(gen() % 400) / 4 });
+		for (int i = 0; i < 2; i++)
+			recs[pid]["LAB2"].push_back({ rec_date(3 * i + 1), (float)(gen() % 100) / 2 });
+		for (int i = 0; i < 2; i++)
+			recs[pid]["DIAG"].push_back({ rec_date(4 * i + 3), (float)(1 + gen() % 20) });
+	}
+}
+
+// adds delta records to the expected merged records : in time order, records identical to an existing one are dropped
+static void merge_append(TestRecs &expected, const TestRecs &delta)
+{
+	for (auto &pid_recs : delta)
+		for (auto &sig_recs : pid_recs.second) {
+			vector<pair<int, float>> &v = expected[pid_recs.first][sig_recs.first];
+			for (auto &r : sig_recs.second)
+				if (find(v.begin(), v.end(), r) == v.end())
+					v.push_back(r);
+			stable_sort(v.begin(), v.end(), [](const pair<int, float> &a, const pair<int, float> &b) { return a.first < b.first; });
+		}
+}
+
+//=========================================================================================================
+static int check_no_overlays(const string &rep_config)
+{
+	ifstream inf(rep_config);
+	string line;
+	while (getline(inf, line))
+		if (line.compare(0, 7, "OVERLAY") == 0) {
+			MERR("test_overlays: %s still has %s\n", rep_config.c_str(), line.c_str());
+			return -1;
+		}
+	return 0;
+}
+
+static int check_compressed(const string &rep_config)
+{
+	MedRepository rep;
+	if (rep.init(rep_config) < 0)
+		return -1;
+	for (const string &sig : test_rep_signals) {
+		string data_fname = rep.data_fnames[rep.sigs.fno(sig)];
+		if (read_data_format(data_fname) != REPOSITORY_COMPRESSED_FORMAT) {
+			MERR("test_overlays: %s is not compressed\n", data_fname.c_str());
+			return -1;
+		}
+	}
+	return 0;
+}
+
+//=========================================================================================================
+int test_overlays(const string &work_dir)
+{
+	string dir = work_dir + "/overlays";
+	boost::filesystem::remove_all(dir);
+	if (write_test_rep_defs(dir) < 0)
+		return -1;
+
+	TestRecs base, append, replace;
+	make_base_recs(base);
+
+	// append : new records of existing pids, one of them between existing ones and one identical to an existing one
+	append[3]["LAB"] = { { rec_date(9), 42.5f }, { rec_date(3), 7.25f }, base[3]["LAB"][1] };
+	append[5]["DIAG"] = { { rec_date(10), 17 } };
+	append[11]["LAB"] = { { rec_date(1), 1.5f } };
+	append[11]["LAB2"] = { { rec_date(12), 2.5f } };
+
+	// replace : a changed pid (now without LAB2 and DIAG) and a new pid
+	replace[7]["GENDER"] = { { 0, 2 } };
+	replace[7]["LAB"] = { { rec_date(0), 10.0f }, { rec_date(5), 11.0f } };
+	replace[30]["GENDER"] = { { 0, 1 } };
+	replace[30]["LAB"] = { { rec_date(2), 30.5f } };
+	replace[30]["DIAG"] = { { rec_date(2), 4 }, { rec_date(6), 5 } };
+
+	string base_config, append_config, replace_config;
+	if (convert_test_rep(dir, "base", base, { "COMPRESS\t1" }, base_config) < 0 ||
+		convert_test_rep(dir, "append", append, { "DELTA_OF\tbase/base.repository", "DELTA_MODE\tappend" }, append_config) < 0 ||
+		convert_test_rep(dir, "replace", replace, { "DELTA_OF\tbase/base.repository", "DELTA_MODE\treplace" }, replace_config) < 0)
+		return -1;
+
+	TestRecs expected = base;
+	merge_append(expected, append);
+	for (auto &pid_recs : replace)
+		expected[pid_recs.first] = pid_recs.second;
+
+	if (check_compressed(base_config) < 0)
+		return -1;
+
+	// full and partial loads
+	if (check_test_rep(base_config, expected, {}, {}) < 0 ||
+		check_test_rep(base_config, expected, { 3, 5, 7, 12, 30 }, { "LAB", "DIAG" }) < 0 ||
+		check_test_rep(base_config, expected, { 7 }, { "LAB2" }) < 0)
+		return -1;
+
+	// by pid files written while the overlays are there
+	MedPidRepository by_pid;
+	if (by_pid.create(base_config, 1, 30, 0) < 0) {
+		MERR("test_overlays: failed creating the by pid files of %s\n", base_config.c_str());
+		return -1;
+	}
+	if (MedPidRepository().init(base_config) == 0) {
+		MERR("test_overlays: by pid init of %s succeeded with overlays\n", base_config.c_str());
+		return -1;
+	}
+
+	// folding, then reading the base without the deltas
+	MedRepository rep;
+	if (rep.init(base_config) < 0 || rep.fold_overlays() < 0) {
+		MERR("test_overlays: failed folding the overlays of %s\n", base_config.c_str());
+		return -1;
+	}
+	boost::filesystem::remove_all(dir + "/append");
+	boost::filesystem::remove_all(dir + "/replace");
+
+	if (check_no_overlays(base_config) < 0 || check_compressed(base_config) < 0 ||
+		check_test_rep(base_config, expected, {}, {}) < 0 ||
+		check_test_rep(base_config, expected, { 3, 7, 30 }, { "LAB" }) < 0)
+		return -1;
+
+	if (MedPidRepository().init(base_config) < 0) {
+		MERR("test_overlays: by pid init of %s failed after folding\n", base_config.c_str());
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+//
+// SerializationTest : streamed write_to_file / read_from_file against the blob serialize / deserialize.
+// The file body (after the version) must be byte-identical to serialize(blob), blob readers must read it,
+// and a file written as version + serialize(blob) must be read by the streamed reader.
+//
+
+#include "InfraTester.h"
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <boost/filesystem.hpp>
+#include <SerializableObject/SerializableObject/SerializableObject.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+//=========================================================================================================
+// an object with hand written serialization (no streaming support of its own)
+class TestHandObject : public SerializableObject {
+public:
+	vector<int> v;
+
+	size_t get_size() { return sizeof(int) * (v.size() + 1); }
+	size_t serialize(unsigned char *blob) {
+		int n = (int)v.size();
+		memcpy(blob, &n, sizeof(int));
+		memcpy(blob + sizeof(int), v.data(), sizeof(int) * n);
+		return sizeof(int) * (n + 1);
+	}
+	size_t deserialize(unsigned char *blob) {
+		int n;
+		memcpy(&n, blob, sizeof(int));
+		v.resize(n);
+		memcpy(v.data(), blob + sizeof(int), sizeof(int) * n);
+		return sizeof(int) * (n + 1);
+	}
+};
+MEDSERIALIZE_SUPPORT(TestHandObject)
+
+class TestEmptyObject : public SerializableObject {
+};
+MEDSERIALIZE_SUPPORT(TestEmptyObject)
+
+class TestTopObject : public SerializableObject {
+public:
+	int a = 0;
+	TestHandObject h;
+	TestEmptyObject e;
+	TestHandObject h2;
+	vector<TestHandObject> hv;
+	vector<float> big;
+	pair<int, string> p;
+	map<string, vector<int>> m;
+
+	bool same(const TestTopObject &o) const { return a == o.a && h.v == o.h.v && h2.v == o.h2.v && same_hv(o) && big == o.big && p == o.p && m == o.m; }
+
+	bool same_hv(const TestTopObject &o) const {
+		if (hv.size() != o.hv.size()) return false;
+		for (size_t i = 0; i < hv.size(); i++)
+			if (hv[i].v != o.hv[i].v) return false;
+		return true;
+	}
+
+	ADD_SERIALIZATION_FUNCS(a, h, e, h2, hv, big, p, m)
+};
+MEDSERIALIZE_SUPPORT(TestTopObject)
+
+//=========================================================================================================
+static int read_file_bytes(const string &fname, vector<unsigned char> &bytes)
+{
+	ifstream inf(fname, ios::binary);
+	if (!inf) {
+		MERR("test_serialization: can't read %s\n", fname.c_str());
+		return -1;
+	}
+	bytes.assign(istreambuf_iterator<char>(inf), istreambuf_iterator<char>());
+	return 0;
+}
+
+//=========================================================================================================
+int test_serialization(const string &work_dir)
+{
+	string dir = work_dir + "/serialization";
+	boost::filesystem::create_directories(dir);
+
+	// big crosses several stream chunks
+	TestTopObject t;
+	t.a = 7;
+	t.h.v = { 1, 2, 3 };
+	t.h2.v.assign(1000, 5);
+	t.hv.resize(3);
+	t.hv[0].v = { 4 };
+	t.hv[2].v.assign(20, 6);
+	t.big.resize(3000000);
+	for (size_t i = 0; i < t.big.size(); i++)
+		t.big[i] = (float)i / 3;
+	t.p = { 3, "x" };
+	t.m["first"] = { 1, 2 };
+	t.m["second"] = {};
+
+	string fname = dir + "/top.bin";
+	if (t.write_to_file(fname) < 0)
+		return -1;
+
+	// streamed read
+	TestTopObject r;
+	if (r.read_from_file(fname) < 0 || !r.same(t)) {
+		MERR("test_serialization: read_from_file of %s differs from the written object\n", fname.c_str());
+		return -1;
+	}
+
+	// file body is the blob
+	vector<unsigned char> blob, bytes;
+	t.serialize_vec(blob);
+	if (read_file_bytes(fname, bytes) < 0)
+		return -1;
+	if (bytes.size() != sizeof(int) + blob.size() || memcmp(bytes.data() + sizeof(int), blob.data(), blob.size()) != 0) {
+		MERR("test_serialization: %s is not version + serialize(blob)\n", fname.c_str());
+		return -1;
+	}
+
+	// blob read of the file body
+	TestTopObject rb;
+	rb.deserialize(bytes.data() + sizeof(int));
+	if (!rb.same(t)) {
+		MERR("test_serialization: blob deserialize of %s differs from the written object\n", fname.c_str());
+		return -1;
+	}
+
+	// streamed read of a file written through the blob path (version + serialize(blob))
+	string blob_fname = dir + "/top_blob.bin";
+	ofstream blob_file(blob_fname, ios::binary);
+	blob_file.write((const char *)bytes.data(), sizeof(int));
+	blob_file.write((const char *)blob.data(), blob.size());
+	blob_file.close();
+	TestTopObject rl;
+	if (!blob_file || rl.read_from_file(blob_fname) < 0 || !rl.same(t)) {
+		MERR("test_serialization: read_from_file of the blob written %s differs from the written object\n", blob_fname.c_str());
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+//
+// SigCodecTest : MedSigCodec encode / decode round trips over the channel codings (delta times, dictionary and
+// frame of reference values, floats coded as integers or as bits, padding bytes), and decoding of corrupted blocks.
+//
+
+#include "InfraTester.h"
+#include <random>
+#include <cstring>
+#include <cmath>
+#include <InfraMed/InfraMed/MedSignals.h>
+#include <InfraMed/InfraMed/MedSigCodec.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+template <typename T> static inline void put_chan(unsigned char *rec, int offset, T v) { memcpy(rec + offset, &v, sizeof(T)); }
+
+//=========================================================================================================
+// n records of T(i),V(f,f,d,s),p,p : increasing dates, integer floats with few distinct values, general floats
+// (with NaN and -0.0), large integer doubles and negative shorts. padding bytes are random.
+static void make_mixed_recs(const SignalInfo &info, int n, mt19937 &gen, vector<unsigned char> &recs)
+{
+	recs.resize((size_t)n * info.bytes_len);
+	for (auto &b : recs)
+		b = (unsigned char)gen();
+
+	const float cats[] = { 3, 700, 5000, 123456 };
+	int date = 20100101;
+	for (int j = 0; j < n; j++) {
+		unsigned char *rec = &recs[(size_t)j * info.bytes_len];
+		date += gen() % 40;
+		float f = (float)(gen() % 100000) / 7;
+		if (j % 17 == 5) f = NAN;
+		if (j % 23 == 7) f = -0.0f;
+		put_chan<int>(rec, info.time_channel_offsets[0], date);
+		put_chan<float>(rec, info.val_channel_offsets[0], cats[gen() % 4]);
+		put_chan<float>(rec, info.val_channel_offsets[1], f);
+		put_chan<double>(rec, info.val_channel_offsets[2], (double)(1LL << 40) + (double)(gen() % 1000) * 1024);
+		put_chan<short>(rec, info.val_channel_offsets[3], (short)(-(int)(gen() % 30000)));
+	}
+}
+
+// n records of T(i),V(f) with integer values
+static void make_date_val_recs(const SignalInfo &info, int n, mt19937 &gen, vector<unsigned char> &recs)
+{
+	recs.resize((size_t)n * info.bytes_len);
+	int date = 20000101;
+	for (int j = 0; j < n; j++) {
+		unsigned char *rec = &recs[(size_t)j * info.bytes_len];
+		date += 1 + gen() % 10;
+		put_chan<int>(rec, info.time_channel_offsets[0], date);
+		put_chan<float>(rec, info.val_channel_offsets[0], (float)(gen() % 50));
+	}
+}
+
+//=========================================================================================================
+static int check_round_trip(const string &spec, const MedSigCodec &codec, const vector<unsigned char> &recs, int n)
+{
+	vector<unsigned char> blk;
+	codec.encode(recs.data(), n, blk);
+	vector<unsigned char> out(recs.size());
+	if (codec.decode(blk.data(), blk.size(), n, out.data()) < 0 || memcmp(out.data(), recs.data(), recs.size()) != 0) {
+		MERR("test_sig_codec: %s : %d records were not restored by decode\n", spec.c_str(), n);
+		return -1;
+	}
+	return 0;
+}
+
+// truncated blocks and bad column modes must be rejected, random bit flips must not crash
+static int check_corrupted(const string &spec, const MedSigCodec &codec, const vector<unsigned char> &recs, int n, mt19937 &gen)
+{
+	vector<unsigned char> blk;
+	codec.encode(recs.data(), n, blk);
+	vector<unsigned char> out(recs.size());
+
+	for (size_t len = 0; len < blk.size(); len++) {
+		vector<unsigned char> prefix(blk.begin(), blk.begin() + len); // own buffer, so reading past len is caught by tools
+		if (codec.decode(prefix.data(), prefix.size(), n, out.data()) != -1) {
+			MERR("test_sig_codec: %s : block truncated to %zu of %zu bytes was decoded\n", spec.c_str(), len, blk.size());
+			return -1;
+		}
+	}
+
+	vector<unsigned char> bad = blk;
+	bad[0] = 0x7F;
+	if (codec.decode(bad.data(), bad.size(), n, out.data()) != -1) {
+		MERR("test_sig_codec: %s : block with a bad column mode was decoded\n", spec.c_str());
+		return -1;
+	}
+
+	for (int k = 0; k < 200; k++) {
+		bad = blk;
+		for (int b = 0; b < 3; b++)
+			bad[gen() % bad.size()] ^= (unsigned char)(1 << (gen() % 8));
+		codec.decode(bad.data(), bad.size(), n, out.data());
+	}
+
+	return 0;
+}
+
+//=========================================================================================================
+int test_sig_codec(const string &work_dir)
+{
+	mt19937 gen(23);
+	const int sizes[] = { 1, 2, 5, 100, 1000 };
+
+	vector<pair<string, void(*)(const SignalInfo &, int, mt19937 &, vector<unsigned char> &)>> specs = {
+		{ "T(i),V(f,f,d,s),p,p", make_mixed_recs },
+		{ GenericSigVec::get_type_generic_spec(T_DateVal), make_date_val_recs }
+	};
+
+	for (auto &spec : specs) {
+		SignalInfo info;
+		info.name = "codec_test";
+		info.set_gsv_spec(spec.first);
+		MedSigCodec codec;
+		if (codec.init(info) < 0) {
+			MERR("test_sig_codec: failed init of codec for %s\n", spec.first.c_str());
+			return -1;
+		}
+
+		for (int n : sizes) {
+			vector<unsigned char> recs;
+			spec.second(info, n, gen, recs);
+			if (check_round_trip(spec.first, codec, recs, n) < 0)
+				return -1;
+		}
+
+		vector<unsigned char> recs;
+		spec.second(info, 100, gen, recs);
+		if (check_corrupted(spec.first, codec, recs, 100, gen) < 0)
+			return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+//
+// TestRepository : writing, converting and checking the small repositories of the tests
+//
+
+#include "InfraTester.h"
+#include <fstream>
+#include <set>
+#include <boost/filesystem.hpp>
+#include <InfraMed/InfraMed/InfraMed.h>
+#include <InfraMed/InfraMed/MedConvert.h>
+#include <InfraMed/InfraMed/MedPidRepository.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+const vector<string> test_rep_signals = { "GENDER", "LAB", "LAB2", "DIAG" };
+
+#define TEST_REP_N_DIAGS 20
+
+//=========================================================================================================
+int write_test_rep_defs(const string &dir)
+{
+	boost::filesystem::create_directories(dir + "/dicts");
+
+	ofstream sigs(dir + "/test.signals");
+	sigs << "SIGNAL\tGENDER\t100\t0\tgender\t0\n";
+	sigs << "SIGNAL\tLAB\t1000\t1\tlab test\t0\n";
+	sigs << "SIGNAL\tLAB2\t1001\t1\tsecond lab test\t0\n";
+	sigs << "SIGNAL\tDIAG\t2000\t1\tdiagnosis\t1\n";
+	sigs.close();
+
+	ofstream dict(dir + "/dicts/dict.DIAG");
+	dict << "SECTION\tDIAG\n";
+	for (int i = 1; i <= TEST_REP_N_DIAGS; i++)
+		dict << "DEF\t" << i << "\tD" << i << "\n";
+	dict.close();
+
+	if (!sigs || !dict) {
+		MERR("write_test_rep_defs: failed writing signals and dictionary into %s\n", dir.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+//=========================================================================================================
+int convert_test_rep(const string &dir, const string &name, const TestRecs &recs, const vector<string> &extra_config, string &rep_config)
+{
+	string data_fname = dir + "/" + name + ".data";
+	ofstream data(data_fname);
+	for (auto &pid_recs : recs)
+		for (auto &sig_recs : pid_recs.second)
+			for (auto &r : sig_recs.second) {
+				data << pid_recs.first << "\t" << sig_recs.first << "\t";
+				if (sig_recs.first != "GENDER")
+					data << r.first << "\t";
+				if (sig_recs.first == "DIAG")
+					data << "D" << (int)r.second << "\n";
+				else
+					data << r.second << "\n";
+			}
+	data.close();
+
+	string out_dir = dir + "/" + name;
+	boost::filesystem::create_directories(out_dir);
+	string convert_config = dir + "/" + name + ".convert_config";
+	ofstream conf(convert_config);
+	conf << "DIR\t" << dir << "\n";
+	conf << "OUTDIR\t" << out_dir << "\n";
+	conf << "CONFIG\t" << name << ".repository\n";
+	conf << "DICTIONARY\tdicts/dict.DIAG\n";
+	conf << "SIGNAL\ttest.signals\n";
+	conf << "DATA\t" << name << ".data\n";
+	conf << "MODE\t3\n";
+	conf << "PREFIX\t" << name << "_rep\n";
+	for (const string &line : extra_config)
+		conf << line << "\n";
+	conf.close();
+
+	if (!data || !conf) {
+		MERR("convert_test_rep: failed writing %s input files into %s\n", name.c_str(), dir.c_str());
+		return -1;
+	}
+
+	MedConvert mc;
+	if (mc.read_all(convert_config) < 0) {
+		MERR("convert_test_rep: failed converting %s\n", convert_config.c_str());
+		return -1;
+	}
+	rep_config = out_dir + "/" + name + ".repository";
+	return 0;
+}
+
+//=========================================================================================================
+int check_test_rep(const string &rep_config, const TestRecs &recs, const vector<int> &pids, const vector<string> &signals)
+{
+	MedPidRepository rep;
+	vector<string> sigs = signals.empty() ? test_rep_signals : signals;
+	if (rep.read_all(rep_config, pids, sigs) < 0) {
+		MERR("check_test_rep: failed reading %s\n", rep_config.c_str());
+		return -1;
+	}
+
+	set<int> all_pids(pids.begin(), pids.end());
+	if (pids.empty()) {
+		for (auto &it : recs)
+			all_pids.insert(it.first);
+		all_pids.insert(rep.pids.begin(), rep.pids.end());
+	}
+
+	int n_bad = 0;
+	UniversalSigVec usv;
+	for (int pid : all_pids)
+		for (const string &sig : sigs) {
+			vector<pair<int, float>> expected;
+			auto p = recs.find(pid);
+			if (p != recs.end() && p->second.count(sig))
+				expected = p->second.at(sig);
+
+			rep.uget(pid, sig, usv);
+			vector<pair<int, float>> got;
+			for (int i = 0; i < usv.len; i++)
+				got.push_back({ usv.n_time_channels() > 0 ? usv.Time(i) : 0, usv.Val(i) });
+
+			if (got != expected) {
+				if (n_bad++ < 10)
+					MERR("check_test_rep: %s : pid %d signal %s has %d records, expected %d\n",
+						rep_config.c_str(), pid, sig.c_str(), (int)got.size(), (int)expected.size());
+			}
+		}
+
+	if (n_bad > 0) {
+		MERR("check_test_rep: %s : %d pid signals differ\n", rep_config.c_str(), n_bad);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,184 @@
+//
+// TreeShapTest : the batched path-table TreeSHAP (TreeShapPathTables) against the recursive dense_tree_shap,
+// on random ensembles with missing values, several outputs, grouped feature sets and interactions.
+// Interactions of grouped feature sets are not supported by the tables, batched_tree_shap must fall back to dense_tree_shap.
+//
+
+#include "InfraTester.h"
+#include <random>
+#include <algorithm>
+#include <MedAlgo/MedAlgo/tree_shap.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+#define TREE_SHAP_TEST_MAX_DIFF 2e-13
+
+//=========================================================================================================
+// grows a random subtree at node (relative to the tree offset), returns its depth
+static unsigned grow_random_tree(TreeEnsemble &trees, unsigned offset, int node, int &n_nodes, unsigned depth, unsigned M, mt19937 &gen)
+{
+	unsigned i = offset + node;
+	uniform_real_distribution<double> u(0, 1);
+
+	// a node becomes a leaf when out of depth/room, or at random below the first levels
+	if (depth >= 6 || n_nodes + 2 > (int)trees.max_nodes || (depth >= 2 && u(gen) < 0.3)) {
+		trees.children_left[i] = trees.children_right[i] = trees.children_default[i] = -1;
+		trees.features[i] = -1;
+		trees.thresholds[i] = 0;
+		trees.node_sample_weights[i] = 1 + gen() % 20;
+		for (unsigned j = 0; j < trees.num_outputs; j++)
+			trees.values[i * trees.num_outputs + j] = u(gen) * 2 - 1;
+		return 0;
+	}
+
+	int left = n_nodes++, right = n_nodes++;
+	trees.children_left[i] = left;
+	trees.children_right[i] = right;
+	trees.children_default[i] = (gen() % 2) ? left : right;
+	trees.features[i] = gen() % M;
+	trees.thresholds[i] = (tfloat)(gen() % 5) + 0.5 * (gen() % 2); // some thresholds equal to data values
+	unsigned depth_left = grow_random_tree(trees, offset, left, n_nodes, depth + 1, M, gen);
+	unsigned depth_right = grow_random_tree(trees, offset, right, n_nodes, depth + 1, M, gen);
+
+	unsigned li = offset + left, ri = offset + right;
+	tfloat wl = trees.node_sample_weights[li], wr = trees.node_sample_weights[ri];
+	trees.node_sample_weights[i] = wl + wr;
+	for (unsigned j = 0; j < trees.num_outputs; j++)
+		trees.values[i * trees.num_outputs + j] = (wl * trees.values[li * trees.num_outputs + j] + wr * trees.values[ri * trees.num_outputs + j]) / (wl + wr);
+
+	return max(depth_left, depth_right) + 1;
+}
+
+static void make_random_ensemble(TreeEnsemble &trees, unsigned n_trees, unsigned num_outputs, unsigned M, mt19937 &gen)
+{
+	const unsigned max_nodes = 63;
+	trees.allocate(n_trees, max_nodes, num_outputs);
+	trees.max_depth = 0;
+	trees.base_offset = 0.25;
+	for (unsigned t = 0; t < n_trees; t++) {
+		unsigned offset = t * max_nodes;
+		for (unsigned k = 0; k < max_nodes; k++) {
+			trees.children_left[offset + k] = trees.children_right[offset + k] = trees.children_default[offset + k] = -1;
+			trees.features[offset + k] = -1;
+			trees.thresholds[offset + k] = 0;
+			trees.node_sample_weights[offset + k] = 0;
+			for (unsigned j = 0; j < num_outputs; j++)
+				trees.values[(offset + k) * num_outputs + j] = 0;
+		}
+		int n_nodes = 1;
+		trees.max_depth = max(trees.max_depth, grow_random_tree(trees, offset, 0, n_nodes, 0, M, gen));
+	}
+}
+
+//=========================================================================================================
+struct TreeShapCase {
+	string name;
+	unsigned num_outputs;
+	unsigned M;
+	unsigned num_Exp; // < M : features are grouped into num_Exp sets
+	bool interactions;
+	size_t max_table_entries;
+};
+
+static int run_tree_shap_case(const TreeShapCase &c, mt19937 &gen)
+{
+	const unsigned n_trees = 20, num_X = 150;
+
+	TreeEnsemble trees;
+	make_random_ensemble(trees, n_trees, c.num_outputs, c.M, gen);
+
+	// data on the same grid as the thresholds, ~20% missing
+	vector<tfloat> X(num_X * c.M);
+	bool *X_missing = new bool[num_X * c.M];
+	for (size_t i = 0; i < X.size(); i++) {
+		X[i] = (tfloat)(gen() % 10) / 2;
+		X_missing[i] = (gen() % 5 == 0);
+	}
+
+	// feature sets : identity, or consecutive features grouped into num_Exp sets
+	vector<unsigned> feature_sets(c.M);
+	for (unsigned j = 0; j < c.M; j++)
+		feature_sets[j] = (unsigned)(((size_t)j * c.num_Exp) / c.M);
+
+	ExplanationDataset data(X.data(), X_missing, NULL, NULL, NULL, num_X, c.M, 0, c.num_Exp);
+	tfloat max_diff = benchmark_tree_shap(trees, data, feature_sets.data(), c.interactions, c.max_table_entries);
+
+	delete[] X_missing;
+	trees.free();
+
+	if (!(max_diff < TREE_SHAP_TEST_MAX_DIFF)) {
+		MERR("test_tree_shap: case %s : max abs diff %g between batched and recursive TreeSHAP\n", c.name.c_str(), (double)max_diff);
+		return -1;
+	}
+	MLOG("test_tree_shap: case %s : max abs diff %g\n", c.name.c_str(), (double)max_diff);
+	return 0;
+}
+
+//=========================================================================================================
+// interactions with grouped (or permuted) feature sets : batched_tree_shap must give what dense_tree_shap gives,
+// including failing the same way, and not the tables' interactions of single features
+static int run_interactions_fallback_case(const string &name, const vector<unsigned> &feature_sets, unsigned num_Exp, mt19937 &gen)
+{
+	const unsigned n_trees = 10, num_X = 40, M = (unsigned)feature_sets.size();
+
+	TreeEnsemble trees;
+	make_random_ensemble(trees, n_trees, 1, M, gen);
+	vector<tfloat> X(num_X * M);
+	bool *X_missing = new bool[num_X * M];
+	for (size_t i = 0; i < X.size(); i++) {
+		X[i] = (tfloat)(gen() % 10) / 2;
+		X_missing[i] = (gen() % 5 == 0);
+	}
+	ExplanationDataset data(X.data(), X_missing, NULL, NULL, NULL, num_X, M, 0, num_Exp);
+	vector<unsigned> sets = feature_sets;
+
+	TreeShapPathTables tables;
+	tables.build(trees, sets.data(), M, num_Exp);
+	size_t out_size = (size_t)num_X * (M + 1) * (M + 1);
+	vector<tfloat> dense_res(out_size, 0), batched_res(out_size, 0);
+	bool dense_threw = false, batched_threw = false;
+	try { dense_tree_shap(trees, data, dense_res.data(), FEATURE_DEPENDENCE::tree_path_dependent, MODEL_TRANSFORM::identity, true, sets.data()); }
+	catch (...) { dense_threw = true; }
+	try { batched_tree_shap(trees, data, tables, sets.data(), true, batched_res.data()); }
+	catch (...) { batched_threw = true; }
+
+	delete[] X_missing;
+	trees.free();
+
+	if (tables.supports_interactions() || dense_threw != batched_threw || (!dense_threw && dense_res != batched_res)) {
+		MERR("test_tree_shap: case %s : batched interactions did not fall back to dense_tree_shap (dense %s, batched %s)\n", name.c_str(),
+			dense_threw ? "threw" : "ran", batched_threw ? "threw" : "ran");
+		return -1;
+	}
+	MLOG("test_tree_shap: case %s : fell back to dense_tree_shap (%s)\n", name.c_str(), dense_threw ? "not supported there either" : "same output");
+	return 0;
+}
+
+//=========================================================================================================
+int test_tree_shap(const string &work_dir)
+{
+	vector<TreeShapCase> cases = {
+		{ "single output", 1, 12, 12, false, TREE_SHAP_MAX_TABLE_ENTRIES },
+		{ "two outputs", 2, 12, 12, false, TREE_SHAP_MAX_TABLE_ENTRIES },
+		{ "grouped sets", 1, 12, 5, false, TREE_SHAP_MAX_TABLE_ENTRIES },
+		{ "grouped sets two outputs", 2, 12, 4, false, TREE_SHAP_MAX_TABLE_ENTRIES },
+		{ "repeated features", 1, 3, 3, false, TREE_SHAP_MAX_TABLE_ENTRIES },
+		{ "no tables", 1, 12, 12, false, 0 },
+		{ "grouped sets no tables", 2, 12, 5, false, 0 },
+		{ "interactions", 1, 6, 6, true, TREE_SHAP_MAX_TABLE_ENTRIES },
+		{ "interactions no tables", 2, 6, 6, true, 0 }
+	};
+
+	mt19937 gen(2);
+	int rc = 0;
+	for (auto &c : cases)
+		if (run_tree_shap_case(c, gen) < 0)
+			rc = -1;
+
+	if (run_interactions_fallback_case("grouped sets interactions", { 0, 0, 1, 1, 2, 2 }, 3, gen) < 0 ||
+		run_interactions_fallback_case("permuted sets interactions", { 5, 4, 3, 2, 1, 0 }, 6, gen) < 0)
+		rc = -1;
+	return rc;
+}
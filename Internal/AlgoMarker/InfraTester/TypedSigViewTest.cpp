@@ -0,0 +1,80 @@
+//
+// TypedSigViewTest : TypedSigView (and dispatch_typed_sig_view) against the generic GenericSigVec accessors.
+// Every dispatched layout must get its typed view and read the same times and values, other layouts must fall back
+// to the generic accessors.
+//
+
+#include "InfraTester.h"
+#include <random>
+#include <cmath>
+#include <type_traits>
+#include <InfraMed/InfraMed/MedSignals.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+static inline bool same_val(float a, float b) { return a == b || (std::isnan(a) && std::isnan(b)); }
+
+// reads all channels through the view f is called with, returns 1 if it was a typed view, 0 for the generic one
+// and -1 if a time or value differs from the generic accessors
+static int check_view(const GenericSigVec &gsv)
+{
+	return dispatch_typed_sig_view(gsv, [&gsv](const auto &v) {
+		for (int i = 0; i < gsv.len; i++) {
+			for (int chan = 0; chan < gsv.n_time_channels(); chan++)
+				if (v.Time(i, chan) != gsv.Time(i, chan))
+					return -1;
+			for (int chan = 0; chan < gsv.n_val_channels(); chan++)
+				if (!same_val(v.Val(i, chan), gsv.Val(i, chan)))
+					return -1;
+		}
+		return std::is_same<typename std::decay<decltype(v)>::type, GenericSigVec>::value ? 0 : 1;
+	});
+}
+
+//=========================================================================================================
+int test_typed_sig_view(const string &work_dir)
+{
+	mt19937 gen(2);
+	const int n = 50;
+
+	// layouts with a typed kernel
+	vector<SigType> typed = { T_DateVal, T_TimeVal, T_DateRangeVal, T_DateVal2, T_DateShort2, T_ValShort4, T_DateFloat2 };
+	// layouts that must use the generic accessors : fixed types without a kernel (T_TimeShort4 values are signed in the spec
+	// but unsigned in STimeShort4) and a padded spec
+	vector<string> generic = { GenericSigVec::get_type_generic_spec(T_Value), GenericSigVec::get_type_generic_spec(T_DateRangeVal2),
+		GenericSigVec::get_type_generic_spec(T_TimeShort4), "T(i),V(f),p,p,p,p" };
+
+	vector<pair<string, int>> cases;
+	for (SigType t : typed)
+		cases.push_back({ GenericSigVec::get_type_generic_spec(t), 1 });
+	for (const string &spec : generic)
+		cases.push_back({ spec, 0 });
+
+	for (auto &c : cases) {
+		// the layout is matched from the channels, as for signals read from a signals file
+		SignalInfo info;
+		info.sid = 1;
+		info.set_gsv_spec(c.first);
+		GenericSigVec gsv;
+		gsv.init(info);
+
+		vector<unsigned char> buf((size_t)n * info.bytes_len);
+		for (auto &b : buf)
+			b = (unsigned char)gen();
+		gsv.set_data(buf.data(), n);
+
+		int rc = check_view(gsv);
+		if (rc != c.second) {
+			if (rc < 0)
+				MERR("test_typed_sig_view: %s : typed view reads differ from the generic accessors\n", c.first.c_str());
+			else
+				MERR("test_typed_sig_view: %s : dispatched to the %s view, expected the %s view\n", c.first.c_str(),
+					rc ? "typed" : "generic", c.second ? "typed" : "generic");
+			return -1;
+		}
+	}
+
+	return 0;
+}
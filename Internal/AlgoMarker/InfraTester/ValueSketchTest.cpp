@@ -0,0 +1,92 @@
+//
+// ValueSketchTest : quantile cleaning bounds learned from a ValueQuantileSketch (single, and merged from chunks as in
+// get_values_sketch) against the exact bounds of get_quantile_min_max on all the values. Each bound must be a value
+// whose rank is within the sketch rank error of the exact one.
+//
+
+#include "InfraTester.h"
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <MedProcessTools/MedProcessTools/MedValueCleaner.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+//=========================================================================================================
+// normal values, increasing values (the worst order for the compactions) and few distinct values
+static void make_sketch_values(int dist, int n, vector<float> &values)
+{
+	mt19937 gen(31 + dist);
+	normal_distribution<float> normal(100, 15);
+	values.resize(n);
+	for (int i = 0; i < n; i++)
+		values[i] = (dist == 0) ? normal(gen) : (dist == 1) ? (float)i / 10 : (float)(1 + gen() % 50);
+}
+
+// the bound must lie between the values at ranks rank -/+ eps*n of the sorted values (up to the float rounding of
+// quantile_min_max, which calculates the bounds from the median)
+static bool within_rank_error(float bound, double q, const vector<float> &sorted, float eps)
+{
+	long long n = (long long)sorted.size();
+	long long rank = min((long long)(n * q), n - 1);
+	long long err = (long long)(eps * n);
+	float from = sorted[max(0LL, rank - err)], to = sorted[min(n - 1, rank + err)];
+	return bound >= from - 1e-6f * fabs(from) && bound <= to + 1e-6f * fabs(to);
+}
+
+static int check_sketch_bounds(const string &name, MedValueCleaner &exact, MedValueCleaner &sketched, const vector<float> &sorted, float eps)
+{
+	// with the default factors : trimMin/trimMax are the lower/upper quantiles and nbrsMin the median
+	double q = exact.params.quantile;
+	vector<pair<string, pair<float, double>>> bounds = { { "lower", { sketched.trimMin, q } }, { "upper", { sketched.trimMax, 1 - q } },
+		{ "median", { sketched.nbrsMin, 0.5 } } };
+	int rc = 0;
+	for (auto &b : bounds)
+		if (!within_rank_error(b.second.first, b.second.second, sorted, eps)) {
+			MERR("test_value_sketch: %s : %s %g out of the rank error (exact bounds %g - %g median %g)\n", name.c_str(), b.first.c_str(),
+				b.second.first, exact.trimMin, exact.trimMax, exact.nbrsMin);
+			rc = -1;
+		}
+	return rc;
+}
+
+//=========================================================================================================
+int test_value_sketch(const string &work_dir)
+{
+	const int n = 300000, n_chunks = 8;
+	int rc = 0;
+	for (int dist = 0; dist < 3; dist++)
+		for (float eps : { 0.01f, 0.001f }) {
+			vector<float> values;
+			make_sketch_values(dist, n, values);
+
+			MedValueCleaner exact, single, merged;
+			for (MedValueCleaner *c : { &exact, &single, &merged })
+				c->params.quantile = (float)0.01;
+
+			ValueQuantileSketch single_sketch(eps), merged_sketch(eps);
+			vector<ValueQuantileSketch> chunk_sketches(n_chunks, ValueQuantileSketch(eps));
+			for (int i = 0; i < n; i++) {
+				single_sketch.add(values[i]);
+				chunk_sketches[(long long)i * n_chunks / n].add(values[i]);
+			}
+			for (ValueQuantileSketch &chunk_sketch : chunk_sketches)
+				merged_sketch.merge(chunk_sketch);
+
+			vector<float> sorted = values;
+			if (exact.get_quantile_min_max(sorted) < 0 || single.get_quantile_min_max(single_sketch) < 0 ||
+				merged.get_quantile_min_max(merged_sketch) < 0) {
+				MERR("test_value_sketch: failed learning bounds\n");
+				return -1;
+			}
+
+			string name = "dist " + to_string(dist) + " eps " + to_string(eps);
+			if (check_sketch_bounds(name + " single", exact, single, sorted, eps) < 0 ||
+				check_sketch_bounds(name + " merged", exact, merged, sorted, eps) < 0)
+				rc = -1;
+		}
+
+	return rc;
+}
@@ -0,0 +1,131 @@
+//
+// ValuesMultiTest : get_values_multi, which applies the preceding processors once per id for all requests,
+// must return exactly the values get_values returns for each request alone.
+// The preceding cleaners remove and trim records, so the versions differ from the repository.
+//
+
+#include "InfraTester.h"
+#include <random>
+#include <cfloat>
+#include <boost/filesystem.hpp>
+#include <InfraMed/InfraMed/MedPidRepository.h>
+#include <MedProcessTools/MedProcessTools/RepProcess.h>
+#include <MedProcessTools/MedProcessTools/MedSamples.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+//=========================================================================================================
+// LAB and LAB2 on different dates (so the union of time points is larger than each signal's), with outliers
+static void make_values_recs(TestRecs &recs)
+{
+	mt19937 gen(11);
+	for (int pid = 1; pid <= 200; pid++) {
+		recs[pid]["GENDER"] = { { 0, (float)(1 + gen() % 2) } };
+		int date = 20150101;
+		int n = gen() % 12;
+		for (int i = 0; i < n; i++) {
+			date += 100 * (1 + gen() % 3);
+			float v = (float)(gen() % 400) / 4;
+			if (gen() % 10 == 0) v += 200; // removed or trimmed by the LAB cleaner
+			recs[pid]["LAB"].push_back({ date, v });
+			if (gen() % 2)
+				recs[pid]["LAB2"].push_back({ date + 5, (float)(gen() % 100) / 2 });
+		}
+		if (n > 0 && gen() % 3 == 0)
+			recs[pid]["DIAG"].push_back({ date, (float)(1 + gen() % 20) });
+	}
+}
+
+static void init_cleaner(RepNbrsOutlierCleaner &cleaner, MedPidRepository &rep, float remove_min, float remove_max, float trim_min, float trim_max)
+{
+	cleaner.params.doRemove = cleaner.params.doTrim = true;
+	cleaner.removeMin = remove_min;
+	cleaner.removeMax = remove_max;
+	cleaner.trimMin = trim_min;
+	cleaner.trimMax = trim_max;
+	cleaner.nbrsMin = trim_min;
+	cleaner.nbrsMax = trim_max;
+	cleaner.set_affected_signal_ids(rep.dict);
+	cleaner.set_signal_ids(rep.sigs);
+	cleaner.set_required_signal_ids(rep.dict);
+	cleaner.init_tables(rep.dict, rep.sigs);
+}
+
+//=========================================================================================================
+int test_values_multi(const string &work_dir)
+{
+	string dir = work_dir + "/values_multi";
+	boost::filesystem::remove_all(dir);
+	if (write_test_rep_defs(dir) < 0)
+		return -1;
+
+	TestRecs recs;
+	make_values_recs(recs);
+	string rep_config;
+	if (convert_test_rep(dir, "rep", recs, {}, rep_config) < 0)
+		return -1;
+
+	MedPidRepository rep;
+	if (rep.read_all(rep_config, {}, test_rep_signals) < 0) {
+		MERR("test_values_multi: failed reading %s\n", rep_config.c_str());
+		return -1;
+	}
+
+	MedSamples samples;
+	for (auto &it : recs) {
+		MedIdSamples id_samples(it.first);
+		id_samples.samples.push_back(MedSample(it.first, 20300101, 0, 20300101));
+		samples.idSamples.push_back(id_samples);
+	}
+
+	RepNbrsOutlierCleaner lab_cleaner("LAB"), lab2_cleaner("LAB2");
+	init_cleaner(lab_cleaner, rep, 0, 250, 5, 90);
+	init_cleaner(lab2_cleaner, rep, 1, 49, 3, 45);
+
+	vector<ValuesLearnRequest> requests(4);
+	requests[0].signalId = rep.sigs.sid("LAB");
+	requests[1].signalId = rep.sigs.sid("LAB2");
+	requests[2].signalId = rep.sigs.sid("LAB");
+	requests[2].range_min = 10;
+	requests[2].range_max = 60;
+	requests[3].signalId = rep.sigs.sid("DIAG");
+
+	vector<vector<RepProcessor *>> prev_sets = { {}, { &lab_cleaner }, { &lab2_cleaner }, { &lab_cleaner, &lab2_cleaner } };
+
+	int rc = 0;
+	vector<float> raw_lab_values;
+	for (size_t s = 0; s < prev_sets.size(); s++) {
+		vector<RepProcessor *> &prev = prev_sets[s];
+		vector<vector<float>> multi_values;
+		if (get_values_multi(rep, samples, requests, multi_values, prev) < 0) {
+			MERR("test_values_multi: get_values_multi failed with %zu preceding processors\n", prev.size());
+			return -1;
+		}
+
+		for (size_t k = 0; k < requests.size(); k++) {
+			const ValuesLearnRequest &req = requests[k];
+			vector<float> values;
+			if (get_values(rep, samples, req.signalId, req.time_channel, req.val_channel, req.range_min, req.range_max, values, prev) < 0) {
+				MERR("test_values_multi: get_values failed for signal %d\n", req.signalId);
+				return -1;
+			}
+			if (values.empty() || multi_values[k] != values) {
+				MERR("test_values_multi: processors set %zu request %zu : get_values_multi returned %zu values, get_values %zu\n",
+					s, k, multi_values[k].size(), values.size());
+				rc = -1;
+			}
+		}
+
+		// the LAB cleaner must change the LAB values, otherwise the versions are not checked
+		if (s == 0)
+			raw_lab_values = multi_values[0];
+		else if (s == 1 && multi_values[0] == raw_lab_values) {
+			MERR("test_values_multi: the LAB cleaner did not change any LAB value\n");
+			rc = -1;
+		}
+	}
+
+	return rc;
+}
@@ -0,0 +1,109 @@
+//
+// WindowIndexTest : BasicFeatGenerator window aggregations answered by the shared window index (SigWindowIndex)
+// against the linear scans, for every indexed type, on long histories with values away from 0 (the index sums values
+// centered by their mean). min/max/range_width must be identical, avg/sum/std equal up to float rounding.
+//
+
+#include "InfraTester.h"
+#include <random>
+#include <cmath>
+#include <boost/filesystem.hpp>
+#include <InfraMed/InfraMed/MedPidRepository.h>
+#include <MedProcessTools/MedProcessTools/FeatureGenerator.h>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_APP
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+#define WINDOW_INDEX_TEST_REL_DIFF 1e-4
+
+//=========================================================================================================
+// long LAB histories around two levels (and a few short ones), several records on some days
+static void make_window_recs(TestRecs &recs)
+{
+	mt19937 gen(5);
+	for (int pid = 1; pid <= 60; pid++) {
+		recs[pid]["GENDER"] = { { 0, (float)(1 + gen() % 2) } };
+		int n = (pid % 10 == 0) ? (int)(gen() % 4) : 100 + (int)(gen() % 400);
+		float level = (pid % 2) ? 200.0f : 20.0f;
+		int days = 0;
+		for (int i = 0; i < n; i++) {
+			days += gen() % 7;
+			float v = level + (float)(gen() % 2000) / 100;
+			recs[pid]["LAB"].push_back({ med_time_converter.convert_days(MedTime::Date, 20000 + days), v });
+		}
+	}
+}
+
+static bool close_enough(float indexed, float linear, bool exact)
+{
+	if (indexed == linear)
+		return true;
+	if (exact)
+		return false;
+	return fabs(indexed - linear) <= WINDOW_INDEX_TEST_REL_DIFF * max(1.0f, fabs(linear));
+}
+
+//=========================================================================================================
+int test_window_index(const string &work_dir)
+{
+	string dir = work_dir + "/window_index";
+	boost::filesystem::remove_all(dir);
+	if (write_test_rep_defs(dir) < 0)
+		return -1;
+
+	TestRecs recs;
+	make_window_recs(recs);
+	string rep_config;
+	if (convert_test_rep(dir, "rep", recs, {}, rep_config) < 0)
+		return -1;
+
+	MedPidRepository rep;
+	if (rep.read_all(rep_config, {}, test_rep_signals) < 0) {
+		MERR("test_window_index: failed reading %s\n", rep_config.c_str());
+		return -1;
+	}
+	int sid = rep.sigs.sid("LAB");
+	vector<int> rec_sids = { sid };
+
+	vector<pair<string, bool>> types = { { "avg", false }, { "sum", false }, { "std", false }, { "max", true }, { "min", true }, { "range_width", true } };
+	vector<pair<int, int>> windows = { { 0, 30 }, { 0, 365 }, { 100, 1000 }, { 0, 10000 } };
+
+	mt19937 gen(7);
+	int rc = 0;
+	long long n_checked = 0;
+	for (auto &t : types)
+		for (auto &w : windows) {
+			BasicFeatGenerator indexed, linear;
+			string init = "type=" + t.first + ";signal=LAB;time_unit=Days;win_from=" + to_string(w.first) + ";win_to=" + to_string(w.second);
+			indexed.init_from_string(init + ";win_index_min_samples=1");
+			linear.init_from_string(init);
+			for (BasicFeatGenerator *g : { &indexed, &linear }) {
+				g->set_signal_ids(rep.sigs);
+				g->time_unit_sig = rep.sigs.Sid2Info[sid].time_unit;
+			}
+
+			int n_diffs = 0;
+			for (auto &it : recs) {
+				// samples all along the history (and after it), each as a version of the record
+				int n_samples = 6;
+				PidDynamicRec rec;
+				rec.init_from_rep(std::addressof(rep), it.first, rec_sids, n_samples);
+				for (int k = 0; k < n_samples; k++) {
+					int time = med_time_converter.convert_days(MedTime::Date, 20000 + (int)(gen() % 3500));
+					float v_indexed = indexed.get_value(rec, k, time, time);
+					float v_linear = linear.get_value(rec, k, time, time);
+					n_checked++;
+					if (!close_enough(v_indexed, v_linear, t.second)) {
+						if (n_diffs++ < 5)
+							MERR("test_window_index: %s win %d-%d pid %d time %d : indexed %.9g linear %.9g\n",
+								t.first.c_str(), w.first, w.second, it.first, time, v_indexed, v_linear);
+						rc = -1;
+					}
+				}
+			}
+		}
+
+	MLOG("test_window_index: compared %lld values\n", n_checked);
+	return rc;
+}
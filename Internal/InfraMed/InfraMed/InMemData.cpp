@@ -5,7 +5,7 @@
 extern MedLogger global_logger;
 
 int InMemRepData::insertData_to_buffer(int pid, int sid, int *time_data, float *val_data, int n_time, int n_val, 
-	const MedSignals &sigs, map<pair<int, int>, pair<int, vector<char>>> &data) {
+	const MedSignals &sigs, InMemDataBuffer &data) {
 	int n_time_ch = sigs.Sid2Info[sid].n_time_channels;
 	int n_val_ch = sigs.Sid2Info[sid].n_val_channels;
 
@@ -30,7 +30,9 @@ int InMemRepData::insertData_to_buffer(int pid, int sid, int *time_data, float *
 
 	int len_bytes = sigs.Sid2Info[sid].bytes_len;
 
-	vector<char> elem(len_bytes*n_elem);
+	// elements are prepared in a per thread scratch buffer (nothing is inserted if filling fails)
+	static thread_local vector<char> elem;
+	elem.resize(len_bytes*n_elem);
 
 	int type = sigs.Sid2Info[sid].type;
 
@@ -63,19 +65,10 @@ int InMemRepData::insertData_to_buffer(int pid, int sid, int *time_data, float *
 			if (vdata) vdata += n_val_ch;
 		}
 	}
-	// all is ready -> we push it to the map
-	pair<int, int> pid_sid(pid, sid);
-	pair<int, vector<char>> n_data;
-	if (data.find(pid_sid) == data.end()) {
-		data[pid_sid] = n_data;
-		data[pid_sid].second = elem;
-		data[pid_sid].first = n_elem;
-		//MLOG("inserted pid %d sid %d nelem %d bytes %d size %d\n", pid, sid, n_elem, len_bytes, elem.size());
-	}
-	else {
-		data[pid_sid].second.insert(data[pid_sid].second.end(), elem.begin(), elem.end());
-		data[pid_sid].first += n_elem;
-	}
+	// all is ready -> we push it to the buffer
+	char *dst = data.append(pid, sid, n_elem, (int)elem.size());
+	if (elem.size() > 0)
+		memcpy(dst, elem.data(), elem.size());
 
 	return 0;
 }
@@ -101,11 +94,12 @@ int InMemRepData::insertData(int pid, int sid, int *time_data, float *val_data,
 //-------------------------------------------------------------------------------------------------------------------
 int InMemRepData::sort_pid_sid(int pid, int sid)
 {
-	pair<int, int> pid_sid(pid, sid);
+	int len;
+	char *pid_sid_data = (char *)data.get(pid, sid, len);
 
-	if (data.find(pid_sid) == data.end()) return 0; // nothing to do.
+	if (pid_sid_data == NULL) return 0; // nothing to do.
 
-	if (data[pid_sid].first <= 1) return 0; // no need to sort a single variable
+	if (len <= 1) return 0; // no need to sort a single variable
 
 	int (*compare_func)(const void *, const void *);
 	GenericSigVec gsv;
@@ -126,15 +120,14 @@ int InMemRepData::sort_pid_sid(int pid, int sid)
 	case T_TimeShort4:			compare_func = &MedSignalsCompareSig<STimeShort4>;		break;
 	case T_Generic:
 		gsv.init(my_rep->sigs.Sid2Info[sid]);
-		gsv.inplace_sort_data(&data[pid_sid].second[0], data[pid_sid].first);
+		gsv.inplace_sort_data(pid_sid_data, len);
 		return 0;
 	//case T_CompactDateVal:		break; // not fully supported yet
 	default: MERR("ERROR:sort_pid_sid Unknown sig_type %d\n", my_rep->sigs.Sid2Info[sid].type);
 		return -1;
 	}
 
-	//MLOG("pid %d sid %d len %d bytes %d first_val %f\n", pid, sid, data[pid_sid].first, my_rep->sigs.Sid2Info[sid].bytes_len, data[pid_sid].second[0]);
-	qsort(&data[pid_sid].second[0], data[pid_sid].first, my_rep->sigs.Sid2Info[sid].bytes_len, compare_func);
+	qsort(pid_sid_data, len, my_rep->sigs.Sid2Info[sid].bytes_len, compare_func);
 
 	return 0;
 }
@@ -142,10 +135,10 @@ int InMemRepData::sort_pid_sid(int pid, int sid)
 //-------------------------------------------------------------------------------------------------------------------
 int InMemRepData::sortData()
 {
-	for (auto &data_elem : data) {
-		//MLOG("Now sorting pid %d sid %d (%s)\n", data_elem.first.first, data_elem.first.second, my_rep->sigs.Sid2Name[data_elem.first.second].c_str());
-		if (sort_pid_sid(data_elem.first.first, data_elem.first.second) < 0) {
-			MERR("FAILED:: InMemRepData::sortData() failed sorting pid %d sid %d\n", data_elem.first.first, data_elem.first.second);
+	data.compact();
+	for (auto &data_elem : data.get_entries()) {
+		if (sort_pid_sid(data_elem.pid, data_elem.sid) < 0) {
+			MERR("FAILED:: InMemRepData::sortData() failed sorting pid %d sid %d\n", data_elem.pid, data_elem.sid);
 			return -1;
 		}
 	}
@@ -153,29 +146,195 @@ int InMemRepData::sortData()
 }
 
 //-------------------------------------------------------------------------------------------------------------------
-void *InMemRepData::get_from_buffer(int pid, int sid, int &len, const map<pair<int, int>, pair<int, vector<char>>> &data) {
-	pair<int, int> pid_sid(pid, sid);
-	if (data.find(pid_sid) == data.end()) {
+void * InMemRepData::get(int pid, int sid, int &len)
+{
+	return InMemRepData::get_from_buffer(pid, sid, len, data);
+}
+
+void InMemRepData::erase_pid_data(int pid) {
+	//Erase from data all (pid, sid):
+	for ( auto &it : my_rep->sigs.Name2Sid)
+		data.erase(pid, it.second);
+
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+size_t InMemRepData::get_size()
+{
+	map<pair<int, int>, pair<int, vector<char>>> map_data;
+	data.to_map(map_data);
+	return MedSerialize::get_size_top("data", map_data);
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+size_t InMemRepData::serialize(unsigned char *blob)
+{
+	map<pair<int, int>, pair<int, vector<char>>> map_data;
+	data.to_map(map_data);
+	return MedSerialize::serialize_top(blob, "data", map_data);
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+size_t InMemRepData::deserialize(unsigned char *blob)
+{
+	map<pair<int, int>, pair<int, vector<char>>> map_data;
+	size_t size = MedSerialize::deserialize_top(blob, "data", map_data);
+	data.from_map(map_data);
+	return size;
+}
+
+//===================================================================================================================
+// InMemDataBuffer
+//===================================================================================================================
+int InMemDataBuffer::find_slot(int pid, int sid) const
+{
+	size_t mask = slots.size() - 1;
+	for (size_t i = hash_slot(pid, sid); slots[i] != 0; i = (i + 1) & mask) {
+		const Entry &e = entries[slots[i] - 1];
+		if (e.pid == pid && e.sid == sid)
+			return (int)i;
+	}
+	return -1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+void InMemDataBuffer::rehash(size_t n_slots)
+{
+	slots.assign(n_slots, 0);
+	size_t mask = n_slots - 1;
+	for (int j = 0; j < (int)entries.size(); j++) {
+		size_t i = hash_slot(entries[j].pid, entries[j].sid);
+		while (slots[i] != 0) i = (i + 1) & mask;
+		slots[i] = j + 1;
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+char *InMemDataBuffer::append(int pid, int sid, int n_elem, int n_bytes)
+{
+	int slot = find_slot(pid, sid);
+	if (slot < 0) {
+		// new entry - keep the table at most half full
+		if (2 * (entries.size() + 1) > slots.size())
+			rehash(2 * slots.size());
+		size_t mask = slots.size() - 1;
+		size_t i = hash_slot(pid, sid);
+		while (slots[i] != 0) i = (i + 1) & mask;
+		entries.push_back({ pid, sid, 0, 0, arena.size() });
+		slots[i] = (int)entries.size();
+		slot = (int)i;
+	}
+
+	Entry &e = entries[slots[slot] - 1];
+	if (e.offset + e.n_bytes != arena.size()) {
+		// not the last written entry : move it to the end of the arena
+		size_t new_offset = arena.size();
+		arena.resize(new_offset + e.n_bytes);
+		if (e.n_bytes > 0)
+			memmove(&arena[new_offset], &arena[e.offset], e.n_bytes);
+		e.offset = new_offset;
+	}
+
+	arena.resize(arena.size() + n_bytes);
+	e.n_elem += n_elem;
+	e.n_bytes += n_bytes;
+
+	return arena.data() + e.offset + e.n_bytes - n_bytes;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+void *InMemDataBuffer::get(int pid, int sid, int &len) const
+{
+	int slot = find_slot(pid, sid);
+	if (slot < 0) {
 		len = 0;
 		return NULL;
 	}
 
-	len = data.at(pid_sid).first;
-	return (void *)&data.at(pid_sid).second[0];
+	const Entry &e = entries[slots[slot] - 1];
+	len = e.n_elem;
+	return (void *)(arena.data() + e.offset);
 }
 
-void * InMemRepData::get(int pid, int sid, int &len)
+//-------------------------------------------------------------------------------------------------------------------
+void InMemDataBuffer::erase(int pid, int sid)
 {
-	return InMemRepData::get_from_buffer(pid, sid, len, data);
-}
+	int slot = find_slot(pid, sid);
+	if (slot < 0)
+		return;
 
-void InMemRepData::erase_pid_data(int pid) {
-	//Erase from data all (pid, sid):
-	for ( auto &it : my_rep->sigs.Name2Sid) {
-		pair<int, int> pid_sid(pid, it.second);
-		if (data.find(pid_sid) != data.end()) {
-			data.erase(pid_sid);
+	// remove from entries by moving the last entry into its place
+	int j = slots[slot] - 1;
+	int last = (int)entries.size() - 1;
+	if (j != last) {
+		int last_slot = find_slot(entries[last].pid, entries[last].sid);
+		entries[j] = entries[last];
+		slots[last_slot] = j + 1;
+	}
+	entries.pop_back();
+
+	// backward shift deletion in the probing sequence
+	size_t mask = slots.size() - 1;
+	size_t hole = (size_t)slot;
+	for (size_t i = (hole + 1) & mask; slots[i] != 0; i = (i + 1) & mask) {
+		const Entry &e = entries[slots[i] - 1];
+		size_t home = hash_slot(e.pid, e.sid);
+		// move slot i into the hole if its home position is not in (hole, i]
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			slots[hole] = slots[i];
+			hole = i;
 		}
 	}
+	slots[hole] = 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+void InMemDataBuffer::compact()
+{
+	auto entry_less = [](const Entry &a, const Entry &b) { return a.pid < b.pid || (a.pid == b.pid && a.sid < b.sid); };
+	bool sorted = is_sorted(entries.begin(), entries.end(), entry_less);
+	if (!sorted) {
+		sort(entries.begin(), entries.end(), entry_less);
+		rehash(slots.size());
+	}
+
+	size_t live_bytes = 0;
+	for (auto &e : entries) live_bytes += e.n_bytes;
+	if (sorted && live_bytes == arena.size())
+		return;
+
+	vector<char> new_arena(live_bytes);
+	size_t offset = 0;
+	for (auto &e : entries) {
+		if (e.n_bytes > 0)
+			memcpy(&new_arena[offset], &arena[e.offset], e.n_bytes);
+		e.offset = offset;
+		offset += e.n_bytes;
+	}
+	arena.swap(new_arena);
+}
 
+//-------------------------------------------------------------------------------------------------------------------
+void InMemDataBuffer::to_map(map<pair<int, int>, pair<int, vector<char>>> &data) const
+{
+	data.clear();
+	for (auto &e : entries) {
+		pair<int, vector<char>> &d = data[pair<int, int>(e.pid, e.sid)];
+		d.first = e.n_elem;
+		d.second.assign(arena.begin() + e.offset, arena.begin() + e.offset + e.n_bytes);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+void InMemDataBuffer::from_map(const map<pair<int, int>, pair<int, vector<char>>> &data)
+{
+	clear();
+	size_t n_bytes = 0;
+	for (auto &it : data) n_bytes += it.second.second.size();
+	reserve(n_bytes, (int)data.size());
+	for (auto &it : data) {
+		char *dst = append(it.first.first, it.first.second, it.second.first, (int)it.second.second.size());
+		if (it.second.second.size() > 0)
+			memcpy(dst, it.second.second.data(), it.second.second.size());
+	}
 }
\ No newline at end of file
@@ -32,6 +32,7 @@ using namespace std;
 #define MED_MAGIC_NUM	0x0123456789abcdef
 #define REPOSITORY_FULL_FORMAT 0x0
 #define REPOSITORY_STRIPPED_FORMAT 0x1
+#define REPOSITORY_COMPRESSED_FORMAT 0x3	// stripped records coded per pid (see MedSigCodec.h)
 
 #define MAX_PID_NUMBER	20000000
 
@@ -50,6 +51,8 @@ using namespace std;
 #define INFRAMED_MIN_AGE			0
 #define INFRAMED_MAX_AGE		150
 
+#define IM_DEFAULT_READ_GAP	(64*1024)	// partial loads coalescing gap (bytes)
+
 class MedRepository;
 class PidRec;
 class InMemRepData;
@@ -113,20 +116,42 @@ public:
 
 	unsigned char *work_area;	// ptr to data in memory (NULL if there's no data loaded)
 	int work_area_allocated;	// signing if we allocated the work_area for data (and need to delete[] it) or not.
+	int work_area_mapped;		// signing the work_area is a read only mapping of the data file (and need to be unmapped)
+	int use_mmap;				// when set full loads map the data file instead of copying it (kept through clear())
 	unsigned long long w_size;
 	int is_loaded;
 	int full_load;				// signing wheather we loaded a full signal or a partial one
 	unsigned long long tot_size;
 	double tot_size_gb;
 	int is_locked;				// will not be freed if locked !!!
+	int evicted;				// freed by the signals cache (MedRepository::free_to_bound), reloaded on the next access
+	unsigned long long last_access;	// signals cache clock at the last load/access
+	unsigned long long read_gap;	// partial loads: pids ranges up to this many bytes apart are read together (kept through clear())
+	unsigned long long bytes_read;	// partial loads: bytes read from the data file vs. bytes kept
+	unsigned long long bytes_used;
 
 	unsigned int acc;			// accumulator for easier insertions
 
 	void init() {
 		sid = 0; sv.set_def(0); acc = 0; w_size = 0; tot_size = 0; tot_size_gb = 0; is_loaded = 0; full_load = 0;
-		is_locked = 0; work_area_allocated = 0; work_area = NULL;
+		is_locked = 0; work_area_allocated = 0; work_area_mapped = 0; work_area = NULL; evicted = 0; last_access = 0;
+		bytes_read = 0; bytes_used = 0;
+	}
+	IndexTable() { use_mmap = 0; read_gap = IM_DEFAULT_READ_GAP; init(); }
+
+	// stamps the signals cache clock on an access. Many threads access the same signal, hence the atomic reads/writes,
+	// and the write is skipped when already stamped to keep the line shared
+	void touch(const unsigned long long &clock) {
+		unsigned long long now, last;
+#pragma omp atomic read
+		now = clock;
+#pragma omp atomic read
+		last = last_access;
+		if (last != now) {
+#pragma omp atomic write
+			last_access = now;
+		}
 	}
-	IndexTable() { init(); }
 
 	int insert(unsigned int pid, int len) { int rc = insert(pid, acc, len); if (rc >= 0) acc += (unsigned int)len; return rc; }
 	int insert(unsigned int pid, unsigned int delta, int len); // { last_len = len; return sv.insert(pid, delta);  }
@@ -134,6 +159,9 @@ public:
 	int get_len(const unsigned int pid);
 	unsigned long long get_data_size(); // returns the size in bytes required for the actual data accompanying this index table
 
+	// the loaded data of all pids is one block in pids order: returns its start, the pids and the record offsets of each pid (n_pids+1 entries)
+	int get_block(unsigned char *&start, vector<int> &pids, vector<unsigned long long> &offsets);
+
 	void clear(); // also deallocated data if needed
 
 	// locking prevents clearing or reading if already loaded
@@ -152,12 +180,19 @@ public:
 	// i/o to read index and data as well
 	int read_index_and_data(string &idx_fname, string &data_fname);
 	int read_index_and_data(string &idx_fname, string &data_fname, const vector<int> &pids_to_include);
+	int read_index_and_data_locked(string &idx_fname, string &data_fname, const vector<int> &pids_to_include); // caller holds the read lock of sid (or owns the table)
+	int read_compressed_data(const string &data_fname);	// full load of a compressed data file (decoded into the plain layout)
+
+	// paging hints for a mapped work_area (no op when the data was copied)
+	void advise_pids(const vector<int> &pids, int advice);
 
 };
 
 class MedIndex {
 public:
 	int rep_mode;
+	int use_mmap;	// mode 3 and up: map data files instead of reading them (see MedRepository::set_mmap_mode)
+	unsigned long long read_gap;	// gap threshold for coalescing partial reads (see MedRepository::set_read_gap)
 
 	vector<string> ifnames;
 
@@ -204,7 +239,7 @@ public:
 	int min_pid_num;
 	int max_pid_num;
 
-	MedIndex() { min_pid_num = -1; max_pid_num = -1; rep_mode = 0; }
+	MedIndex() { min_pid_num = -1; max_pid_num = -1; rep_mode = 0; use_mmap = 0; read_gap = IM_DEFAULT_READ_GAP; }
 
 private:
 	int mode;
@@ -252,6 +287,58 @@ private:
 
 };
 
+// InMemDataBuffer holds the in memory data of InMemRepData : all (pid,sid) vectors live in a single byte arena,
+// and are found through an open addressing hash on (pid,sid).
+// Appending to a (pid,sid) that is not the last one written moves it to the end of the arena, the space left behind
+// is reclaimed by compact() (called from InMemRepData::sortData()), which also puts the entries back in (pid,sid) order.
+// Pointers returned by get() are valid until the next append/compact.
+class InMemDataBuffer {
+public:
+	struct Entry {
+		int pid;
+		int sid;
+		int n_elem;
+		int n_bytes;
+		size_t offset;
+	};
+
+	InMemDataBuffer() { clear(); }
+
+	/// make room for n_elem more elements (n_bytes) of pid,sid , returns where to write them
+	char *append(int pid, int sid, int n_elem, int n_bytes);
+
+	/// data of pid,sid , NULL and len 0 if not loaded
+	void *get(int pid, int sid, int &len) const;
+	bool contains(int pid, int sid) const { return find_slot(pid, sid) >= 0; }
+
+	void erase(int pid, int sid);
+	void clear() { arena.clear(); entries.clear(); slots.assign(16, 0); }
+	void reserve(size_t n_bytes, int n_entries) { arena.reserve(n_bytes); entries.reserve(n_entries); }
+
+	/// sort the entries by (pid,sid) and rewrite the arena so that it holds exactly the live entries in that order
+	void compact();
+
+	/// all loaded (pid,sid) entries : sorted by (pid,sid) after compact() (and so after InMemRepData::sortData()), in insertion order before
+	const vector<Entry> &get_entries() const { return entries; }
+	size_t size() const { return entries.size(); }
+
+	/// conversion to/from the (pid,sid) -> (n_elem, data) map form (used for serialization)
+	void to_map(map<pair<int, int>, pair<int, vector<char>>> &data) const;
+	void from_map(const map<pair<int, int>, pair<int, vector<char>>> &data);
+
+private:
+	vector<char> arena;
+	vector<Entry> entries;
+	vector<int> slots;		// open addressing table (size is a power of 2) , entries index + 1 , 0 : empty slot
+
+	size_t hash_slot(int pid, int sid) const {
+		unsigned long long key = ((unsigned long long)(unsigned int)pid << 32) | (unsigned int)sid;
+		return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (slots.size() - 1);
+	}
+	int find_slot(int pid, int sid) const;
+	void rehash(size_t n_slots);
+};
+
 // InMemRepData is a class holding RAW data to be loaded into a repository 
 // it works under the assumption of a small number of pids (1-1000 more or less).
 // Large datasets would better be from an already made repository
@@ -261,7 +348,7 @@ private:
 class InMemRepData : public SerializableObject {
 public:
 	MedRepository * my_rep;
-	map<pair<int, int>, pair<int, vector<char>>> data;  // map from a pair of pid,sid to a pair of nvals, data vector
+	InMemDataBuffer data;  // pid,sid -> nvals, data
 
 														// init_rep must be called first , as we must know the sigs names/types/etc...
 	void init_rep(MedRepository &rep) { my_rep = &rep; }
@@ -272,7 +359,7 @@ public:
 	int insertData(int pid, int sid, int *time_data, float *val_data, int n_time, int n_val);
 	int insertData(int pid, const char *sig, int *time_data, float *val_data, int n_time, int n_val);
 	static int insertData_to_buffer(int pid, int sid, int *time_data, float *val_data, int n_time, int n_val, 
-	const MedSignals &sigs, map<pair<int, int>, pair<int, vector<char>>> &data);
+	const MedSignals &sigs, InMemDataBuffer &data);
 
 	/// Erase pid data
 	void erase_pid_data(int pid);
@@ -286,7 +373,7 @@ public:
 	void clear() { data.clear(); }
 
 	// a repository get function to use with this type of data
-	static void *get_from_buffer(int pid, int sid, int &len,const map<pair<int, int>, pair<int, vector<char>>> &data);
+	static void *get_from_buffer(int pid, int sid, int &len, const InMemDataBuffer &data) { return data.get(pid, sid, len); }
 	void *get(int pid, int sid, int &len);
 
 	// debug and prints
@@ -294,8 +381,10 @@ public:
 	int print(int pid);
 	int print(int pid, int sid);
 
-	// serializer for data
-	ADD_SERIALIZATION_FUNCS(data);
+	// serializer for data (same format as the former map<pair<int, int>, pair<int, vector<char>>> data member)
+	size_t get_size();
+	size_t serialize(unsigned char *blob);
+	size_t deserialize(unsigned char *blob);
 
 };
 
@@ -320,7 +409,8 @@ public:
 	int format;
 
 	MedIndex index;
-	MedDictionarySections dict;
+	MedDictionarySections own_dict;
+	MedDictionarySections &dict;	// own_dict, or the dictionary of the repository it was created to share (see MedRepository(MedDictionarySections &))
 	MedSignals sigs;
 	vector<int> pids;
 	vector<int> all_pids_list;
@@ -400,11 +490,80 @@ public:
 	int free_to_bound() { return free_to_bound(bound_gb); }				// calls free_to_bound with default set memory bound
 	int free_to_bound(double _bound_gb); // frees unlocked signals until getting below the bound
 
-	// default is inifinity (1000gb), however - if set, the repository will try to free signals in order to get below this bound
-	// it can not free locked in signals, so in some cases the overall memory usage could be higher
-	int set_max_mem(double gb_mem) { bound_gb = gb_mem; return 0; }
-
-	MedRepository() { path = ""; metadata_path = ""; work_area = NULL; work_size = 0; fsignals_to_files = ""; index.my_rep = this; min_pid_num = -1; max_pid_num = -1; rep_mode = 0; rep_files_prefix = "rep"; bound_gb = 100.0; sigs.my_repo = this; }
+	// default is 100gb and no automatic freeing. Once set, the repository works as a signals cache: set_max_mem(), each
+	// load() and each reload of an evicted signal evict the least recently used fully loaded signals until getting below
+	// this bound, and an evicted signal is reloaded on its next access (get3() or pin()). Hence a pointer returned by
+	// get3()/uget() is valid only while its signal is pinned or held (see MedRepositoryPins) : callers reading signals
+	// while other threads load, or reading several signals at once, must pin them. Locked, pinned, held and partially
+	// loaded signals are never evicted, so in some cases the overall memory usage could be higher
+	int set_max_mem(double gb_mem) { bound_gb = gb_mem; use_sig_cache = 1; free_to_bound(); return 0; }
+
+	// signals cache
+	struct SigCacheStats {
+		long long hits = 0;				// load() of an already loaded signal
+		long long misses = 0;			// load() that read a signal
+		long long reloads = 0;			// evicted signals read again on access
+		long long evictions = 0;
+		unsigned long long evicted_bytes = 0;
+	};
+	int use_sig_cache;
+	unsigned long long access_clock;	// advanced on each load, stamped on the accessed index tables
+	SigCacheStats cache_stats;
+	double loaded_gb();					// memory of all loaded signals
+	void print_cache_stats();
+
+	// pinning a signal keeps it from being evicted (and reloads it if it was), several threads can pin the same signal.
+	// get3() pointers into a signal stay valid while it is pinned. pin/unpin do nothing when the cache is off.
+	int pin(int sid);
+	void unpin(int sid);
+	// holding is a pin that may be released later by any thread (PidDynamicRec keeps pointers into held signals).
+	// Holds are counted also when the cache is off, so signals held before set_max_mem() stay held until released
+	int hold(int sid);
+	void release(int sid);
+	int reload_evicted(int sid);
+	void sig_cache_touch(int sid, bool hit);	// stamps the access after a load (hit if it was already loaded)
+
+	// mmap mode (mode 3 and up) : .data files are mapped read only instead of being copied into memory, get3() then
+	// returns pointers into the mapping, and several processes reading the same repository share one physical copy.
+	// load() of an already mapped signal becomes a WILLNEED paging hint, free() unmaps.
+	// Partial loads (with a pids list) still copy only the requested pids.
+	// Can be set in the repository config file with a "MMAP 1" line, or with set_mmap_mode() before init/read_all/load.
+	int set_mmap_mode(int _use_mmap);
+	int mmap_mode() { return index.use_mmap; }
+
+	// partial loads (load() with pids) read the requested pids ranges of each signal in file order, merging ranges that
+	// are up to read_gap bytes apart into one read, and issuing the reads in parallel. A bigger gap means fewer, larger
+	// reads at the price of reading unused bytes, 0 merges only adjacent ranges. Can also be set with READ_GAP in the config.
+	struct PartialReadStats {
+		long long loads = 0;				// partial signal loads
+		unsigned long long bytes_read = 0;	// read from the data files
+		unsigned long long bytes_used = 0;	// of which belong to requested pids
+	};
+	PartialReadStats read_stats;
+	void set_read_gap(unsigned long long gap_bytes);
+	void print_read_stats();
+
+	// overlays (mode 3 and up): small delta repositories built by MedConvert (DELTA_OF in its config) are registered in
+	// the base config with "OVERLAY <delta .repository> <append|replace>" lines, and each loaded signal is merged with
+	// them per pid, in the config order. append adds the overlay records (merged by time, exact duplicates dropped),
+	// replace takes all the records of the pids in the overlay (new or changed pids converted with their full history).
+	// Merged signals are always copied into memory (also in mmap mode). fold_overlays() writes the merged signals as the
+	// new base files and removes the OVERLAY lines, the delta repositories can then be deleted.
+	struct RepOverlay {
+		string config_fname;
+		int replace = 0;
+		vector<int> pids;					// all pids in the overlay, sorted
+		vector<string> index_fnames;		// by the base fno, empty when the overlay has no such signal
+		vector<string> data_fnames;
+	};
+	vector<RepOverlay> overlays;
+	int read_overlays();
+	int merge_overlays(int sid, const vector<int> &pids_sort_uniq);
+	int fold_overlays();
+
+	MedRepository() : MedRepository(own_dict) {}
+	// a repository using the given dictionary, which must outlive it, and is not changed by clear()
+	explicit MedRepository(MedDictionarySections &_dict) : dict(_dict) { path = ""; metadata_path = ""; work_area = NULL; work_size = 0; fsignals_to_files = ""; index.my_rep = this; min_pid_num = -1; max_pid_num = -1; rep_mode = 0; rep_files_prefix = "rep"; bound_gb = 100.0; use_sig_cache = 0; access_clock = 0; sigs.my_repo = this; }
 	~MedRepository() {
 		//fprintf(stderr, "rep free\n"); fflush(stderr);
 		if (work_area) {
@@ -416,6 +575,8 @@ public:
 		free_all_sigs();
 		//fprintf(stderr, "rep free ended\n"); fflush(stderr);
 	};
+	MedRepository(const MedRepository &) = delete;
+	MedRepository &operator=(const MedRepository &) = delete;
 	//int build_full_format_index();
 
 	void clear();
@@ -520,6 +681,21 @@ private:
 	vector<int> sids;
 };
 
+//===============================================================
+// pins a set of signals of a repository (see MedRepository::pin) for the lifetime of the object, so
+// get3()/uget() pointers into them stay valid. Does nothing when the signals cache is off.
+class MedRepositoryPins {
+public:
+	MedRepositoryPins(MedRepository &_rep, const vector<int> &sids);
+	~MedRepositoryPins();
+	MedRepositoryPins(const MedRepositoryPins &) = delete;
+	MedRepositoryPins &operator=(const MedRepositoryPins &) = delete;
+
+private:
+	MedRepository &rep;
+	vector<int> pinned;
+};
+
 //=============================================================================================
 // Inline functions
 //=============================================================================================
@@ -620,6 +796,13 @@ inline void *MedRepository::get_all_modes(int pid, int sid, int &len)
 // get for mode 3 using index table 
 inline void *MedRepository::get3(int pid, int sid, int &len)
 {
+	if (use_sig_cache) {
+		IndexTable &itable = index.index_table[sid];
+		if (itable.evicted)
+			reload_evicted(sid);
+		itable.touch(access_clock);
+	}
+
 	unsigned long long pos;
 	index.index_table[sid].get(pid, pos, len);
 
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <fstream>
 #include <algorithm>
+#include <omp.h>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string.hpp>
@@ -56,6 +57,8 @@ void MedConvert::clear()
 	serial2sid.clear();
 	forced.clear();
 	safe_mode = 0;
+	delta_of = "";
+	delta_replace = 0;
 	default_time_unit = MedTime::Date;
 }
 
@@ -99,6 +102,15 @@ int MedConvert::read_config(const string &fname)
 				if (fields[0].compare("DATA_S") == 0) in_strings_data_fnames.push_back(fields[1]);
 				if (fields[0].compare("MODE") == 0) mode = med_stoi(fields[1]);
 				if (fields[0].compare("SAFE_MODE") == 0) safe_mode = med_stoi(fields[1]);
+				if (fields[0].compare("COMPRESS") == 0) compress = med_stoi(fields[1]);
+				if (fields[0].compare("DELTA_OF") == 0) delta_of = fields[1];
+				if (fields[0].compare("DELTA_MODE") == 0) {
+					if (fields[1] != "append" && fields[1] != "replace") {
+						MERR("MedConvert: read_config: DELTA_MODE should be append or replace, got %s\n", fields[1].c_str());
+						return -1;
+					}
+					delta_replace = (fields[1] == "replace");
+				}
 				if (fields[0].compare("PREFIX") == 0) rep_files_prefix = fields[1];
 				if (fields[0].compare("RELATIVE") == 0) relative = 1;
 				if (fields[0].compare("TIMEUNIT") == 0 || fields[0].compare("TIME_UNIT") == 0) {
@@ -294,6 +306,25 @@ int MedConvert::read_all(const string &config_fname)
 	if (out_path.length() == 0)
 		out_path = path;
 
+	if (delta_of != "") {
+		add_path_to_name_IM(path, delta_of);
+		MedRepository base;
+		if (mode < 3 || base.read_config(delta_of) < 0 || base.rep_mode < 3) {
+			MERR("MedConvert: read_all: DELTA_OF needs mode 3 and up, and a readable mode 3 and up repository (%s)\n", delta_of.c_str());
+			return -1;
+		}
+		boost::system::error_code ec;
+		if (base.rep_files_prefix == rep_files_prefix && boost::filesystem::equivalent(base.path, out_path, ec)) {
+			MERR("MedConvert: read_all: the delta repository would overwrite %s, use another OUTDIR or PREFIX\n", delta_of.c_str());
+			return -1;
+		}
+		// appended records come without the forced signals of their pids
+		if (!delta_replace && forced.size() > 0) {
+			MLOG("MedConvert: read_all: append delta, not forcing signals\n");
+			forced.clear();
+		}
+	}
+
 	// add path to all input fnames + fix names
 	add_path_to_name_IM(path, code_to_signal_fname);
 	add_path_to_name_IM(path, signal_to_files_fname);
@@ -404,6 +435,8 @@ int MedConvert::read_all(const string &config_fname)
 	if (create_indexes() < 0)
 		MTHROW_AND_ERR("MedConvert: read_all(): failed generating new data and indexes\n");
 
+	if (delta_of != "" && register_delta() < 0)
+		return -1;
 
 
 	return 0;
@@ -674,13 +707,16 @@ void MedConvert::parse_fields_into_gsv(string &curr_line, vector<string> &fields
 
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------
-void MedConvert::get_next_signal_all_lines(vector<string> &lines, vector<int> &f_i, pid_data &curr, vector<file_stat> &fstat, map<pair<string, string>, int>& missing_dict_vals)
+void MedConvert::get_next_signal_all_lines(vector<string> &lines, vector<int> &f_i, const vector<int> &line_owner, vector<pid_data> &batch, vector<file_stat> &fstat, map<pair<string, string>, int>& missing_dict_vals)
 {
 	//MLOG("===> lines %d\n", lines.size());
-//#pragma omp parallel for schedule(dynamic) if (run_parallel)
+
+	// unknown dictionary values are counted per thread and merged at the end
+	vector<map<pair<string, string>, int>> th_missing_dict_vals(omp_get_max_threads());
+	int n_missing_before = (int)missing_dict_vals.size();
 
 	vector<collected_data> cds(lines.size());
-#pragma omp parallel for if (run_parallel)
+#pragma omp parallel for schedule(dynamic, 256) if (run_parallel)
 	for (int k = 0; k < lines.size(); k++) {
 		//MLOG("k=%d line %s\n", k, lines[k].c_str());
 		collected_data &cd = cds[k];
@@ -745,16 +781,10 @@ void MedConvert::get_next_signal_all_lines(vector<string> &lines, vector<int> &f
 		}
 		catch (invalid_argument &e) {
 
+			map<pair<string, string>, int> &my_missing = th_missing_dict_vals[omp_get_thread_num()];
 			pair<string, string> my_key = make_pair(sigs.name(sid), string(e.what()));
-			if (missing_dict_vals.find(my_key) == missing_dict_vals.end()) {
-#pragma omp critical
-				missing_dict_vals[my_key] = 1;
-			}
-			else {
-#pragma omp atomic
-				++missing_dict_vals[my_key];
-			}
-			if (missing_dict_vals.size() < 10)
+			++my_missing[my_key];
+			if (n_missing_before + my_missing.size() < 10)
 				MWARN("MedConvert::get_next_signal: missing from dictionary (sig [%s], type %d) : file [%s] : line [%s] \n",
 					sigs.name(sid).c_str(), sigs.type(sid), curr_fstat.fname.c_str(), curr_line.c_str());
 			if (!full_error_file.empty()) {
@@ -770,8 +800,10 @@ void MedConvert::get_next_signal_all_lines(vector<string> &lines, vector<int> &f
 		}
 		catch (...) {
 
-			curr_fstat.n_bad_format_lines++;
-			if (curr_fstat.n_bad_format_lines < 10) {
+			int n_bad;
+#pragma omp atomic capture
+			n_bad = ++curr_fstat.n_bad_format_lines;
+			if (n_bad < 10) {
 				MWARN("MedConvert::get_next_signal: bad format in parsing file %s in line %d:\n%s\n",
 					curr_fstat.fname.c_str(), curr_fstat.n_parsed_lines, curr_line.c_str());
 			}
@@ -788,11 +820,15 @@ void MedConvert::get_next_signal_all_lines(vector<string> &lines, vector<int> &f
 		}
 	}
 
+	for (auto &th_missing : th_missing_dict_vals)
+		for (auto &it : th_missing)
+			missing_dict_vals[it.first] += it.second;
+
 	for (int k = 0; k < cds.size(); k++) {
 		file_stat &curr_fstat = fstat[f_i[k]];
 		if (cds[k].serial >= 0) {
 			{
-				curr.raw_data[cds[k].serial].push_back(cds[k]);
+				batch[line_owner[k]].raw_data[cds[k].serial].push_back(cds[k]);
 				curr_fstat.n_parsed_lines++;
 			}
 		}
@@ -997,6 +1033,44 @@ int MedConvert::create_indexes()
 	MedProgress load_progress("MedConvert::create_indexes", 0, 30);
 
 
+	// pids are collected (in pid order) into batches of pids_batch_size, the lines of a whole batch are parsed in one
+	// parallel loop, each pid is sorted in parallel, and then written in pid order, so the output stays sorted by pid
+	vector<pid_data> batch;
+	vector<string> lines;
+	vector<int> f_i;
+	vector<int> line_owner;
+	auto flush_batch = [&]() {
+		if (batch.empty())
+			return;
+		timer_action.start();
+		for (auto &bp : batch)
+			bp.raw_data.resize(serial2sid.size());
+		get_next_signal_all_lines(lines, f_i, line_owner, batch, fstats, missing_dict_vals);
+#pragma omp parallel for schedule(dynamic) if (run_parallel && batch.size() > 1)
+		for (int b = 0; b < batch.size(); b++)
+			sort_pid_data(batch[b]);
+		timer_action.take_curr_time();
+		tot_time[4] += timer_action.diff_sec();
+		tot_time[0] += timer_action.diff_sec();
+
+		// write data to output files
+		timer_action.start();
+		for (auto &bp : batch) {
+			if (write_indexes_new_modes(bp, true) < 0) {
+				//MERR("MedConvert: create_indexes: curr packet for pid %d was not written...\n", bp.pid);
+			}
+			else
+				all_pids.push_back(bp.pid);
+		}
+		timer_action.take_curr_time();
+		tot_time[1] += timer_action.diff_sec();
+
+		batch.clear();
+		lines.clear();
+		f_i.clear();
+		line_owner.clear();
+	};
+
 	while (n_open_in_files > 0) {
 
 		// find current pid to extract
@@ -1016,16 +1090,12 @@ int MedConvert::create_indexes()
 			if (err_log_file.is_open()) err_log_file.flush();
 		}
 
-		// read data from files
+		// read lines of current pid from files
 		curr.raw_data.clear();
-		curr.raw_data.resize(serial2sid.size());
 		curr.pid = c_pid;
 
-		timer_action.start();
-
 		inside_timer.start();
-		vector<string> lines;
-		vector<int> f_i;
+		size_t n_lines_before = lines.size();
 
 #pragma omp parallel for schedule(dynamic) if (run_parallel_files)
 		for (int i = 0; i < n_files_opened; i++) {
@@ -1038,32 +1108,26 @@ int MedConvert::create_indexes()
 
 		inside_timer.take_curr_time();
 		tot_time[3] += inside_timer.diff_sec();
+		tot_time[0] += inside_timer.diff_sec();
 
-		inside_timer.start();
-		get_next_signal_all_lines(lines, f_i, curr, fstats, missing_dict_vals);
-		inside_timer.take_curr_time();
-		tot_time[4] += inside_timer.diff_sec();
-
-
-		timer_action.take_curr_time();
-		tot_time[0] += timer_action.diff_sec();
-
-		// write data to output files
-		timer_action.start();
 		if (curr.pid >= 0) {
-			if (write_indexes_new_modes(curr) < 0) {
-				//MERR("MedConvert: create_indexes: curr packet for pid %d was not written...\n", curr.pid);
-
-			}
-			else
-				all_pids.push_back(curr.pid);
+			line_owner.resize(lines.size(), (int)batch.size());
+			batch.push_back(move(curr));
+			curr = pid_data();
+		}
+		else {
+			lines.resize(n_lines_before);
+			f_i.resize(n_lines_before);
 		}
-		timer_action.take_curr_time();
-		tot_time[1] += timer_action.diff_sec();
 
 		++n_pids_extracted;
 		load_progress.update();
+		bool last_pid = (n_open_in_files <= 0) || (test_run_max_pids > 0 && n_pids_extracted >= test_run_max_pids);
+		if (batch.size() >= max(pids_batch_size, 1) || last_pid)
+			flush_batch();
+
 		if (check_for_error_pid_cnt > 0 && n_pids_extracted % check_for_error_pid_cnt == 0) {
+			flush_batch();
 			timer_action.start();
 			test_for_load_error(missing_dict_vals, n_pids_extracted, false, curr_errors, curr_errors,
 				prev_forced_errs);
@@ -1075,6 +1139,7 @@ int MedConvert::create_indexes()
 		if (test_run_max_pids > 0 && n_pids_extracted >= test_run_max_pids)
 			break;
 	}
+	flush_batch();
 
 	MLOG("Current pid to extract is %d <<<<< >>>>> n_extracted %d n_open_in_files %d. Times [%2.1f (%2.1f, %2.1f), %2.1f, %2.1f]\n",
 		c_pid, n_pids_extracted, n_open_in_files, tot_time[0], tot_time[3], tot_time[4], tot_time[1], tot_time[2]);
@@ -1152,11 +1217,64 @@ void MedConvert::test_for_load_error(const map<pair<string, string>, int> &missi
 
 	}
 }
+//------------------------------------------------
+// adding the converted repository as an overlay of DELTA_OF (see MedRepository::overlays), once
+int MedConvert::register_delta()
+{
+	if (repository_config_fname == "") {
+		MERR("MedConvert:: register_delta:: no repository_config (CONFIG) file, can't add it to %s\n", delta_of.c_str());
+		return -1;
+	}
+	string delta_config = boost::filesystem::absolute(repository_config_fname).string();
+
+	ifstream inf(delta_of, ios::in | ios::binary);
+	if (!inf) {
+		MERR("MedConvert:: register_delta:: can't open %s\n", delta_of.c_str());
+		return -1;
+	}
+	string curr_line;
+	while (getline(inf, curr_line)) {
+		if (curr_line.size() > 0 && curr_line.back() == '\r')
+			curr_line.pop_back();
+		vector<string> fields;
+		split(fields, curr_line, boost::is_any_of("\t"));
+		if (fields.size() >= 2 && fields[0] == "OVERLAY" && fields[1] == delta_config) {
+			MLOG("MedConvert:: register_delta:: %s is already an overlay of %s\n", delta_config.c_str(), delta_of.c_str());
+			return 0;
+		}
+	}
+	inf.clear();
+	inf.seekg(0, ios::end);
+	bool newline_needed = false;
+	if (inf.tellg() > 0) {
+		inf.seekg(-1, ios::end);
+		newline_needed = (inf.get() != '\n');
+	}
+	inf.close();
+
+	ofstream outf(delta_of, ios::out | ios::app);
+	if (newline_needed)
+		outf << endl;
+	outf << "OVERLAY\t" << delta_config << "\t" << (delta_replace ? "replace" : "append") << endl;
+	outf.close();
+	if (!outf) {
+		MERR("MedConvert:: register_delta:: failed writing %s\n", delta_of.c_str());
+		return -1;
+	}
+	MLOG("MedConvert:: register_delta:: added %s as an overlay of %s\n", delta_config.c_str(), delta_of.c_str());
+	return 0;
+}
+
 //------------------------------------------------
 int MedConvert::open_indexes()
 {
 	int i;
 
+	if (compress && mode < 3) {
+		MWARN("MedConvert:: open_indexes:: compressed data files are supported from mode 3, writing plain files\n");
+		compress = 0;
+	}
+
 	if (mode < 3) {
 		index_f.resize(index_fnames.size());
 		fill(index_f.begin(), index_f.end(), (ofstream *)NULL);
@@ -1185,6 +1303,12 @@ int MedConvert::open_indexes()
 			indexes[i].last_len = 0;
 			indexes[i].work_area = NULL;
 		}
+		if (compress) {
+			codecs.resize(index_fnames.size());
+			blocks_pos.assign(index_fnames.size(), vector<unsigned long long>());
+			for (i = 0; i < codecs.size(); i++)
+				codecs[i].init(sigs.Sid2Info[serial2sid[i]]);
+		}
 	}
 
 	data_f.resize(data_fnames.size());
@@ -1201,7 +1325,7 @@ int MedConvert::open_indexes()
 			if (verbose_open_files)
 				MLOG("data_f file %d %s opened\n", i, data_fnames[i].c_str());
 			// writing repository stripped format bits to data fo;es
-			int data_format = REPOSITORY_STRIPPED_FORMAT;
+			int data_format = compress ? REPOSITORY_COMPRESSED_FORMAT : REPOSITORY_STRIPPED_FORMAT;
 			data_f[i]->write((char *)&data_format, sizeof(int));
 			data_f_pos[i] = sizeof(int);
 			data_f[i]->flush();
@@ -1245,6 +1369,13 @@ int MedConvert::write_all_indexes(vector<int> &all_pids)
 	}
 	for (int i = 0; i < data_f.size(); i++) {
 		if (data_f[i] != NULL) {
+			if (compress) {
+				blocks_pos[i].push_back(data_f_pos[i]);
+				if (codecs[i].write_trailer(*data_f[i], blocks_pos[i]) < 0) {
+					MERR("MedConvert:: write_all_indexes:: failed writing %s\n", data_fnames[i].c_str());
+					return -1;
+				}
+			}
 			data_f[i]->close();
 			delete data_f[i];
 			data_f[i] = NULL;
@@ -1273,15 +1404,12 @@ auto cd_to_tuple(const collected_data & v1) -> decltype(std::tie(v1.date, v1.dat
 */
 
 //------------------------------------------------
-int MedConvert::write_indexes_new_modes(pid_data &curr)
+void MedConvert::sort_pid_data(pid_data &curr)
 {
-	if (curr.pid < 0)
-		MTHROW_AND_ERR("MedConvert::write_indexes negative pid %d", curr.pid);
 	// sort unique per signal
-	int i;
 	int n_sids = (int)curr.raw_data.size();
 #pragma omp parallel for if (n_sids > 4) schedule(dynamic)
-	for (i = 0; i < curr.raw_data.size(); i++) {
+	for (int i = 0; i < curr.raw_data.size(); i++) {
 		GenericSigVec gsv1;
 		auto& info = sigs.Sid2Info[serial2siginfo[i].sid];
 		gsv1.init(info);
@@ -1302,7 +1430,17 @@ int MedConvert::write_indexes_new_modes(pid_data &curr)
 		curr.raw_data[i].resize(std::distance(curr.raw_data[i].begin(), it));
 
 	}
+}
 
+//-----------------------------------------------------------------------------------------------------------------
+int MedConvert::write_indexes_new_modes(pid_data &curr, bool is_sorted)
+{
+	if (curr.pid < 0)
+		MTHROW_AND_ERR("MedConvert::write_indexes negative pid %d", curr.pid);
+	if (!is_sorted)
+		sort_pid_data(curr);
+
+	int i;
 	// forced signals
 	for (i = 0; i < forced.size(); i++) {
 		if (curr.raw_data[sid2serial[dict.id(forced[i])]].size() != 1) {
@@ -1330,8 +1468,19 @@ int MedConvert::write_indexes_new_modes(pid_data &curr)
 			if (sid_type >= 0 && sid_type < T_Last) {
 
 				int struct_len = (int)sigs.Sid2Info[sid].bytes_len;
-				for (int j = 0; j < ilen; j++) {
-					data_f[fno]->write((char *)&(curr.raw_data[i][j].buf[0]), struct_len);
+				if (compress) {
+					vector<unsigned char> recs((size_t)ilen * struct_len), blk;
+					for (int j = 0; j < ilen; j++)
+						memcpy(&recs[(size_t)j * struct_len], &(curr.raw_data[i][j].buf[0]), struct_len);
+					codecs[fno].encode(&recs[0], ilen, blk);
+					data_f[fno]->write((char *)&blk[0], blk.size());
+					blocks_pos[fno].push_back(data_f_pos[fno]);
+					data_f_pos[fno] += blk.size();
+				}
+				else {
+					for (int j = 0; j < ilen; j++) {
+						data_f[fno]->write((char *)&(curr.raw_data[i][j].buf[0]), struct_len);
+					}
 				}
 
 				indexes[fno].insert(curr.pid, ilen);
@@ -1404,6 +1553,8 @@ void MedConvert::init_load_params(const string &init_str) {
 			run_parallel = (med_stoi(it.second) > 0);
 		else if (it.first == "run_parallel_files")
 			run_parallel_files = (med_stoi(it.second) > 0);
+		else if (it.first == "pids_batch_size")
+			pids_batch_size = med_stoi(it.second);
 		else if (it.first == "full_error_file")
 			full_error_file = it.second;
 		else
@@ -8,6 +8,7 @@
 #include "InfraMed.h"
 #include "MedDictionary.h"
 #include "MedSignals.h"
+#include "MedSigCodec.h"
 
 #include <vector>
 #include <string>
@@ -72,6 +73,9 @@ class  MedConvert {
 public:
 	int mode;						// 0/1 - original mode (currently default) 2 - new mode (data and index file for each signal)
 	int safe_mode;					// 0/1 - in safe_mode==1 loading will exit in several inconsistencies
+	int compress = 0;				// 0/1 - mode 3 and up: write compressed data files (COMPRESS in config, see MedSigCodec.h)
+	string delta_of;				// mode 3 and up: the converted data is an overlay of this repository (DELTA_OF in config), registered in its config when done
+	int delta_replace = 0;			// 0/1 - DELTA_MODE append/replace in config : new records of existing pids, or new/changed pids with their full history
 	string	rep_files_prefix;		// general prefix for all files created in mode 2
 
 	string config_fname;
@@ -111,6 +115,7 @@ public:
 	bool verbose_open_files = false; ///< If true will print when openning files
 	bool run_parallel = true; ///< If true will load in parallel
 	bool run_parallel_files = false; ///< If true will read files in parallel
+	int pids_batch_size = 1000; ///< how many pids are collected before parsing their lines together in parallel (1 : pid by pid)
 	string full_error_file; ///< provide full path to error file
 
 	void init_load_params(const string &init_str);
@@ -165,11 +170,12 @@ public:
 	int n_open_in_files;
 	// actually reading data and creating index and data files
 	void collect_lines(vector<string> &lines, vector<int> &f_i, int file_i, vector<string> &buffered_lines, int &buffer_pos, ifstream &inf, int file_type, pid_data &curr, int &fpid, file_stat& curr_fstat, map<pair<string, string>, int>&);
-	void get_next_signal_all_lines(vector<string> &lines, vector<int> &f_i, pid_data &curr, vector<file_stat> &fstat, map<pair<string, string>, int>&);
+	void get_next_signal_all_lines(vector<string> &lines, vector<int> &f_i, const vector<int> &line_owner, vector<pid_data> &batch, vector<file_stat> &fstat, map<pair<string, string>, int>&);
 	void parse_fields_into_gsv(string &curr_line, vector<string> &fields, int sid, GenericSigVec &cd_sv);
 	int create_indexes();
 	int create_repository_config();
 	int create_signals_config();
+	int register_delta();
 
 	// legacy
 	//void get_next_signal(vector<string> &buffered_lines, int &buffer_pos, ifstream &inf, int file_type, pid_data &curr, int &fpid, file_stat& curr_fstat, map<pair<string, string>, int>&);
@@ -183,9 +189,12 @@ public:
 	vector<ofstream *> index_f;
 	vector<ofstream *> data_f;
 	vector<unsigned long long> data_f_pos;
+	vector<MedSigCodec> codecs;						// compress: coder of each data file
+	vector<vector<unsigned long long>> blocks_pos;	// compress: position of each pid block in each data file
 	int open_indexes();
 	int write_all_indexes(vector<int> &all_pids);
-	int write_indexes_new_modes(pid_data &curr);
+	void sort_pid_data(pid_data &curr);
+	int write_indexes_new_modes(pid_data &curr, bool is_sorted = false);
 	int close_indexes();
 
 	// loading subsets
@@ -9,14 +9,17 @@
 
 #include "InfraMed.h"
 #include "MedDictionary.h"
+#include "Utils.h"
 #include "Logger/Logger/Logger.h"
 #include <fstream>
+#include <cstring>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 //#define _SCL_SECURE_NO_WARNINGS
 
 #include <queue>
 #include <unordered_set>
+#include <unordered_map>
 #include <algorithm>
 
 #define LOCAL_SECTION LOG_DICT
@@ -62,6 +65,7 @@ int MedDictionary::read(const string &fname)
 
 	MLOG_D("MedDictinary: read: reading dictionary file %s\n", fname.c_str());
 	fnames.push_back(fname); // TD : check that we didn't already load this file
+	compiled.clear();
 	string curr_line;
 	while (getline(inf, curr_line)) {
 		mes_trim(curr_line); //Alpine has problem with boost::trim 
@@ -148,6 +152,7 @@ int MedDictionary::read(const string &fname)
 //-----------------------------------------------------------------------------------------------
 void MedDictionary::push_new_set(int set_id, int member_id)
 {
+	compiled.clear();
 	pair<int, int> p;
 	p.first = set_id;
 	p.second = member_id;
@@ -181,6 +186,8 @@ int MedDictionary::id_list(vector<string> &names, vector<int> &ids)
 //-----------------------------------------------------------------------------------------------
 int MedDictionary::id(const string &name) const
 {
+	if (!compiled.empty())
+		return compiled.id(name);
 	if (Name2Id.find(name) == Name2Id.end())
 		return -1;
 	return Name2Id.at(name);
@@ -225,6 +232,9 @@ int MedDictionary::is_in_set(const string& member, const string& set_name)
 //-----------------------------------------------------------------------------------------------
 int MedDictionary::is_in_set(int member_id, int set_id)
 {
+	if (!compiled.empty())
+		return compiled.is_in_set(member_id, set_id);
+
 	pair<int, int> p;
 	p.first = set_id;
 	p.second = member_id;
@@ -333,6 +343,20 @@ void MedDictionary::get_members_to_all_sets(vector<int> &members, vector<int> &s
 
 
 	Member2AllSets.clear();
+	if (!compiled.empty()) {
+		for (int member : members) {
+			int n;
+			const int *all_sets = compiled.ancestors(member, n);
+			vector<int> &v_sets = Member2AllSets[member];
+			if (use_sets.empty() || use_sets.find(member) != use_sets.end())
+				v_sets.push_back(member);
+			for (int j = 0; j < n; j++)
+				if (use_sets.empty() || use_sets.find(all_sets[j]) != use_sets.end())
+					v_sets.push_back(all_sets[j]);
+		}
+		return;
+	}
+
 #pragma omp parallel for
 	for (int i = 0; i < members.size(); i++) {
 		int member = members[i];
@@ -494,7 +518,9 @@ int MedDictionary::prep_sets_lookup_table(const vector<string> &set_names, vecto
 	}
 
 	int max_id = 1;
-	if (Id2Name.size() > 0)
+	if (!compiled.empty())
+		max_id = compiled.max_id();
+	else if (Id2Name.size() > 0)
 		max_id = Id2Name.rbegin()->first;
 	else
 		MTHROW_AND_ERR("prep_sets_lookup_table() : Got an empty Id2Name...\n");
@@ -502,6 +528,25 @@ int MedDictionary::prep_sets_lookup_table(const vector<string> &set_names, vecto
 	lut.clear();
 	lut.resize(max_id + 1, (char)0);
 
+	if (!compiled.empty()) {
+		vector<int> q;
+		for (int set_id : sig_ids) {
+			if (lut[set_id]) continue;
+			lut[set_id] = 1;
+			q.assign(1, set_id);
+			for (size_t k = 0; k < q.size(); k++) {
+				int n;
+				const int *members = compiled.children(q[k], n);
+				for (int j = 0; j < n; j++)
+					if (lut[members[j]] == 0) {
+						lut[members[j]] = 1;
+						q.push_back(members[j]);
+					}
+			}
+		}
+		return 0;
+	}
+
 	/*
 		for (int j=0; j<sig_ids.size(); j++) {
 			MLOG("lut j=%d sig %s %d\n", j, set_names[j].c_str(), sig_ids[j]);
@@ -549,11 +594,29 @@ int MedDictionary::prep_sets_indexed_lookup_table(const vector<string> &set_name
 		}
 	}
 
-	int max_id = Id2Name.rbegin()->first;
+	int max_id = compiled.empty() ? Id2Name.rbegin()->first : compiled.max_id();
 
 	lut.clear();
 	lut.resize(max_id + 1, 0);
 
+	if (!compiled.empty()) {
+		vector<int> q;
+		for (int j = 0; j < sig_ids.size(); j++) {
+			q.assign(1, sig_ids[j]);
+			lut[sig_ids[j]] = j + 1;
+			for (size_t k = 0; k < q.size(); k++) {
+				int n;
+				const int *members = compiled.children(q[k], n);
+				for (int i = 0; i < n; i++)
+					if (lut[members[i]] == 0) {
+						lut[members[i]] = j + 1;
+						q.push_back(members[i]);
+					}
+			}
+		}
+		return 0;
+	}
+
 	/*
 	for (int j=0; j<sig_ids.size(); j++) {
 	MLOG("lut j=%d sig %s %d\n", j, set_names[j].c_str(), sig_ids[j]);
@@ -588,6 +651,7 @@ int MedDictionary::prep_sets_indexed_lookup_table(const vector<string> &set_name
 void MedDictionary::push_new_def(string name, int id)
 {
 	lock_guard<mutex> guard(lock_dict_changes);
+	compiled.clear();
 	Name2Id[name] = id;
 	Id2Name[id] = name;
 	Id2Names[id].push_back(name);
@@ -638,6 +702,531 @@ int MedDictionary::write_to_file(string fout, int mode)
 	return 0;
 }
 
+//===============================================================================================
+// MedCompiledDictionary
+//===============================================================================================
+// arrays of the compiled layout
+enum {
+	CDICT_ID2NODE = 0,		// int [max_id+1] : node of each id or -1
+	CDICT_NODE_ID,			// int [n_nodes]
+	CDICT_NODE_NAME,		// uint [n_nodes] : official name offset (or MED_CDICT_NO_NAME)
+	CDICT_NODE_LONGEST,		// uint [n_nodes] : longest name offset
+	CDICT_NAMES_START,		// uint [n_nodes+1]
+	CDICT_NAMES,			// uint : name offsets (Id2Names order)
+	CDICT_PARENTS_START,	// uint [n_nodes+1]
+	CDICT_PARENTS,			// int : set ids (Member2Sets order)
+	CDICT_CHILDREN_START,	// uint [n_nodes+1]
+	CDICT_CHILDREN,			// int : member ids (Set2Members order)
+	CDICT_ANCESTORS_START,	// uint [n_nodes+1]
+	CDICT_ANCESTORS,		// int : all containing set ids, sorted
+	CDICT_HASH_NAME,		// uint [hash_size] : name offset or MED_CDICT_NO_NAME for an empty slot
+	CDICT_HASH_ID,			// int [hash_size]
+	CDICT_SECTIONS,			// uint [n_sections] : section names offsets
+	CDICT_STRINGS,			// char : all names, '\0' terminated
+	CDICT_N_ARRAYS
+};
+
+struct MedCompiledDictionaryHeader {
+	char magic[8];
+	int version;
+	int max_id;
+	int n_nodes;
+	int n_sections;
+	unsigned long long hash_size;
+	unsigned long long offset[CDICT_N_ARRAYS];	// in bytes from the start of the header
+	unsigned long long total_size;
+};
+
+// FNV-1a
+static inline unsigned long long cdict_hash(const char *s)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	for (; *s; s++) {
+		h ^= (unsigned char)*s;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+//-----------------------------------------------------------------------------------------------
+const unsigned char *MedCompiledDictionary::base() const
+{
+	if (mapped) return mapped.get();
+	if (!blob.empty()) return (const unsigned char *)blob.data();
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------------------------
+template <class T> const T *MedCompiledDictionary::arr(int a) const
+{
+	return (const T *)(base() + ((const MedCompiledDictionaryHeader *)base())->offset[a]);
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::max_id() const
+{
+	if (empty()) return -1;
+	return ((const MedCompiledDictionaryHeader *)base())->max_id;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::n_nodes() const
+{
+	if (empty()) return 0;
+	return ((const MedCompiledDictionaryHeader *)base())->n_nodes;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::node_id(int node) const
+{
+	return arr<int>(CDICT_NODE_ID)[node];
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::node(int id) const
+{
+	if (id < 0 || id > max_id()) return -1;
+	return arr<int>(CDICT_ID2NODE)[id];
+}
+
+//-----------------------------------------------------------------------------------------------
+const char *MedCompiledDictionary::str(unsigned int offset) const
+{
+	if (offset == MED_CDICT_NO_NAME) return NULL;
+	return arr<char>(CDICT_STRINGS) + offset;
+}
+
+//-----------------------------------------------------------------------------------------------
+const int *MedCompiledDictionary::csr(int start_arr, int data_arr, int id, int &n) const
+{
+	n = 0;
+	int nd = node(id);
+	if (nd < 0) return NULL;
+	const unsigned int *start = arr<unsigned int>(start_arr);
+	n = (int)(start[nd + 1] - start[nd]);
+	return arr<int>(data_arr) + start[nd];
+}
+
+const int *MedCompiledDictionary::parents(int id, int &n) const { return csr(CDICT_PARENTS_START, CDICT_PARENTS, id, n); }
+const int *MedCompiledDictionary::children(int id, int &n) const { return csr(CDICT_CHILDREN_START, CDICT_CHILDREN, id, n); }
+const int *MedCompiledDictionary::ancestors(int id, int &n) const { return csr(CDICT_ANCESTORS_START, CDICT_ANCESTORS, id, n); }
+const unsigned int *MedCompiledDictionary::names(int id, int &n) const { return (const unsigned int *)csr(CDICT_NAMES_START, CDICT_NAMES, id, n); }
+
+//-----------------------------------------------------------------------------------------------
+const char *MedCompiledDictionary::name(int id) const
+{
+	int nd = node(id);
+	if (nd < 0) return NULL;
+	return str(arr<unsigned int>(CDICT_NODE_NAME)[nd]);
+}
+
+//-----------------------------------------------------------------------------------------------
+const char *MedCompiledDictionary::longest_name(int id) const
+{
+	int nd = node(id);
+	if (nd < 0) return NULL;
+	return str(arr<unsigned int>(CDICT_NODE_LONGEST)[nd]);
+}
+
+//-----------------------------------------------------------------------------------------------
+void MedCompiledDictionary::get_section_names(vector<string> &section_names) const
+{
+	section_names.clear();
+	if (empty()) return;
+	const unsigned int *offs = arr<unsigned int>(CDICT_SECTIONS);
+	for (int i = 0; i < ((const MedCompiledDictionaryHeader *)base())->n_sections; i++)
+		section_names.push_back(str(offs[i]));
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::id(const string &name) const
+{
+	const MedCompiledDictionaryHeader *hdr = (const MedCompiledDictionaryHeader *)base();
+	const unsigned int *hash_name = arr<unsigned int>(CDICT_HASH_NAME);
+	unsigned long long mask = hdr->hash_size - 1;
+	for (unsigned long long i = cdict_hash(name.c_str()) & mask; ; i = (i + 1) & mask) {
+		if (hash_name[i] == MED_CDICT_NO_NAME)
+			return -1;
+		if (strcmp(str(hash_name[i]), name.c_str()) == 0)
+			return arr<int>(CDICT_HASH_ID)[i];
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::is_in_set(int member_id, int set_id) const
+{
+	if (member_id == set_id)
+		return 1;
+	int n;
+	const int *sets = ancestors(member_id, n);
+	return (n > 0 && binary_search(sets, sets + n, set_id)) ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::compile(const MedDictionary &dict)
+{
+	clear();
+
+	// nodes : all ids defined or used in sets
+	vector<int> ids;
+	for (auto &e : dict.Id2Name) ids.push_back(e.first);
+	for (auto &e : dict.Name2Id) ids.push_back(e.second);
+	for (auto &e : dict.Set2Members) {
+		ids.push_back(e.first);
+		ids.insert(ids.end(), e.second.begin(), e.second.end());
+	}
+	sort(ids.begin(), ids.end());
+	ids.erase(unique(ids.begin(), ids.end()), ids.end());
+	if (!ids.empty() && ids[0] < 0) {
+		MWARN("MedCompiledDictionary::compile() : section %d has negative ids, dictionary is not compiled\n", dict.dict_id);
+		return -1;
+	}
+	if (ids.empty())
+		return -1;
+
+	int max_id = ids.back();
+	int n_nodes = (int)ids.size();
+	vector<int> id2node(max_id + 1, -1);
+	for (int i = 0; i < n_nodes; i++)
+		id2node[ids[i]] = i;
+
+	// strings
+	vector<char> strings;
+	unordered_map<string, unsigned int> str_offset;
+	auto add_str = [&](const string &s) {
+		auto it = str_offset.find(s);
+		if (it != str_offset.end()) return it->second;
+		unsigned int off = (unsigned int)strings.size();
+		strings.insert(strings.end(), s.begin(), s.end());
+		strings.push_back('\0');
+		str_offset[s] = off;
+		return off;
+	};
+
+	vector<unsigned int> node_name(n_nodes, MED_CDICT_NO_NAME), node_longest(n_nodes, MED_CDICT_NO_NAME);
+	vector<unsigned int> names_start(n_nodes + 1, 0), names;
+	vector<unsigned int> parents_start(n_nodes + 1, 0), children_start(n_nodes + 1, 0);
+	vector<int> parents, children;
+	for (int i = 0; i < n_nodes; i++) {
+		int id = ids[i];
+		auto it_names = dict.Id2Names.find(id);
+		if (it_names != dict.Id2Names.end())
+			for (auto &s : it_names->second) names.push_back(add_str(s));
+		names_start[i + 1] = (unsigned int)names.size();
+		auto it_name = dict.Id2Name.find(id);
+		if (it_name != dict.Id2Name.end()) node_name[i] = add_str(it_name->second);
+		auto it_longest = dict.Id2LongestName.find(id);
+		if (it_longest != dict.Id2LongestName.end()) node_longest[i] = add_str(it_longest->second);
+
+		auto it_sets = dict.Member2Sets.find(id);
+		if (it_sets != dict.Member2Sets.end())
+			parents.insert(parents.end(), it_sets->second.begin(), it_sets->second.end());
+		parents_start[i + 1] = (unsigned int)parents.size();
+		auto it_members = dict.Set2Members.find(id);
+		if (it_members != dict.Set2Members.end())
+			children.insert(children.end(), it_members->second.begin(), it_members->second.end());
+		children_start[i + 1] = (unsigned int)children.size();
+	}
+
+	// transitive closure of the sets of each node
+	vector<vector<int>> all_sets(n_nodes);
+#pragma omp parallel
+	{
+		vector<int> stamp(n_nodes, -1), q;
+#pragma omp for schedule(dynamic, 256)
+		for (int i = 0; i < n_nodes; i++) {
+			q.clear();
+			q.push_back(i);
+			for (size_t k = 0; k < q.size(); k++) {
+				for (unsigned int j = parents_start[q[k]]; j < parents_start[q[k] + 1]; j++) {
+					int p = id2node[parents[j]];
+					if (stamp[p] != i) {
+						stamp[p] = i;
+						q.push_back(p);
+					}
+				}
+			}
+			vector<int> &sets = all_sets[i];
+			for (size_t k = 1; k < q.size(); k++)
+				sets.push_back(ids[q[k]]);
+			sort(sets.begin(), sets.end());
+		}
+	}
+	vector<unsigned int> ancestors_start(n_nodes + 1, 0);
+	vector<int> ancestors;
+	for (int i = 0; i < n_nodes; i++) {
+		ancestors.insert(ancestors.end(), all_sets[i].begin(), all_sets[i].end());
+		if (ancestors.size() >= MED_CDICT_NO_NAME)
+			MTHROW_AND_ERR("MedCompiledDictionary::compile() : sets closure too big\n");
+		ancestors_start[i + 1] = (unsigned int)ancestors.size();
+	}
+	all_sets.clear();
+
+	// names hash : at most half full
+	unsigned long long hash_size = 16;
+	while (hash_size < 2 * dict.Name2Id.size()) hash_size *= 2;
+	vector<unsigned int> hash_name(hash_size, MED_CDICT_NO_NAME);
+	vector<int> hash_id(hash_size, -1);
+	for (auto &e : dict.Name2Id) {
+		unsigned int off = add_str(e.first);
+		unsigned long long i = cdict_hash(e.first.c_str()) & (hash_size - 1);
+		while (hash_name[i] != MED_CDICT_NO_NAME) i = (i + 1) & (hash_size - 1);
+		hash_name[i] = off;
+		hash_id[i] = e.second;
+	}
+
+	vector<string> snames(dict.section_name.begin(), dict.section_name.end());
+	sort(snames.begin(), snames.end());
+	vector<unsigned int> sections;
+	for (auto &s : snames) sections.push_back(add_str(s));
+	if (strings.size() >= MED_CDICT_NO_NAME)
+		MTHROW_AND_ERR("MedCompiledDictionary::compile() : names too big\n");
+
+	// layout
+	vector<pair<const void *, unsigned long long>> arrays(CDICT_N_ARRAYS);
+	arrays[CDICT_ID2NODE] = { id2node.data(), id2node.size() * sizeof(int) };
+	arrays[CDICT_NODE_ID] = { ids.data(), ids.size() * sizeof(int) };
+	arrays[CDICT_NODE_NAME] = { node_name.data(), node_name.size() * sizeof(unsigned int) };
+	arrays[CDICT_NODE_LONGEST] = { node_longest.data(), node_longest.size() * sizeof(unsigned int) };
+	arrays[CDICT_NAMES_START] = { names_start.data(), names_start.size() * sizeof(unsigned int) };
+	arrays[CDICT_NAMES] = { names.data(), names.size() * sizeof(unsigned int) };
+	arrays[CDICT_PARENTS_START] = { parents_start.data(), parents_start.size() * sizeof(unsigned int) };
+	arrays[CDICT_PARENTS] = { parents.data(), parents.size() * sizeof(int) };
+	arrays[CDICT_CHILDREN_START] = { children_start.data(), children_start.size() * sizeof(unsigned int) };
+	arrays[CDICT_CHILDREN] = { children.data(), children.size() * sizeof(int) };
+	arrays[CDICT_ANCESTORS_START] = { ancestors_start.data(), ancestors_start.size() * sizeof(unsigned int) };
+	arrays[CDICT_ANCESTORS] = { ancestors.data(), ancestors.size() * sizeof(int) };
+	arrays[CDICT_HASH_NAME] = { hash_name.data(), hash_name.size() * sizeof(unsigned int) };
+	arrays[CDICT_HASH_ID] = { hash_id.data(), hash_id.size() * sizeof(int) };
+	arrays[CDICT_SECTIONS] = { sections.data(), sections.size() * sizeof(unsigned int) };
+	arrays[CDICT_STRINGS] = { strings.data(), strings.size() };
+
+	MedCompiledDictionaryHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, MED_CDICT_MAGIC, 8);
+	hdr.version = MED_CDICT_VERSION;
+	hdr.max_id = max_id;
+	hdr.n_nodes = n_nodes;
+	hdr.n_sections = (int)sections.size();
+	hdr.hash_size = hash_size;
+	unsigned long long off = (sizeof(hdr) + 7) & ~7ULL;
+	for (int a = 0; a < CDICT_N_ARRAYS; a++) {
+		hdr.offset[a] = off;
+		off = (off + arrays[a].second + 7) & ~7ULL;
+	}
+	hdr.total_size = off;
+
+	blob.assign(off / 8, 0);
+	unsigned char *p = (unsigned char *)blob.data();
+	memcpy(p, &hdr, sizeof(hdr));
+	for (int a = 0; a < CDICT_N_ARRAYS; a++)
+		if (arrays[a].second > 0)
+			memcpy(p + hdr.offset[a], arrays[a].first, arrays[a].second);
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::write(const string &fname) const
+{
+	if (empty()) {
+		MERR("MedCompiledDictionary::write() : nothing to write to %s\n", fname.c_str());
+		return -1;
+	}
+	string f = fname;
+	return write_bin_file_IM(f, (unsigned char *)base(), ((const MedCompiledDictionaryHeader *)base())->total_size);
+}
+
+//-----------------------------------------------------------------------------------------------
+bool MedCompiledDictionary::is_compiled_file(const string &fname)
+{
+	char magic[8];
+	ifstream inf(fname, ios::in | ios::binary);
+	if (!inf || !inf.read(magic, 8))
+		return false;
+	return memcmp(magic, MED_CDICT_MAGIC, 8) == 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::read(const string &fname)
+{
+	clear();
+
+	unsigned char *data = NULL;
+	unsigned long long size = 0;
+#if defined (_MSC_VER) || defined (_WIN32)
+	string f = fname;
+	if (read_bin_file_IM(f, data, size) < 0)
+		return -1;
+	int rc = read(data, size, fname);
+	delete[] data;
+	return rc;
+#else
+	if (mmap_bin_file_IM(fname, data, size) < 0)
+		return -1;
+	if (data != NULL) {
+		mapped = std::shared_ptr<unsigned char>(data, [size](unsigned char *p) { munmap_bin_file_IM(p, size); });
+		mapped_size = size;
+	}
+	return check(fname, size);
+#endif
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::read(const unsigned char *data, unsigned long long size, const string &src_name)
+{
+	clear();
+	blob.assign((size + 7) / 8, 0);
+	if (size > 0)
+		memcpy(blob.data(), data, size);
+	return check(src_name, size);
+}
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long MedCompiledDictionary::size() const
+{
+	if (empty()) return 0;
+	return ((const MedCompiledDictionaryHeader *)base())->total_size;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedCompiledDictionary::check(const string &src_name, unsigned long long size)
+{
+	const MedCompiledDictionaryHeader *hdr = (const MedCompiledDictionaryHeader *)base();
+	if (hdr == NULL || size < sizeof(MedCompiledDictionaryHeader) || memcmp(hdr->magic, MED_CDICT_MAGIC, 8) != 0 ||
+		hdr->version != MED_CDICT_VERSION || hdr->total_size > size) {
+		MERR("MedCompiledDictionary::read() : %s is not a valid compiled dictionary (version %d)\n", src_name.c_str(), MED_CDICT_VERSION);
+		clear();
+		return -1;
+	}
+
+	MLOG_D("MedCompiledDictionary: read %s : %d ids\n", src_name.c_str(), hdr->n_nodes);
+	return 0;
+}
+
+//===============================================================================================
+// MedDictionary compiled form
+//===============================================================================================
+int MedDictionary::compile()
+{
+	if (compiled.compile(*this) < 0)
+		compiled.clear();
+	return 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedDictionary::write_compiled(const string &fname)
+{
+	if (compiled.empty() && compiled.compile(*this) < 0) {
+		MERR("MedDictionary::write_compiled() : can't compile dictionary %d\n", dict_id);
+		return -1;
+	}
+	return compiled.write(fname);
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedDictionary::read_compiled(const string &fname)
+{
+	MedCompiledDictionary cdict;
+	if (cdict.read(fname) < 0)
+		return -1;
+	return read_compiled(cdict, fname);
+}
+
+//-----------------------------------------------------------------------------------------------
+// the maps are filled from the compiled arrays (no text parsing), when nothing else was read the compiled form is kept
+// otherwise the file is merged like a text dictionary and the result compiled
+int MedDictionary::read_compiled(const MedCompiledDictionary &cdict, const string &fname)
+{
+	bool was_empty = Name2Id.empty() && Id2Name.empty() && MemberInSet.empty() && used.empty();
+	fnames.push_back(fname);
+
+	int n_nodes = cdict.n_nodes();
+	if (was_empty) {
+		// fast path : nodes are sorted by id, and sorted inputs are inserted at the end of the maps
+		vector<pair<string, int>> all_names;
+		vector<pair<pair<int, int>, int>> pairs;
+		for (int i = 0; i < n_nodes; i++) {
+			int n_id = cdict.node_id(i), n;
+			const char *official = cdict.name(n_id);
+			if (official != NULL)
+				Id2Name.emplace_hint(Id2Name.end(), n_id, official);
+			const char *longest = cdict.longest_name(n_id);
+			if (longest != NULL)
+				Id2LongestName.emplace_hint(Id2LongestName.end(), n_id, longest);
+			const unsigned int *names = cdict.names(n_id, n);
+			if (n > 0) {
+				vector<string> &v = Id2Names.emplace_hint(Id2Names.end(), n_id, vector<string>())->second;
+				for (int j = 0; j < n; j++) {
+					v.push_back(cdict.str(names[j]));
+					all_names.push_back(pair<string, int>(v.back(), cdict.id(v.back())));
+				}
+			}
+			const int *sets = cdict.parents(n_id, n);
+			if (n > 0)
+				Member2Sets.emplace_hint(Member2Sets.end(), n_id, vector<int>(sets, sets + n));
+			for (int j = 0; j < n; j++)
+				pairs.push_back(pair<pair<int, int>, int>(pair<int, int>(sets[j], n_id), 1));
+			const int *members = cdict.children(n_id, n);
+			if (n > 0)
+				Set2Members.emplace_hint(Set2Members.end(), n_id, vector<int>(members, members + n));
+		}
+		sort(all_names.begin(), all_names.end());
+		for (auto &e : all_names) {
+			Name2Id.emplace_hint(Name2Id.end(), e.first, e.second);
+			used.emplace_hint(used.end(), e.first, 1);
+		}
+		sort(pairs.begin(), pairs.end());
+		MemberInSet.insert(pairs.begin(), pairs.end());
+		compiled = cdict;
+		return 0;
+	}
+
+	for (int i = 0; i < n_nodes; i++) {
+		int n_id = cdict.node_id(i);
+		const char *official = cdict.name(n_id);
+		if (official != NULL)
+			Id2Name[n_id] = official;
+		const char *longest = cdict.longest_name(n_id);
+		if (longest != NULL && ((Id2LongestName.find(n_id) == Id2LongestName.end()) || (strlen(longest) > Id2LongestName[n_id].length())))
+			Id2LongestName[n_id] = longest;
+		int n;
+		const unsigned int *names = cdict.names(n_id, n);
+		for (int j = 0; j < n; j++) {
+			string s = cdict.str(names[j]);
+			if (used.find(s) == used.end()) {
+				Id2Names[n_id].push_back(s);
+				used[s] = 1;
+			}
+			Name2Id[s] = cdict.id(s);
+		}
+	}
+
+	// sets, keeping the members order of each set
+	set<pair<int, int>> new_pairs;
+	for (int i = 0; i < n_nodes; i++) {
+		int member_id = cdict.node_id(i), n;
+		const int *sets = cdict.parents(member_id, n);
+		for (int j = 0; j < n; j++) {
+			pair<int, int> p(sets[j], member_id);
+			if (MemberInSet.find(p) != MemberInSet.end()) continue;
+			MemberInSet[p] = 1;
+			Member2Sets[member_id].push_back(sets[j]);
+			new_pairs.insert(p);
+		}
+	}
+	for (int i = 0; i < n_nodes; i++) {
+		int set_id = cdict.node_id(i), n;
+		const int *members = cdict.children(set_id, n);
+		for (int j = 0; j < n; j++)
+			if (new_pairs.find(pair<int, int>(set_id, members[j])) != new_pairs.end())
+				Set2Members[set_id].push_back(members[j]);
+	}
+
+	compile();
+	return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //-----------------------------------------------------------------------------------------------
 int MedDictionarySections::read(const string &fname)
@@ -647,36 +1236,71 @@ int MedDictionarySections::read(const string &fname)
 
 	string section_name = "DEFAULT";
 
-	ifstream inf(fname);
-
-	if (!inf) {
-		MTHROW_AND_ERR("MedDictionarySections: read: Can't open file %s\n", fname.c_str());
+	// compiled dictionaries keep their section names
+	MedCompiledDictionary cdict;
+	if (MedCompiledDictionary::is_compiled_file(fname)) {
+		if (cdict.read(fname) < 0)
+			MTHROW_AND_ERR("MedDictionarySections: read: Can't read compiled dictionary %s\n", fname.c_str());
+		vector<string> cnames;
+		cdict.get_section_names(cnames);
+		if (cnames.size() > 0) {
+			section_name = cnames[0];
+			for (size_t i = 1; i < cnames.size(); i++)
+				section_name += "," + cnames[i];
+		}
 	}
 
-	MLOG_D("MedDictinarySections: read: reading dictionary file %s\n", fname.c_str());
-	string curr_line;
-	int n_line = 0;
-	while (n_line < 100 && getline(inf, curr_line)) {
-		n_line++;
-		if ((curr_line.size() > 1) && (curr_line[0] != '#')) {
+	else {
+		ifstream inf(fname);
 
-			if (curr_line[curr_line.size() - 1] == '\r')
-				curr_line.erase(curr_line.size() - 1);
+		if (!inf) {
+			MTHROW_AND_ERR("MedDictionarySections: read: Can't open file %s\n", fname.c_str());
+		}
 
-			vector<string> fields;
-			split(fields, curr_line, boost::is_any_of("\t"));
+		MLOG_D("MedDictinarySections: read: reading dictionary file %s\n", fname.c_str());
+		string curr_line;
+		int n_line = 0;
+		while (n_line < 100 && getline(inf, curr_line)) {
+			n_line++;
+			if ((curr_line.size() > 1) && (curr_line[0] != '#')) {
+
+				if (curr_line[curr_line.size() - 1] == '\r')
+					curr_line.erase(curr_line.size() - 1);
 
-			if (fields.size() >= 2) {
-				if (fields[0].compare(0, 7, "SECTION") == 0) {
-					section_name = fields[1];
-					break;
+				vector<string> fields;
+				split(fields, curr_line, boost::is_any_of("\t"));
+
+				if (fields.size() >= 2) {
+					if (fields[0].compare(0, 7, "SECTION") == 0) {
+						section_name = fields[1];
+						break;
+					}
 				}
 			}
 		}
+
+		inf.close();
 	}
 
-	inf.close();
+	int section_id = get_section_for_file(section_name, fname);
+	if (!cdict.empty())
+		return (dicts[section_id].read_compiled(cdict, fname));
+	return (dicts[section_id].read(fname));
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedDictionarySections::read_compiled(const MedCompiledDictionary &cdict, const string &section_name, const string &fname)
+{
+	int section_id = get_section_for_file(section_name, fname);
+	if (cdict.empty())
+		return 0; // an empty section
+	return (dicts[section_id].read_compiled(cdict, fname));
+}
 
+//-----------------------------------------------------------------------------------------------
+// finds (or adds) the section of a list of section names (separated by any of " ,;:/"), and registers fname in it
+int MedDictionarySections::get_section_for_file(const string &section_name, const string &fname)
+{
 	vector<string> snames;
 	split(snames, section_name, boost::is_any_of(" ,;:/"));
 	int is_in = -1;
@@ -705,7 +1329,7 @@ int MedDictionarySections::read(const string &fname)
 	for (auto s : snames)
 		dicts[section_id].section_name.insert(s);
 
-	return (dicts[section_id].read(fname));
+	return section_id;
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -715,6 +1339,7 @@ int MedDictionarySections::read(vector<string> &dfnames)
 	for (int i = 0; i < dfnames.size(); i++) {
 		rc += read(dfnames[i]);
 	}
+	compile();
 	return rc;
 }
 
@@ -732,9 +1357,19 @@ int MedDictionarySections::read(string path, vector<string> &dfnames)
 			throw;
 		}
 	}
+	compile();
 	return rc;
 }
 
+//-----------------------------------------------------------------------------------------------
+int MedDictionarySections::compile()
+{
+	for (auto &d : dicts)
+		if (d.compiled.empty())
+			d.compile();
+	return 0;
+}
+
 //------------------------------------------------------------------------------------------------------
 void MedDictionarySections::add_section(string new_section_name)
 {
@@ -752,6 +1387,20 @@ void MedDictionarySections::connect_to_section(string new_section_name, int sect
 	dicts[section_id].section_name.insert(new_section_name);
 }
 
+//------------------------------------------------------------------------------------------------------
+void MedDictionarySections::push_new_signal_def(const string &sig_name, int sid)
+{
+	int add_section = section_id(sig_name);
+	lock_guard<mutex> guard(lock_dict_changes);
+	MedDictionary &sdict = dicts[add_section];
+	sdict.compiled.clear();
+	dicts[0].compiled.clear();
+	sdict.Name2Id[sig_name] = sid;
+	dicts[0].Name2Id[sig_name] = sid;
+	sdict.Id2Name[sid] = sig_name;
+	sdict.Id2Names[sid] = { sig_name };
+}
+
 //------------------------------------------------------------------------------------------------------
 int MedDictionarySections::add_json_simple_format(json &js)
 {
@@ -791,6 +1440,7 @@ int MedDictionarySections::add_json_simple_format(json &js)
 			}
 		}
 	}
+	compile();
 	return 0;
 }
 
@@ -847,5 +1497,6 @@ int MedDictionarySections::add_json(json &js)
 		}
 	}
 
+	compile();
 	return 0;
 }
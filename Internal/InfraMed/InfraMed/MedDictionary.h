@@ -8,12 +8,74 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <json/json.hpp>
 
 using namespace std;
 
 //#define	MAX_DICT_ID_NUM	10000000
 
+class MedDictionary;
+
+//
+// MedCompiledDictionary - a flat read only form of a MedDictionary, for fast lookups in big hierarchies (ICD, ATC, READ, ...)
+// - ids are mapped to dense nodes, and each node keeps its names, direct sets, direct members
+//   and the sorted list of ALL the sets it is contained in (transitive closure), making is_in_set a binary search.
+// - all names are kept in an open addressing hash table.
+// - the same memory layout is written to disk (.cdict files) and mapped back with no parsing.
+// A compiled dictionary reflects the dictionary at the time of compilation, changing the dictionary drops it.
+//
+#define MED_CDICT_MAGIC		"MEDCDICT"
+#define MED_CDICT_VERSION	1
+#define MED_CDICT_NO_NAME	0xFFFFFFFF
+
+class DLLEXTERN MedCompiledDictionary {
+
+public:
+	// build from a dictionary. returns -1 if the dictionary has nothing to compile
+	int compile(const MedDictionary &dict);
+	void clear() { blob.clear(); mapped.reset(); mapped_size = 0; }
+	bool empty() const { return base() == NULL; }
+
+	// .cdict files: read() maps the file read only (reads it to memory where mapping is not supported)
+	int write(const string &fname) const;
+	int read(const string &fname);
+	static bool is_compiled_file(const string &fname);
+
+	// in memory form (for embedding in other binary files), read() copies the data
+	const unsigned char *data() const { return base(); }
+	unsigned long long size() const;
+	int read(const unsigned char *data, unsigned long long size, const string &src_name);
+
+	// lookups
+	int max_id() const;
+	int id(const string &name) const;
+	int is_in_set(int member_id, int set_id) const;
+	const char *name(int id) const;					// official name, NULL if id is not defined
+	const char *longest_name(int id) const;
+	const int *parents(int id, int &n) const;		// direct sets of id
+	const int *children(int id, int &n) const;		// direct members of set id
+	const int *ancestors(int id, int &n) const;		// all sets containing id (sorted), not including id itself
+	const unsigned int *names(int id, int &n) const; // offsets of all names of id (use str())
+	const char *str(unsigned int offset) const;
+	void get_section_names(vector<string> &section_names) const;
+
+	// iteration over all defined ids
+	int n_nodes() const;
+	int node_id(int node) const;
+
+private:
+	vector<unsigned long long> blob;		// owned layout (8 bytes aligned)
+	shared_ptr<unsigned char> mapped;		// or a mapped .cdict file
+	unsigned long long mapped_size = 0;
+
+	const unsigned char *base() const;
+	int check(const string &src_name, unsigned long long size);
+	int node(int id) const;
+	template <class T> const T *arr(int a) const;
+	const int *csr(int start_arr, int data_arr, int id, int &n) const;
+};
+
 class DLLEXTERN  MedDictionary {
 
 public:
@@ -27,8 +89,9 @@ public:
 	map<int, vector<int>> Member2Sets;	// for each id - a vector of all sets the id is a member of
 	int dict_id;	// for debug
 	unordered_set<string> section_name; // for debug and for checking if a signal related to this dictionary
+	MedCompiledDictionary compiled;		// when not empty used for id(), is_in_set() and the sets lookup tables
 
-	void clear() { fnames.clear(); Name2Id.clear(); MemberInSet.clear(); Set2Members.clear(); }
+	void clear() { fnames.clear(); Name2Id.clear(); MemberInSet.clear(); Set2Members.clear(); compiled.clear(); }
 	int read(const string &fname);
 	int read(vector<string> &dfnames);
 	int read(string path, vector<string> &dfnames);
@@ -68,6 +131,13 @@ public:
 	// write to file : mode=1: only defs, mode=2: defs+sets
 	int write_to_file(string fout, int mode = 1);
 
+	// compiled form : compile() is called after reading all dictionary files, changes to the dictionary drop it.
+	// read_compiled() loads a .cdict file (as written by write_compiled()) instead of the text files
+	int compile();
+	int write_compiled(const string &fname);
+	int read_compiled(const string &fname);
+	int read_compiled(const MedCompiledDictionary &cdict, const string &fname);
+
 private:
 	map<string, int> used;
 
@@ -112,10 +182,17 @@ public:
 		default_section = 0; curr_section = 0; read_state = 0;
 	}
 	MedDictionarySections() { init(); }
-	int read(const string &fname);
+	int read(const string &fname);		// text dictionary or a compiled .cdict file
 	int read(vector<string> &dfnames);
 	int read(string path, vector<string> &dfnames);
 
+	// compile all sections not compiled yet, and write a section as a .cdict file
+	int compile();
+	int write_compiled(int section_id, const string &fname) { return dicts[section_id].write_compiled(fname); }
+	// add an already loaded compiled dictionary to the given section (names separated by any of " ,;:/", the first is the section's name)
+	// an empty cdict only adds the section
+	int read_compiled(const MedCompiledDictionary &cdict, const string &section_name, const string &fname);
+
 
 	// in the following calls note that WE DO NOT CHECK IF section_id or section_name exist and appear in the map and correct range.
 	// this is done for efficiency (saving an if for each call).
@@ -164,6 +241,9 @@ public:
 	// APIs to add a new dictionary section - this is needed in some cases of creating virtual signals that are categorial
 	void add_section(string new_section_name); // { MedDictionary dummy; dicts.push_back(dummy); SectionName2Id[new_section_name] = (int)dicts.size() - 1; }
 	void connect_to_section(string new_section_name, int section_id); // { SectionName2Id[new_section_name] = section_id; }
+	// define a (virtual) signal name with its sid in its own section and in the DEFAULT section.
+	// drops the compiled form of these sections, call compile() after the last one
+	void push_new_signal_def(const string &sig_name, int sid);
 
 	// push new defs/sets from a json object:
 	// new elements get an automatic new id.
@@ -171,6 +251,8 @@ public:
 	int add_json(json &js); // auto detects the format
 	int add_json_simple_format(json &js);
 
+private:
+	int get_section_for_file(const string &section_name, const string &fname);
 };
 
 
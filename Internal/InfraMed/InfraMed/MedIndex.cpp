@@ -1148,6 +1148,8 @@ int MedIndex::read_index_table_and_data(int sid, string &idx_fname, string &data
 	}
 
 	index_table[sid].sid = sid; // setting the sid number inside its container
+	index_table[sid].use_mmap = use_mmap;
+	index_table[sid].read_gap = read_gap;
 
 	if (index_table[sid].read_index_and_data(idx_fname, data_fname, pids_to_include) < 0) {
 		MERR("%s Error reading index and data\n", prefix.c_str());
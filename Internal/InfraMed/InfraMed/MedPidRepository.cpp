@@ -2,6 +2,7 @@
 #include "Utils.h"
 #include <Logger/Logger/Logger.h>
 #include <string.h>
+#include <atomic>
 
 #define LOCAL_SECTION LOG_REP
 #define LOCAL_LEVEL	LOG_DEF_LEVEL
@@ -14,6 +15,7 @@ extern MedLogger global_logger;
 #define PID_REC_MUTEX_POOL_SIZE	2048
 #define PID_REC_MUTEX_MASK (2047)
 mutex dynamic_pid_rec_mutex_pool[PID_REC_MUTEX_POOL_SIZE];
+atomic<unsigned long long> pid_rec_mod_serial(0);
 
 //------------------------------------------------------------------------------------------------------------
 // creating the "by pid" index and data files for a range of given pids with at most "jump" pids in each file
@@ -225,6 +227,12 @@ int MedPidRepository::init(const string &conf_fname)
 		MERR("MedPidRepository: init: failed init of MedRepository side\n");
 		return -1;
 	}
+	// by pid reads return the __pids__ files as is, they can't tell whether these include the overlays
+	if (overlays.size() > 0 && !in_mem_mode_active()) {
+		MERR("MedPidRepository: init: %s has overlays, which by pid reads (__pids__ files) do not merge. Fold them (fold_overlays) before using it by pid\n",
+			conf_fname.c_str());
+		return -1;
+	}
 
 	return 0;
 
@@ -384,7 +392,14 @@ void *PidRec::get(int sid, int &len)
 	if (pl == NULL)
 		return NULL;
 	len = pl->len;
-	return ((void *)&data[pl->pos]);
+	return ((void *)pos_ptr(*pl));
+}
+
+//------------------------------------------------------------------------------------------------------------
+// serials are global (not per record) so that a stamp can never repeat even for a new record at the same address
+void PidRec::touch()
+{
+	mod_serial = ++pid_rec_mod_serial;
 }
 
 //------------------------------------------------------------------------------------------------------------
@@ -405,6 +420,7 @@ int PidRec::realloc(unsigned int len)
 	data_buffer.resize(len);
 	data = &data_buffer[0];
 	data_size = len;
+	touch();
 	return 0;
 }
 
@@ -426,6 +442,7 @@ void PidRec::free()
 int PidRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids_to_use)
 {
 	// clear what was before and init basics
+	touch();
 	sv.clear();
 	my_rep = NULL;
 	my_base_rep = rep;
@@ -442,6 +459,7 @@ int PidRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids_to_use
 
 	for (auto sid : sids) {
 		int len;
+		bool pinned = (my_base_rep->pin(sid) == 0);	// the signals cache can't evict it while copying
 		unsigned char *sig_data = (unsigned char *)my_base_rep->get(pid, sid, len);
 		//unsigned char *sig_data = (unsigned char *)rep->get(pid, sid, len);
 		if (sig_data != NULL) {
@@ -456,6 +474,7 @@ int PidRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids_to_use
 			sv.insert(sid_serial, pl);
 			data_len += slen;
 		}
+		if (pinned) my_base_rep->unpin(sid);
 	}
 
 	return 0;
@@ -483,6 +502,7 @@ int PidDynamicRec::set_n_versions(int n_ver)
 	}
 
 	n_versions = n_ver;
+	touch();
 
 	// keys to the new index will be (serial sid)*(n_ver)+ver, originally we want them all to point to the original
 	vector<unsigned int> orig_keys;
@@ -527,6 +547,7 @@ int PidDynamicRec::set_n_versions(vector<int> &time_points)
 	}
 
 	n_versions = n_ver;
+	touch();
 
 	// keys to the new index will be (serial sid)*(n_ver)+ver, originally we want them all to point to the original
 	vector<unsigned int> orig_keys;
@@ -586,7 +607,7 @@ void *PidDynamicRec::get(int sid, int version, int &len)
 	if (pl == NULL)
 		return NULL;
 	len = pl->len;
-	return ((void *)&data[pl->pos]);
+	return ((void *)pos_ptr(*pl));
 }
 
 //..................................................................................................................
@@ -596,6 +617,7 @@ void PidDynamicRec::clear_vers()
 	n_versions = 0;
 	sv_vers.clear();
 	curr_len = data_len;
+	touch();
 }
 
 //..................................................................................................................
@@ -610,7 +632,7 @@ int PidDynamicRec::set_version_data(int sid, int version, void *datap, int len)
 
 	int size = my_base_rep->sigs.Sid2Info[sid].bytes_len * len;
 
-	if (((unsigned int)pl->pos < data_len) || (len > pl->len) || (pl->do_split)) {
+	if (is_orig(pl) || (len > pl->len) || (pl->do_split)) {
 		// need to create a new place for this version
 		//MLOG("In here : pos %d len %d curr_len %d data_len %d len %d size %d data_size %d\n", pl->pos, pl->len, curr_len, data_len, len, size, data_size);
 		if (curr_len + size > data_size)
@@ -678,7 +700,7 @@ int PidDynamicRec::set_version_off_orig(int sid, int version)
 	if (pl == NULL)
 		return -1;
 
-	if ((unsigned int)pl->pos < data_len && pl->len > 0) {
+	if (is_orig(pl) && pl->len > 0) {
 		// This means our current version is in the original section (below data_len)
 		// Hence we will make a copy of it in the versions working area
 
@@ -694,7 +716,7 @@ int PidDynamicRec::set_version_off_orig(int sid, int version)
 		new_pl.do_split = 0; // since we allocated a new space for it
 		curr_len += size;
 
-		void *datap = (void *)&data[pl->pos];
+		void *datap = (void *)pos_ptr(*pl);
 		memcpy((char *)&data[new_pl.pos], (char *)datap, size);
 		set_poslen(sid, version, new_pl);
 	}
@@ -751,7 +773,7 @@ int PidDynamicRec::remove(int sid, int v_in, int idx, int v_out)
 	int size = size1 + size2;
 
 	PosLen new_pl;
-	if (((unsigned int)pl_out->pos < data_len) || (pl_out->len < pl_in->len - 1) || (pl_out->do_split)) {
+	if (is_orig(pl_out) || (pl_out->len < pl_in->len - 1) || (pl_out->do_split)) {
 		// need to create a new place for this version
 		if (curr_len + size > data_size)
 			resize_data(2 * (data_size + size));
@@ -759,14 +781,14 @@ int PidDynamicRec::remove(int sid, int v_in, int idx, int v_out)
 		new_pl.do_split = 0;
 		curr_len += size;
 
-		memcpy(&data[new_pl.pos], &data[pl_in->pos], size1);
-		memcpy(&data[new_pl.pos + size1], &data[pl_in->pos + size1 + sid_byte_len], size2);
+		memcpy(&data[new_pl.pos], pos_ptr(*pl_in), size1);
+		memcpy(&data[new_pl.pos + size1], pos_ptr(*pl_in) + size1 + sid_byte_len, size2);
 	}
 	else {
 		// current place is enough for it, and also positioned after the original
 		if (v_in != v_out) {
-			memcpy(&data[pl_out->pos], &data[pl_in->pos], size1);
-			memcpy(&data[pl_out->pos + size1], &data[pl_in->pos + size1 + sid_byte_len], size2);
+			memcpy(&data[pl_out->pos], pos_ptr(*pl_in), size1);
+			memcpy(&data[pl_out->pos + size1], pos_ptr(*pl_in) + size1 + sid_byte_len, size2);
 		}
 		else {
 			unsigned char *d = &data[pl_out->pos + size1];
@@ -810,7 +832,7 @@ int PidDynamicRec::change(int sid, int v_in, int idx, void *new_elem, int v_out)
 	int size = sid_byte_len * pl_in->len;
 
 	PosLen new_pl;
-	if (((unsigned int)pl_out->pos < data_len) || (pl_out->len < pl_in->len - 1) || (pl_out->do_split)) {
+	if (is_orig(pl_out) || (pl_out->len < pl_in->len - 1) || (pl_out->do_split)) {
 		// need to create a new place for this version
 		if (curr_len + size > data_size)
 			resize_data(2 * (data_size + size));
@@ -818,13 +840,13 @@ int PidDynamicRec::change(int sid, int v_in, int idx, void *new_elem, int v_out)
 		new_pl.do_split = 0;
 		curr_len += size;
 
-		memcpy(&data[new_pl.pos], &data[pl_in->pos], size);
+		memcpy(&data[new_pl.pos], pos_ptr(*pl_in), size);
 		memcpy((char *)&data[new_pl.pos + pos_to_change], (char *)new_elem, sid_byte_len);
 	}
 	else {
 		// current place is enough for it, and also positioned after the original
 		if (v_in != v_out) {
-			memcpy(&data[pl_out->pos], &data[pl_in->pos], size);
+			memcpy(&data[pl_out->pos], pos_ptr(*pl_in), size);
 		}
 		memcpy((char *)&data[pl_out->pos + pos_to_change], (char *)new_elem, sid_byte_len);
 		new_pl = *pl_out;
@@ -965,9 +987,12 @@ int PidDynamicRec::print_sigs(const vector<string> &sigs)
 int PidDynamicRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids_to_use, int _n_versions)
 {
 	// clear what was before and init basics
+	touch();
 	sv.clear();
 	sv_vers.clear();
 	//	sv_vers.init();
+	release_held();
+	ext_data.clear();
 	my_rep = NULL;
 	my_base_rep = rep;
 	pid = _pid;
@@ -982,11 +1007,25 @@ int PidDynamicRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids
 	vector<int> sids = sids_to_use;
 	//	sort(sids_to_use.begin(), sids_to_use.end()); // sorting sids in preparation for inserts into sv.
 	sort(sids.begin(), sids.end()); // sorting sids in preparation for inserts into sv.
+	// in mem mode data lives in a growing arena, hence is always copied
+	bool cow = copy_on_write && !my_base_rep->in_mem_mode_active();
 	for (auto sid : sids) {
 		int len;
+		bool held = cow && (my_base_rep->hold(sid) == 0);	// copy on write: pointing to the repository while held
+		bool pinned = !held && (my_base_rep->pin(sid) == 0);	// the signals cache can't evict it while copying
 		unsigned char *sig_data = (unsigned char *)my_base_rep->get(pid, sid, len);
 		//unsigned char *sig_data = (unsigned char *)rep->get(pid, sid, len);
-		if (sig_data != NULL) {
+		if (sig_data != NULL && held) {
+			int sid_serial = my_base_rep->sigs.sid2serial[sid];
+			ext_data.push_back(sig_data);
+			held_sids.push_back(sid);
+			PosLen pl;
+			pl.pos = -(int)ext_data.size();
+			pl.len = len;
+			pl.do_split = 0;
+			sv.insert(sid_serial, pl);
+		}
+		else if (sig_data != NULL) {
 			int sid_serial = my_base_rep->sigs.sid2serial[sid];
 			int sid_byte_len = my_base_rep->sigs.Sid2Info[sid].bytes_len;
 			int slen = len * sid_byte_len;
@@ -1007,6 +1046,8 @@ int PidDynamicRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids
 			pl.do_split = 0;
 			sv.insert(sid_serial, pl);
 		}
+		if (held && sig_data == NULL) my_base_rep->release(sid);
+		if (pinned) my_base_rep->unpin(sid);
 	}
 	//curr_len = data_len;
 	//return 0;
@@ -1018,6 +1059,46 @@ int PidDynamicRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids
 	return 0;
 }
 
+//..................................................................................................................
+void PidDynamicRec::release_held()
+{
+	for (int sid : held_sids)
+		my_base_rep->release(sid);
+	held_sids.clear();
+}
+
+//..................................................................................................................
+// a copy points to the same repository memory, hence holds the signals again
+PidDynamicRec::PidDynamicRec(const PidDynamicRec &other) : PidRec(other)
+{
+	n_versions = other.n_versions;
+	curr_len = other.curr_len;
+	sv_vers = other.sv_vers;
+	usvs = other.usvs;
+	copy_on_write = other.copy_on_write;
+	held_sids = other.held_sids;
+	for (int sid : held_sids)
+		my_base_rep->hold(sid);
+}
+
+//..................................................................................................................
+PidDynamicRec &PidDynamicRec::operator=(const PidDynamicRec &other)
+{
+	if (this == &other)
+		return *this;
+	release_held();
+	PidRec::operator=(other);
+	n_versions = other.n_versions;
+	curr_len = other.curr_len;
+	sv_vers = other.sv_vers;
+	usvs = other.usvs;
+	copy_on_write = other.copy_on_write;
+	held_sids = other.held_sids;
+	for (int sid : held_sids)
+		my_base_rep->hold(sid);
+	return *this;
+}
+
 //..................................................................................................................
 int PidDynamicRec::init_from_rep(MedRepository *rep, int _pid, vector<int> &sids_to_use, vector<int> &time_points)
 {
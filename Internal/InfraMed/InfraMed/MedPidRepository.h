@@ -51,8 +51,13 @@ class PidRec {
 		MedPidRepository *my_rep;			// needed for the get() method in order to get access to dictionaries
 		MedRepository *my_base_rep;			// needed for the get() method in order to get access to dictionaries
 		int allow_realloc;					// allow reallocation of data in read if given not enough space
+		unsigned long long mod_serial;		// unique stamp renewed whenever the record is initialized or its data/versions change.
+											// allows caches built over the record data (e.g. feature generation window indexes) to know they are stale.
 
-		PidRec() { pid = -1; data = NULL; data_len = 0; data_size = 0; is_allocated = 0; my_rep = NULL; sv.clear(); allow_realloc = 1; }
+		PidRec() { pid = -1; data = NULL; data_len = 0; data_size = 0; is_allocated = 0; my_rep = NULL; sv.clear(); allow_realloc = 1; mod_serial = 0; }
+
+		// renew mod_serial (called internally on every change)
+		void touch();
 
 		// after reading the data to *data this operation is needed to build the sparse vec from (serial) sid to PosLen
 		int init_sv();
@@ -78,6 +83,11 @@ class PidRec {
 		void set_data_to_buffer() { data = &data_buffer[0]; }
 		void free();
 
+	protected:
+		// a negative pos points outside data, to ext_data[-pos-1] (the repository memory, see PidDynamicRec::init_from_rep)
+		vector<unsigned char *> ext_data;
+		inline unsigned char *pos_ptr(const PosLen &pl) { return pl.pos < 0 ? ext_data[-pl.pos - 1] : &data[pl.pos]; }
+
 	private:
 		vector<unsigned char> data_buffer;	// the actual holder of the data when using prealloc/realloc/resize_data
 											// this makes for much easier data garbage collection (no need for free)
@@ -93,6 +103,7 @@ class MedPidRepository : public MedRepository {
 
 
 	int init(const string &conf_fname);		// when using MedPidRepository, init it with this API, then use the load() APIs in MedRepository to load full signals.
+											// fails for a repository with overlays (see MedRepository::fold_overlays)
 
 	// creating the "by pid" index and data files for a range of given pids with at most "jump" pids in each file
 	int create(string &rep_fname, int from_pid, int to_pid, int jump);
@@ -110,6 +121,8 @@ class MedPidRepository : public MedRepository {
 	// it is recommended for use with pre allocation of enough space in prec.data when going to reuse the same prec for reads.
 	int get_pid_rec(int pid, PidRec &prec);
 
+	MedPidRepository() {}
+	explicit MedPidRepository(MedDictionarySections &_dict) : MedRepository(_dict) {}
 	~MedPidRepository();
 
 };
@@ -179,6 +192,15 @@ public:
 	int print_sigs(const vector<string> &sigs); // print some sigs we need (debugging tool)
 	
 	PidDynamicRec() { n_versions = 0; }
+	PidDynamicRec(const PidDynamicRec &other);
+	PidDynamicRec &operator=(const PidDynamicRec &other);
+	~PidDynamicRec() { release_held(); }
+
+	// copy on write: when set (default) init_from_rep points the original data to the repository memory (read only) instead of
+	// copying it (not in in mem mode), and a signal is copied into the record only when a version of it is changed (set_version_data, change, remove, update).
+	// The used repository signals are held (can't be evicted by the signals cache) until the record is initialized again or destroyed.
+	// Data returned by get() must then not be written to directly.
+	int copy_on_write = 1;
 
 	// next are options to init a PidDynamicRec from data that already resides in some part of a MedRepository that is already in memory.
 
@@ -197,8 +219,11 @@ private:
 	int n_versions;
 	unsigned int curr_len;
 	MedSparseVec<PosLen> sv_vers;
+	vector<int> held_sids;
+	void release_held();
+	bool is_orig(const PosLen *pl) { return pl->pos < 0 || (unsigned int)pl->pos < data_len; } // still pointing to the original data
 	PosLen *get_poslen(int sid, int version) { if (version >= n_versions) return NULL; return sv_vers.get((unsigned int)(my_base_rep->sigs.sid2serial[sid])*n_versions+version); }
-	void set_poslen(int sid, int version, PosLen pl) { sv_vers[(unsigned int)my_base_rep->sigs.sid2serial[sid]*n_versions+version] = pl; }
+	void set_poslen(int sid, int version, PosLen pl) { touch(); sv_vers[(unsigned int)my_base_rep->sigs.sid2serial[sid]*n_versions+version] = pl; }
 };
 
 
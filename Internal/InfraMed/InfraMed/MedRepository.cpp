@@ -11,13 +11,17 @@
 #include "InfraMed.h"
 #include "Utils.h"
 #include "MedPidRepository.h"
+#include "MedSigCodec.h"
 #include <fstream>
 #include <Logger/Logger/Logger.h>
 #include <MedUtils/MedUtils/MedUtils.h>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
 #include <omp.h>
+#include <shared_mutex>
+#include <atomic>
 
 #define LOCAL_SECTION LOG_REP
 #define LOCAL_LEVEL	LOG_DEF_LEVEL
@@ -26,6 +30,8 @@ extern MedLogger global_logger;
 
 mutex index_table_locks[MAX_SID_NUMBER];
 mutex index_table_read_locks[MAX_SID_NUMBER];
+atomic<int> index_table_holds[MAX_SID_NUMBER];		// signals cache: long term pins (see MedRepository::hold)
+shared_mutex index_table_pins[MAX_SID_NUMBER];		// signals cache: shared by pinning threads, exclusive when evicting or reloading
 
 //===========================================================
 // MedRepository
@@ -43,10 +49,11 @@ void MedRepository::clear()
 	format = 0;
 	time_unit = MedTime::Date;
 	index.clear();
-	if (dict.read_state != 1) dict.clear();
+	if (dict.read_state != 1 && &dict == &own_dict) dict.clear();
 	free_all_sigs();
 	sigs.clear();
 	pids.clear();
+	overlays.clear();
 	if (work_area != NULL)
 		delete[] work_area;
 	work_area = NULL;
@@ -114,6 +121,29 @@ int MedRepository::read_config(const string &fname)
 				rep_mode = stoi(fields[1]);
 				index.rep_mode = rep_mode;
 			}
+			else if (fields[0].compare("MMAP") == 0) {
+				index.use_mmap = stoi(fields[1]);
+			}
+			else if (fields[0].compare("READ_GAP") == 0) {
+				index.read_gap = stoull(fields[1]);
+			}
+			else if (fields[0].compare("OVERLAY") == 0) {
+				RepOverlay ov;
+				ov.config_fname = fields[1];
+				if (!boost::filesystem::path(ov.config_fname).is_absolute()) {
+					// relative to the base config
+					size_t found = fixed_name.find_last_of("/\\");
+					if (found != string::npos)
+						ov.config_fname = fixed_name.substr(0, found) + "/" + ov.config_fname;
+				}
+				if (fields.size() > 2 && fields[2] == "replace")
+					ov.replace = 1;
+				else if (fields.size() > 2 && fields[2] != "append") {
+					MERR("MedRepository: read_config: unknown overlay mode in: %s\n", curr_line.c_str());
+					return -1;
+				}
+				overlays.push_back(ov);
+			}
 			else if (fields[0].compare("PREFIX") == 0) {
 				rep_files_prefix = fields[1];
 			}
@@ -356,6 +386,13 @@ int MedRepository::read_pid_list()
 
 	if (size > 0) delete[] data;
 
+	// new pids in overlays
+	for (auto &ov : overlays) {
+		vector<int> merged;
+		set_union(all_pids_list.begin(), all_pids_list.end(), ov.pids.begin(), ov.pids.end(), back_inserter(merged));
+		all_pids_list.swap(merged);
+	}
+
 	return 0;
 }
 
@@ -396,6 +433,8 @@ int MedRepository::init(const string &conf_fname)
 	}
 
 	generate_fnames_for_prefix();
+	if (read_overlays() < 0)
+		return -1;
 	MedTimer t("Rep Read Time");
 	t.start();
 	//MLOG("Reading Index Tables\n");
@@ -488,6 +527,9 @@ int MedRepository::read_all(const string &conf_fname, const vector<int> &pids_to
 		auto it = unique(pids_sort_uniq.begin(), pids_sort_uniq.end());
 		pids_sort_uniq.resize(distance(pids_sort_uniq.begin(), it));
 
+		if (read_overlays() < 0)
+			return -1;
+
 		if (read_index_tables(pids_sort_uniq, signals_to_take) < 0)
 			return -1;
 
@@ -1356,6 +1398,17 @@ int MedRepository::get_dates_with_signal(int pid, vector<string> &sig_names, vec
 	return 0;
 }
 
+//--------------------------------------------------------------------------------------
+// path and prefix of the .idx and .data files of a signal (mode 3 and up)
+static string sig_files_name(const string &path, const string &prefix, const string &sig_name)
+{
+	string fixed_sig_name = sig_name;
+	boost::replace_all(fixed_sig_name, "/", "_div_");
+	boost::replace_all(fixed_sig_name, ":", "_over_");
+	boost::replace_all(fixed_sig_name, "%", "_percent_");
+	return path + "/" + prefix + "_" + fixed_sig_name;
+}
+
 //--------------------------------------------------------------------------------------
 int MedRepository::generate_fnames_for_prefix()
 {
@@ -1365,11 +1418,7 @@ int MedRepository::generate_fnames_for_prefix()
 	//for (int i=0; i<sigs.signals_names.size(); i++) ii.push_back(i); // this is just for debugging, making sure we are order independent
 	//random_shuffle(ii.begin(), ii.end());
 	for (int i = 0; i < sigs.signals_names.size(); i++) {
-		string fixed_sig_name = sigs.signals_names[i];
-		boost::replace_all(fixed_sig_name, "/", "_div_");
-		boost::replace_all(fixed_sig_name, ":", "_over_");
-		boost::replace_all(fixed_sig_name, "%", "_percent_");
-		string name = path + "/" + rep_files_prefix + "_" + fixed_sig_name; //sigs.signals_names[i];
+		string name = sig_files_name(path, rep_files_prefix, sigs.signals_names[i]);
 		data_fnames.push_back(name + ".data");
 		index_fnames.push_back(name + ".idx");
 		int sid = sigs.sid(sigs.signals_names[i]);
@@ -1403,6 +1452,11 @@ int MedRepository::read_index_tables(const vector<int> &pids_to_take, const vect
 				MERR("MedRepository:read_index_tables: FAILED at sid %d index file %s\n", sid, index_fnames[fno].c_str());
 				nerr++;
 			}
+			else {
+				lock_guard<mutex> guard(index_table_read_locks[sid]);
+				if (merge_overlays(sid, pids_to_take) < 0)
+					nerr++;
+			}
 		}
 	}
 	if (nerr > 0) return -1;
@@ -1510,6 +1564,9 @@ int MedRepository::load(const vector<int> &sids, vector<int> &pids_to_take)
 #pragma omp critical
 		rc += local_rc;
 	}
+
+	if (use_sig_cache)
+		free_to_bound();
 	return rc;
 
 }
@@ -1521,21 +1578,42 @@ int MedRepository::load(const int sid, vector<int> &pids_to_take)
 	if (sid < 0 || sid >= index.index_table.size())
 		return -1;
 
-	if (index.index_table[sid].full_load)
-		return 0; // nothing to do already fully loaded
+	if (index.index_table[sid].full_load) {
+		// nothing to do already fully loaded, in mmap mode we only hint the pager
+		index.index_table[sid].advise_pids(pids_to_take, IM_ADVICE_WILLNEED);
+		sig_cache_touch(sid, true);
+		return 0;
+	}
 
 	if (index.index_table[sid].is_locked)
 		return -2; // need to load but can't since it is locked
 
 	int fno = sigs.Sid2Info[sid].fno;
+	index.index_table[sid].use_mmap = index.use_mmap;
+	index.index_table[sid].read_gap = index.read_gap;
 
 	vector<int> pids_sort_uniq = pids_to_take;
 	sort(pids_sort_uniq.begin(), pids_sort_uniq.end());
 	auto it = unique(pids_sort_uniq.begin(), pids_sort_uniq.end());
 	pids_sort_uniq.resize(distance(pids_sort_uniq.begin(), it));
 
-	if (index.index_table[sid].read_index_and_data(index_fnames[fno], data_fnames[fno], pids_sort_uniq) < -1)
-		return -1;
+	{
+		// the overlays are merged under the same lock, another load of sid can't replace the table meanwhile
+		lock_guard<mutex> guard(index_table_read_locks[sid]);
+		if (index.index_table[sid].read_index_and_data_locked(index_fnames[fno], data_fnames[fno], pids_sort_uniq) < -1)
+			return -1;
+		if (merge_overlays(sid, pids_sort_uniq) < 0)
+			return -1;
+	}
+	sig_cache_touch(sid, false);
+	if (!index.index_table[sid].full_load) {
+#pragma omp atomic
+		read_stats.loads++;
+#pragma omp atomic
+		read_stats.bytes_read += index.index_table[sid].bytes_read;
+#pragma omp atomic
+		read_stats.bytes_used += index.index_table[sid].bytes_used;
+	}
 
 	return 0;
 }
@@ -1547,21 +1625,655 @@ int MedRepository::load_pids_sorted(const int sid, vector<int> &pids_sort_uniq)
 	if (sid < 0 || sid >= index.index_table.size())
 		return -1;
 
-	if (index.index_table[sid].full_load)
-		return 0; // nothing to do already fully loaded
+	if (index.index_table[sid].full_load) {
+		// nothing to do already fully loaded, in mmap mode we only hint the pager
+		index.index_table[sid].advise_pids(pids_sort_uniq, IM_ADVICE_WILLNEED);
+		sig_cache_touch(sid, true);
+		return 0;
+	}
 
 	if (index.index_table[sid].is_locked)
 		return -2; // need to load but can't since it is locked
 
 	int fno = sigs.Sid2Info[sid].fno;
+	index.index_table[sid].use_mmap = index.use_mmap;
+	index.index_table[sid].read_gap = index.read_gap;
+
+	{
+		// the overlays are merged under the same lock, another load of sid can't replace the table meanwhile
+		lock_guard<mutex> guard(index_table_read_locks[sid]);
+		if (index.index_table[sid].read_index_and_data_locked(index_fnames[fno], data_fnames[fno], pids_sort_uniq) < -1)
+			return -1;
+		if (merge_overlays(sid, pids_sort_uniq) < 0)
+			return -1;
+	}
+	sig_cache_touch(sid, false);
+	if (!index.index_table[sid].full_load) {
+#pragma omp atomic
+		read_stats.loads++;
+#pragma omp atomic
+		read_stats.bytes_read += index.index_table[sid].bytes_read;
+#pragma omp atomic
+		read_stats.bytes_used += index.index_table[sid].bytes_used;
+	}
+
+	if (use_sig_cache)
+		free_to_bound();
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// signals cache
+//--------------------------------------------------------------------------------------
+void MedRepository::sig_cache_touch(int sid, bool hit)
+{
+	unsigned long long tick;
+#pragma omp atomic capture
+	tick = ++access_clock;
+#pragma omp atomic write
+	index.index_table[sid].last_access = tick;
+	if (!hit)
+		index.index_table[sid].evicted = 0;
+
+	if (hit) {
+#pragma omp atomic
+		cache_stats.hits++;
+	}
+	else {
+#pragma omp atomic
+		cache_stats.misses++;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+double MedRepository::loaded_gb()
+{
+	double gb = 0;
+	for (int sid : sigs.signals_ids)
+		if (sid > 0 && sid < index.index_table.size() && index.index_table[sid].is_loaded)
+			gb += index.index_table[sid].tot_size_gb;
+	return gb;
+}
 
+//--------------------------------------------------------------------------------------
+// evicting is skipped when the signal is pinned (or being reloaded)
+static int evict_sig(MedRepository &rep, int sid, unsigned long long &bytes)
+{
+	unique_lock<shared_mutex> pins(index_table_pins[sid], try_to_lock);
+	if (!pins.owns_lock())
+		return -1;
+	lock_guard<mutex> guard(index_table_read_locks[sid]);
 
-	if (index.index_table[sid].read_index_and_data(index_fnames[fno], data_fnames[fno], pids_sort_uniq) < -1)
+	IndexTable &itable = rep.index.index_table[sid];
+	if (!itable.is_loaded || !itable.full_load || itable.is_locked || index_table_holds[sid] > 0)
 		return -1;
+	bytes = itable.tot_size;
+	itable.clear();
+	itable.evicted = 1;
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+int MedRepository::free_to_bound(double _bound_gb)
+{
+	double gb = 0;
+	vector<pair<unsigned long long, int>> lru;
+	for (int sid : sigs.signals_ids) {
+		if (sid <= 0 || sid >= index.index_table.size() || !index.index_table[sid].is_loaded)
+			continue;
+		IndexTable &itable = index.index_table[sid];
+		gb += itable.tot_size_gb;
+		if (itable.full_load && !itable.is_locked) {
+			unsigned long long last_access;
+#pragma omp atomic read
+			last_access = itable.last_access;
+			lru.push_back(pair<unsigned long long, int>(last_access, sid));
+		}
+	}
+	if (gb <= _bound_gb)
+		return 0;
 
+	sort(lru.begin(), lru.end());
+	for (size_t i = 0; i < lru.size() && gb > _bound_gb; i++) {
+		unsigned long long bytes;
+		if (evict_sig(*this, lru[i].second, bytes) < 0)
+			continue;
+		gb -= (double)bytes / (double)(1 << 30);
+#pragma omp atomic
+		cache_stats.evictions++;
+#pragma omp atomic
+		cache_stats.evicted_bytes += bytes;
+		MLOG_D("MedRepository::free_to_bound : evicted %s (%llu bytes)\n", sigs.Sid2Name[lru[i].second].c_str(), bytes);
+	}
+
+	if (gb > _bound_gb) {
+		MWARN("MedRepository::free_to_bound : %.2f gb are still loaded (bound %.2f gb), remaining signals are locked, pinned or partially loaded\n", gb, _bound_gb);
+		return -1;
+	}
 	return 0;
 }
 
+//--------------------------------------------------------------------------------------
+int MedRepository::reload_evicted(int sid)
+{
+	{
+		unique_lock<shared_mutex> pins(index_table_pins[sid]);
+		if (!index.index_table[sid].evicted)
+			return 0;
+		vector<int> all_pids;
+		if (load_pids_sorted(sid, all_pids) < 0) {
+			MERR("MedRepository::reload_evicted : failed reloading %s\n", sigs.Sid2Name[sid].c_str());
+			return -1;
+		}
+#pragma omp atomic
+		cache_stats.reloads++;
+	}
+	// evicting others only after releasing this signal
+	free_to_bound();
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+int MedRepository::pin(int sid)
+{
+	if (!use_sig_cache)
+		return 0;
+	if (sid <= 0 || sid >= index.index_table.size())
+		return -1;
+
+	index_table_pins[sid].lock_shared();
+	while (index.index_table[sid].evicted) {
+		index_table_pins[sid].unlock_shared();
+		if (reload_evicted(sid) < 0)
+			return -1;
+		index_table_pins[sid].lock_shared();
+	}
+	index.index_table[sid].touch(access_clock);
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+void MedRepository::unpin(int sid)
+{
+	if (use_sig_cache && sid > 0 && sid < index.index_table.size())
+		index_table_pins[sid].unlock_shared();
+}
+
+//--------------------------------------------------------------------------------------
+// holds are counted also while the cache is off, so every release matches a counted hold even if the cache was
+// turned on in between. With the cache on the hold is counted while the signal is pinned, so it can't be evicted in between
+int MedRepository::hold(int sid)
+{
+	if (pin(sid) < 0)
+		return -1;
+	if (sid > 0 && sid < MAX_SID_NUMBER)
+		index_table_holds[sid]++;
+	unpin(sid);
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+void MedRepository::release(int sid)
+{
+	if (sid > 0 && sid < MAX_SID_NUMBER)
+		index_table_holds[sid]--;
+}
+
+//--------------------------------------------------------------------------------------
+// each signal is pinned once, pinning fails only for signals that can't be reloaded
+MedRepositoryPins::MedRepositoryPins(MedRepository &_rep, const vector<int> &sids) : rep(_rep)
+{
+	if (!rep.use_sig_cache)
+		return;
+	for (int sid : sids)
+		if (find(pinned.begin(), pinned.end(), sid) == pinned.end() && rep.pin(sid) == 0)
+			pinned.push_back(sid);
+}
+
+MedRepositoryPins::~MedRepositoryPins()
+{
+	for (int sid : pinned)
+		rep.unpin(sid);
+}
+
+//--------------------------------------------------------------------------------------
+void MedRepository::print_cache_stats()
+{
+	MLOG("signals cache : %.3f gb loaded (bound %.3f gb) hits %lld misses %lld reloads %lld evictions %lld evicted %.3f gb\n",
+		loaded_gb(), bound_gb, cache_stats.hits, cache_stats.misses, cache_stats.reloads, cache_stats.evictions,
+		(double)cache_stats.evicted_bytes / (double)(1 << 30));
+}
+
+//--------------------------------------------------------------------------------------
+void MedRepository::set_read_gap(unsigned long long gap_bytes)
+{
+	index.read_gap = gap_bytes;
+	for (auto &it : index.index_table)
+		it.read_gap = gap_bytes;
+}
+
+//--------------------------------------------------------------------------------------
+void MedRepository::print_read_stats()
+{
+	double used = read_stats.bytes_read > 0 ? (double)read_stats.bytes_used / (double)read_stats.bytes_read : 1.0;
+	MLOG("partial loads : %lld signal loads, read %.3f gb, used %.3f gb (%.1f%%), read gap %llu bytes\n",
+		read_stats.loads, (double)read_stats.bytes_read / (double)(1 << 30), (double)read_stats.bytes_used / (double)(1 << 30),
+		100.0 * used, index.read_gap);
+}
+
+//--------------------------------------------------------------------------------------
+// overlays
+//--------------------------------------------------------------------------------------
+// overlay records are decoded with the signal definitions of the base : layout and time units must be the same
+static bool same_sig_layout(const SignalInfo &a, const SignalInfo &b)
+{
+	return a.bytes_len == b.bytes_len && a.time_unit == b.time_unit &&
+		a.n_time_channels == b.n_time_channels && a.n_val_channels == b.n_val_channels &&
+		a.time_channel_types == b.time_channel_types && a.val_channel_types == b.val_channel_types &&
+		a.is_categorical_per_val_channel == b.is_categorical_per_val_channel;
+}
+
+//--------------------------------------------------------------------------------------
+// categorical values of the overlay are ids of its dictionaries : each name must have the same id in the same section of the base
+static int check_overlay_dict(MedDictionarySections &base, MedDictionarySections &ov, string &bad)
+{
+	for (auto &sec : ov.SectionName2Id) {
+		auto it = base.SectionName2Id.find(sec.first);
+		if (it == base.SectionName2Id.end()) {
+			if (ov.dicts[sec.second].Name2Id.empty())
+				continue;
+			bad = "section " + sec.first;
+			return -1;
+		}
+		map<string, int> &base_ids = base.dicts[it->second].Name2Id;
+		for (auto &e : ov.dicts[sec.second].Name2Id) {
+			auto b = base_ids.find(e.first);
+			if (b == base_ids.end() || b->second != e.second) {
+				bad = sec.first + " : " + e.first;
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// opening the overlays of the config, called after the signals were read and their file names generated
+int MedRepository::read_overlays()
+{
+	for (auto &ov : overlays) {
+		MedRepository ov_rep;
+		if (ov_rep.read_config(ov.config_fname) < 0) {
+			MERR("MedRepository::read_overlays : can't read overlay %s\n", ov.config_fname.c_str());
+			return -1;
+		}
+		if (ov_rep.rep_mode < 3) {
+			MERR("MedRepository::read_overlays : overlay %s : overlays are supported from mode 3\n", ov.config_fname.c_str());
+			return -1;
+		}
+		if (ov_rep.sigs.read(ov_rep.signal_fnames) < 0) {
+			MERR("MedRepository::read_overlays : overlay %s : failed reading signals\n", ov.config_fname.c_str());
+			return -1;
+		}
+		if (ov_rep.time_unit != time_unit) {
+			MERR("MedRepository::read_overlays : overlay %s : time unit %d differs from the base time unit %d\n", ov.config_fname.c_str(), ov_rep.time_unit, time_unit);
+			return -1;
+		}
+		if (ov_rep.dictionary_fnames != dictionary_fnames) {
+			string bad;
+			if (ov_rep.dict.read(ov_rep.dictionary_fnames) < 0) {
+				MERR("MedRepository::read_overlays : overlay %s : failed reading dictionaries\n", ov.config_fname.c_str());
+				return -1;
+			}
+			if (check_overlay_dict(dict, ov_rep.dict, bad) < 0) {
+				MERR("MedRepository::read_overlays : overlay %s : dictionaries differ from the base (%s), the overlay must be converted with the base dictionaries\n",
+					ov.config_fname.c_str(), bad.c_str());
+				return -1;
+			}
+		}
+
+		ov.index_fnames.assign(index_fnames.size(), "");
+		ov.data_fnames.assign(data_fnames.size(), "");
+		for (int sid : sigs.signals_ids) {
+			int ov_sid = ov_rep.sigs.sid(sigs.Sid2Name[sid]);
+			if (ov_sid < 0)
+				continue;
+			if (!same_sig_layout(ov_rep.sigs.Sid2Info[ov_sid], sigs.Sid2Info[sid])) {
+				MERR("MedRepository::read_overlays : signal %s has a different type or time unit in overlay %s\n", sigs.Sid2Name[sid].c_str(), ov.config_fname.c_str());
+				return -1;
+			}
+			string name = sig_files_name(ov_rep.path, ov_rep.rep_files_prefix, sigs.Sid2Name[sid]);
+			if (file_exists_IM(name + ".idx")) {
+				int fno = sigs.Sid2Info[sid].fno;
+				ov.index_fnames[fno] = name + ".idx";
+				ov.data_fnames[fno] = name + ".data";
+			}
+		}
+
+		// pids list (missing for overlays converted with LOAD_ONLY, replace then applies to pids with records only)
+		if (ov_rep.read_pid_list() < 0)
+			return -1;
+		ov.pids = ov_rep.all_pids_list;
+		sort(ov.pids.begin(), ov.pids.end());
+		MLOG("MedRepository: overlay %s (%s) : %d pids\n", ov.config_fname.c_str(), ov.replace ? "replace" : "append", (int)ov.pids.size());
+	}
+
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// merging the overlays into a just loaded signal. pids_sort_uniq are the pids of the load (empty for a full load).
+// called with index_table_read_locks[sid] held (the overlay tables are local, hence read without locking)
+int MedRepository::merge_overlays(int sid, const vector<int> &pids_sort_uniq)
+{
+	if (overlays.size() == 0 || (pids_sort_uniq.size() > 0 && pids_sort_uniq[0] < 0))
+		return 0;
+
+	IndexTable &itable = index.index_table[sid];
+	int fno = sigs.Sid2Info[sid].fno;
+
+	// reading the signal from each overlay
+	vector<IndexTable> ov_tables(overlays.size());
+	bool needed = false;
+	for (int k = 0; k < overlays.size(); k++) {
+		RepOverlay &ov = overlays[k];
+		if (ov.replace && !needed) {
+			// only the replaced pids of this load can be in the table
+			if (pids_sort_uniq.size() == 0) {
+				for (int pid : ov.pids)
+					if (itable.get_len(pid) > 0) {
+						needed = true;
+						break;
+					}
+			}
+			else {
+				auto p = pids_sort_uniq.cbegin();
+				auto q = ov.pids.cbegin();
+				while (!needed && p != pids_sort_uniq.cend() && q != ov.pids.cend()) {
+					if (*p < *q) p++;
+					else if (*q < *p) q++;
+					else {
+						needed = itable.get_len(*p) > 0;
+						p++; q++;
+					}
+				}
+			}
+		}
+		if (fno >= ov.index_fnames.size() || ov.index_fnames[fno] == "")
+			continue;
+		ov_tables[k].sid = sid;
+		ov_tables[k].read_gap = itable.read_gap;
+		if (ov_tables[k].read_index_and_data_locked(ov.index_fnames[fno], ov.data_fnames[fno], pids_sort_uniq) < 0) {
+			MERR("MedRepository::merge_overlays : failed reading %s from overlay %s\n", sigs.Sid2Name[sid].c_str(), ov.config_fname.c_str());
+			for (auto &t : ov_tables) t.clear();
+			return -1;
+		}
+		if (ov_tables[k].is_loaded && ov_tables[k].sv.data.size() > 1)
+			needed = true;
+	}
+
+	if (!needed) {
+		for (auto &t : ov_tables) t.clear();
+		return 0;
+	}
+
+	// all the pids
+	vector<unsigned int> keys, ov_keys, merged_keys;
+	itable.sv.get_all_keys(keys);
+	unsigned long long max_size = itable.w_size;
+	for (auto &t : ov_tables)
+		if (t.is_loaded) {
+			t.sv.get_all_keys(ov_keys);
+			merged_keys.clear();
+			set_union(keys.begin(), keys.end(), ov_keys.begin(), ov_keys.end(), back_inserter(merged_keys));
+			keys.swap(merged_keys);
+			max_size += t.w_size;
+		}
+
+	IndexTable merged;
+	merged.sid = sid;
+	merged.base = 0;
+	merged.factor = sigs.Sid2Info[sid].bytes_len;
+	merged.last_len = 0;
+	merged.work_area = new unsigned char[max_size + 1];
+	merged.work_area_allocated = 1;
+
+	int rlen = merged.factor;
+	UniversalSigVec usv;
+	usv.init(sigs.Sid2Info[sid]);
+	auto rec_lt = [&](const unsigned char *a, const unsigned char *b) { return usv.compareTimeLt(a, 0, b, 0); };
+
+	unsigned long long d_pos = 0;
+	vector<const unsigned char *> recs;
+	for (unsigned int pid : keys) {
+		recs.clear();
+		unsigned long long pos;
+		int len;
+		itable.get(pid, pos, len);
+		for (int i = 0; i < len; i++)
+			recs.push_back(&itable.work_area[pos + (unsigned long long)i * rlen]);
+
+		for (int k = 0; k < overlays.size(); k++) {
+			len = 0;
+			if (ov_tables[k].is_loaded)
+				ov_tables[k].get(pid, pos, len);
+			if (overlays[k].replace) {
+				if (len == 0 && !binary_search(overlays[k].pids.begin(), overlays[k].pids.end(), (int)pid))
+					continue;
+				recs.clear();
+				for (int i = 0; i < len; i++)
+					recs.push_back(&ov_tables[k].work_area[pos + (unsigned long long)i * rlen]);
+			}
+			else if (len > 0) {
+				for (int i = 0; i < len; i++)
+					recs.push_back(&ov_tables[k].work_area[pos + (unsigned long long)i * rlen]);
+				// same order as MedConvert, dropping records identical to an earlier one
+				stable_sort(recs.begin(), recs.end(), rec_lt);
+				size_t n = 0;
+				for (size_t i = 0; i < recs.size(); i++) {
+					bool dup = false;
+					for (size_t j = n; j > 0 && !rec_lt(recs[j - 1], recs[i]); j--)
+						if (memcmp(recs[j - 1], recs[i], rlen) == 0) {
+							dup = true;
+							break;
+						}
+					if (!dup)
+						recs[n++] = recs[i];
+				}
+				recs.resize(n);
+			}
+		}
+
+		if (recs.size() > 0) {
+			for (auto rec : recs) {
+				memcpy(&merged.work_area[d_pos], rec, rlen);
+				d_pos += rlen;
+			}
+			merged.insert(pid, (int)recs.size());
+		}
+	}
+
+	merged.w_size = d_pos;
+	merged.is_loaded = 1;
+	merged.full_load = itable.full_load;
+	merged.use_mmap = itable.use_mmap;
+	merged.read_gap = itable.read_gap;
+	merged.bytes_read = itable.bytes_read;
+	merged.bytes_used = itable.bytes_used;
+	for (auto &t : ov_tables) {
+		merged.bytes_read += t.bytes_read;
+		merged.bytes_used += t.bytes_used;
+		t.clear();
+	}
+	merged.tot_size = merged.get_size() + merged.get_data_size();
+	merged.tot_size_gb = (double)merged.tot_size / (double)(1 << 30);
+
+	int keep_lock = itable.is_locked;
+	itable.is_locked = 0;
+	itable.clear();
+	itable = move(merged);
+	itable.is_locked = keep_lock;
+
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// writes the merged signals as the new base files (through temporary files, compressed if the base file was) and
+// removes the overlays from the config. Signals are freed on the way, the repository is expected to be opened with
+// init() and not to be read by other processes meanwhile.
+int MedRepository::fold_overlays()
+{
+	if (overlays.size() == 0) {
+		MLOG("MedRepository::fold_overlays : no overlays in %s\n", config_fname.c_str());
+		return 0;
+	}
+	if (rep_mode < 3 || in_mem_mode_active()) {
+		MERR("MedRepository::fold_overlays : supported for mode 3 and up repositories only\n");
+		return -1;
+	}
+
+	bool any_replace = false;
+	for (auto &ov : overlays)
+		any_replace = any_replace || (ov.replace && ov.pids.size() > 0);
+
+	int n_folded = 0;
+	for (int sid : sigs.signals_ids) {
+		int fno = sigs.Sid2Info[sid].fno;
+		bool changed = any_replace;
+		for (auto &ov : overlays)
+			changed = changed || (fno < ov.index_fnames.size() && ov.index_fnames[fno] != "");
+		if (!changed)
+			continue;
+
+		if (index.index_table[sid].is_locked) {
+			MERR("MedRepository::fold_overlays : signal %s is locked\n", sigs.Sid2Name[sid].c_str());
+			return -1;
+		}
+		free(sid);
+		vector<int> all_pids;
+		if (load_pids_sorted(sid, all_pids) < 0) {
+			MERR("MedRepository::fold_overlays : failed loading %s\n", sigs.Sid2Name[sid].c_str());
+			return -1;
+		}
+		IndexTable &itable = index.index_table[sid];
+
+		// writing data and index in the MedConvert layout
+		bool compressed = (read_data_format(data_fnames[fno]) == REPOSITORY_COMPRESSED_FORMAT);
+		int data_format = compressed ? REPOSITORY_COMPRESSED_FORMAT : REPOSITORY_STRIPPED_FORMAT;
+		string idx_tmp = index_fnames[fno] + ".fold";
+		string data_tmp = data_fnames[fno] + ".fold";
+		ofstream data_f(data_tmp, ios::out | ios::binary);
+		if (!data_f) {
+			MERR("MedRepository::fold_overlays : can't open %s\n", data_tmp.c_str());
+			return -1;
+		}
+		data_f.write((char *)&data_format, sizeof(int));
+
+		IndexTable new_index;
+		new_index.sid = sid;
+		new_index.base = sizeof(int);
+		new_index.factor = sigs.Sid2Info[sid].bytes_len;
+		new_index.last_len = 0;
+
+		MedSigCodec codec;
+		vector<unsigned long long> blocks_pos;
+		vector<unsigned char> blk;
+		unsigned long long f_pos = sizeof(int);
+		if (compressed)
+			codec.init(sigs.Sid2Info[sid]);
+
+		vector<unsigned int> keys;
+		itable.sv.get_all_keys(keys);
+		for (unsigned int pid : keys) {
+			unsigned long long pos;
+			int len;
+			itable.get(pid, pos, len);
+			if (len == 0)
+				continue;
+			if (compressed) {
+				blk.clear();
+				codec.encode(&itable.work_area[pos], len, blk);
+				data_f.write((char *)&blk[0], blk.size());
+				blocks_pos.push_back(f_pos);
+				f_pos += blk.size();
+			}
+			else
+				data_f.write((char *)&itable.work_area[pos], (size_t)len * new_index.factor);
+			new_index.insert(pid, len);
+		}
+		if (compressed) {
+			blocks_pos.push_back(f_pos);
+			codec.write_trailer(data_f, blocks_pos);
+		}
+		data_f.close();
+		free(sid);
+		if (!data_f || new_index.write_to_file(idx_tmp) < 0) {
+			MERR("MedRepository::fold_overlays : failed writing %s\n", data_tmp.c_str());
+			return -1;
+		}
+
+		boost::system::error_code ec;
+		boost::filesystem::rename(data_tmp, data_fnames[fno], ec);
+		if (!ec)
+			boost::filesystem::rename(idx_tmp, index_fnames[fno], ec);
+		if (ec) {
+			MERR("MedRepository::fold_overlays : failed replacing the files of %s : %s\n", sigs.Sid2Name[sid].c_str(), ec.message().c_str());
+			return -1;
+		}
+		n_folded++;
+	}
+
+	// pids list, already merged with the overlays by read_pid_list()
+	if (all_pids_list.size() > 0) {
+		vector<int> list = all_pids_list;
+		list.insert(list.begin(), (int)all_pids_list.size());
+		string fname_pids = path + "/" + rep_files_prefix + "_all_pids.list";
+		if (write_bin_file_IM(fname_pids, (unsigned char *)&list[0], sizeof(int)*list.size()) < 0) {
+			MERR("MedRepository::fold_overlays : could not write %s\n", fname_pids.c_str());
+			return -1;
+		}
+	}
+
+	// config without the OVERLAY lines
+	ifstream inf(config_fname);
+	if (!inf) {
+		MERR("MedRepository::fold_overlays : can't open %s\n", config_fname.c_str());
+		return -1;
+	}
+	string conf_tmp = config_fname + ".fold", curr_line;
+	ofstream outf(conf_tmp);
+	while (getline(inf, curr_line))
+		if (curr_line.compare(0, 7, "OVERLAY") != 0)
+			outf << curr_line << "\n";
+	inf.close();
+	outf.close();
+	boost::system::error_code ec;
+	boost::filesystem::rename(conf_tmp, config_fname, ec);
+	if (!outf || ec) {
+		MERR("MedRepository::fold_overlays : failed writing %s\n", config_fname.c_str());
+		return -1;
+	}
+
+	MLOG("MedRepository::fold_overlays : folded %d overlays into %d signals of %s\n", (int)overlays.size(), n_folded, config_fname.c_str());
+	overlays.clear();
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+int MedRepository::set_mmap_mode(int _use_mmap)
+{
+#if defined (_MSC_VER) || defined (_WIN32)
+	if (_use_mmap) {
+		MERR("MedRepository::set_mmap_mode() : mmap mode is not supported on this platform\n");
+		return -1;
+	}
+#endif
+	index.use_mmap = _use_mmap;
+	// already loaded signals keep their current state until they are freed and loaded again
+	for (auto &it : index.index_table)
+		it.use_mmap = _use_mmap;
+	return 0;
+}
 
 //--------------------------------------------------------------------------------------
 int MedRepository::lock_all_sigs()
@@ -1672,6 +2384,7 @@ int MedRepository::free(const int sid)
 
 	// freeing the index table matching sid
 	index.index_table[sid].clear();
+	index.index_table[sid].evicted = 0;
 	return 0;
 }
 
@@ -1793,6 +2506,38 @@ unsigned long long IndexTable::get_data_size()
 	return size;
 }
 
+//--------------------------------------------------------------------------------------
+int IndexTable::get_block(unsigned char *&start, vector<int> &pids, vector<unsigned long long> &offsets)
+{
+	lock_guard<mutex> guard(index_table_locks[sid]);
+
+	start = NULL;
+	pids.clear();
+	offsets.assign(1, 0);
+	if (!is_loaded) {
+		MERR("IndexTable::get_block sid %d is not loaded\n", sid);
+		return -1;
+	}
+	if (sv.data.size() < 2)
+		return 0;
+
+	vector<unsigned int> keys;
+	sv.get_all_keys(keys);
+	pids.assign(keys.begin(), keys.end());
+	offsets.resize(keys.size() + 1);
+	for (size_t i = 1; i < sv.data.size(); i++) {
+		if (sv.data[i] < sv.data[i - 1] && i > 1) {
+			MERR("IndexTable::get_block sid %d data is not in pids order\n", sid);
+			return -1;
+		}
+		offsets[i - 1] = sv.data[i] - sv.data[1];
+	}
+	offsets.back() = offsets[keys.size() - 1] + last_len;
+	start = work_area + base + (unsigned long long)sv.data[1] * factor;
+
+	return 0;
+}
+
 //--------------------------------------------------------------------------------------
 size_t IndexTable::get_size()
 {
@@ -1916,6 +2661,10 @@ void IndexTable::clear()
 			//MLOG("IndexTable::clear after work_area [%d]\n", work_area);
 		}
 	}
+	else if (work_area_mapped) {
+		if (munmap_bin_file_IM(work_area, w_size) < 0)
+			MERR("Error IndexTable::clear - failed unmapping sid %d\n", sid);
+	}
 	work_area = NULL;
 	init();
 	try {
@@ -1951,12 +2700,17 @@ int IndexTable::read_index_and_data(string &idx_fname, string &data_fname)
 //--------------------------------------------------------------------------------------
 int IndexTable::read_index_and_data(string &idx_fname, string &data_fname, const vector<int> &pids_to_include)
 {
-	string prefix = "IndexTable::read_index_and_data :: ";
-
 	// threads locking: making sure only a single thread at a time can load this specific sid
 	// using the index_table_read_locks set of locks, since the inner functions use the index_table_locks mechanism
 	// MLOG("in read_index_and_data with sid %d\n", sid);
 	lock_guard<mutex> guard(index_table_read_locks[sid]);
+	return read_index_and_data_locked(idx_fname, data_fname, pids_to_include);
+}
+
+//--------------------------------------------------------------------------------------
+int IndexTable::read_index_and_data_locked(string &idx_fname, string &data_fname, const vector<int> &pids_to_include)
+{
+	string prefix = "IndexTable::read_index_and_data :: ";
 
 	if (is_loaded && is_locked) {
 		MTHROW_AND_ERR("%s ERROR: failed reading index table %s since this signal is LOCKED\n", prefix.c_str(), idx_fname.c_str());
@@ -1978,9 +2732,24 @@ int IndexTable::read_index_and_data(string &idx_fname, string &data_fname, const
 			return -1;
 		}
 
+		bool mapped = false;
 		if (file_exists_IM(data_fname)) {
-			//if (read_bin_file_IM_parallel(data_fname, work_area, w_size) < 0) {
-			if (read_bin_file_IM(data_fname, work_area, w_size) < 0) {
+			if (read_data_format(data_fname) == REPOSITORY_COMPRESSED_FORMAT) {
+				// compressed files are decoded into memory, also in mmap mode
+				if (read_compressed_data(data_fname) < 0) {
+					MTHROW_AND_ERR("%s ERROR: can't read compressed file %s\n", prefix.c_str(), data_fname.c_str());
+					return -1;
+				}
+			}
+			else if (use_mmap) {
+				mapped = true;
+				if (mmap_bin_file_IM(data_fname, work_area, w_size) < 0) {
+					MTHROW_AND_ERR("%s ERROR: can't map file %s\n", prefix.c_str(), data_fname.c_str());
+					return -1;
+				}
+			}
+			//else if (read_bin_file_IM_parallel(data_fname, work_area, w_size) < 0) {
+			else if (read_bin_file_IM(data_fname, work_area, w_size) < 0) {
 				MTHROW_AND_ERR("%s ERROR: can't read or allocate for file %s\n", prefix.c_str(), data_fname.c_str());
 				return -1;
 			}
@@ -1991,7 +2760,12 @@ int IndexTable::read_index_and_data(string &idx_fname, string &data_fname, const
 			work_area = NULL;
 		}
 
-		if (w_size > 0) work_area_allocated = 1;
+		if (w_size > 0) {
+			if (mapped)
+				work_area_mapped = 1;
+			else
+				work_area_allocated = 1;
+		}
 		is_loaded = 1;
 		full_load = 1;
 		//MLOG("sid %d : %s index size %ld data_size %ld %ld\n", sid, idx_fname.c_str(), get_size(), d_size, w_size);
@@ -2056,29 +2830,66 @@ int IndexTable::read_index_and_data(string &idx_fname, string &data_fname, const
 			w_size = d_size;
 		work_area_allocated = 1;
 
-		// now reading with a buffer one by one , copying and updating index_table
-		MedBufferedFile mbf;
+		// reading the pids ranges (coalesced, in parallel) into work_area in pids order, then updating index_table
+		vector<FileRange_IM> ranges(inds.size());
+		//MLOG("pid_to_read : %d pids factor %d sid %d\n", pids_to_include.size(),factor,sid);
 
-		if (mbf.open(data_fname) < 0) {
-			MTHROW_AND_ERR("ERROR: Can't open data file %s\n", data_fname.c_str());
-			return -1;
+		// the data file is opened once for its format and, when compressed, the positions of the pids blocks
+		ifstream data_inf(data_fname, ios::in | ios::binary | ios::ate);
+		unsigned long long data_size = data_inf ? (unsigned long long)data_inf.tellg() : 0;
+		int format = -1;
+		if (data_inf) {
+			data_inf.seekg(0, ios::beg);
+			if (!data_inf.read((char *)&format, sizeof(int)))
+				format = -1;
+		}
+
+		if (format == REPOSITORY_COMPRESSED_FORMAT) {
+			// compressed: reading the blocks of the pids (block i-1 belongs to index entry i) and decoding them
+			MedSigCodec codec;
+			vector<int> blocks(inds.size());
+			for (int i = 0; i < inds.size(); i++)
+				blocks[i] = inds[i] - 1;
+			unsigned long long n_blocks = 0;
+			if (codec.read_block_ranges(data_inf, data_size, data_fname, blocks, ranges, n_blocks) < 0 ||
+				n_blocks + 1 != idx.sv.data.size() || codec.bytes_len != idx.factor)
+				MTHROW_AND_ERR("ERROR: compressed data file %s doesn't match its index\n", data_fname.c_str());
+			data_inf.close();
+			unsigned long long c_size = 0;
+			for (int i = 0; i < inds.size(); i++)
+				c_size += ranges[i].len;
+			vector<unsigned char> c_data(c_size);
+			if (read_ranges_IM(data_fname, ranges, c_data.data(), read_gap, bytes_read) < 0) {
+				MTHROW_AND_ERR("ERROR: Can't read data file %s\n", data_fname.c_str());
+				return -1;
+			}
+			bytes_used = c_size;
+
+			unsigned long long c_pos = 0, d_pos = 0;
+			for (int i = 0; i < inds.size(); i++) {
+				if (codec.decode(&c_data[c_pos], ranges[i].len, lens[i], work_area + d_pos) < 0)
+					MTHROW_AND_ERR("ERROR: corrupted block of pid %d in %s\n", keys[i], data_fname.c_str());
+				c_pos += ranges[i].len;
+				d_pos += (unsigned long long)lens[i] * factor;
+			}
+		}
+		else {
+			data_inf.close();
+			for (int i = 0; i < inds.size(); i++) {
+				ranges[i].pos = idx.base + (unsigned long long)idx.sv.data[inds[i]] * (unsigned long long)idx.factor;
+				ranges[i].len = (unsigned long long)lens[i] * factor;
+			}
+			if (read_ranges_IM(data_fname, ranges, work_area, read_gap, bytes_read) < 0) {
+				MTHROW_AND_ERR("ERROR: Can't read data file %s\n", data_fname.c_str());
+				return -1;
+			}
+			bytes_used = d_size;
 		}
 
-		unsigned char *buf = work_area;
-		//MLOG("pid_to_read : %d pids factor %d sid %d\n", pids_to_include.size(),factor,sid);
-
-		for (int i = 0; i < inds.size(); i++) {
-			unsigned long long pos = idx.base + (unsigned long long)idx.sv.data[inds[i]] * (unsigned long long)idx.factor;
-			int blen = lens[i] * factor;
-			//MLOG("before pid %d sid %d pos %lld factor %d %d blen %d i %d idx.base %d\n", inds[i], sid, pos, factor, idx.factor, blen, i, idx.base);
-			mbf.read(buf, pos, blen);
-			//MLOG("after pid %d sid %d pos %lld factor %d %d blen %d i %d idx.base %d\n", inds[i], sid, pos, factor, idx.factor, blen, i, idx.base);
-			buf += blen;
+		for (int i = 0; i < inds.size(); i++)
 			if (insert(keys[i], lens[i]) < 0)
 				MTHROW_AND_ERR("IndexTable::read_index_and_data could not insert(keys[i], lens[i])\n");
-		}
 
-		mbf.close();
 		is_loaded = 1;
 		full_load = 0;
 	}
@@ -2088,6 +2899,73 @@ int IndexTable::read_index_and_data(string &idx_fname, string &data_fname, const
 	return 0;
 }
 
+//--------------------------------------------------------------------------------------
+int IndexTable::read_compressed_data(const string &data_fname)
+{
+	string fname = data_fname;
+	unsigned char *c_data = NULL;
+	unsigned long long c_size = 0;
+	if (read_bin_file_IM(fname, c_data, c_size) < 0)
+		return -1;
+
+	MedSigCodec codec;
+	vector<unsigned long long> blocks_pos;
+	int rc = codec.read_trailer(c_data, c_size, blocks_pos);
+	if (rc == 0 && (blocks_pos.size() != sv.data.size() || codec.bytes_len != factor)) {
+		MERR("IndexTable::read_compressed_data : %s doesn't match its index (%d blocks for %d pids)\n", data_fname.c_str(),
+			(int)blocks_pos.size() - 1, (int)sv.data.size() - 1);
+		rc = -1;
+	}
+
+	if (rc == 0) {
+		// same layout as a plain data file: base bytes, then the records in index order
+		unsigned long long n_recs = sv.data.size() > 1 ? (unsigned long long)sv.data.back() + last_len : 0;
+		w_size = base + n_recs * factor;
+		work_area = new unsigned char[w_size];
+		memset(work_area, 0, base);
+
+		int nerr = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:nerr)
+		for (long long i = 1; i < (long long)sv.data.size(); i++) {
+			int len = (i < (long long)sv.data.size() - 1) ? (int)(sv.data[i + 1] - sv.data[i]) : last_len;
+			if (codec.decode(c_data + blocks_pos[i - 1], blocks_pos[i] - blocks_pos[i - 1], len,
+				work_area + base + (unsigned long long)sv.data[i] * factor) < 0)
+				nerr++;
+		}
+		if (nerr > 0) {
+			MERR("IndexTable::read_compressed_data : %d corrupted blocks in %s\n", nerr, data_fname.c_str());
+			delete[] work_area;
+			work_area = NULL;
+			w_size = 0;
+			rc = -1;
+		}
+	}
+
+	delete[] c_data;
+	return rc;
+}
+
+//--------------------------------------------------------------------------------------
+// pids is expected to be sorted, an empty list means the whole signal
+void IndexTable::advise_pids(const vector<int> &pids, int advice)
+{
+	if (!work_area_mapped || work_area == NULL)
+		return;
+
+	if (pids.size() == 0) {
+		madvise_IM(work_area, w_size, advice);
+		return;
+	}
+
+	for (int pid : pids) {
+		unsigned long long pos;
+		int len;
+		get(pid, pos, len);
+		if (len > 0)
+			madvise_IM(&work_area[pos], (unsigned long long)len * factor, advice);
+	}
+}
+
 //======================================================================================================================
 int UsvsIterator::init(MedRepository *_rep, const vector<string> &_sig_names, const vector<UniversalSigVec *> &_usvs)
 {
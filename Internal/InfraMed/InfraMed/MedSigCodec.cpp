@@ -0,0 +1,530 @@
+//
+// MedSigCodec.cpp
+//
+#include "MedSigCodec.h"
+#include <Logger/Logger/Logger.h>
+#include <algorithm>
+#include <cstring>
+
+#define LOCAL_SECTION LOG_INFRA
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+extern MedLogger global_logger;
+
+// channel coding modes (the high bit marks float values coded as integers)
+#define CODEC_FOR		1
+#define CODEC_DELTA		2
+#define CODEC_DICT		3
+#define CODEC_RAW		4
+#define CODEC_AS_INT	0x80
+
+//-----------------------------------------------------------------------------
+// helpers
+//-----------------------------------------------------------------------------
+static inline unsigned long long zigzag(long long x) { return ((unsigned long long)x << 1) ^ (unsigned long long)(x >> 63); }
+static inline long long unzigzag(unsigned long long x) { return (long long)(x >> 1) ^ -(long long)(x & 1); }
+
+static inline void put_varint(vector<unsigned char> &out, unsigned long long x)
+{
+	while (x >= 0x80) {
+		out.push_back((unsigned char)(x | 0x80));
+		x >>= 7;
+	}
+	out.push_back((unsigned char)x);
+}
+
+static inline int bits_for(unsigned long long range)
+{
+	int b = 0;
+	while (b < 64 && (range >> b) != 0) b++;
+	return b;
+}
+
+static inline unsigned long long packed_len(unsigned long long n, int bits) { return (n * bits + 7) / 8; }
+
+// values are expected to fit in bits
+static void pack_bits(const vector<unsigned long long> &v, int bits, vector<unsigned char> &out)
+{
+	if (bits == 0 || v.size() == 0)
+		return;
+	size_t start = out.size();
+	out.resize(start + packed_len(v.size(), bits), 0);
+	unsigned char *p = &out[start];
+	unsigned long long bitpos = 0;
+	for (unsigned long long x : v) {
+		unsigned char *q = p + (bitpos >> 3);
+		int sh = (int)(bitpos & 7);
+		*q++ |= (unsigned char)(x << sh);
+		for (int done = 8 - sh; done < bits; done += 8)
+			*q++ |= (unsigned char)(x >> done);
+		bitpos += bits;
+	}
+}
+
+static inline unsigned long long get_bits(const unsigned char *p, unsigned long long bitpos, int bits)
+{
+	const unsigned char *q = p + (bitpos >> 3);
+	int sh = (int)(bitpos & 7);
+	unsigned long long x = (unsigned long long)(*q++) >> sh;
+	for (int got = 8 - sh; got < bits; got += 8)
+		x |= (unsigned long long)(*q++) << got;
+	if (bits < 64)
+		x &= (1ULL << bits) - 1;
+	return x;
+}
+
+// bounds checked reading of a block
+struct CodecReader {
+	const unsigned char *p;
+	const unsigned char *end;
+	bool ok = true;
+
+	CodecReader(const unsigned char *_p, unsigned long long len) { p = _p; end = _p + len; }
+	unsigned char byte() {
+		if (p >= end) { ok = false; return 0; }
+		return *p++;
+	}
+	unsigned long long varint() {
+		unsigned long long x = 0;
+		for (int sh = 0; sh < 64; sh += 7) {
+			unsigned char b = byte();
+			x |= (unsigned long long)(b & 0x7f) << sh;
+			if (!(b & 0x80)) return x;
+		}
+		ok = false;
+		return 0;
+	}
+	const unsigned char *take(unsigned long long n) {
+		if ((unsigned long long)(end - p) < n) { ok = false; return NULL; }
+		const unsigned char *q = p;
+		p += n;
+		return q;
+	}
+};
+
+static bool float_is_int(double f, int size)
+{
+	if (!(f > -9.2e18 && f < 9.2e18))
+		return false;
+	long long x = (long long)f;
+	if (size == sizeof(float)) {
+		float a = (float)f, b = (float)x;
+		return memcmp(&a, &b, sizeof(float)) == 0;
+	}
+	double b = (double)x;
+	return memcmp(&f, &b, sizeof(double)) == 0;
+}
+
+static inline long long load_col(const unsigned char *r, const MedSigCodec::Column &c, bool as_int)
+{
+	if (c.kind == MedSigCodec::COL_FLOAT) {
+		float f;
+		memcpy(&f, r + c.offset, sizeof(float));
+		if (as_int) return (long long)f;
+		unsigned int b;
+		memcpy(&b, &f, sizeof(float));
+		return (long long)b;
+	}
+	if (c.kind == MedSigCodec::COL_DOUBLE) {
+		double f;
+		memcpy(&f, r + c.offset, sizeof(double));
+		if (as_int) return (long long)f;
+		long long b;
+		memcpy(&b, &f, sizeof(double));
+		return b;
+	}
+
+	unsigned long long x = 0;
+	memcpy(&x, r + c.offset, c.size);
+	if (c.kind == MedSigCodec::COL_INT && c.size < 8) {
+		int sh = 64 - 8 * c.size;
+		return (long long)(x << sh) >> sh;
+	}
+	return (long long)x;
+}
+
+static inline void store_col(unsigned char *r, const MedSigCodec::Column &c, long long x, bool as_int)
+{
+	if (as_int && c.kind == MedSigCodec::COL_FLOAT) {
+		float f = (float)x;
+		memcpy(r + c.offset, &f, sizeof(float));
+	}
+	else if (as_int && c.kind == MedSigCodec::COL_DOUBLE) {
+		double f = (double)x;
+		memcpy(r + c.offset, &f, sizeof(double));
+	}
+	else
+		memcpy(r + c.offset, &x, c.size);
+}
+
+//-----------------------------------------------------------------------------
+// MedSigCodec
+//-----------------------------------------------------------------------------
+int MedSigCodec::init(const SignalInfo &info)
+{
+	typedef GenericSigVec::type_enc type_enc;
+
+	bytes_len = info.bytes_len;
+	cols.clear();
+
+	vector<Column> chans;
+	for (int k = 0; k < info.n_time_channels + info.n_val_channels; k++) {
+		Column c;
+		unsigned char t = k < info.n_time_channels ? info.time_channel_types[k] : info.val_channel_types[k - info.n_time_channels];
+		c.offset = k < info.n_time_channels ? info.time_channel_offsets[k] : info.val_channel_offsets[k - info.n_time_channels];
+		c.size = type_enc::bytes_len(t);
+		if (t == type_enc::FLOAT32) c.kind = COL_FLOAT;
+		else if (t == type_enc::FLOAT64) c.kind = COL_DOUBLE;
+		else if (t == type_enc::FLOAT80) c.kind = COL_RAW;
+		else c.kind = (t & type_enc::SIGNED) ? COL_INT : COL_UINT;
+		chans.push_back(c);
+	}
+	sort(chans.begin(), chans.end(), [](const Column &a, const Column &b) { return a.offset < b.offset; });
+
+	// bytes not covered by a channel become byte columns
+	int pos = 0;
+	bool valid = true;
+	for (auto &c : chans) {
+		if (c.size <= 0 || c.offset < pos || c.offset + c.size > bytes_len) {
+			valid = false;
+			break;
+		}
+		for (; pos < c.offset; pos++)
+			cols.push_back({ pos, 1, COL_UINT });
+		cols.push_back(c);
+		pos += c.size;
+	}
+	if (!valid) {
+		MWARN("MedSigCodec::init : channels of %s don't match its records, coding it byte by byte\n", info.name.c_str());
+		cols.clear();
+		pos = 0;
+	}
+	for (; pos < bytes_len; pos++)
+		cols.push_back({ pos, 1, COL_UINT });
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+void MedSigCodec::encode(const unsigned char *recs, int n, vector<unsigned char> &out) const
+{
+	vector<long long> v(n);
+	vector<unsigned long long> packed;
+
+	for (const Column &c : cols) {
+		if (c.kind == COL_RAW) {
+			out.push_back(CODEC_RAW);
+			for (int j = 0; j < n; j++)
+				out.insert(out.end(), recs + (size_t)j * bytes_len + c.offset, recs + (size_t)j * bytes_len + c.offset + c.size);
+			continue;
+		}
+
+		bool as_int = false;
+		if (c.kind == COL_FLOAT || c.kind == COL_DOUBLE) {
+			as_int = true;
+			for (int j = 0; j < n && as_int; j++) {
+				double f;
+				if (c.kind == COL_FLOAT) {
+					float ff;
+					memcpy(&ff, recs + (size_t)j * bytes_len + c.offset, sizeof(float));
+					f = ff;
+				}
+				else
+					memcpy(&f, recs + (size_t)j * bytes_len + c.offset, sizeof(double));
+				as_int = float_is_int(f, c.size);
+			}
+		}
+		unsigned char flag = as_int ? CODEC_AS_INT : 0;
+
+		long long mn = 0, mx = 0;
+		for (int j = 0; j < n; j++) {
+			v[j] = load_col(recs + (size_t)j * bytes_len, c, as_int);
+			if (j == 0 || v[j] < mn) mn = v[j];
+			if (j == 0 || v[j] > mx) mx = v[j];
+		}
+
+		// choosing the cheapest coding
+		int for_bits = bits_for((unsigned long long)mx - (unsigned long long)mn);
+		unsigned long long for_cost = packed_len(n, for_bits);
+
+		long long dmn = 0, dmx = 0;
+		for (int j = 1; j < n; j++) {
+			long long d = (long long)((unsigned long long)v[j] - (unsigned long long)v[j - 1]);
+			if (j == 1 || d < dmn) dmn = d;
+			if (j == 1 || d > dmx) dmx = d;
+		}
+		int delta_bits = bits_for((unsigned long long)dmx - (unsigned long long)dmn);
+		unsigned long long delta_cost = n > 1 ? packed_len(n - 1, delta_bits) + 10 : for_cost + 1;
+
+		vector<long long> dict;
+		unsigned long long dict_cost = for_cost + 1;
+		if (for_bits > 2 && n > 4) {
+			dict = v;
+			sort(dict.begin(), dict.end());
+			dict.resize(unique(dict.begin(), dict.end()) - dict.begin());
+			dict_cost = packed_len(dict.size(), for_bits) + packed_len(n, bits_for(dict.size() - 1)) + 4;
+		}
+
+		packed.clear();
+		if (delta_cost < for_cost && delta_cost <= dict_cost) {
+			out.push_back(CODEC_DELTA | flag);
+			put_varint(out, zigzag(v[0]));
+			put_varint(out, zigzag(dmn));
+			out.push_back((unsigned char)delta_bits);
+			for (int j = 1; j < n; j++)
+				packed.push_back((unsigned long long)v[j] - (unsigned long long)v[j - 1] - (unsigned long long)dmn);
+			pack_bits(packed, delta_bits, out);
+		}
+		else if (dict_cost < for_cost) {
+			out.push_back(CODEC_DICT | flag);
+			put_varint(out, dict.size());
+			put_varint(out, zigzag(mn));
+			out.push_back((unsigned char)for_bits);
+			for (long long x : dict)
+				packed.push_back((unsigned long long)x - (unsigned long long)mn);
+			pack_bits(packed, for_bits, out);
+			int ibits = bits_for(dict.size() - 1);
+			out.push_back((unsigned char)ibits);
+			packed.clear();
+			for (int j = 0; j < n; j++)
+				packed.push_back(lower_bound(dict.begin(), dict.end(), v[j]) - dict.begin());
+			pack_bits(packed, ibits, out);
+		}
+		else {
+			out.push_back(CODEC_FOR | flag);
+			put_varint(out, zigzag(mn));
+			out.push_back((unsigned char)for_bits);
+			for (int j = 0; j < n; j++)
+				packed.push_back((unsigned long long)v[j] - (unsigned long long)mn);
+			pack_bits(packed, for_bits, out);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+int MedSigCodec::decode(const unsigned char *blk, unsigned long long blk_len, int n, unsigned char *recs) const
+{
+	CodecReader rd(blk, blk_len);
+
+	for (const Column &c : cols) {
+		unsigned char mode = rd.byte();
+		bool as_int = (mode & CODEC_AS_INT) != 0;
+		mode &= ~CODEC_AS_INT;
+
+		if (mode == CODEC_RAW) {
+			const unsigned char *p = rd.take((unsigned long long)n * c.size);
+			if (p == NULL) return -1;
+			for (int j = 0; j < n; j++)
+				memcpy(recs + (size_t)j * bytes_len + c.offset, p + (size_t)j * c.size, c.size);
+		}
+		else if (mode == CODEC_FOR) {
+			unsigned long long mn = (unsigned long long)unzigzag(rd.varint());
+			int bits = rd.byte();
+			const unsigned char *p = rd.take(packed_len(n, bits));
+			if (p == NULL || bits > 64) return -1;
+			for (int j = 0; j < n; j++) {
+				unsigned long long x = bits ? get_bits(p, (unsigned long long)j * bits, bits) : 0;
+				store_col(recs + (size_t)j * bytes_len, c, (long long)(mn + x), as_int);
+			}
+		}
+		else if (mode == CODEC_DELTA) {
+			unsigned long long x = (unsigned long long)unzigzag(rd.varint());
+			unsigned long long dmn = (unsigned long long)unzigzag(rd.varint());
+			int bits = rd.byte();
+			const unsigned char *p = rd.take(n > 1 ? packed_len(n - 1, bits) : 0);
+			if (!rd.ok || bits > 64) return -1;
+			for (int j = 0; j < n; j++) {
+				if (j > 0)
+					x += dmn + (bits ? get_bits(p, (unsigned long long)(j - 1) * bits, bits) : 0);
+				store_col(recs + (size_t)j * bytes_len, c, (long long)x, as_int);
+			}
+		}
+		else if (mode == CODEC_DICT) {
+			unsigned long long k = rd.varint();
+			unsigned long long mn = (unsigned long long)unzigzag(rd.varint());
+			int bits = rd.byte();
+			const unsigned char *p = rd.take(packed_len(k, bits));
+			int ibits = rd.byte();
+			const unsigned char *q = rd.take(packed_len(n, ibits));
+			if (!rd.ok || k == 0 || bits > 64 || ibits > 64) return -1;
+			vector<long long> dict(k);
+			for (unsigned long long i = 0; i < k; i++)
+				dict[i] = (long long)(mn + (bits ? get_bits(p, i * bits, bits) : 0));
+			for (int j = 0; j < n; j++) {
+				unsigned long long i = ibits ? get_bits(q, (unsigned long long)j * ibits, ibits) : 0;
+				if (i >= k) return -1;
+				store_col(recs + (size_t)j * bytes_len, c, dict[i], as_int);
+			}
+		}
+		else
+			return -1;
+
+		if (!rd.ok)
+			return -1;
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MedSigCodec::write_trailer(ofstream &f, const vector<unsigned long long> &blocks_pos) const
+{
+	int n_cols = (int)cols.size();
+	f.write((char *)&n_cols, sizeof(int));
+	for (const Column &c : cols) {
+		int kind = c.kind;
+		f.write((char *)&c.offset, sizeof(int));
+		f.write((char *)&c.size, sizeof(int));
+		f.write((char *)&kind, sizeof(int));
+	}
+	f.write((char *)&bytes_len, sizeof(int));
+	unsigned long long n_blocks = blocks_pos.size() - 1;
+	f.write((char *)&n_blocks, sizeof(unsigned long long));
+	f.write((char *)&blocks_pos[0], sizeof(unsigned long long) * blocks_pos.size());
+	f.write((char *)&blocks_pos.back(), sizeof(unsigned long long));
+
+	return f.good() ? 0 : -1;
+}
+
+//-----------------------------------------------------------------------------
+// the layout at the start of the trailer : the columns, bytes_len and n_blocks
+static int parse_layout(MedSigCodec &codec, CodecReader &rd, unsigned long long &n_blocks)
+{
+	const unsigned char *p = rd.take(sizeof(int));
+	if (p == NULL) return -1;
+	int n_cols;
+	memcpy(&n_cols, p, sizeof(int));
+	if (n_cols < 0) return -1;
+	p = rd.take((unsigned long long)n_cols * 3 * sizeof(int) + sizeof(int) + sizeof(unsigned long long));
+	if (p == NULL) return -1;
+
+	codec.cols.resize(n_cols);
+	for (int i = 0; i < n_cols; i++) {
+		int f[3];
+		memcpy(f, p, sizeof(f)); p += sizeof(f);
+		codec.cols[i].offset = f[0];
+		codec.cols[i].size = f[1];
+		codec.cols[i].kind = (unsigned char)f[2];
+	}
+	memcpy(&codec.bytes_len, p, sizeof(int)); p += sizeof(int);
+	memcpy(&n_blocks, p, sizeof(unsigned long long));
+	return 0;
+}
+
+// trailer holds the bytes from trailer_pos to the trailer position at the end of the file
+static int parse_trailer(MedSigCodec &codec, const unsigned char *trailer, unsigned long long len, unsigned long long trailer_pos,
+	vector<unsigned long long> &blocks_pos)
+{
+	CodecReader rd(trailer, len);
+	unsigned long long n_blocks;
+	if (parse_layout(codec, rd, n_blocks) < 0 || n_blocks >= len / sizeof(unsigned long long))
+		return -1;
+
+	const unsigned char *p = rd.take((n_blocks + 1) * sizeof(unsigned long long));
+	if (p == NULL) return -1;
+	blocks_pos.resize(n_blocks + 1);
+	memcpy(&blocks_pos[0], p, (n_blocks + 1) * sizeof(unsigned long long));
+
+	if (blocks_pos[0] < sizeof(int) || blocks_pos.back() != trailer_pos)
+		return -1;
+	for (size_t i = 1; i < blocks_pos.size(); i++)
+		if (blocks_pos[i] < blocks_pos[i - 1])
+			return -1;
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MedSigCodec::read_trailer(const unsigned char *data, unsigned long long size, vector<unsigned long long> &blocks_pos)
+{
+	if (size < sizeof(int) + sizeof(unsigned long long)) {
+		MERR("MedSigCodec::read_trailer : data is too short (%llu bytes)\n", size);
+		return -1;
+	}
+	unsigned long long trailer_pos;
+	memcpy(&trailer_pos, data + size - sizeof(unsigned long long), sizeof(unsigned long long));
+	if (trailer_pos > size - sizeof(unsigned long long) ||
+		parse_trailer(*this, data + trailer_pos, size - sizeof(unsigned long long) - trailer_pos, trailer_pos, blocks_pos) < 0) {
+		MERR("MedSigCodec::read_trailer : corrupted trailer\n");
+		return -1;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// positions of blocks up to this many entries apart are read together
+#define CODEC_POS_RUN_GAP	512
+
+int MedSigCodec::read_block_ranges(ifstream &inf, unsigned long long size, const string &data_fname, const vector<int> &blocks,
+	vector<FileRange_IM> &ranges, unsigned long long &n_blocks)
+{
+	unsigned long long trailer_pos = 0;
+	if (size >= sizeof(int) + sizeof(unsigned long long)) {
+		inf.seekg(size - sizeof(unsigned long long), ios::beg);
+		inf.read((char *)&trailer_pos, sizeof(unsigned long long));
+	}
+	if (!inf || trailer_pos < sizeof(int) || trailer_pos > size - sizeof(unsigned long long)) {
+		MERR("MedSigCodec::read_block_ranges : %s is not a compressed data file\n", data_fname.c_str());
+		return -1;
+	}
+
+	// the layout, then the positions table must fill the rest of the trailer
+	unsigned long long trailer_len = size - sizeof(unsigned long long) - trailer_pos;
+	int n_cols = -1;
+	inf.seekg(trailer_pos, ios::beg);
+	inf.read((char *)&n_cols, sizeof(int));
+	unsigned long long layout_len = sizeof(int) + (unsigned long long)max(n_cols, 0) * 3 * sizeof(int) + sizeof(int) + sizeof(unsigned long long);
+	vector<unsigned char> layout;
+	bool ok = (inf && n_cols >= 0 && layout_len <= trailer_len);
+	if (ok) {
+		layout.resize(layout_len);
+		inf.seekg(trailer_pos, ios::beg);
+		inf.read((char *)layout.data(), layout_len);
+		CodecReader rd(layout.data(), layout_len);
+		ok = (inf && parse_layout(*this, rd, n_blocks) == 0 && n_blocks < trailer_len / sizeof(unsigned long long) &&
+			trailer_len == layout_len + (n_blocks + 1) * sizeof(unsigned long long));
+	}
+	if (!ok) {
+		MERR("MedSigCodec::read_block_ranges : corrupted trailer in %s\n", data_fname.c_str());
+		return -1;
+	}
+
+	// runs of close blocks, each read as one slice of the positions table
+	unsigned long long table_pos = trailer_pos + layout_len;
+	ranges.resize(blocks.size());
+	vector<unsigned long long> pos;
+	for (size_t i = 0; i < blocks.size();) {
+		size_t j = i + 1;
+		while (j < blocks.size() && blocks[j] >= blocks[j - 1] && blocks[j] - blocks[j - 1] <= CODEC_POS_RUN_GAP)
+			j++;
+		int first = blocks[i], last = blocks[j - 1];
+		if (first < 0 || (unsigned long long)last >= n_blocks) {
+			MERR("MedSigCodec::read_block_ranges : block %d out of range in %s (%llu blocks)\n", first < 0 ? first : last, data_fname.c_str(), n_blocks);
+			return -1;
+		}
+		pos.resize(last - first + 2);
+		inf.seekg(table_pos + (unsigned long long)first * sizeof(unsigned long long), ios::beg);
+		inf.read((char *)pos.data(), pos.size() * sizeof(unsigned long long));
+		for (size_t k = i; k < j && inf; k++) {
+			unsigned long long from = pos[blocks[k] - first], to = pos[blocks[k] - first + 1];
+			if (from < sizeof(int) || to < from || to > trailer_pos)
+				inf.setstate(ios::failbit);
+			ranges[k].pos = from;
+			ranges[k].len = to - from;
+		}
+		if (!inf) {
+			MERR("MedSigCodec::read_block_ranges : corrupted blocks positions in %s\n", data_fname.c_str());
+			return -1;
+		}
+		i = j;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+int read_data_format(const string &data_fname)
+{
+	ifstream inf(data_fname, ios::in | ios::binary);
+	int format = -1;
+	if (!inf || !inf.read((char *)&format, sizeof(int)))
+		return -1;
+	return format;
+}
@@ -0,0 +1,70 @@
+//
+// MedSigCodec.h - compressed signal data files (repository mode 3 and up, see COMPRESS in MedConvert)
+//
+// The records of each pid are coded as one block, channel by channel. The values of a channel are taken as 64 bit
+// integers and stored with the cheapest of:
+//   FOR   : frame of reference - the minimum, and (value - minimum) bit packed
+//   DELTA : the first value, then the differences from the previous record, frame of reference packed (time channels)
+//   DICT  : the distinct values, frame of reference packed, and the bit packed dictionary index of each record (categories)
+// float channels holding only integer values are coded as integers, other floats as their bits.
+// Record bytes not covered by channels are coded byte by byte, so decoding always restores the original records.
+//
+// Compressed data file: int format (REPOSITORY_COMPRESSED_FORMAT), the blocks in the index order, then the trailer:
+// the codec layout, n_blocks and the blocks positions in the file (n_blocks+1 values), and last the trailer position.
+// Partial loads read the layout and then only the positions of the blocks they need (see read_block_ranges).
+// The index file is the same as for plain data files (pids and records counts), block i belongs to the i-th index entry.
+//
+
+#ifndef __MED_SIG_CODEC_H__
+#define __MED_SIG_CODEC_H__
+
+#include "MedSignals.h"
+#include "Utils.h"
+#include <vector>
+#include <string>
+#include <fstream>
+
+using namespace std;
+
+class MedSigCodec {
+public:
+	// column kinds
+	static const unsigned char COL_UINT = 0;
+	static const unsigned char COL_INT = 1;
+	static const unsigned char COL_FLOAT = 2;
+	static const unsigned char COL_DOUBLE = 3;
+	static const unsigned char COL_RAW = 4;
+
+	struct Column {
+		int offset;
+		int size;
+		unsigned char kind;
+	};
+
+	vector<Column> cols;
+	int bytes_len = 0;
+
+	// layout from the signal channels
+	int init(const SignalInfo &info);
+
+	// appends the coded block of n records to out
+	void encode(const unsigned char *recs, int n, vector<unsigned char> &out) const;
+
+	// decodes a block of n records into recs. returns -1 for a corrupted block
+	int decode(const unsigned char *blk, unsigned long long blk_len, int n, unsigned char *recs) const;
+
+	// trailer i/o. blocks_pos has n_blocks+1 entries (the last is the trailer position)
+	int write_trailer(ofstream &f, const vector<unsigned long long> &blocks_pos) const;
+	int read_trailer(const unsigned char *data, unsigned long long size, vector<unsigned long long> &blocks_pos);
+
+	// partial loads: reads the layout from the trailer of the compressed data file inf (size bytes, data_fname for
+	// messages), and the file ranges of the given blocks (increasing, 0 based) from their positions only.
+	// n_blocks returns the number of blocks in the file.
+	int read_block_ranges(ifstream &inf, unsigned long long size, const string &data_fname, const vector<int> &blocks,
+		vector<FileRange_IM> &ranges, unsigned long long &n_blocks);
+};
+
+// returns the format int at the start of a data file, -1 if it can't be read
+int read_data_format(const string &data_fname);
+
+#endif
@@ -11,6 +11,7 @@
 #include "Logger/Logger/Logger.h"
 #include"MedUtils/MedUtils/MedUtils.h"
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -202,7 +203,11 @@ static bool str_is_int_number(const std::string &str)
 
 int MedSignals::read(const string &fname)
 {
-	lock_guard<mutex> guard(insert_signal_mutex);
+	auto it = preloaded.find(fname);
+	if (it != preloaded.end()) {
+		istringstream pinf(it->second);
+		return read(pinf, fname);
+	}
 
 	ifstream inf(fname);
 
@@ -211,6 +216,16 @@ int MedSignals::read(const string &fname)
 		return -1;
 	}
 
+	int rc = read(inf, fname);
+	inf.close();
+	return rc;
+}
+
+//-----------------------------------------------------------------------------------------------
+int MedSignals::read(istream &inf, const string &fname)
+{
+	lock_guard<mutex> guard(insert_signal_mutex);
+
 	fnames.push_back(fname); // TBD : check that we didn't already load this file
 	string curr_line;
 	MLOG_D("Working on signals file %s\n", fname.c_str());
@@ -341,7 +356,6 @@ int MedSignals::read(const string &fname)
 		sid2serial[signals_ids[i]] = i;
 
 
-	inf.close();
 	fnames.push_back(fname);
 	MLOG_D("Finished reading signals file %s\n", fname.c_str());
 	return 0;
@@ -705,6 +719,31 @@ int GenericSigVec::get_index_ge_time_bound(int time_chan, int time_bound)
 
 void GenericSigVec::init_from_sigtype(SigType sigtype) {
 	init_from_spec(get_type_generic_spec(sigtype));
+	layout_type = sigtype;
+}
+
+int GenericSigVec::match_layout_type(const GenericSigVec &gsv) {
+	static vector<GenericSigVec> fixed_types = []() {
+		vector<GenericSigVec> res(T_Generic);
+		for (int t = 0; t < T_Generic; t++)
+			res[t].init_from_spec(get_type_generic_spec((SigType)t));
+		return res;
+	}();
+
+	for (int t = 0; t < T_Generic; t++) {
+		const GenericSigVec &f = fixed_types[t];
+		if (f.struct_size != gsv.struct_size || f.n_time != gsv.n_time || f.n_val != gsv.n_val)
+			continue;
+		bool same = true;
+		for (int chan = 0; chan < f.n_time && same; chan++)
+			same = (f.time_channel_offsets[chan] == gsv.time_channel_offsets[chan] && f.time_channel_types[chan] == gsv.time_channel_types[chan]);
+		for (int chan = 0; chan < f.n_val && same; chan++)
+			same = (f.val_channel_offsets[chan] == gsv.val_channel_offsets[chan] && f.val_channel_types[chan] == gsv.val_channel_types[chan]);
+		if (same)
+			return t;
+	}
+
+	return T_Generic;
 }
 
 void GenericSigVec::init_from_repo(MedRepository& repo, int sid) {
@@ -744,6 +783,7 @@ void GenericSigVec::init_from_spec(const string& signalSpec) {
 	struct_size = 0;
 	n_time = 0;
 	n_val = 0;
+	layout_type = T_Generic;
 	int i = 0;
 	char prev_char = '\0';
 	bool in_val_chan = false, in_time_chan = false;
@@ -886,6 +926,7 @@ void SignalInfo::set_gsv_spec(const string &gsv_spec_str) {
 	val_channel_offsets = gsv.val_channel_offsets;
 	time_channel_types = gsv.time_channel_types;
 	val_channel_types = gsv.val_channel_types;
+	layout_type = GenericSigVec::match_layout_type(gsv);
 	MedRep::get_type_channels(generic_signal_spec, time_unit, n_time_channels, n_val_channels);
 }
 
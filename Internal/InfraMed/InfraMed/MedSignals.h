@@ -703,6 +703,7 @@ public:
 	int time_unit;
 	int n_time_channels;
 	int n_val_channels;
+	int layout_type = T_Generic; // the fixed SigType whose struct layout matches the channels (T_Generic if none), used for typed access
 	int virtual_sig = 0; // flag to tell if the signal was defined in the signals files OR if it was defined as a virtual signal
 	std::array<int, GENERIC_SIG_VEC_MAX_CHANNELS> is_categorical_per_val_channel ; // when 1, channel doens't hold numerical values but rather pointers to a dict
 	std::array<string, GENERIC_SIG_VEC_MAX_CHANNELS> unit_of_measurement_per_val_channel;
@@ -728,12 +729,14 @@ public:
 	vector<int>	signals_ids;
 	vector<int> sid2serial; // inverse of signal_ids, -1: empty slots
 	MedRepository* my_repo = NULL; // backward pointer to the owning repo
+	map<string, string> preloaded; // signals files contents by file name, read instead of the file (e.g. from an AlgoMarker bundle). kept by clear()
 
 	void clear() { fnames.clear(); Name2Sid.clear(); Sid2Name.clear(); signals_names.clear(); signals_ids.clear(); }
 
 	int read(const string &fname);
 	int read(vector<string> &sfnames);
 	int read(string path, vector<string> &sfnames);
+	int read(istream &inf, const string &fname); // signals file contents given as a stream, fname is only used for logging
 
 	inline int sid(const string &name);
 	string name(int sid);
@@ -1014,6 +1017,7 @@ public:
 		struct_size = info.bytes_len;
 		n_time = info.n_time_channels;
 		n_val = info.n_val_channels;
+		layout_type = info.layout_type;
 
 		sid = info.sid;
 	}
@@ -1021,6 +1025,7 @@ public:
 	int struct_size;
 	int n_time;
 	int n_val;
+	int layout_type; // SigType with the same memory layout (T_Generic if none), see TypedSigView
 
 	std::array<int, GENERIC_SIG_VEC_MAX_CHANNELS> time_channel_offsets;
 	std::array<int, GENERIC_SIG_VEC_MAX_CHANNELS> val_channel_offsets;
@@ -1033,7 +1038,7 @@ public:
 		data = _data;
 		len = _len;
 	}
-	GenericSigVec() : data(nullptr), sid(-1), len(0), struct_size(0), n_time(0), n_val(0) { time_channel_offsets.fill(0); val_channel_offsets.fill(0); time_channel_types.fill(0); val_channel_types.fill(0); }
+	GenericSigVec() : data(nullptr), sid(-1), len(0), struct_size(0), n_time(0), n_val(0), layout_type(T_Generic) { time_channel_offsets.fill(0); val_channel_offsets.fill(0); time_channel_types.fill(0); val_channel_types.fill(0); }
 	GenericSigVec(const string& signalSpec, int time_unit = MedTime::Undefined) : GenericSigVec() { _time_unit = time_unit; init_from_spec(signalSpec); }
 	GenericSigVec(SigType sigtype, int time_unit = MedTime::Undefined) : GenericSigVec() { _time_unit = time_unit; init_from_sigtype(sigtype); }
 	GenericSigVec(const GenericSigVec& other) { *this = other; }
@@ -1043,6 +1048,7 @@ public:
 		sid = other.sid;
 		n_time = other.n_time;
 		n_val = other.n_val;
+		layout_type = other.layout_type;
 		_time_unit = other._time_unit;
 		time_channel_offsets = other.time_channel_offsets;
 		time_channel_types = other.time_channel_types;
@@ -1237,6 +1243,9 @@ public:
 
 	static string get_type_generic_spec(SigType t);
 
+	// returns the fixed SigType whose channels layout is identical to the given gsv, T_Generic if none
+	static int match_layout_type(const GenericSigVec &gsv);
+
 	string get_signal_generic_spec() const;
 
 protected:
@@ -1270,4 +1279,77 @@ public:
 	}
 };
 
+//=============================================================================================
+// TypedSigView - switch free access to signal data with a known struct layout.
+// Obtained once per pid/signal from a GenericSigVec (valid only if matches()), after which
+// Time()/Val() are plain member reads the compiler can inline and vectorize in hot loops.
+// Use dispatch_typed_sig_view() to run a templated kernel on the best matching view.
+//=============================================================================================
+template <class T> struct SigTypeOf { static const int type = T_Generic; };
+template <> struct SigTypeOf<SVal> { static const int type = T_Value; };
+template <> struct SigTypeOf<SDateVal> { static const int type = T_DateVal; };
+template <> struct SigTypeOf<STimeVal> { static const int type = T_TimeVal; };
+template <> struct SigTypeOf<SDateRangeVal> { static const int type = T_DateRangeVal; };
+template <> struct SigTypeOf<STimeStamp> { static const int type = T_TimeStamp; };
+template <> struct SigTypeOf<STimeRangeVal> { static const int type = T_TimeRangeVal; };
+template <> struct SigTypeOf<SDateVal2> { static const int type = T_DateVal2; };
+template <> struct SigTypeOf<STimeLongVal> { static const int type = T_TimeLongVal; };
+template <> struct SigTypeOf<SDateShort2> { static const int type = T_DateShort2; };
+template <> struct SigTypeOf<SValShort2> { static const int type = T_ValShort2; };
+template <> struct SigTypeOf<SValShort4> { static const int type = T_ValShort4; };
+template <> struct SigTypeOf<SDateRangeVal2> { static const int type = T_DateRangeVal2; };
+template <> struct SigTypeOf<SDateFloat2> { static const int type = T_DateFloat2; };
+template <> struct SigTypeOf<STimeRange> { static const int type = T_TimeRange; };
+// no STimeShort4 view : its values are unsigned shorts, while the T_TimeShort4 channels (and so the generic reads) are signed
+
+template <class T> class TypedSigView {
+public:
+	T *data;
+	int len;		// type len (not bytes len)
+
+	TypedSigView() : data(NULL), len(0) {}
+	TypedSigView(const GenericSigVec &gsv) { init(gsv); }
+
+	static bool matches(const GenericSigVec &gsv) {
+		return (SigTypeOf<T>::type != T_Generic && gsv.layout_type == SigTypeOf<T>::type && gsv.struct_size == (int)sizeof(T));
+	}
+
+	// returns false (and an empty view) if the gsv layout does not match T
+	bool init(const GenericSigVec &gsv) {
+		if (!matches(gsv)) { data = NULL; len = 0; return false; }
+		data = (T *)gsv.data;
+		len = gsv.len;
+		return true;
+	}
+
+	inline int n_time_channels() const { return T::n_time_channels(); }
+	inline int n_val_channels() const { return T::n_val_channels(); }
+
+	inline int Time(int idx, int chan) const { return data[idx].Time(chan); }
+	inline float Val(int idx, int chan) const { return data[idx].Val(chan); }
+
+	// channel 0 easy API
+	inline int Time(int idx) const { return data[idx].Time(0); }
+	inline float Val(int idx) const { return data[idx].Val(0); }
+};
+
+// calls f(view) with the TypedSigView matching the gsv layout for the common signal types, and f(gsv) otherwise.
+// f is expected to be generic (templated on the view) using only len, Time(idx, chan) and Val(idx, chan).
+template <class F> inline auto dispatch_typed_sig_view(const GenericSigVec &gsv, F &&f) -> decltype(f(gsv))
+{
+	if (gsv.len > 0) {
+		switch (gsv.layout_type) {
+		case T_DateVal: if (TypedSigView<SDateVal>::matches(gsv)) return f(TypedSigView<SDateVal>(gsv)); break;
+		case T_TimeVal: if (TypedSigView<STimeVal>::matches(gsv)) return f(TypedSigView<STimeVal>(gsv)); break;
+		case T_DateRangeVal: if (TypedSigView<SDateRangeVal>::matches(gsv)) return f(TypedSigView<SDateRangeVal>(gsv)); break;
+		case T_DateVal2: if (TypedSigView<SDateVal2>::matches(gsv)) return f(TypedSigView<SDateVal2>(gsv)); break;
+		case T_DateShort2: if (TypedSigView<SDateShort2>::matches(gsv)) return f(TypedSigView<SDateShort2>(gsv)); break;
+		case T_ValShort4: if (TypedSigView<SValShort4>::matches(gsv)) return f(TypedSigView<SValShort4>(gsv)); break;
+		case T_DateFloat2: if (TypedSigView<SDateFloat2>::matches(gsv)) return f(TypedSigView<SDateFloat2>(gsv)); break;
+		default: break;
+		}
+	}
+	return f(gsv);
+}
+
 #endif
@@ -10,6 +10,15 @@
 #define _FILE_OFFSET_BITS 64
 #include <cstdio>
 #include <boost/filesystem.hpp>
+#include <omp.h>
+#include <numeric>
+#if !defined (_MSC_VER) && !defined (_WIN32)
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define LOCAL_SECTION LOG_INFRA
 #define LOCAL_LEVEL	LOG_DEF_LEVEL
@@ -228,3 +237,261 @@ int write_bin_file_IM(string &fname, unsigned char* data, unsigned long long siz
 
 	return 0;
 }
+
+//-----------------------------------------------------------------------------
+// mmap helpers
+// the mapping is read only and private, hence pages are shared through the page cache
+// between all processes mapping the same file
+//-----------------------------------------------------------------------------
+#if defined (_MSC_VER) || defined (_WIN32)
+int mmap_bin_file_IM(const string &fname, unsigned char* &data, unsigned long long &size)
+{
+	MERR("mmap_bin_file_IM(): memory mapped files are not supported on this platform (%s)\n", fname.c_str());
+	data = NULL;
+	size = 0;
+	return -1;
+}
+
+int munmap_bin_file_IM(unsigned char *data, unsigned long long size) { return -1; }
+
+int madvise_IM(unsigned char *data, unsigned long long size, int advice) { return 0; }
+
+#else
+int mmap_bin_file_IM(const string &fname, unsigned char* &data, unsigned long long &size)
+{
+	data = NULL;
+	size = 0;
+
+	int fd = open(fname.c_str(), O_RDONLY);
+	if (fd < 0) {
+		MERR("mmap_bin_file_IM(): can't open file %s for read\n%s\n", fname.c_str(), strerror(errno));
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		MERR("mmap_bin_file_IM(): can't stat file %s\n%s\n", fname.c_str(), strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	size = (unsigned long long)st.st_size;
+	if (size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // mapping stays valid after closing the descriptor
+	if (p == MAP_FAILED) {
+		MERR("mmap_bin_file_IM(): can't map file %s (%llu bytes)\n%s\n", fname.c_str(), size, strerror(errno));
+		size = 0;
+		return -1;
+	}
+
+	data = (unsigned char *)p;
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+int munmap_bin_file_IM(unsigned char *data, unsigned long long size)
+{
+	if (data == NULL || size == 0)
+		return 0;
+	return munmap((void *)data, size);
+}
+
+//-----------------------------------------------------------------------------
+// advice is given on page aligned boundaries containing [data, data+size)
+int madvise_IM(unsigned char *data, unsigned long long size, int advice)
+{
+	if (data == NULL || size == 0)
+		return 0;
+
+	unsigned long long page = (unsigned long long)sysconf(_SC_PAGESIZE);
+	unsigned long long start = ((unsigned long long)data) & ~(page - 1);
+	unsigned long long len = (unsigned long long)data + size - start;
+
+	int adv = MADV_NORMAL;
+	if (advice == IM_ADVICE_WILLNEED) adv = MADV_WILLNEED;
+	else if (advice == IM_ADVICE_DONTNEED) adv = MADV_DONTNEED;
+	else if (advice == IM_ADVICE_RANDOM) adv = MADV_RANDOM;
+
+	return madvise((void *)start, len, adv);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// coalesced ranges reading
+//-----------------------------------------------------------------------------
+#if defined (_MSC_VER) || defined (_WIN32)
+// no pread: each request opens its own stream (as in read_bin_file_IM_parallel)
+static int open_ranges_file(const string &fname) { return file_exists_IM(fname) ? 0 : -1; }
+static void close_ranges_file(int fd) {}
+static int read_at_IM(const string &fname, int fd, unsigned char *buf, unsigned long long pos, unsigned long long len)
+{
+	FILE *inf = fopen(fname.c_str(), "rb");
+	if (inf == NULL)
+		return -1;
+	int rc = 0;
+	if (_fseeki64(inf, pos, SEEK_SET) != 0 || fread(buf, 1, len, inf) != len)
+		rc = -1;
+	fclose(inf);
+	return rc;
+}
+#else
+static int open_ranges_file(const string &fname) { return open(fname.c_str(), O_RDONLY); }
+static void close_ranges_file(int fd) { close(fd); }
+static int read_at_IM(const string &fname, int fd, unsigned char *buf, unsigned long long pos, unsigned long long len)
+{
+	while (len > 0) {
+		ssize_t n = pread(fd, buf, len, (off_t)pos);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n; pos += n; len -= n;
+	}
+	return 0;
+}
+
+// scatter read of [pos, pos+len) into iov: bytes land directly in their destinations, gaps go to a scratch buffer
+static int read_scatter_IM(int fd, vector<struct iovec> &iov, unsigned long long pos, unsigned long long len)
+{
+	size_t first = 0;
+	while (len > 0 && first < iov.size()) {
+		int cnt = (int)min(iov.size() - first, (size_t)IOV_MAX);
+		ssize_t n = preadv(fd, &iov[first], cnt, (off_t)pos);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		pos += n; len -= n;
+		// skip fully read entries, advance a partially read one
+		while (n > 0 && first < iov.size()) {
+			if ((size_t)n >= iov[first].iov_len) {
+				n -= iov[first].iov_len;
+				first++;
+			}
+			else {
+				iov[first].iov_base = (unsigned char *)iov[first].iov_base + n;
+				iov[first].iov_len -= n;
+				n = 0;
+			}
+		}
+	}
+	return len == 0 ? 0 : -1;
+}
+#define IM_HAS_SCATTER_READ
+#endif
+
+//-----------------------------------------------------------------------------
+int read_ranges_IM(const string &fname, const vector<FileRange_IM> &ranges, unsigned char *out, unsigned long long max_gap,
+	unsigned long long &bytes_read)
+{
+	bytes_read = 0;
+	if (ranges.size() == 0)
+		return 0;
+
+	// destination of each range in out, and the ranges in file order
+	vector<unsigned long long> dst(ranges.size());
+	unsigned long long off = 0;
+	for (size_t i = 0; i < ranges.size(); i++) {
+		dst[i] = off;
+		off += ranges[i].len;
+	}
+	vector<int> order(ranges.size());
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [&](int a, int b) { return ranges[a].pos < ranges[b].pos; });
+
+	// requests: order[from..to) covering the file bytes [start, end)
+	struct ReadReq { int from, to; unsigned long long start, end; };
+	vector<ReadReq> reqs;
+	for (int k = 0; k < (int)order.size(); k++) {
+		const FileRange_IM &r = ranges[order[k]];
+		if (r.len == 0)
+			continue;
+		if (reqs.size() > 0 && r.pos <= reqs.back().end + max_gap &&
+			max(reqs.back().end, r.pos + r.len) - reqs.back().start <= IM_MAX_READ_CHUNK) {
+			reqs.back().to = k + 1;
+			reqs.back().end = max(reqs.back().end, r.pos + r.len);
+		}
+		else
+			reqs.push_back({ k, k + 1, r.pos, r.pos + r.len });
+	}
+
+	int fd = open_ranges_file(fname);
+	if (fd < 0) {
+		MERR("read_ranges_IM(): can't open file %s for read\n%s\n", fname.c_str(), strerror(errno));
+		return -1;
+	}
+
+	int nerr = 0;
+	auto read_req = [&](const ReadReq &q) {
+		int rc = 0;
+		if (q.to - q.from == 1)
+			rc = read_at_IM(fname, fd, out + dst[order[q.from]], q.start, q.end - q.start);
+		else {
+#ifdef IM_HAS_SCATTER_READ
+			// ranges that do not overlap are read straight into out, gap bytes go to a scratch buffer
+			bool disjoint = true;
+			for (int k = q.from + 1; k < q.to && disjoint; k++)
+				if (ranges[order[k]].pos < ranges[order[k - 1]].pos + ranges[order[k - 1]].len)
+					disjoint = false;
+			if (disjoint) {
+				vector<unsigned char> gap_buf(max_gap);
+				vector<struct iovec> iov;
+				unsigned long long cur = q.start;
+				for (int k = q.from; k < q.to; k++) {
+					const FileRange_IM &r = ranges[order[k]];
+					if (r.len == 0)
+						continue;
+					if (r.pos > cur)
+						iov.push_back({ gap_buf.data(), (size_t)(r.pos - cur) });
+					iov.push_back({ out + dst[order[k]], (size_t)r.len });
+					cur = r.pos + r.len;
+				}
+				rc = read_scatter_IM(fd, iov, q.start, q.end - q.start);
+			}
+			else
+#endif
+			{
+				vector<unsigned char> buf(q.end - q.start);
+				rc = read_at_IM(fname, fd, buf.data(), q.start, q.end - q.start);
+				for (int k = q.from; k < q.to && rc == 0; k++)
+					if (ranges[order[k]].len > 0)
+						memcpy(out + dst[order[k]], buf.data() + (ranges[order[k]].pos - q.start), ranges[order[k]].len);
+			}
+		}
+		if (rc < 0) {
+#pragma omp critical
+			nerr++;
+		}
+	};
+
+#if defined(_OPENMP) && _OPENMP >= 201511
+	if (omp_in_parallel()) {
+		// called from a parallel region (loading several signals): requests become tasks, so threads that are
+		// done with their own signals help with the requests of the others
+#pragma omp taskloop grainsize(1)
+		for (int i = 0; i < (int)reqs.size(); i++)
+			read_req(reqs[i]);
+	}
+	else
+#endif
+	{
+#pragma omp parallel for schedule(dynamic) if (reqs.size() > 1)
+		for (int i = 0; i < (int)reqs.size(); i++)
+			read_req(reqs[i]);
+	}
+	close_ranges_file(fd);
+
+	for (auto &q : reqs)
+		bytes_read += q.end - q.start;
+
+	if (nerr > 0) {
+		MERR("read_ranges_IM(): failed %d of %d reads from %s\n", nerr, (int)reqs.size(), fname.c_str());
+		return -1;
+	}
+	return 0;
+}
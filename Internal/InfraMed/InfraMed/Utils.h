@@ -25,6 +25,28 @@ int read_bin_file_IM(string &fname, unsigned char* &data, unsigned long long &si
 int read_bin_file_IM_parallel(string &fname, unsigned char* &data, unsigned long long &size);
 int write_bin_file_IM(string &fname, unsigned char* data, unsigned long long size);
 
+// read only memory mapping of a whole file (used by the repository mmap load mode)
+// advice options for madvise_IM
+#define IM_ADVICE_NORMAL	0
+#define IM_ADVICE_WILLNEED	1
+#define IM_ADVICE_DONTNEED	2
+#define IM_ADVICE_RANDOM	3
+int mmap_bin_file_IM(const string &fname, unsigned char* &data, unsigned long long &size);
+int munmap_bin_file_IM(unsigned char *data, unsigned long long size);
+int madvise_IM(unsigned char *data, unsigned long long size, int advice);
+
+// coalesced reading of many ranges of one file (used by partial loads).
+// ranges are planned in file order, ranges separated by up to max_gap bytes are read as one request (the gap is
+// read and dropped, up to IM_MAX_READ_CHUNK bytes per request), and requests are issued in parallel.
+// out receives the ranges one after the other in the given order. bytes_read returns what was actually read from the file.
+#define IM_MAX_READ_CHUNK	(16*1024*1024)
+struct FileRange_IM {
+	unsigned long long pos;
+	unsigned long long len;
+};
+int read_ranges_IM(const string &fname, const vector<FileRange_IM> &ranges, unsigned char *out, unsigned long long max_gap,
+	unsigned long long &bytes_read);
+
 // forced to keep a copy of these inside in order NOT to depend on external libraries
 // for now assuming an int is enough
 // All will be computed from 1/1/1900
@@ -329,10 +329,11 @@ int MedPredictor::learn(vector<float> &x, vector<float> &y, const vector<float>
 
 //.......................................................................................
 int MedPredictor::predict(MedMat<float> &x, vector<float> &preds) const {
+	int x_nftrs = x.transposed_flag ? x.nrows : x.ncols;
 	if (!model_features.empty()) {//test names of entered matrix:
-		if (model_features.size() != x.ncols)
+		if (model_features.size() != x_nftrs)
 			MTHROW_AND_ERR("(1) Learned Feature model size was %d, request feature size for predict was %d\n",
-			(int)model_features.size(), (int)x.ncols);
+			(int)model_features.size(), x_nftrs);
 
 		if (!x.signals.empty()) //can compare names
 			for (int feat_num = 0; feat_num < model_features.size(); ++feat_num)
@@ -340,9 +341,9 @@ int MedPredictor::predict(MedMat<float> &x, vector<float> &preds) const {
 					MTHROW_AND_ERR("Learned Features are the same. feat_num=%d. in learning was %s, now recieved %s\n",
 					(int)model_features.size(), model_features[feat_num].c_str(), x.signals[feat_num].c_str());
 	}
-	else if (features_count > 0 && features_count != x.ncols)
+	else if (features_count > 0 && features_count != x_nftrs)
 		MTHROW_AND_ERR("(2) Learned Feature model size was %d, request feature size for predict was %d\n",
-			features_count, (int)x.ncols);
+			features_count, x_nftrs);
 
 	int nsamples, nftrs;
 	vector<float> w;
@@ -811,9 +812,13 @@ int MedPredictor::predict(MedFeatures& ftrs_data) const {
 		smp_cnt = (int)ftrs_data.data.begin()->second.size();
 
 	if (smp_cnt <= samples_in_bucket) {
-		// Build X
+		// Build X - in the layout the predictor works on, so prepare_x_mat does not transpose it again
 		MedMat<float> x;
-		ftrs_data.get_as_matrix(x);
+		vector<string> dummy_names;
+		if (transpose_for_predict)
+			ftrs_data.get_as_feature_major_matrix(x, dummy_names);
+		else
+			ftrs_data.get_as_matrix(x);
 
 		// Predict
 		vector<float> preds;
@@ -822,7 +827,7 @@ int MedPredictor::predict(MedFeatures& ftrs_data) const {
 
 		int n = n_preds_per_sample();
 		ftrs_data.samples.resize(preds.size() / n);
-		for (int i = 0; i < x.nrows; i++) {
+		for (int i = 0; i < (int)(preds.size() / n); i++) {
 			ftrs_data.samples[i].prediction.resize(n);
 			for (int j = 0; j < n; j++)
 				ftrs_data.samples[i].prediction[j] = preds[i*n + j];
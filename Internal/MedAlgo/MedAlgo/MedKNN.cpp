@@ -3,6 +3,9 @@
 #include <MedAlgo/MedAlgo/MedAlgo.h>
 #include <MedAlgo/MedAlgo/MedLM.h>
 #include <MedAlgo/MedAlgo/MedKNN.h>
+#include <queue>
+#include <random>
+#include <climits>
 
 #define LOCAL_SECTION LOG_MEDALGO
 #define LOCAL_LEVEL	LOG_DEF_LEVEL
@@ -47,6 +50,7 @@ int MedKNN::init(void *_in_params) {
 	assert(in_params.k > 0);
 	assert(in_params.knnAv >= 0 && in_params.knnAv < KNN_AVG_LAST);
 	x.clear(); y.clear(); w.clear();
+	index = MedKNNIndex();
 	nftrs = nsamples = 0;
 	transpose_for_learn = false;
 	transpose_for_predict = false;
@@ -65,6 +69,11 @@ int MedKNN::set_params(map<string, string>& mapper) {
 		if (field == "k") params.k = stoi(entry.second);
 		else if (field == "knnAv") params.knnAv = get_knn_averaging(entry.second);
 		else if (field == "knnMetr") params.knnMetr = get_knn_metric(entry.second);
+		else if (field == "knnIndex") params.knnIndex = get_knn_index(entry.second);
+		else if (field == "leaf_size") params.leaf_size = stoi(entry.second);
+		else if (field == "hnsw_m") params.hnsw_m = stoi(entry.second);
+		else if (field == "hnsw_ef_construction") params.hnsw_ef_construction = stoi(entry.second);
+		else if (field == "hnsw_ef") params.hnsw_ef = stoi(entry.second);
 		else MLOG("Unknonw parameter \'%s\' for Lasso\n", field.c_str());
 		//! [MedKNN::init]
 	}
@@ -95,6 +104,26 @@ knnMetric MedKNN::get_knn_metric(string name) {
 		return KNN_METRIC_LAST;
 }
 
+knnIndexType MedKNN::get_knn_index(string name) {
+
+	boost::algorithm::to_lower(name);
+	if (name == "brute")
+		return KNN_INDEX_BRUTE;
+	else if (name == "kdtree")
+		return KNN_INDEX_KDTREE;
+	else if (name == "hnsw")
+		return KNN_INDEX_HNSW;
+	else
+		MTHROW_AND_ERR("MedKNN: Unknown index type \'%s\'\n", name.c_str());
+}
+
+
+template <class T> void clear_mem(T *&order) {
+	if (order != NULL) {
+		free(order);
+		order = NULL;
+	}
+}
 
 int MedKNN::Learn(float *_x, float *_y, const float *_w, int _nsamples, int _nftrs) {
 	nsamples = _nsamples;
@@ -105,21 +134,26 @@ int MedKNN::Learn(float *_x, float *_y, const float *_w, int _nsamples, int _nft
 		w = vector<float>(_w, _w + nsamples);
 	else
 		w.resize(nsamples, 1.0);
+
+	// Index
+	index = MedKNNIndex();
+	if (params.knnIndex != KNN_INDEX_BRUTE) {
+		vector<int> order(nftrs);
+		if (order_ftrs(x.data(), nsamples, nftrs, w.data(), order.data()) == -1)
+			return -1;
+		if (index.build(params.knnIndex, x.data(), nsamples, nftrs, order.data(), w.data(), params) < 0)
+			return -1;
+	}
 	
 	return(0);
 }
 
-//prototypes for the working functions
-int order_ftrs(const float *x, int nsamples, int nftrs, const float *weights, int *order);
-int knn_predict(const float *test_x, int ind, const float *learn_x, const float *learn_y, int nlearn, int nftrs, const float *weights, int *order, int *nbrs, double *dists, int k,
-	knnAveraging knnAv, knnMetric knnMetr, float *nbrs_x, float *nbrs_y, float *nbrs_w, float *nbrs_b, float *nbrs_r, float *pred);
+// Predict a single instance using KNN
+#define NRAND 500
 
-template <class T> void clear_mem(T *&order) {
-	if (order != NULL) {
-		free(order);
-		order = NULL;
-	}
-}
+int knn_predict(const float *test_x, int ind, const float *learn_x, const float *learn_y, int nlearn, int nftrs, const float *weights, int *order, int *nbrs, double *dists, int k,
+	knnAveraging knnAv, knnMetric knnMetr, const MedKNNIndex& index, int ef, MedKNNIndex::SearchBuffers& buffers, const vector<int>& rand_rows,
+	float *nbrs_x, float *nbrs_y, float *nbrs_w, float *nbrs_b, float *nbrs_r, float *pred);
 
 int MedKNN::Predict(float *xPred, float *&preds, int pred_samples, int _nftrs) const {
 	assert(preds);
@@ -127,88 +161,53 @@ int MedKNN::Predict(float *xPred, float *&preds, int pred_samples, int _nftrs) c
 
 
 	if ((params.knnAv == KNN_WEIGHTEDLS) && params.k < nftrs) {
-		fprintf(stderr, "k (%d) must be larger than nftrs (%d) in KNN+LS\n", params.k, nftrs);
+		MERR("k (%d) must be larger than nftrs (%d) in KNN+LS\n", params.k, nftrs);
 		return -1;
 	}
 
 	// OK, lets go ...
-	fprintf(stderr, "Running knn : K = %d , Data = (%d + %d) x %d\n", params.k, nsamples, nsamples, nftrs);
-
-	// Allocation
-	int *order = NULL, *nbrs = NULL;
-	double *dists = NULL;
-
-	if ((order = (int *)malloc(nftrs * sizeof(int))) == NULL || (nbrs = (int *)malloc(params.k * sizeof(int))) == NULL ||
-		(dists = (double *)malloc(params.k * sizeof(double))) == NULL) {
-		clear_mem<int>(order);
-		clear_mem<int>(nbrs);
-		clear_mem<double>(dists);
-		fprintf(stderr, "Allocation failed\n");
-		return -1;
-	}
-
-	float *nbrs_x = NULL, *nbrs_y = NULL, *nbrs_w = NULL, *nbrs_b = NULL, *nbrs_r = NULL;
-	if (params.knnAv == KNN_WEIGHTEDLS) {
-		if ((nbrs_x = (float *)malloc(params.k*nftrs * sizeof(float))) == NULL || (nbrs_y = (float *)malloc(params.k * sizeof(float))) == NULL ||
-			(nbrs_w = (float *)malloc(params.k * sizeof(float))) == NULL || (nbrs_b = (float *)malloc(nftrs * sizeof(float))) == NULL ||
-			(nbrs_r = (float *)malloc(nftrs * sizeof(float))) == NULL) {
-			fprintf(stderr, "nbrs data allocation failed\n");
-			clear_mem<int>(order);
-			clear_mem<int>(nbrs);
-			clear_mem<double>(dists);
-			clear_mem<float>(nbrs_x);
-			clear_mem<float>(nbrs_y);
-			clear_mem<float>(nbrs_w);
-			clear_mem<float>(nbrs_b);
-			clear_mem<float>(nbrs_r);
-			return -1;
-		}
-	}
+	MLOG_D("Running knn : K = %d , Data = (%d + %d) x %d , index = %d\n", params.k, nsamples, pred_samples, nftrs, (int)index.type);
 
 	// Order features
-	if (order_ftrs(x.data(), nsamples, nftrs, w.data(), order) == -1) {
-		clear_mem<int>(order);
-		clear_mem<int>(nbrs);
-		clear_mem<double>(dists);
-		clear_mem<float>(nbrs_x);
-		clear_mem<float>(nbrs_y);
-		clear_mem<float>(nbrs_w);
-		clear_mem<float>(nbrs_b);
-		clear_mem<float>(nbrs_r);
+	vector<int> order(nftrs);
+	if (order_ftrs(x.data(), nsamples, nftrs, w.data(), order.data()) == -1)
 		return -1;
-	}
 
-	for (int i = 0; i < pred_samples; i++) {
-		if (i % 1000 == 1)
-			fprintf(stderr, "Predicting %d/%d\n", i, pred_samples);
-		if (knn_predict(xPred, i, x.data(), y.data(), nsamples, nftrs, w.data(), order, nbrs,
-			dists, params.k, params.knnAv, params.knnMetr, nbrs_x, nbrs_y, nbrs_w, nbrs_b, nbrs_r, &(preds[i])) == -1) {
-			fprintf(stderr, "knn prediction failed\n");
-			clear_mem<int>(order);
-			clear_mem<int>(nbrs);
-			clear_mem<double>(dists);
-			clear_mem<float>(nbrs_x);
-			clear_mem<float>(nbrs_y);
-			clear_mem<float>(nbrs_w);
-			clear_mem<float>(nbrs_b);
-			clear_mem<float>(nbrs_r);
-			return -1;
+	// Learning rows for estimating the mean distance, shared by all predictions
+	vector<int> rand_rows(NRAND);
+	for (int &row : rand_rows)
+		row = (int)(nsamples * (rand() / (RAND_MAX + 1.0)));
+
+	int rc = 0;
+#pragma omp parallel
+	{
+		vector<int> nbrs(params.k);
+		vector<double> dists(params.k);
+		vector<float> nbrs_x, nbrs_y, nbrs_w, nbrs_b, nbrs_r;
+		if (params.knnAv == KNN_WEIGHTEDLS) {
+			nbrs_x.resize(params.k*nftrs);
+			nbrs_y.resize(params.k);
+			nbrs_w.resize(params.k);
+			nbrs_b.resize(nftrs);
+			nbrs_r.resize(nftrs);
+		}
+		MedKNNIndex::SearchBuffers buffers;
+
+#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < pred_samples; i++) {
+			if (knn_predict(xPred, i, x.data(), y.data(), nsamples, nftrs, w.data(), order.data(), nbrs.data(), dists.data(), params.k, params.knnAv, params.knnMetr,
+				index, params.hnsw_ef, buffers, rand_rows, nbrs_x.data(), nbrs_y.data(), nbrs_w.data(), nbrs_b.data(), nbrs_r.data(), &(preds[i])) == -1) {
+#pragma omp critical
+				rc = -1;
+			}
 		}
 	}
 
-	free(order);
-	free(dists);
-	free(nbrs);
-
-	if (params.knnAv == KNN_WEIGHTEDLS) {
-		free(nbrs_x);
-		free(nbrs_y);
-		free(nbrs_w);
-		free(nbrs_b);
-		free(nbrs_r);
+	if (rc < 0) {
+		MERR("knn prediction failed\n");
+		return -1;
 	}
 
-
 	return(0);
 }
 
@@ -320,8 +319,27 @@ int order_ftrs(const float *x, int nsamples, int nftrs, const float *weights, in
 	return 0;
 }
 
-void find_nbrs(const float *test_x, int ind, int k, const float *learn_x, int nlearn, int nftrs, int *order, const float *ws, int *nbrs, double *dists, int norm, int test2learn) {
 #define INF_DIST  (99999999.0)
+
+// Keeps row i at distance dist if it is among the k nearest so far (nbrs/dists, the farthest at target_nbr).
+// Ties are broken by row index, so the neighbours do not depend on the order rows are visited in (scan or kd-tree)
+static inline void keep_nbr(int i, double dist, int k, int *nbrs, double *dists, double& target_dist, int& target_nbr) {
+
+	if (!(dist < target_dist || (dist == target_dist && i < nbrs[target_nbr])))
+		return;
+
+	nbrs[target_nbr] = i;
+	dists[target_nbr] = dist;
+
+	// Find new target (most distance current neighbor, the larger row on ties)
+	for (int j = 0; j < k; j++) {
+		if (dists[j] > dists[target_nbr] || (dists[j] == dists[target_nbr] && nbrs[j] > nbrs[target_nbr]))
+			target_nbr = j;
+	}
+	target_dist = dists[target_nbr];
+}
+
+void find_nbrs(const float *test_x, int ind, int k, const float *learn_x, int nlearn, int nftrs, int *order, const float *ws, int *nbrs, double *dists, int norm, int test2learn) {
 	// Initialize with INF
 	for (int i = 0; i < k; i++) {
 		dists[i] = INF_DIST;
@@ -348,33 +366,19 @@ void find_nbrs(const float *test_x, int ind, int k, const float *learn_x, int nl
 			else
 				dist += fabs(d);
 
-			if (dist >= target_dist)
+			if (dist >= target_dist) // rows come in index order, so a tie can't replace the target
 				break;
 		}
 
-		// Replace
-		if (dist < target_dist) {
-			nbrs[target_nbr] = i;
-			target_dist = dists[target_nbr] = dist;
-
-			// Find new target (most distance current neighbor)
-			for (int j = 0; j < k; j++) {
-				if (dists[j] > target_dist) {
-					target_dist = dists[j];
-					target_nbr = j;
-				}
-			}
-		}
+		keep_nbr(i, dist, k, nbrs, dists, target_dist, target_nbr);
 	}
 }
 
-double get_mean_dist(const float *test_x, int ind, const float *learn_x, int nlearn, int nftrs, int nrand, const float *ws, knnMetric knnMetr) {
+double get_mean_dist(const float *test_x, int ind, const float *learn_x, int nftrs, const vector<int>& rand_rows, const float *ws, knnMetric knnMetr) {
 
 	double sum = 0;
 
-	for (int i = 0; i < nrand; i++) {
-		int irand = (int)(nlearn * rand() / (RAND_MAX + 1.0));
-
+	for (int irand : rand_rows) {
 		for (int j = 0; j < nftrs; j++) {
 			double d = ws[j] * (learn_x[XIDX(irand, j, nftrs)] - test_x[XIDX(ind, j, nftrs)]);
 			if (knnMetr == KNN_L2)
@@ -384,7 +388,7 @@ double get_mean_dist(const float *test_x, int ind, const float *learn_x, int nle
 		}
 	}
 
-	return sum / nrand;
+	return sum / rand_rows.size();
 }
 
 void tcalc_xstats(const float *x, const float *w, int nsamples, int nftrs, double *avg, double *std, double missing = -1)
@@ -451,6 +455,7 @@ double tget_corr(const float *x, const float *y, int nsamples, int ind, double m
 	return medial::performance::pearson_corr_without_cleaning(vec1, vec2);
 }
 
+// Unfound neighbours (nbrs == -1, e.g. an HNSW search returning fewer than k) are skipped
 double nbrs_score(const int *nbrs,  double *dists, const float *y, int k, double mean_dist, knnAveraging knnAv) {
 
 	double pred = 0;
@@ -458,7 +463,7 @@ double nbrs_score(const int *nbrs,  double *dists, const float *y, int k, double
 	if (knnAv == KNN_DIST_MEAN) {
 		double sumw = 0;
 		for (int i = 0; i < k; i++) {
-			if (dists[i] != -1) {
+			if (nbrs[i] != -1 && dists[i] != -1) {
 				double w = (dists[i] > mean_dist) ? 0 : (1 - sqrt(dists[i] / mean_dist));
 				pred += y[nbrs[i]] * w;
 				sumw += w;
@@ -595,15 +600,16 @@ int nbrs_ls(const float *testx, int ind, const int *nbrs, const double *dists, c
 	return 0;
 }
 
-// Predict a single instance using KNN
-#define NRAND 500
-
 int knn_predict(const float *test_x, int ind, const float *learn_x, const float *learn_y, int nlearn, int nftrs, const float *weights, int *order, int *nbrs, double *dists, int k,
-	knnAveraging knnAv, knnMetric knnMetr, float *nbrs_x, float *nbrs_y, float *nbrs_w, float *nbrs_b, float *nbrs_r, float *pred) {
+	knnAveraging knnAv, knnMetric knnMetr, const MedKNNIndex& index, int ef, MedKNNIndex::SearchBuffers& buffers, const vector<int>& rand_rows,
+	float *nbrs_x, float *nbrs_y, float *nbrs_w, float *nbrs_b, float *nbrs_r, float *pred) {
 
 
-	find_nbrs(test_x, ind, k, learn_x, nlearn, nftrs, order, weights, nbrs, dists, knnMetr, -1);
-	double mean = get_mean_dist(test_x, ind, learn_x, nlearn, nftrs, NRAND, weights, knnMetr);
+	if (index.type != KNN_INDEX_BRUTE)
+		index.search(test_x, ind, learn_x, nftrs, k, ef, buffers, nbrs, dists);
+	else
+		find_nbrs(test_x, ind, k, learn_x, nlearn, nftrs, order, weights, nbrs, dists, knnMetr, -1);
+	double mean = (knnAv == KNN_1_DIST) ? 0 : get_mean_dist(test_x, ind, learn_x, nftrs, rand_rows, weights, knnMetr);
 
 	if (knnAv == KNN_DIST_MEAN || knnAv == KNN_1_DIST) {
 		*pred = (float)nbrs_score(nbrs, dists, learn_y, k, mean, knnAv);
@@ -616,3 +622,346 @@ int knn_predict(const float *test_x, int ind, const float *learn_x, const float
 		return -1;
 }
 
+
+//======================================================================================
+// MedKNNIndex
+//======================================================================================
+#define KD_PRUNE_SLACK (1.0 - 1e-6) ///< keep pruning conservative against rounding of the bound
+
+int MedKNNIndex::build(knnIndexType _type, const float *x, int nsamples, int nftrs, const int *_order, const float *_weights, const MedKNNParams& params) {
+
+	type = _type;
+	norm = (int)params.knnMetr;
+
+	// Features used, as in find_nbrs
+	order.clear();
+	weights.clear();
+	for (int j = 0; j < nftrs; j++) {
+		if (_weights[_order[j]] == 0)
+			break;
+		order.push_back(_order[j]);
+		weights.push_back(_weights[_order[j]]);
+	}
+
+	if (type == KNN_INDEX_KDTREE) {
+		kd_rows.resize(nsamples);
+		for (int i = 0; i < nsamples; i++)
+			kd_rows[i] = i;
+		kd_dim.clear(); kd_left.clear(); kd_right.clear(); kd_begin.clear(); kd_end.clear(); kd_split.clear();
+		kd_build(x, nftrs, 0, nsamples, max(params.leaf_size, 1));
+		MLOG_D("MedKNNIndex: built kd-tree with %d nodes on %d x %d\n", (int)kd_dim.size(), nsamples, (int)order.size());
+	}
+	else if (type == KNN_INDEX_HNSW) {
+		if (params.hnsw_m < 2) {
+			MERR("MedKNNIndex: hnsw_m should be at least 2 (got %d)\n", params.hnsw_m);
+			return -1;
+		}
+		prepare(x, nsamples, nftrs);
+
+		int m = params.hnsw_m;
+		int ef_construction = max(params.hnsw_ef_construction, m);
+
+		// Levels
+		mt19937 gen(12345);
+		uniform_real_distribution<double> unif(0.0, 1.0);
+		double ml = 1.0 / log((double)m);
+		hnsw_level.resize(nsamples);
+		hnsw_first.resize(nsamples);
+		hnsw_links.clear();
+		for (int i = 0; i < nsamples; i++) {
+			hnsw_level[i] = (int)(-log(1.0 - unif(gen)) * ml);
+			hnsw_first[i] = (int)hnsw_links.size();
+			hnsw_links.resize(hnsw_links.size() + hnsw_level[i] + 1);
+		}
+
+		// Insert
+		hnsw_entry = hnsw_max_level = -1;
+		SearchBuffers buffers;
+		vector<pair<float, int>> cands;
+		for (int i = 0; i < nsamples; i++) {
+			const float *q = hnsw_row(i);
+			int level = hnsw_level[i];
+			if (hnsw_entry < 0) {
+				hnsw_entry = i;
+				hnsw_max_level = level;
+				continue;
+			}
+
+			int ep = hnsw_entry;
+			for (int lc = hnsw_max_level; lc > level; lc--)
+				ep = hnsw_greedy(q, ep, lc);
+
+			for (int lc = min(level, hnsw_max_level); lc >= 0; lc--) {
+				hnsw_search_layer(q, ep, ef_construction, lc, buffers, cands);
+
+				// Select diverse neighbours : a candidate is taken if closer to the node than to those already taken
+				vector<int>& my_links = links(i, lc);
+				for (size_t j = 0; j < cands.size() && my_links.size() < m; j++) {
+					bool take = true;
+					for (int other : my_links)
+						if (hnsw_dist(hnsw_row(cands[j].second), hnsw_row(other)) < cands[j].first) {
+							take = false;
+							break;
+						}
+					if (take)
+						my_links.push_back(cands[j].second);
+				}
+
+				// Link back, keeping the closest
+				size_t max_links = (lc == 0) ? 2 * m : m;
+				for (int nbr : my_links) {
+					vector<int>& nbr_links = links(nbr, lc);
+					nbr_links.push_back(i);
+					if (nbr_links.size() > max_links) {
+						vector<pair<float, int>> by_dist;
+						for (int other : nbr_links)
+							by_dist.push_back({ hnsw_dist(hnsw_row(nbr), hnsw_row(other)), other });
+						sort(by_dist.begin(), by_dist.end());
+						for (size_t j = 0; j < max_links; j++)
+							nbr_links[j] = by_dist[j].second;
+						nbr_links.resize(max_links);
+					}
+				}
+
+				ep = cands[0].second;
+			}
+
+			if (level > hnsw_max_level) {
+				hnsw_entry = i;
+				hnsw_max_level = level;
+			}
+		}
+		MLOG_D("MedKNNIndex: built hnsw graph on %d x %d with %d levels\n", nsamples, nact, hnsw_max_level + 1);
+	}
+	else {
+		MERR("MedKNNIndex: unknown index type %d\n", (int)type);
+		return -1;
+	}
+
+	return 0;
+}
+
+// Weighted rows over the used features (hnsw)
+void MedKNNIndex::prepare(const float *x, int nsamples, int nftrs) {
+
+	nact = (int)order.size();
+	hnsw_x.clear();
+	if (type != KNN_INDEX_HNSW)
+		return;
+
+	hnsw_x.resize((size_t)nsamples * nact);
+	for (int i = 0; i < nsamples; i++)
+		for (int j = 0; j < nact; j++)
+			hnsw_x[(size_t)i * nact + j] = weights[j] * x[XIDX(i, order[j], nftrs)];
+}
+
+// kd-tree node on kd_rows[begin..end) : split at the median of the feature with the widest weighted spread
+int MedKNNIndex::kd_build(const float *x, int nftrs, int begin, int end, int leaf_size) {
+
+	int node = (int)kd_dim.size();
+	kd_dim.push_back(-1);
+	kd_split.push_back(0);
+	kd_left.push_back(-1);
+	kd_right.push_back(-1);
+	kd_begin.push_back(begin);
+	kd_end.push_back(end);
+
+	if (end - begin <= leaf_size)
+		return node;
+
+	int best = -1;
+	float best_spread = 0;
+	for (int j = 0; j < order.size(); j++) {
+		float vmin = x[XIDX(kd_rows[begin], order[j], nftrs)], vmax = vmin;
+		for (int r = begin + 1; r < end; r++) {
+			float val = x[XIDX(kd_rows[r], order[j], nftrs)];
+			if (val < vmin) vmin = val;
+			else if (val > vmax) vmax = val;
+		}
+		float spread = fabs(weights[j]) * (vmax - vmin);
+		if (spread > best_spread) {
+			best_spread = spread;
+			best = j;
+		}
+	}
+	if (best < 0) // identical rows
+		return node;
+
+	int ftr = order[best];
+	int mid = (begin + end) / 2;
+	nth_element(kd_rows.begin() + begin, kd_rows.begin() + mid, kd_rows.begin() + end,
+		[&](int a, int b) { return x[XIDX(a, ftr, nftrs)] < x[XIDX(b, ftr, nftrs)]; });
+
+	kd_dim[node] = best;
+	kd_split[node] = x[XIDX(kd_rows[mid], ftr, nftrs)];
+	int left = kd_build(x, nftrs, begin, mid, leaf_size);
+	int right = kd_build(x, nftrs, mid, end, leaf_size);
+	kd_left[node] = left;
+	kd_right[node] = right;
+
+	return node;
+}
+
+// Exact search : rows are scored and kept exactly as in find_nbrs (ties by row index); subtrees are skipped when the
+// bound on their distance (rd, made of the per-feature offsets in off) cannot reach the current k-th neighbour
+void MedKNNIndex::kd_search(int node, const float *x, int nftrs, const float *q, double rd, vector<double>& off, int k, int *nbrs, double *dists,
+	double& target_dist, int& target_nbr) const {
+
+	if (kd_dim[node] < 0) {
+		for (int r = kd_begin[node]; r < kd_end[node]; r++) {
+			int i = kd_rows[r];
+
+			double dist = 0;
+			for (int j = 0; j < order.size(); j++) {
+				double d = weights[j] * (x[XIDX(i, order[j], nftrs)] - q[order[j]]);
+				if (norm == 2)
+					dist += d * d;
+				else
+					dist += fabs(d);
+
+				if (dist > target_dist) // equal distances go on, a smaller row wins the tie
+					break;
+			}
+
+			keep_nbr(i, dist, k, nbrs, dists, target_dist, target_nbr);
+		}
+		return;
+	}
+
+	int j = kd_dim[node];
+	float diff = q[order[j]] - kd_split[node];
+	int near_node = (diff < 0) ? kd_left[node] : kd_right[node];
+	int far_node = (diff < 0) ? kd_right[node] : kd_left[node];
+
+	kd_search(near_node, x, nftrs, q, rd, off, k, nbrs, dists, target_dist, target_nbr);
+
+	double d = weights[j] * diff;
+	double new_off = (norm == 2) ? d * d : fabs(d);
+	double far_rd = rd - off[j] + new_off;
+	if (far_rd * KD_PRUNE_SLACK < target_dist) {
+		double prev_off = off[j];
+		off[j] = new_off;
+		kd_search(far_node, x, nftrs, q, far_rd, off, k, nbrs, dists, target_dist, target_nbr);
+		off[j] = prev_off;
+	}
+}
+
+// Distance between weighted rows (hnsw), written for vectorization
+float MedKNNIndex::hnsw_dist(const float *a, const float *b) const {
+
+	float dist = 0;
+	if (norm == 2) {
+#pragma omp simd reduction(+:dist)
+		for (int j = 0; j < nact; j++) {
+			float d = a[j] - b[j];
+			dist += d * d;
+		}
+	}
+	else {
+#pragma omp simd reduction(+:dist)
+		for (int j = 0; j < nact; j++)
+			dist += fabs(a[j] - b[j]);
+	}
+	return dist;
+}
+
+// Greedy walk to the closest node at a given level
+int MedKNNIndex::hnsw_greedy(const float *q, int ep, int level) const {
+
+	float dist = hnsw_dist(q, hnsw_row(ep));
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int nbr : links(ep, level)) {
+			float nbr_dist = hnsw_dist(q, hnsw_row(nbr));
+			if (nbr_dist < dist) {
+				dist = nbr_dist;
+				ep = nbr;
+				changed = true;
+			}
+		}
+	}
+	return ep;
+}
+
+// Best-first search at a given level, keeping the ef closest nodes. res is sorted by distance
+void MedKNNIndex::hnsw_search_layer(const float *q, int ep, int ef, int level, SearchBuffers& buffers, vector<pair<float, int>>& res) const {
+
+	// Visited marks, reset by advancing the tag
+	if (buffers.visited.size() != hnsw_level.size() || buffers.visit_tag == INT_MAX) {
+		buffers.visited.assign(hnsw_level.size(), 0);
+		buffers.visit_tag = 0;
+	}
+	int tag = ++buffers.visit_tag;
+
+	priority_queue<pair<float, int>, vector<pair<float, int>>, greater<pair<float, int>>> cands;
+	priority_queue<pair<float, int>> best;
+
+	float dist = hnsw_dist(q, hnsw_row(ep));
+	cands.push({ dist, ep });
+	best.push({ dist, ep });
+	buffers.visited[ep] = tag;
+
+	while (!cands.empty()) {
+		pair<float, int> curr = cands.top();
+		if (curr.first > best.top().first)
+			break;
+		cands.pop();
+
+		for (int nbr : links(curr.second, level)) {
+			if (buffers.visited[nbr] == tag)
+				continue;
+			buffers.visited[nbr] = tag;
+
+			float nbr_dist = hnsw_dist(q, hnsw_row(nbr));
+			if (best.size() < ef || nbr_dist < best.top().first) {
+				cands.push({ nbr_dist, nbr });
+				best.push({ nbr_dist, nbr });
+				if (best.size() > ef)
+					best.pop();
+			}
+		}
+	}
+
+	res.resize(best.size());
+	for (int i = (int)best.size() - 1; i >= 0; i--) {
+		res[i] = best.top();
+		best.pop();
+	}
+}
+
+// k nearest neighbours of row ind of test_x. Unfound neighbours are marked -1, as in find_nbrs
+void MedKNNIndex::search(const float *test_x, int ind, const float *x, int nftrs, int k, int ef, SearchBuffers& buffers, int *nbrs, double *dists) const {
+
+	for (int i = 0; i < k; i++) {
+		dists[i] = INF_DIST;
+		nbrs[i] = -1;
+	}
+
+	const float *q = &test_x[XIDX(ind, 0, nftrs)];
+	if (type == KNN_INDEX_KDTREE) {
+		if (kd_dim.empty())
+			return;
+		buffers.off.assign(order.size(), 0.0);
+		double target_dist = INF_DIST;
+		int target_nbr = 0;
+		kd_search(0, x, nftrs, q, 0.0, buffers.off, k, nbrs, dists, target_dist, target_nbr);
+	}
+	else if (type == KNN_INDEX_HNSW) {
+		if (hnsw_entry < 0)
+			return;
+		buffers.qw.resize(nact);
+		for (int j = 0; j < nact; j++)
+			buffers.qw[j] = weights[j] * q[order[j]];
+
+		int ep = hnsw_entry;
+		for (int lc = hnsw_max_level; lc > 0; lc--)
+			ep = hnsw_greedy(buffers.qw.data(), ep, lc);
+		hnsw_search_layer(buffers.qw.data(), ep, max(ef, k), 0, buffers, buffers.res);
+
+		for (int i = 0; i < k && i < buffers.res.size(); i++) {
+			nbrs[i] = buffers.res[i].second;
+			dists[i] = buffers.res[i].first;
+		}
+	}
+}
@@ -18,14 +18,82 @@ typedef enum {
 	KNN_METRIC_LAST
 }knnMetric;
 
+typedef enum {
+	KNN_INDEX_BRUTE, ///< "brute" : scan all learning rows
+	KNN_INDEX_KDTREE, ///< "kdtree" : exact search on a kd-tree (same neighbours as "brute"), best for low dimension
+	KNN_INDEX_HNSW, ///< "hnsw" : approximate search on a hierarchical navigable small world graph, for high dimension
+	KNN_INDEX_LAST
+} knnIndexType;
+
 struct MedKNNParams : public SerializableObject {
 
 	int k;
 	knnAveraging knnAv;
 	knnMetric knnMetr;
 
+	knnIndexType knnIndex = KNN_INDEX_KDTREE; ///< index built at learning
+	int leaf_size = 16; ///< kdtree : maximal number of rows in a leaf
+	int hnsw_m = 16; ///< hnsw : number of links per node (twice that at the bottom level)
+	int hnsw_ef_construction = 100; ///< hnsw : size of candidates list when building
+	int hnsw_ef = 64; ///< hnsw : size of candidates list when searching (at least k)
+
 	ADD_CLASS_NAME(MedKNNParams)
-		ADD_SERIALIZATION_FUNCS(k, knnAv, knnMetr)
+		ADD_SERIALIZATION_FUNCS(k, knnAv, knnMetr, knnIndex, leaf_size, hnsw_m, hnsw_ef_construction, hnsw_ef)
+};
+
+/// Nearest neighbours index over the learning rows of MedKNN.
+/// Distances are as in the brute-force search : weighted, over the features in order of weight*std up to the first zero weight
+class MedKNNIndex : public SerializableObject {
+public:
+	knnIndexType type = KNN_INDEX_BRUTE; ///< KNN_INDEX_BRUTE means no index
+	vector<int> order; ///< features used, in order
+	vector<float> weights; ///< weights of features in order
+	int norm = 0; ///< metric, as given to the brute-force search
+
+	// kd-tree
+	vector<int> kd_rows; ///< learning rows, arranged by nodes
+	vector<int> kd_dim, kd_left, kd_right, kd_begin, kd_end; ///< nodes (kd_dim = -1 for leaves), rows are kd_rows[kd_begin..kd_end)
+	vector<float> kd_split;
+
+	// hnsw
+	vector<int> hnsw_level; ///< top level of each node
+	vector<int> hnsw_first; ///< position of the level-0 links of each node in hnsw_links, followed by the higher levels
+	vector<vector<int>> hnsw_links;
+	int hnsw_entry = -1;
+	int hnsw_max_level = -1;
+
+	/// Per thread search buffers
+	struct SearchBuffers {
+		vector<double> off;
+		vector<float> qw;
+		vector<int> visited;
+		int visit_tag = 0;
+		vector<pair<float, int>> res;
+	};
+
+	/// <summary> build index of the given type. order/weights are the features order and (per feature) weights of the brute-force search </summary>
+	int build(knnIndexType _type, const float *x, int nsamples, int nftrs, const int *_order, const float *_weights, const MedKNNParams& params);
+	/// <summary> prepare search data (not serialized) from the learning rows </summary>
+	void prepare(const float *x, int nsamples, int nftrs);
+	/// <summary> find k nearest neighbours of row ind of test_x. nbrs/dists as in the brute-force search </summary>
+	void search(const float *test_x, int ind, const float *x, int nftrs, int k, int ef, SearchBuffers& buffers, int *nbrs, double *dists) const;
+
+	ADD_CLASS_NAME(MedKNNIndex)
+		ADD_SERIALIZATION_FUNCS(type, order, weights, norm, kd_rows, kd_dim, kd_left, kd_right, kd_begin, kd_end, kd_split, hnsw_level, hnsw_first, hnsw_links, hnsw_entry, hnsw_max_level)
+
+private:
+	vector<float> hnsw_x; ///< weighted learning rows over the features in order, contiguous for vectorized distances
+	int nact = 0;
+
+	int kd_build(const float *x, int nftrs, int begin, int end, int leaf_size);
+	void kd_search(int node, const float *x, int nftrs, const float *q, double rd, vector<double>& off, int k, int *nbrs, double *dists,
+		double& target_dist, int& target_nbr) const;
+	float hnsw_dist(const float *a, const float *b) const;
+	const float *hnsw_row(int node) const { return &hnsw_x[(size_t)node * nact]; }
+	vector<int>& links(int node, int level) { return hnsw_links[hnsw_first[node] + level]; }
+	const vector<int>& links(int node, int level) const { return hnsw_links[hnsw_first[node] + level]; }
+	int hnsw_greedy(const float *q, int ep, int level) const;
+	void hnsw_search_layer(const float *q, int ep, int ef, int level, SearchBuffers& buffers, vector<pair<float, int>>& res) const;
 };
 
 class MedKNN : public MedPredictor {
@@ -36,6 +104,7 @@ public:
 	vector<float> x;
 	vector<float> y;
 	vector<float> w;
+	MedKNNIndex index;
 
 
 	// Parameters
@@ -52,13 +121,23 @@ public:
 	int init(void *params);
 	knnAveraging get_knn_averaging(string name);
 	knnMetric get_knn_metric(string name);
+	knnIndexType get_knn_index(string name);
 
 	int Learn(float *x, float *y, const float *w, int nsamples, int nftrs);
 	int Predict(float *x, float *&preds, int nsamples, int nftrs) const;
 
+	void post_deserialization() { index.prepare(x.data(), nsamples, nftrs); }
+
 	ADD_CLASS_NAME(MedKNN)
-		ADD_SERIALIZATION_FUNCS(classifier_type, params, nsamples, nftrs, x, y, w)
+		ADD_SERIALIZATION_FUNCS(classifier_type, params, nsamples, nftrs, x, y, w, index)
 };
 
+/// brute-force search of the k nearest learning rows of row ind of test_x (skipping row test2learn), ties by row index.
+/// MedKNNIndex kd-tree searches return the same neighbours
+void find_nbrs(const float *test_x, int ind, int k, const float *learn_x, int nlearn, int nftrs, int *order, const float *ws, int *nbrs, double *dists, int norm, int test2learn);
+/// features order of find_nbrs : by weight * std
+int order_ftrs(const float *x, int nsamples, int nftrs, const float *weights, int *order);
+
 MEDSERIALIZE_SUPPORT(MedKNNParams)
+MEDSERIALIZE_SUPPORT(MedKNNIndex)
 MEDSERIALIZE_SUPPORT(MedKNN)
@@ -1658,6 +1658,377 @@ void dense_tree_shap(const TreeEnsemble& trees, const ExplanationDataset &data,
 	}
 }
 
+//----------------------------------------------------------------------------------------------------------------
+// Batched Tree SHAP
+//----------------------------------------------------------------------------------------------------------------
+
+// weights w_i * (one_i - zero_i) of all slots of a leaf path, skipping slot skip (-1 for none)
+inline void leaf_path_weights(const tfloat *zero, const unsigned char *one, unsigned depth, int skip,
+	PathElement *path, tfloat *weights) {
+	unsigned d = 0;
+	extend_path(path, 0, 1, 1, -1);
+	for (unsigned s = 0; s < depth; ++s) {
+		if ((int)s == skip) continue;
+		++d;
+		extend_path(path, d, zero[s], one[s], (int)s);
+	}
+	for (unsigned i = 1; i <= d; ++i)
+		weights[path[i].feature_index] = unwound_path_sum(path, d, i) * (path[i].one_fraction - path[i].zero_fraction);
+	if (skip >= 0)
+		weights[skip] = 0;
+}
+
+bool TreeShapPathTables::supports_interactions() const {
+	if (num_exp != feature_sets.size())
+		return false;
+	for (unsigned j = 0; j < feature_sets.size(); j++)
+		if (feature_sets[j] != j)
+			return false;
+	return true;
+}
+
+void TreeShapPathTables::clear() {
+	tree_leaves.clear();
+	leaves.clear();
+	tree_splits.clear();
+	split_nodes.clear();
+	step_node.clear();
+	step_child.clear();
+	step_slot.clear();
+	slot_set.clear();
+	slot_zero.clear();
+	tables.clear();
+	feature_sets.clear();
+	num_exp = 0;
+	max_path_depth = 0;
+}
+
+bool TreeShapPathTables::matches(const unsigned *feature_sets_in, unsigned M, unsigned num_Exp) const {
+	if (empty() || num_exp != num_Exp || feature_sets.size() != M)
+		return false;
+	return equal(feature_sets.begin(), feature_sets.end(), feature_sets_in);
+}
+
+void TreeShapPathTables::build(const TreeEnsemble &trees, const unsigned *feature_sets_in, unsigned M, unsigned num_Exp,
+	size_t max_table_entries) {
+	clear();
+	feature_sets.assign(feature_sets_in, feature_sets_in + M);
+	num_exp = num_Exp;
+	tree_leaves.resize(trees.tree_limit + 1);
+	tree_splits.resize(trees.tree_limit + 1);
+
+	vector<int> path_nodes, path_children;
+	vector<int> stack_node, stack_parent;
+	vector<unsigned> stack_depth;
+	vector<int> cur_sets; // sets on the current path, in the order the recursive algorithm keeps them
+	vector<tfloat> cur_zero;
+	TreeEnsemble tree;
+	for (unsigned t = 0; t < trees.tree_limit; ++t) {
+		trees.get_tree(tree, t);
+		tree_leaves[t] = (unsigned)leaves.size();
+		tree_splits[t] = (unsigned)split_nodes.size();
+
+		stack_node.assign(1, 0);
+		stack_parent.assign(1, -1);
+		stack_depth.assign(1, 0);
+		while (!stack_node.empty()) {
+			int node = stack_node.back(), parent = stack_parent.back();
+			unsigned depth = stack_depth.back();
+			stack_node.pop_back(); stack_parent.pop_back(); stack_depth.pop_back();
+
+			if (depth > 0) {
+				path_nodes.resize(depth);
+				path_children.resize(depth);
+				path_nodes[depth - 1] = parent;
+				path_children[depth - 1] = node;
+			}
+
+			if (tree.children_right[node] >= 0) {
+				split_nodes.push_back(node);
+				stack_node.push_back(tree.children_right[node]); stack_parent.push_back(node); stack_depth.push_back(depth + 1);
+				stack_node.push_back(tree.children_left[node]); stack_parent.push_back(node); stack_depth.push_back(depth + 1);
+				continue;
+			}
+
+			// leaf - merge the path into slots. a repeated set moves to the end with the product of the zero fractions
+			cur_sets.clear();
+			cur_zero.clear();
+			for (unsigned k = 0; k < depth; ++k) {
+				int set = (int)feature_sets[tree.features[path_nodes[k]]];
+				tfloat zero = tree.node_sample_weights[path_children[k]] / tree.node_sample_weights[path_nodes[k]];
+				for (size_t p = 0; p < cur_sets.size(); ++p) {
+					if (cur_sets[p] == set) {
+						zero *= cur_zero[p];
+						cur_sets.erase(cur_sets.begin() + p);
+						cur_zero.erase(cur_zero.begin() + p);
+						break;
+					}
+				}
+				cur_sets.push_back(set);
+				cur_zero.push_back(zero);
+			}
+
+			TreeShapLeafPath lp;
+			lp.leaf = (unsigned)node;
+			lp.depth = (unsigned)cur_sets.size();
+			lp.steps_start = (unsigned)step_node.size();
+			lp.n_steps = depth;
+			lp.slots_start = (unsigned)slot_set.size();
+			lp.table_start = -1;
+			for (unsigned k = 0; k < depth; ++k) {
+				int set = (int)feature_sets[tree.features[path_nodes[k]]];
+				step_node.push_back(path_nodes[k]);
+				step_child.push_back(path_children[k]);
+				step_slot.push_back((unsigned)(find(cur_sets.begin(), cur_sets.end(), set) - cur_sets.begin()));
+			}
+			slot_set.insert(slot_set.end(), cur_sets.begin(), cur_sets.end());
+			slot_zero.insert(slot_zero.end(), cur_zero.begin(), cur_zero.end());
+			max_path_depth = max(max_path_depth, lp.depth);
+			leaves.push_back(lp);
+		}
+	}
+	tree_leaves[trees.tree_limit] = (unsigned)leaves.size();
+	tree_splits[trees.tree_limit] = (unsigned)split_nodes.size();
+
+	// tables for the shortest paths first, as long as they fit the budget
+	vector<unsigned> order(leaves.size());
+	for (unsigned i = 0; i < order.size(); ++i) order[i] = i;
+	stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return leaves[a].depth < leaves[b].depth; });
+	vector<unsigned> with_table;
+	size_t n_entries = 0;
+	for (unsigned i : order) {
+		unsigned d = leaves[i].depth;
+		if (d > TREE_SHAP_TABLE_MAX_DEPTH || n_entries + ((size_t)d << d) > max_table_entries)
+			break;
+		leaves[i].table_start = (long long)n_entries;
+		n_entries += (size_t)d << d;
+		with_table.push_back(i);
+	}
+	tables.resize(n_entries);
+
+#pragma omp parallel
+	{
+		vector<PathElement> path(max_path_depth + 2);
+		vector<unsigned char> one(max_path_depth);
+#pragma omp for schedule(dynamic)
+		for (int i = 0; i < (int)with_table.size(); ++i) {
+			const TreeShapLeafPath &lp = leaves[with_table[i]];
+			for (unsigned mask = 0; mask < (1U << lp.depth); ++mask) {
+				for (unsigned s = 0; s < lp.depth; ++s)
+					one[s] = (mask >> s) & 1;
+				leaf_path_weights(&slot_zero[lp.slots_start], one.data(), lp.depth, -1, path.data(),
+					&tables[lp.table_start + (size_t)mask * lp.depth]);
+			}
+		}
+	}
+}
+
+// per thread buffers of the batched explain
+struct TreeShapScratch {
+	vector<int> hot;
+	vector<unsigned char> one;
+	vector<tfloat> weights;
+	vector<PathElement> path;
+
+	TreeShapScratch(const TreeEnsemble &trees, unsigned max_path_depth) :
+		hot(trees.max_nodes), one(max_path_depth + 1), weights(max_path_depth + 1), path(max_path_depth + 2) {}
+};
+
+// child each split node of tree t sends the sample to
+inline void tree_shap_hot_children(const TreeShapPathTables &tbl, const TreeEnsemble &tree, unsigned t,
+	const tfloat *x, const bool *x_missing, int *hot) {
+	for (unsigned k = tbl.tree_splits[t]; k < tbl.tree_splits[t + 1]; ++k) {
+		int node = tbl.split_nodes[k];
+		int f = tree.features[node];
+		if (x_missing[f])
+			hot[node] = tree.children_default[node];
+		else
+			hot[node] = (x[f] <= tree.thresholds[node]) ? tree.children_left[node] : tree.children_right[node];
+	}
+}
+
+// slot weights of a leaf for the sample, from its table or computed
+inline const tfloat *tree_shap_leaf_weights(const TreeShapPathTables &tbl, const TreeShapLeafPath &lp, TreeShapScratch &sc) {
+	unsigned mask = (1U << min(lp.depth, 31U)) - 1;
+	for (unsigned s = 0; s < lp.depth; ++s)
+		sc.one[s] = 1;
+	for (unsigned k = lp.steps_start; k < lp.steps_start + lp.n_steps; ++k) {
+		if (sc.hot[tbl.step_node[k]] != tbl.step_child[k]) {
+			sc.one[tbl.step_slot[k]] = 0;
+			mask &= ~(1U << tbl.step_slot[k]);
+		}
+	}
+	if (lp.table_start >= 0)
+		return &tbl.tables[lp.table_start + (size_t)mask * lp.depth];
+	leaf_path_weights(&tbl.slot_zero[lp.slots_start], sc.one.data(), lp.depth, -1, sc.path.data(), sc.weights.data());
+	return sc.weights.data();
+}
+
+void TreeShapPathTables::explain(const TreeEnsemble &trees, const ExplanationDataset &data, tfloat *out_contribs) const {
+	const unsigned num_outputs = trees.num_outputs;
+	const unsigned row_size = (num_exp + 1) * num_outputs;
+	const int n_blocks = (data.num_X + TREE_SHAP_BLOCK_SIZE - 1) / TREE_SHAP_BLOCK_SIZE;
+
+	MedProgress progress("TREE_SHAPLEY", n_blocks, 15, 50);
+#pragma omp parallel
+	{
+		TreeShapScratch sc(trees, max_path_depth);
+		TreeEnsemble tree;
+#pragma omp for schedule(dynamic)
+		for (int b = 0; b < n_blocks; ++b) {
+			unsigned from = b * TREE_SHAP_BLOCK_SIZE, to = min(data.num_X, from + TREE_SHAP_BLOCK_SIZE);
+
+			// aggregate the effect of explaining each tree, for all samples in the block
+			for (unsigned t = 0; t < trees.tree_limit; ++t) {
+				trees.get_tree(tree, t);
+				for (unsigned i = from; i < to; ++i) {
+					tfloat *phi = out_contribs + (size_t)i * row_size;
+					tree_shap_hot_children(*this, tree, t, data.X + (size_t)i * data.M, data.X_missing + (size_t)i * data.M, sc.hot.data());
+					for (unsigned j = 0; j < num_outputs; ++j)
+						phi[num_exp * num_outputs + j] += tree.values[j];
+
+					for (unsigned l = tree_leaves[t]; l < tree_leaves[t + 1]; ++l) {
+						const TreeShapLeafPath &lp = leaves[l];
+						const tfloat *w = tree_shap_leaf_weights(*this, lp, sc);
+						const tfloat *v = tree.values + lp.leaf * num_outputs;
+						for (unsigned s = 0; s < lp.depth; ++s) {
+							tfloat *phi_s = phi + slot_set[lp.slots_start + s] * num_outputs;
+							for (unsigned j = 0; j < num_outputs; ++j)
+								phi_s[j] += w[s] * v[j];
+						}
+					}
+				}
+			}
+
+			// apply the base offset to the bias term
+			for (unsigned i = from; i < to; ++i)
+				for (unsigned j = 0; j < num_outputs; ++j)
+					out_contribs[(size_t)i * row_size + num_exp * num_outputs + j] += trees.base_offset;
+
+			progress.update();
+		}
+	}
+}
+
+void TreeShapPathTables::explain_interactions(const TreeEnsemble &trees, const ExplanationDataset &data, tfloat *out_contribs) const {
+	const unsigned num_outputs = trees.num_outputs;
+	const unsigned M = data.M;
+	const unsigned contrib_row_size = (M + 1) * num_outputs;
+	const int n_blocks = (data.num_X + TREE_SHAP_BLOCK_SIZE - 1) / TREE_SHAP_BLOCK_SIZE;
+	if (!supports_interactions())
+		MTHROW_AND_ERR("Error in TreeShapPathTables::explain_interactions - sets are not supported\n");
+
+	MedProgress progress("TREE_SHAPLEY_INTERACTIONS", n_blocks, 15, 50);
+#pragma omp parallel
+	{
+		TreeShapScratch sc(trees, max_path_depth);
+		vector<tfloat> cond_weights(max_path_depth + 1);
+		vector<tfloat> diag_contribs((size_t)TREE_SHAP_BLOCK_SIZE * contrib_row_size);
+		TreeEnsemble tree;
+#pragma omp for schedule(dynamic)
+		for (int b = 0; b < n_blocks; ++b) {
+			unsigned from = b * TREE_SHAP_BLOCK_SIZE, to = min(data.num_X, from + TREE_SHAP_BLOCK_SIZE);
+			fill(diag_contribs.begin(), diag_contribs.end(), (tfloat)0);
+
+			for (unsigned t = 0; t < trees.tree_limit; ++t) {
+				trees.get_tree(tree, t);
+				for (unsigned i = from; i < to; ++i) {
+					tfloat *instance_out_contribs = out_contribs + (size_t)i * (M + 1) * contrib_row_size;
+					tfloat *diag = &diag_contribs[(size_t)(i - from) * contrib_row_size];
+					tree_shap_hot_children(*this, tree, t, data.X + (size_t)i * M, data.X_missing + (size_t)i * M, sc.hot.data());
+					for (unsigned j = 0; j < num_outputs; ++j)
+						diag[M * num_outputs + j] += tree.values[j];
+
+					for (unsigned l = tree_leaves[t]; l < tree_leaves[t + 1]; ++l) {
+						const TreeShapLeafPath &lp = leaves[l];
+						const tfloat *w = tree_shap_leaf_weights(*this, lp, sc);
+						const tfloat *v = tree.values + lp.leaf * num_outputs;
+						const int *sets = &slot_set[lp.slots_start];
+						const tfloat *zero = &slot_zero[lp.slots_start];
+						for (unsigned s = 0; s < lp.depth; ++s)
+							for (unsigned j = 0; j < num_outputs; ++j)
+								diag[sets[s] * num_outputs + j] += w[s] * v[j];
+
+						// holding slot s on and off: (on - off) / 2 = (one_s - zero_s) / 2 * contributions of the path without s
+						for (unsigned s = 0; lp.depth > 1 && s < lp.depth; ++s) {
+							leaf_path_weights(zero, sc.one.data(), lp.depth, (int)s, sc.path.data(), cond_weights.data());
+							const tfloat factor = (sc.one[s] - zero[s]) / 2;
+							tfloat *out_s = instance_out_contribs + sets[s] * contrib_row_size;
+							for (unsigned k = 0; k < lp.depth; ++k) {
+								if (k == s) continue;
+								for (unsigned j = 0; j < num_outputs; ++j) {
+									const tfloat val = factor * cond_weights[k] * v[j];
+									out_s[sets[k] * num_outputs + j] += val;
+									diag[sets[k] * num_outputs + j] -= val;
+								}
+							}
+						}
+					}
+				}
+			}
+
+			for (unsigned i = from; i < to; ++i) {
+				tfloat *instance_out_contribs = out_contribs + (size_t)i * (M + 1) * contrib_row_size;
+				const tfloat *diag = &diag_contribs[(size_t)(i - from) * contrib_row_size];
+
+				// set the diagonal
+				for (unsigned j = 0; j < M + 1; ++j) {
+					const unsigned offset = j * contrib_row_size + j * num_outputs;
+					for (unsigned k = 0; k < num_outputs; ++k)
+						instance_out_contribs[offset + k] = diag[j * num_outputs + k];
+				}
+
+				// apply the base offset to the bias term
+				const unsigned last_ind = (M * (M + 1) + M) * num_outputs;
+				for (unsigned j = 0; j < num_outputs; ++j)
+					instance_out_contribs[last_ind + j] += trees.base_offset;
+			}
+
+			progress.update();
+		}
+	}
+}
+
+void batched_tree_shap(const TreeEnsemble& trees, const ExplanationDataset &data, const TreeShapPathTables &tables,
+	unsigned *feature_sets, bool interactions, tfloat *out_contribs) {
+	if (!interactions)
+		tables.explain(trees, data, out_contribs);
+	else if (tables.supports_interactions())
+		tables.explain_interactions(trees, data, out_contribs);
+	else
+		dense_tree_shap(trees, data, out_contribs, FEATURE_DEPENDENCE::tree_path_dependent, MODEL_TRANSFORM::identity, interactions, feature_sets);
+}
+
+tfloat benchmark_tree_shap(const TreeEnsemble& trees, const ExplanationDataset &data, unsigned *feature_sets, bool interactions,
+	size_t max_table_entries) {
+	size_t out_size = interactions ? (size_t)data.num_X * (data.M + 1) * (data.M + 1) * trees.num_outputs :
+		(size_t)data.num_X * (data.num_Exp + 1) * trees.num_outputs;
+	vector<tfloat> orig_res(out_size, 0), batched_res(out_size, 0);
+
+	MedTimer tm_orig, tm_build, tm_batched;
+	tm_orig.start();
+	dense_tree_shap(trees, data, orig_res.data(), FEATURE_DEPENDENCE::tree_path_dependent, MODEL_TRANSFORM::identity, interactions, feature_sets);
+	tm_orig.take_curr_time();
+
+	TreeShapPathTables tables;
+	tm_build.start();
+	tables.build(trees, feature_sets, data.M, data.num_Exp, max_table_entries);
+	tm_build.take_curr_time();
+	tm_batched.start();
+	batched_tree_shap(trees, data, tables, feature_sets, interactions, batched_res.data());
+	tm_batched.take_curr_time();
+
+	tfloat max_diff = 0;
+	for (size_t i = 0; i < out_size; ++i)
+		max_diff = max(max_diff, (tfloat)abs(orig_res[i] - batched_res[i]));
+
+	MLOG("benchmark_tree_shap: %u samples, %u trees, %zu leaves (%zu table entries)%s: recursive %2.3f sec, batched %2.3f sec (+ %2.3f sec build), max abs diff %g\n",
+		data.num_X, trees.tree_limit, tables.leaves.size(), tables.tables.size(), interactions ? ", interactions" : "",
+		tm_orig.diff_sec(), tm_batched.diff_sec(), tm_build.diff_sec(), (double)max_diff);
+
+	return max_diff;
+}
+
 void get_weights(const TreeEnsemble& tree, int node_index, unsigned *sets) {
 
 	if (tree.children_right[node_index] >= 0) {
@@ -179,6 +179,73 @@ void dense_tree_shap(const TreeEnsemble& trees, const ExplanationDataset &data,
 void dense_tree_shap(const TreeEnsemble& trees, const ExplanationDataset &data, tfloat *out_contribs,
 	const int feature_dependence, unsigned model_transform, bool interactions, unsigned *feature_sets);
 
+#define TREE_SHAP_TABLE_MAX_DEPTH 12 ///< leaves with longer paths (in unique sets) compute their weights per sample
+#define TREE_SHAP_MAX_TABLE_ENTRIES (1 << 22) ///< default memory budget (in tfloat entries) of the precomputed weights
+#define TREE_SHAP_BLOCK_SIZE 64 ///< samples explained together in each pass over the trees
+
+/**
+* Root path of a single leaf, with repeated splits on the same feature set merged into one slot
+*/
+struct TreeShapLeafPath {
+	unsigned leaf; ///< leaf node index within its tree
+	unsigned depth; ///< number of slots (unique feature sets) on the path
+	unsigned steps_start; ///< first split of the path in TreeShapPathTables::step_*
+	unsigned n_steps; ///< number of splits on the path
+	unsigned slots_start; ///< first slot of the path in TreeShapPathTables::slot_*
+	long long table_start; ///< first entry in TreeShapPathTables::tables, -1 if weights are computed per sample
+};
+
+/**
+* Batched Tree SHAP with tree path dependence ("Fast TreeSHAP" style).
+* The leaf paths of all trees are collected once. A sample only decides, per leaf, which slots it follows,
+* and for short paths the Shapley weights of every on/off pattern are precomputed so applying a leaf is a lookup.
+* Samples are explained in blocks, tree by tree, with per-thread scratch buffers.
+*/
+class TreeShapPathTables {
+public:
+	vector<unsigned> tree_leaves; ///< first leaf of each tree in leaves (size: trees + 1)
+	vector<TreeShapLeafPath> leaves;
+	vector<unsigned> tree_splits; ///< first split node of each tree in split_nodes (size: trees + 1)
+	vector<int> split_nodes; ///< all internal nodes of each tree
+	vector<int> step_node; ///< split node on a leaf path
+	vector<int> step_child; ///< child taken towards the leaf
+	vector<unsigned> step_slot; ///< slot of the split within its leaf path
+	vector<int> slot_set; ///< feature set of each slot
+	vector<tfloat> slot_zero; ///< zero fraction of each slot (product of cover ratios along the path)
+	vector<tfloat> tables; ///< per leaf with table: depth weights for each of the 2^depth on/off patterns
+	vector<unsigned> feature_sets; ///< feature sets the paths were built with
+	unsigned num_exp = 0; ///< number of explanation sets
+	unsigned max_path_depth = 0; ///< longest leaf path (in slots)
+
+	/// builds leaf paths of all trees and the weight tables of the shortest paths within max_table_entries
+	void build(const TreeEnsemble &trees, const unsigned *feature_sets, unsigned M, unsigned num_Exp, size_t max_table_entries = TREE_SHAP_MAX_TABLE_ENTRIES);
+	/// true if built with the same feature sets
+	bool matches(const unsigned *feature_sets, unsigned M, unsigned num_Exp) const;
+	/// true if built without grouping (each feature is its own set), as explain_interactions requires
+	bool supports_interactions() const;
+	bool empty() const { return tree_leaves.empty(); }
+	void clear();
+
+	/// same output as dense_tree_path_dependent (out_contribs: num_X x (num_Exp + 1) x num_outputs)
+	void explain(const TreeEnsemble &trees, const ExplanationDataset &data, tfloat *out_contribs) const;
+	/// same output as dense_tree_interactions_path_dependent (out_contribs: num_X x (M + 1) x (M + 1) x num_outputs). sets are not supported
+	void explain_interactions(const TreeEnsemble &trees, const ExplanationDataset &data, tfloat *out_contribs) const;
+};
+
+/**
+* Tree path dependent Tree SHAP (identity transform) with the batched tables, falling back to dense_tree_shap
+* for interactions of grouped feature sets, which the tables do not support
+*/
+void batched_tree_shap(const TreeEnsemble& trees, const ExplanationDataset &data, const TreeShapPathTables &tables,
+	unsigned *feature_sets, bool interactions, tfloat *out_contribs);
+
+/**
+* Runs the recursive and the batched tree path dependent Tree SHAP on the same data.
+* Prints run times and returns the maximal absolute difference between the two outputs
+*/
+tfloat benchmark_tree_shap(const TreeEnsemble& trees, const ExplanationDataset &data, unsigned *feature_sets, bool interactions,
+	size_t max_table_entries = TREE_SHAP_MAX_TABLE_ENTRIES);
+
 /**
 * Iterative calling to Shapley
 */
@@ -820,6 +820,12 @@ int EmbedMatCreator::get_sparse_mat(MedPidRepository &rep, vector<pair<int, int>
 
 	int n = 0;
 
+	vector<int> embed_sids;
+	for (auto &es : embed_sigs)
+		if (es.type != ECTYPE_DUMMY && es.type != ECTYPE_MODEL)
+			embed_sids.push_back(es.sid);
+	MedRepositoryPins pins(rep, embed_sids);
+
 #pragma omp parallel for
 	for (int i = 0; i < pids_times.size(); i++) {
 
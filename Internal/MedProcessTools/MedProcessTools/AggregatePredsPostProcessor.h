@@ -44,6 +44,7 @@ public:
 	void Apply(MedFeatures &matrix); 
 
 	void init_post_processor(MedModel& model);
+	bool apply_keeps_state() const { return true; }
 
 	void dprint(const string &pref) const;
 
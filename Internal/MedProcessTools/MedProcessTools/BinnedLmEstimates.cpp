@@ -206,6 +206,7 @@ int BinnedLmEstimates::_learn(MedPidRepository& rep, const MedSamples& samples,
 	vector<float> values;
 	vector<int> ages, times, genders;
 	vector<int> id_firsts(nids), id_lasts(nids);
+	MedRepositoryPins pins(rep, { signalId, genderId, bdateId });
 
 #pragma omp parallel for
 	for (int i = 0; i < nids; i++) {
@@ -598,13 +599,13 @@ int BinnedLmEstimates::_generate(PidDynamicRec& rec, MedFeatures& features, int
 //.......................................................................................
 void BinnedLmEstimates::get_p_data(MedFeatures &features, vector<float *> &_p_data) {
 
-	p_data.clear();
+	_p_data.clear();
 
 	if (iGenerateWeights) {
 		if (names.size() != 1)
 			MTHROW_AND_ERR("Cannot generate weights using a multi-feature generator (type %d generates %d features)\n", generator_type, (int)names.size())
 		else
-			_p_data[0] = &(features.weights[0]);
+			_p_data.push_back(&(features.weights[0]));
 	}
 	else {
 		for (unsigned int ipoint = 0; ipoint < params.estimation_points.size(); ipoint++)
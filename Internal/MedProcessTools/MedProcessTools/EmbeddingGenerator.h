@@ -49,6 +49,8 @@ public:
 
 	// preparing a batch result of model results if an internal MedModel generator is used
 	void prepare(MedFeatures & features, MedPidRepository& rep, MedSamples& samples);
+	/// the batches prepared by prepare() are kept in the generator
+	bool apply_keeps_state() const { return true; }
 
 	// Learn a generator
 	int _learn(MedPidRepository& rep, const MedSamples& samples, vector<RepProcessor *> processors);
@@ -1380,6 +1380,12 @@ void TreeExplainer::_init(map<string, string> &mapper) {
 			missing_value = med_stof(it->second);
 		else if (it->first == "verbose")
 			verbose = stoi(it->second) > 0;
+		else if (it->first == "batched_shap")
+			batched_shap = stoi(it->second) > 0;
+		else if (it->first == "shap_table_entries")
+			shap_table_entries = med_stoi(it->second);
+		else if (it->first == "benchmark_shap")
+			benchmark_shap = stoi(it->second) > 0;
 		else
 			MTHROW_AND_ERR("Error in TreeExplainer::init - Unsupported parameter \"%s\"\n", it->first.c_str());
 	}
@@ -1394,11 +1400,38 @@ void TreeExplainer::post_deserialization() {
 			if (approximate)
 				static_cast<MedXGB *>(original_predictor)->feat_contrib_flags |= APPROX_CONTRIBS;
 		}
-		try_convert_trees();
+		if (try_convert_trees())
+			prepare_shap_tables();
 	}
 
 }
 
+void TreeExplainer::prepare_shap_tables() {
+	shap_tables.clear();
+	if (!batched_shap || approximate || processing.iterative || !generic_tree_model.is_allocate || processing.group2Inds.empty())
+		return;
+
+	// same feature sets as in explain (checked there again)
+	int M = 0;
+	for (const vector<int> &grp : processing.group2Inds)
+		M += (int)grp.size();
+	int num_Exp = M;
+	vector<unsigned> feature_sets(M);
+	if (processing.group_by_sum) {
+		for (int i = 0; i < M; i++)
+			feature_sets[i] = i;
+	}
+	else {
+		num_Exp = (int)processing.group2Inds.size();
+		for (int i = 0; i < num_Exp; i++)
+			for (int j : processing.group2Inds[i])
+				if (j < M)
+					feature_sets[j] = i;
+	}
+
+	shap_tables.build(generic_tree_model, feature_sets.data(), M, num_Exp, shap_table_entries);
+}
+
 void TreeExplainer::init_post_processor(MedModel& model) {
 	ModelExplainer::init_post_processor(model);
 	post_deserialization();
@@ -1406,8 +1439,10 @@ void TreeExplainer::init_post_processor(MedModel& model) {
 
 void TreeExplainer::_learn(const MedFeatures &train_mat) {
 
-	if (try_convert_trees())
+	if (try_convert_trees()) {
+		prepare_shap_tables();
 		return; //success in convert to trees
+	}
 
 	// Iterative mode only when working with coverted trees
 	if (processing.iterative || approximate)
@@ -1502,7 +1537,10 @@ void TreeExplainer::explain(const MedFeatures &matrix, vector<map<string, float>
 			num_Exp = (int)processing.group2Inds.size();
 
 		data_set = ExplanationDataset(x.data(), x_missing.get(), y.data(), R_p, R_missing.get(), num_X, M, num_R, num_Exp);
-		shap_res.assign(num_X * (num_Exp + 1)* num_outputs, 0);
+		if (interaction_shap)
+			shap_res.assign((size_t)num_X * (M + 1) * (M + 1) * num_outputs, 0);
+		else
+			shap_res.assign(num_X * (num_Exp + 1)* num_outputs, 0);
 	}
 
 	int tree_dep = FEATURE_DEPENDENCE::tree_path_dependent; //global is not supported in python - so not completed yet. indepent is usefull for complex transform, but can't be run with interaction
@@ -1539,6 +1577,20 @@ void TreeExplainer::explain(const MedFeatures &matrix, vector<map<string, float>
 			if (processing.iterative)
 				iterative_tree_shap(generic_tree_model, data_set, shap_res.data(), tree_dep, tranform,
 					interaction_shap, feature_sets.data(), verbose, names, processing.abs_cov_features, processing.iteration_cnt, processing.use_max_cov);
+			else if (batched_shap) {
+				if (benchmark_shap)
+					benchmark_tree_shap(generic_tree_model, data_set, feature_sets.data(), interaction_shap, shap_table_entries);
+
+				// use the prepared tables, unless features/groups differ from learn
+				TreeShapPathTables local_tables;
+				const TreeShapPathTables *tables = &shap_tables;
+				if (!shap_tables.matches(feature_sets.data(), M, num_Exp)) {
+					local_tables.build(generic_tree_model, feature_sets.data(), M, num_Exp, shap_table_entries);
+					tables = &local_tables;
+				}
+				// interactions of groups fall back to dense_tree_shap
+				batched_tree_shap(generic_tree_model, data_set, *tables, feature_sets.data(), interaction_shap, shap_res.data());
+			}
 			else
 				dense_tree_shap(generic_tree_model, data_set, shap_res.data(), tree_dep, tranform, interaction_shap, feature_sets.data());
 
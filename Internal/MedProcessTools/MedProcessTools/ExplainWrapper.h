@@ -169,6 +169,8 @@ private:
 	bool convert_lightgbm_trees();
 	bool convert_xgb_trees();
 	void _init(map<string, string> &mapper);
+	TreeShapPathTables shap_tables; ///< leaf paths of generic_tree_model for the batched Tree SHAP
+	void prepare_shap_tables();
 public:
 	bool try_convert_trees();
 	TreeEnsemble generic_tree_model;
@@ -178,6 +180,9 @@ public:
 	int approximate = false; ///< if true will run SAABAS alg - which is faster
 	float missing_value = MED_MAT_MISSING_VALUE; ///< missing value
 	bool verbose = false;
+	bool batched_shap = true; ///< If true will explain converted trees with the batched Tree SHAP (same values, faster)
+	int shap_table_entries = TREE_SHAP_MAX_TABLE_ENTRIES; ///< memory budget (in doubles) for the batched Tree SHAP weight tables
+	bool benchmark_shap = false; ///< If true will also run the recursive Tree SHAP and print run times and differences
 
 	TreeExplainer() { processor_type = FTR_POSTPROCESS_TREE_SHAP; }
 
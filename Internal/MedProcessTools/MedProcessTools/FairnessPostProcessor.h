@@ -57,6 +57,7 @@ public:
 	FairnessPostProcessor() { processor_type = PostProcessorTypes::FTR_POSTPROCESS_FAIRNESS; };
 	~FairnessPostProcessor() {};
 	void init_post_processor(MedModel& mdl) { p_rep = mdl.p_rep; }
+	bool apply_keeps_state() const { return true; }
 
 	void parse_constrains(const string &s); ///< parses the constrains
 
@@ -93,7 +93,7 @@ void FeatureGenerator::prepare(MedFeatures &features, MedPidRepository& rep, Med
 //.......................................................................................
 void FeatureGenerator::get_p_data(MedFeatures &features, vector<float *> &_p_data) {
 
-	p_data.clear();
+	_p_data.clear();
 	if (iGenerateWeights)
 		_p_data.push_back(&(features.weights[0]));
 	else {
@@ -211,6 +211,11 @@ int FeatureGenerator::generate(PidDynamicRec& in_rep, MedFeatures& features) {
 	return _generate(in_rep, features, features.get_pid_pos(in_rep.pid), features.get_pid_len(in_rep.pid));
 }
 
+//.......................................................................................
+int FeatureGenerator::generate(PidDynamicRec& in_rep, MedFeatures& features, vector<float *> &_p_data) {
+	return _generate(in_rep, features, features.get_pid_pos(in_rep.pid), features.get_pid_len(in_rep.pid), _p_data);
+}
+
 //.......................................................................................
 // Add uncleaned data at end of feature vector
 int FeatureGenerator::generate(MedPidRepository& rep, int id, MedFeatures& features) {
@@ -512,9 +517,12 @@ int BasicFeatGenerator::_generate(PidDynamicRec& rec, MedFeatures& features, int
 	float *p_feat = _p_data[0] + index;
 	MedSample *p_samples = &(features.samples[index]);
 
+	bool swept = (sweep_min_samples > 0 && num >= sweep_min_samples && supports_sweep() && generate_sweep(rec, features, index, num, p_feat));
+
 	for (int i = 0; i < num; i++) {
-		p_feat[i] = get_value(rec, i, med_time_converter.convert_times(features.time_unit, time_unit_win, p_samples[i].time),
-			med_time_converter.convert_times(features.time_unit, time_unit_sig, p_samples[i].outcomeTime));
+		if (!swept)
+			p_feat[i] = get_value(rec, i, med_time_converter.convert_times(features.time_unit, time_unit_win, p_samples[i].time),
+				med_time_converter.convert_times(features.time_unit, time_unit_sig, p_samples[i].outcomeTime));
 		if (apply_categ_map && (p_feat[i] != missing_val)) p_feat[i] = categ_map[p_feat[i]];
 		if (zero_missing && (p_feat[i] == missing_val)) p_feat[i] = zero_missing_val;
 	}
@@ -602,6 +610,90 @@ void BasicFeatGenerator::get_required_signal_categories(unordered_map<string, ve
 	}
 }
 
+//.......................................................................................
+bool BasicFeatGenerator::supports_sweep() const {
+
+	if (timeRangeSignalName != "")
+		return false;
+
+	switch (type) {
+	case FTR_LAST_VALUE: case FTR_FIRST_VALUE: case FTR_AVG_VALUE: case FTR_MAX_VALUE: case FTR_MIN_VALUE: case FTR_STD_VALUE:
+	case FTR_SUM_VALUE: case FTR_NSAMPLES: case FTR_EXISTS: case FTR_RANGE_WIDTH:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Sweep generation : samples of a pid are given sorted by time. If all of them see the same signal data (no rep processor
+// changed a single version) and their windows move forward, the window is maintained incrementally along the signal.
+// Returns false (without generating anything) otherwise.
+//.......................................................................................
+bool BasicFeatGenerator::generate_sweep(PidDynamicRec& rec, MedFeatures& features, int index, int num, float *p_feat) {
+
+	rec.uget(signalId, 0);
+	UniversalSigVec usv;
+	for (int i = 1; i < num; i++) {
+		rec.uget(signalId, i, usv);
+		if (usv.data != rec.usv.data || usv.len != rec.usv.len)
+			return false;
+	}
+	if (rec.usv.len > 0 && (time_channel >= rec.usv.n_time_channels() || val_channel >= rec.usv.n_val_channels()))
+		return false;
+
+	MedSample *p_samples = &(features.samples[index]);
+	vector<pair<int, int>> windows(num);
+	for (int i = 0; i < num; i++) {
+		int time = med_time_converter.convert_times(features.time_unit, time_unit_win, p_samples[i].time);
+		int outcomeTime = med_time_converter.convert_times(features.time_unit, time_unit_sig, p_samples[i].outcomeTime);
+		get_window_in_sig_time(win_from, win_to, time_unit_win, time_unit_sig, time, windows[i].first, windows[i].second, bound_outcomeTime, outcomeTime);
+		if (i > 0 && (windows[i].first < windows[i - 1].first || windows[i].second < windows[i - 1].second))
+			return false;
+	}
+
+	SigWindowSweep sweep;
+	if (!sweep.init(rec.usv, time_channel, val_channel, min_value, max_value))
+		return false;
+
+	for (int i = 0; i < num; i++) {
+		sweep.advance(windows[i].first, windows[i].second);
+		int nvals = sweep.count();
+
+		float val = missing_val;
+		switch (type) {
+		case FTR_LAST_VALUE:	if (nvals > 0) val = sweep.last(); break;
+		case FTR_FIRST_VALUE:	if (nvals > 0) val = sweep.first(); break;
+		case FTR_AVG_VALUE:		if (nvals > 0) val = (float)(sweep.sum / nvals); break;
+		case FTR_SUM_VALUE:		val = (float)sweep.sum; break;
+		case FTR_NSAMPLES:		val = (float)sweep.n_in_range; break;
+		case FTR_EXISTS:		val = (nvals > 0) ? (float)1.0 : (float)0.0; break;
+		case FTR_STD_VALUE:
+			if (nvals > 1) {
+				double avg = sweep.sum / nvals;
+				double var = sweep.sum_sq / nvals - avg * avg;
+				if (var < 0.0001) var = 0.0001;
+				val = (float)sqrt(var);
+			}
+			break;
+		case FTR_MAX_VALUE: case FTR_MIN_VALUE: case FTR_RANGE_WIDTH:
+			// same missing-value sentinels as the scanning versions
+			if (nvals > 0) {
+				float max_val = std::max((float)-1e10, sweep.max());
+				float min_val = std::min((float)1e20, sweep.min());
+				if (type == FTR_MAX_VALUE) { if (max_val > -1e10) val = max_val; }
+				else if (type == FTR_MIN_VALUE) { if (min_val < (float)1e20) val = min_val; }
+				else if (max_val > -1e10 && min_val < (float)1e20) val = max_val - min_val;
+			}
+			break;
+		default:
+			return false;
+		}
+		p_feat[i] = val;
+	}
+
+	return true;
+}
+
 //.......................................................................................
 float BasicFeatGenerator::get_value(PidDynamicRec& rec, int idx, int time, int outcomeTime) {
 
@@ -616,16 +708,22 @@ float BasicFeatGenerator::get_value(PidDynamicRec& rec, int idx, int time, int o
 			win_from, updated_win_from, win_to, updated_win_to, (type == FTR_WIN_DELTA_VALUE), d_win_from, updated_d_win_from, d_win_to, updated_d_win_to);
 	}
 
+	// window index shared between generators of this pid for the window aggregations it supports
+	SigWindowIndex *widx = NULL;
+	if (win_index_min_samples > 0 && rec.get_n_versions() >= win_index_min_samples &&
+		(type == FTR_AVG_VALUE || type == FTR_MAX_VALUE || type == FTR_MIN_VALUE || type == FTR_STD_VALUE || type == FTR_SUM_VALUE || type == FTR_RANGE_WIDTH))
+		widx = medial::window_index::get(rec, signalId, rec.usv, time_channel, val_channel);
+
 	switch (type) {
 	case FTR_LAST_VALUE:	return uget_last(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_LAST_NTH_VALUE:	return uget_last_nth(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_FIRST_VALUE:	return uget_first(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_LAST2_VALUE:	return uget_last2(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
-	case FTR_AVG_VALUE:		return uget_avg(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
-	case FTR_MAX_VALUE:		return uget_max(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
-	case FTR_MIN_VALUE:		return uget_min(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
-	case FTR_STD_VALUE:		return uget_std(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
-	case FTR_SUM_VALUE:		return uget_sum(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
+	case FTR_AVG_VALUE:		return uget_avg(rec.usv, time, updated_win_from, updated_win_to, outcomeTime, widx);
+	case FTR_MAX_VALUE:		return uget_max(rec.usv, time, updated_win_from, updated_win_to, outcomeTime, widx);
+	case FTR_MIN_VALUE:		return uget_min(rec.usv, time, updated_win_from, updated_win_to, outcomeTime, widx);
+	case FTR_STD_VALUE:		return uget_std(rec.usv, time, updated_win_from, updated_win_to, outcomeTime, widx);
+	case FTR_SUM_VALUE:		return uget_sum(rec.usv, time, updated_win_from, updated_win_to, outcomeTime, widx);
 	case FTR_LAST_DELTA_VALUE:	return uget_last_delta(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_LAST_DAYS:			return uget_last_time(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_LAST2_DAYS:		return uget_last2_time(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
@@ -637,7 +735,7 @@ float BasicFeatGenerator::get_value(PidDynamicRec& rec, int idx, int time, int o
 	case FTR_CATEGORY_SET_SUM:			return uget_category_set_sum(rec, rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_NSAMPLES:			return uget_nsamples(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_EXISTS:			return uget_exists(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
-	case FTR_RANGE_WIDTH:			return uget_range_width(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
+	case FTR_RANGE_WIDTH:			return uget_range_width(rec.usv, time, updated_win_from, updated_win_to, outcomeTime, widx);
 	case FTR_MAX_DIFF:			return uget_max_diff(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_FIRST_DAYS:		return uget_first_time(rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
 	case FTR_CATEGORY_SET_FIRST:		return uget_category_set_first(rec, rec.usv, time, updated_win_from, updated_win_to, outcomeTime);
@@ -681,6 +779,8 @@ int BasicFeatGenerator::init(map<string, string>& mapper) {
 		else if (field == "missing_value") missing_val = stof(entry.second);
 		else if (field == "full_name") full_name = stoi(entry.second);
 		else if (field == "rename_signal") rename_signal = entry.second;
+		else if (field == "sweep_min_samples") sweep_min_samples = med_stoi(entry.second);
+		else if (field == "win_index_min_samples") win_index_min_samples = med_stoi(entry.second);
 		else if (field != "fg_type")
 			MLOG("Unknown parameter \'%s\' for BasicFeatGenerator\n", field.c_str());
 		//! [BasicFeatGenerator::init]
@@ -1204,6 +1304,89 @@ float RangeFeatGenerator::get_value(PidDynamicRec& rec, int idx, int time) {
 // in all following uget funcs the relevant time window is [min_time, max_time] and time is given in time_unit_win
 //................................................................................................................
 
+// Window kernels for the most common uget funcs.
+// These are templated over the signal view, and are called through dispatch_typed_sig_view() so that for the
+// common signal layouts (SDateVal, STimeVal, ...) channel access is resolved at compile time.
+namespace basic_window_kernels {
+
+	template <class SV> float last(const SV &sv, int tchan, int vchan, int min_time, int max_time, float missing)
+	{
+		for (int i = sv.len - 1; i >= 0; i--) {
+			int itime = sv.Time(i, tchan);
+			if (itime <= max_time) {
+				if (itime >= min_time)
+					return sv.Val(i, vchan);
+				else
+					return missing;
+			}
+		}
+		return missing;
+	}
+
+	template <class SV> float first(const SV &sv, int tchan, int vchan, int min_time, int max_time, float missing)
+	{
+		for (int i = 0; i < sv.len; i++) {
+			int itime = sv.Time(i, tchan);
+			if (itime >= min_time) {
+				if (itime > max_time)
+					return missing;
+				else
+					return sv.Val(i, vchan);
+			}
+		}
+		return missing;
+	}
+
+	// sum, sum of squares and count of values in window
+	template <class SV> void moments(const SV &sv, int tchan, int vchan, int min_time, int max_time, double &sum, double &sum_sq, double &nvals)
+	{
+		sum = 0; sum_sq = 0; nvals = 0;
+		for (int i = 0; i < sv.len; i++) {
+			int itime = sv.Time(i, tchan);
+			if (itime > max_time) break;
+			if (itime >= min_time) {
+				float ival = sv.Val(i, vchan);
+				sum += ival;
+				sum_sq += ival * ival;
+				nvals++;
+			}
+		}
+	}
+
+	template <class SV> float max(const SV &sv, int tchan, int vchan, int min_time, int max_time, float init_val)
+	{
+		float max_val = init_val;
+		for (int i = 0; i < sv.len; i++) {
+			int itime = sv.Time(i, tchan);
+			if (itime > max_time) break;
+			if (itime >= min_time && sv.Val(i, vchan) > max_val) max_val = sv.Val(i, vchan);
+		}
+		return max_val;
+	}
+
+	template <class SV> float min(const SV &sv, int tchan, int vchan, int min_time, int max_time, float init_val)
+	{
+		float min_val = init_val;
+		for (int i = 0; i < sv.len; i++) {
+			int itime = sv.Time(i, tchan);
+			if (itime > max_time) break;
+			if (itime >= min_time && sv.Val(i, vchan) < min_val) min_val = sv.Val(i, vchan);
+		}
+		return min_val;
+	}
+
+	template <class SV> float sum(const SV &sv, int tchan, int vchan, int min_time, int max_time)
+	{
+		float sum_val = (float)0;
+		for (int i = sv.len - 1; i >= 0; i--) {
+			int itime = sv.Time(i, tchan);
+			if (itime < min_time) break;
+			if (itime <= max_time) sum_val += sv.Val(i, vchan);
+		}
+		return sum_val;
+	}
+}
+
 // get the last value in the window [win_to, win_from] before time
 float BasicFeatGenerator::uget_last(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime)
 {
@@ -1211,18 +1394,8 @@ float BasicFeatGenerator::uget_last(UniversalSigVec &usv, int time, int _win_fro
 	get_window_in_sig_time(_win_from, _win_to, time_unit_win, time_unit_sig, time, min_time, max_time, bound_outcomeTime, outcomeTime);
 
 	//MLOG("min_time %d max_time %d usv.len %d time %d\n", min_time, max_time, usv.len, time);
-	for (int i = usv.len - 1; i >= 0; i--) {
-		int itime = usv.Time(i, time_channel);
-		//MLOG("%d,%d,%f\n", i, itime, usv.Val(i, val_channel));
-		if (itime <= max_time) {
-			if (itime >= min_time)
-				return usv.Val(i, val_channel);
-			else
-				return missing_val;
-		}
-	}
-
-	return missing_val;
+	return dispatch_typed_sig_view(usv, [&](const auto &sv) {
+		return basic_window_kernels::last(sv, time_channel, val_channel, min_time, max_time, missing_val); });
 }
 
 // get the last nth value in the window [win_to, win_from] before time
@@ -1258,16 +1431,8 @@ float BasicFeatGenerator::uget_first(UniversalSigVec &usv, int time, int _win_fr
 	int min_time, max_time;
 	get_window_in_sig_time(_win_from, _win_to, time_unit_win, time_unit_sig, time, min_time, max_time, bound_outcomeTime, outcomeTime);
 
-	for (int i = 0; i < usv.len; i++) {
-		int itime = usv.Time(i, time_channel);
-		if (itime >= min_time) {
-			if (itime > max_time)
-				return missing_val;
-			else
-				return usv.Val(i, val_channel);
-		}
-	}
-	return missing_val;
+	return dispatch_typed_sig_view(usv, [&](const auto &sv) {
+		return basic_window_kernels::first(sv, time_channel, val_channel, min_time, max_time, missing_val); });
 }
 
 //.......................................................................................
@@ -1291,21 +1456,21 @@ float BasicFeatGenerator::uget_last2(UniversalSigVec &usv, int time, int _win_fr
 
 //.......................................................................................
 // get the average value in the window [win_to, win_from] before time
-float BasicFeatGenerator::uget_avg(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime)
+float BasicFeatGenerator::uget_avg(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx)
 {
 	int min_time, max_time;
 	get_window_in_sig_time(_win_from, _win_to, time_unit_win, time_unit_sig, time, min_time, max_time, bound_outcomeTime, outcomeTime);
 
-	double sum = 0, nvals = 0;
-
-	for (int i = 0; i < usv.len; i++) {
-		int itime = usv.Time(i, time_channel);
-		if (itime > max_time) break;
-		if (itime >= min_time) {
-			sum += usv.Val(i, val_channel);
-			nvals++;
-		}
+	double sum = 0, sum_sq = 0, nvals = 0;
+	if (widx != NULL) {
+		int from, to;
+		widx->bounds(min_time, max_time, usv.len, from, to);
+		sum = widx->sum(from, to);
+		nvals = to - from;
 	}
+	else
+		dispatch_typed_sig_view(usv, [&](const auto &sv) {
+			basic_window_kernels::moments(sv, time_channel, val_channel, min_time, max_time, sum, sum_sq, nvals); });
 
 	if (nvals > 0)
 		return (float)(sum / nvals);
@@ -1315,18 +1480,20 @@ float BasicFeatGenerator::uget_avg(UniversalSigVec &usv, int time, int _win_from
 
 //.......................................................................................
 // get the max value in the window [win_to, win_from] before time
-float BasicFeatGenerator::uget_max(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime)
+float BasicFeatGenerator::uget_max(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx)
 {
 	int min_time, max_time;
 	get_window_in_sig_time(_win_from, _win_to, time_unit_win, time_unit_sig, time, min_time, max_time, bound_outcomeTime, outcomeTime);
 
-	float max_val = -1e10;
-
-	for (int i = 0; i < usv.len; i++) {
-		int itime = usv.Time(i, time_channel);
-		if (itime > max_time) break;
-		if (itime >= min_time && usv.Val(i, val_channel) > max_val)	max_val = usv.Val(i, val_channel);
+	float max_val = (float)-1e10;
+	if (widx != NULL) {
+		int from, to;
+		widx->bounds(min_time, max_time, usv.len, from, to);
+		if (to > from) max_val = std::max(max_val, widx->max(from, to));
 	}
+	else
+		max_val = dispatch_typed_sig_view(usv, [&](const auto &sv) {
+			return basic_window_kernels::max(sv, time_channel, val_channel, min_time, max_time, (float)-1e10); });
 
 	if (max_val > -1e10)
 		return max_val;
@@ -1337,10 +1504,10 @@ float BasicFeatGenerator::uget_max(UniversalSigVec &usv, int time, int _win_from
 
 //.......................................................................................
 // get max_val - min_val in the window
-float BasicFeatGenerator::uget_range_width(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime)
+float BasicFeatGenerator::uget_range_width(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx)
 {
-	float max_val = uget_max(usv, time, _win_from, _win_to, outcomeTime);
-	float min_val = uget_min(usv, time, _win_from, _win_to, outcomeTime);
+	float max_val = uget_max(usv, time, _win_from, _win_to, outcomeTime, widx);
+	float min_val = uget_min(usv, time, _win_from, _win_to, outcomeTime, widx);
 
 	if (max_val == missing_val || min_val == missing_val)
 		return missing_val;
@@ -1350,18 +1517,20 @@ float BasicFeatGenerator::uget_range_width(UniversalSigVec &usv, int time, int _
 
 //.......................................................................................
 // get the min value in the window [win_to, win_from] before time
-float BasicFeatGenerator::uget_min(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime)
+float BasicFeatGenerator::uget_min(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx)
 {
 	int min_time, max_time;
 	get_window_in_sig_time(_win_from, _win_to, time_unit_win, time_unit_sig, time, min_time, max_time, bound_outcomeTime, outcomeTime);
 
 	float min_val = (float)1e20;
-
-	for (int i = 0; i < usv.len; i++) {
-		int itime = usv.Time(i, time_channel);
-		if (itime > max_time) break;
-		if (itime >= min_time && usv.Val(i, val_channel) < min_val) 	min_val = usv.Val(i, val_channel);
+	if (widx != NULL) {
+		int from, to;
+		widx->bounds(min_time, max_time, usv.len, from, to);
+		if (to > from) min_val = std::min(min_val, widx->min(from, to));
 	}
+	else
+		min_val = dispatch_typed_sig_view(usv, [&](const auto &sv) {
+			return basic_window_kernels::min(sv, time_channel, val_channel, min_time, max_time, (float)1e20); });
 
 	if (min_val < (float)1e20)
 		return min_val;
@@ -1372,46 +1541,47 @@ float BasicFeatGenerator::uget_min(UniversalSigVec &usv, int time, int _win_from
 
 //.......................................................................................
 // get the sum of values in the window [win_to, win_from] before time
-float BasicFeatGenerator::uget_sum(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime)
+float BasicFeatGenerator::uget_sum(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx)
 {
 	int min_time, max_time;
 	get_window_in_sig_time(_win_from, _win_to, time_unit_win, time_unit_sig, time, min_time, max_time, bound_outcomeTime, outcomeTime);
 
-	float sum_val = (float)0;
-
-	for (int i = usv.len - 1; i >= 0; i--) {
-		int itime = usv.Time(i, time_channel);
-		if (itime < min_time) break;
-		if (itime <= max_time) sum_val += usv.Val(i, val_channel);
+	if (widx != NULL) {
+		int from, to;
+		widx->bounds(min_time, max_time, usv.len, from, to);
+		return (float)widx->sum(from, to);
 	}
 
-	return sum_val;
+	return dispatch_typed_sig_view(usv, [&](const auto &sv) {
+		return basic_window_kernels::sum(sv, time_channel, val_channel, min_time, max_time); });
 }
 
 
 //.......................................................................................
 // get the std in the window [win_to, win_from] before time
-float BasicFeatGenerator::uget_std(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime)
+float BasicFeatGenerator::uget_std(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx)
 {
 	int min_time, max_time;
 	get_window_in_sig_time(_win_from, _win_to, time_unit_win, time_unit_sig, time, min_time, max_time, bound_outcomeTime, outcomeTime);
 
-	double sum = 0, sum_sq = 0, nvals = 0;
-
-	for (int i = 0; i < usv.len; i++) {
-		int itime = usv.Time(i, time_channel);
-		if (itime > max_time) break;
-		if (itime >= min_time) {
-			float ival = usv.Val(i, val_channel);
-			sum += ival;
-			sum_sq += ival * ival;
-			nvals++;
+	double sum = 0, sum_sq = 0, nvals = 0, var = 0;
+	if (widx != NULL) {
+		int from, to;
+		widx->bounds(min_time, max_time, usv.len, from, to);
+		nvals = to - from;
+		if (nvals > 1)
+			var = widx->var(from, to);
+	}
+	else {
+		dispatch_typed_sig_view(usv, [&](const auto &sv) {
+			basic_window_kernels::moments(sv, time_channel, val_channel, min_time, max_time, sum, sum_sq, nvals); });
+		if (nvals > 1) {
+			double avg = sum / nvals;
+			var = sum_sq / nvals - avg * avg;
 		}
 	}
 
 	if (nvals > 1) {
-		double avg = sum / nvals;
-		double var = sum_sq / nvals - avg * avg;
 		if (var < 0.0001) var = 0.0001;
 		return (float)sqrt(var);
 	}
@@ -2311,7 +2481,7 @@ int AttrFeatGenerator::init(map<string, string>& mapper) {
 //.......................................................................................
 int AttrFeatGenerator::_generate(PidDynamicRec& rec, MedFeatures& features, int index, int num, vector<float *> &_p_data) {
 
-	float *p_feat = p_data[0] + index;
+	float *p_feat = _p_data[0] + index;
 	for (int i = 0; i < num; i++) {
 		if (features.samples[index + i].attributes.find(attribute) != features.samples[index + i].attributes.end())
 			p_feat[i] = features.samples[index + i].attributes[attribute];
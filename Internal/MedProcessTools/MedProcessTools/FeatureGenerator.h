@@ -7,6 +7,7 @@
 #include <MedProcessTools/MedProcessTools/MedFeatures.h>
 #include <SerializableObject/SerializableObject/SerializableObject.h>
 #include <MedProcessTools/MedProcessTools/MedModelExceptions.h>
+#include <MedProcessTools/MedProcessTools/SigWindowIndex.h>
 #include <MedTime/MedTime/MedTime.h>
 #include <MedAlgo/MedAlgo/MedAlgo.h>
 #include <MedAlgo/MedAlgo/MedLM.h>
@@ -121,8 +122,16 @@ public:
 	// the default run will use it with the generator p_data.
 	virtual int _generate(PidDynamicRec& in_rep, MedFeatures& features, int index, int num, vector<float *> &_p_data) { return 0; }
 
+	/// true if the generator can evaluate all the (time sorted) samples of a pid in a single forward sweep
+	/// over the signal instead of recomputing each sample window from scratch
+	virtual bool supports_sweep() const { return false; }
+
+	/// true if an apply keeps its state in the generator itself (beyond p_data), so concurrent applies can't share it (see MedModelApplyContext)
+	virtual bool apply_keeps_state() const { return false; }
+
 	int generate(PidDynamicRec& in_rep, MedFeatures& features, int index, int num) { return _generate(in_rep, features, index, num); }
 	int generate(PidDynamicRec& in_rep, MedFeatures& features);
+	int generate(PidDynamicRec& in_rep, MedFeatures& features, vector<float *> &_p_data);
 	int generate(MedPidRepository& rep, int id, MedFeatures& features);
 	int generate(MedPidRepository& rep, int id, MedFeatures& features, int index, int num);
 
@@ -245,11 +254,11 @@ private:
 	float uget_last_nth(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_first(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_last2(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
-	float uget_avg(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
-	float uget_max(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
-	float uget_min(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
-	float uget_sum(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
-	float uget_std(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
+	float uget_avg(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx = NULL);
+	float uget_max(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx = NULL);
+	float uget_min(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx = NULL);
+	float uget_sum(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx = NULL);
+	float uget_std(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx = NULL);
 	float uget_last_delta(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_last_time(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_last2_time(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
@@ -261,13 +270,16 @@ private:
 	float uget_category_set_sum(PidDynamicRec &rec, UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_nsamples(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime);
 	float uget_exists(UniversalSigVec &usv, int time, int _win_from, int _win_to, int outcomeTime);
-	float uget_range_width(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
+	float uget_range_width(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime, SigWindowIndex *widx = NULL);
 	float uget_max_diff(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_first_time(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_category_set_first(PidDynamicRec &rec, UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_category_set_first_time(PidDynamicRec &rec, UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 	float uget_time_since_last_change(UniversalSigVec &usv, int time_point, int _win_from, int _win_to, int outcomeTime);
 
+	// generate all samples in a single sweep, returns false if the samples can't be swept (and nothing was generated)
+	bool generate_sweep(PidDynamicRec& rec, MedFeatures& features, int index, int num, float *p_feat);
+
 	// Applying non FTR_CATEGORY_SET_* types to categorical data
 	unordered_set<int> categ_require_dict = { FTR_LAST_VALUE, FTR_FIRST_VALUE, FTR_LAST2_VALUE, FTR_LAST_NTH_VALUE }; // Types that requriew dictionary if applied on categorical data
 	unordered_set<int> categ_forbidden = { FTR_AVG_VALUE, FTR_MAX_VALUE, FTR_MIN_VALUE,  FTR_STD_VALUE, FTR_LAST_DELTA_VALUE,
@@ -306,6 +318,8 @@ public:
 	float zero_missing_val = 0; ///< when zero_missing is on - whats the value to store in the missing value feature
 	int full_name = 0; ///< add time and value channels even if 0
 	string rename_signal = "";
+	int sweep_min_samples = 0; ///< generate all samples of a pid in a single forward sweep (see supports_sweep) when the pid has at least this many samples. 0 (default) : never, set per model (e.g. 2) to opt in
+	int win_index_min_samples = 0; ///< use the shared window index (binary search + prefix sums) for avg/sum/std/min/max/range_width when a pid has at least this many samples. 0 (default) : never, set per model (e.g. 4) to opt in. Sums may differ from the linear scan in the last float bits
 
 	// helpers
 	vector<char> lut;							///< to be used when generating FTR_CATEGORY_SET_*
@@ -362,6 +376,9 @@ public:
 	int _generate(PidDynamicRec& rec, MedFeatures& features, int index, int num, vector<float *> &_p_data);
 	float get_value(PidDynamicRec& rec, int index, int time, int outcomeTime);
 
+	/// sweep generation is supported for the window aggregations that can be maintained incrementally
+	bool supports_sweep() const;
+
 	/// Signal Ids
 	void set_signal_ids(MedSignals& sigs);
 
@@ -772,6 +789,8 @@ public:
 
 	/// Do the actual prediction prior to feature generation ...
 	void prepare(MedFeatures & features, MedPidRepository& rep, MedSamples& samples);
+	/// the predictions of prepare() are kept in the generator
+	bool apply_keeps_state() const { return true; }
 
 	///learn method
 	int _learn(MedPidRepository& rep, const MedSamples& samples, vector<RepProcessor *> processors);
@@ -0,0 +1,397 @@
+#include <MedProcessTools/MedProcessTools/MedArrow.h>
+#include <cstdio>
+#include <cctype>
+
+#include <Logger/Logger/Logger.h>
+#define LOCAL_SECTION LOG_MEDFEAT
+#define LOCAL_LEVEL	LOG_DEF_LEVEL
+
+//.......................................................................................
+// Export : producer data behind each exported schema/array, freed by its release callback.
+// every child has its own data, so a consumer can move children out of the parent.
+//.......................................................................................
+struct ArrowFieldData {
+	string format, name, metadata;
+	vector<ArrowSchema> children;
+	vector<ArrowSchema *> child_ptrs;
+};
+
+struct ArrowColumnData {
+	const void *buffers[2];
+	vector<unsigned char> owned;	///< copied values (empty when pointing to MedFeatures data)
+	shared_ptr<const void> owner;	///< keeps the MedFeatures pointed to alive until this column is released
+	vector<ArrowArray> children;
+	vector<ArrowArray *> child_ptrs;
+};
+
+/// a column to export: points to existing data or owns a copy
+struct ArrowExportColumn {
+	string name;
+	string format;
+	string metadata;
+	const void *data = NULL;
+	vector<unsigned char> owned;
+
+	// points to data while owner is alive, copies it when there is no owner
+	void set_data(const void *p, size_t n_bytes, const shared_ptr<const void> &owner) {
+		if (owner != nullptr)
+			data = p;
+		else
+			owned.assign((const unsigned char *)p, (const unsigned char *)p + n_bytes);
+	}
+};
+
+static void release_arrow_schema(ArrowSchema *s)
+{
+	ArrowFieldData *d = (ArrowFieldData *)s->private_data;
+	for (ArrowSchema &c : d->children)
+		if (c.release != NULL)
+			c.release(&c);
+	delete d;
+	s->release = NULL;
+}
+
+static void release_arrow_array(ArrowArray *a)
+{
+	ArrowColumnData *d = (ArrowColumnData *)a->private_data;
+	for (ArrowArray &c : d->children)
+		if (c.release != NULL)
+			c.release(&c);
+	delete d;
+	a->release = NULL;
+}
+
+static ArrowFieldData *init_arrow_schema(ArrowSchema *s, const string &format, const string &name, const string &metadata)
+{
+	ArrowFieldData *d = new ArrowFieldData;
+	d->format = format;
+	d->name = name;
+	d->metadata = metadata;
+	s->format = d->format.c_str();
+	s->name = d->name.c_str();
+	s->metadata = metadata.empty() ? NULL : d->metadata.data();
+	s->flags = 0;
+	s->n_children = 0;
+	s->children = NULL;
+	s->dictionary = NULL;
+	s->release = release_arrow_schema;
+	s->private_data = d;
+	return d;
+}
+
+static ArrowColumnData *init_arrow_array(ArrowArray *a, int64_t length, int n_buffers)
+{
+	ArrowColumnData *d = new ArrowColumnData;
+	d->buffers[0] = NULL;
+	d->buffers[1] = NULL;
+	a->length = length;
+	a->null_count = 0;
+	a->offset = 0;
+	a->n_buffers = n_buffers;
+	a->n_children = 0;
+	a->buffers = d->buffers;
+	a->children = NULL;
+	a->dictionary = NULL;
+	a->release = release_arrow_array;
+	a->private_data = d;
+	return d;
+}
+
+// struct array of the given columns
+static void export_arrow_columns(vector<ArrowExportColumn> &cols, int64_t length, ArrowSchema *schema, ArrowArray *array, const shared_ptr<const void> &owner = nullptr)
+{
+	ArrowFieldData *sd = init_arrow_schema(schema, "+s", "", "");
+	ArrowColumnData *ad = init_arrow_array(array, length, 1);
+	sd->children.resize(cols.size());
+	ad->children.resize(cols.size());
+	for (size_t i = 0; i < cols.size(); i++) {
+		init_arrow_schema(&sd->children[i], cols[i].format, cols[i].name, cols[i].metadata);
+		ArrowColumnData *cd = init_arrow_array(&ad->children[i], length, 2);
+		cd->owned.swap(cols[i].owned);
+		if (cols[i].data != NULL) {
+			cd->buffers[1] = cols[i].data;
+			cd->owner = owner;
+		}
+		else
+			cd->buffers[1] = (const void *)cd->owned.data();
+		sd->child_ptrs.push_back(&sd->children[i]);
+		ad->child_ptrs.push_back(&ad->children[i]);
+	}
+	schema->n_children = array->n_children = (int64_t)cols.size();
+	schema->children = sd->child_ptrs.data();
+	array->children = ad->child_ptrs.data();
+}
+
+template <class T, class F> static void add_samples_column(vector<ArrowExportColumn> &cols, const string &name, const char *format, const vector<MedSample> &samples, F get)
+{
+	ArrowExportColumn col;
+	col.name = name;
+	col.format = format;
+	col.owned.resize(samples.size() * sizeof(T));
+	T *p = (T *)col.owned.data();
+	for (size_t i = 0; i < samples.size(); i++)
+		p[i] = get(samples[i]);
+	cols.push_back(move(col));
+}
+
+static void add_samples_columns(vector<ArrowExportColumn> &cols, const vector<MedSample> &samples)
+{
+	add_samples_column<int>(cols, "id", "i", samples, [](const MedSample &s) { return s.id; });
+	add_samples_column<int>(cols, "time", "i", samples, [](const MedSample &s) { return s.time; });
+	add_samples_column<float>(cols, "outcome", "f", samples, [](const MedSample &s) { return s.outcome; });
+	add_samples_column<int>(cols, "outcomeTime", "i", samples, [](const MedSample &s) { return s.outcomeTime; });
+	add_samples_column<int>(cols, "split", "i", samples, [](const MedSample &s) { return s.split; });
+
+	size_t n_preds = 0;
+	for (const MedSample &s : samples)
+		n_preds = max(n_preds, s.prediction.size());
+	for (size_t k = 0; k < n_preds; k++)
+		add_samples_column<float>(cols, "pred_" + to_string(k), "f", samples,
+			[k](const MedSample &s) { return (k < s.prediction.size()) ? s.prediction[k] : (float)MED_MAT_MISSING_VALUE; });
+}
+
+//.......................................................................................
+// feature attributes as arrow field metadata: int32 count, then int32 length + bytes for each key and value
+//.......................................................................................
+static string encode_arrow_metadata(const vector<pair<string, string>> &kv)
+{
+	string s;
+	auto put_int = [&s](int32_t v) { s.append((const char *)&v, sizeof(v)); };
+	put_int((int32_t)kv.size());
+	for (const auto &p : kv) {
+		put_int((int32_t)p.first.size());
+		s += p.first;
+		put_int((int32_t)p.second.size());
+		s += p.second;
+	}
+	return s;
+}
+
+static void decode_arrow_metadata(const char *m, map<string, string> &kv)
+{
+	kv.clear();
+	if (m == NULL)
+		return;
+	int32_t n, len;
+	memcpy(&n, m, sizeof(n)); m += sizeof(n);
+	for (int32_t i = 0; i < n; i++) {
+		memcpy(&len, m, sizeof(len)); m += sizeof(len);
+		string key(m, len); m += len;
+		memcpy(&len, m, sizeof(len)); m += sizeof(len);
+		kv[key] = string(m, len); m += len;
+	}
+}
+
+static string float_str(float v)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.9g", v);
+	return buf;
+}
+
+//.......................................................................................
+int medial::arrow::export_features(const MedFeatures &features, ArrowSchema *schema, ArrowArray *array, const vector<string> &names, shared_ptr<const void> owner)
+{
+	vector<string> col_names;
+	if (names.size())
+		col_names = names;
+	else
+		features.get_feature_names(col_names);
+
+	size_t n = features.samples.size();
+	vector<ArrowExportColumn> cols;
+	add_samples_columns(cols, features.samples);
+	if (features.weights.size()) {
+		if (features.weights.size() != n) {
+			MERR("medial::arrow::export_features : %zu weights for %zu samples\n", features.weights.size(), n);
+			return -1;
+		}
+		ArrowExportColumn col;
+		col.name = "weight";
+		col.format = "f";
+		col.set_data(features.weights.data(), n * sizeof(float), owner);
+		cols.push_back(move(col));
+	}
+
+	for (const string &name : col_names) {
+		auto it = features.data.find(name);
+		if (it == features.data.end() || it->second.size() != n) {
+			MERR("medial::arrow::export_features : feature [%s] is missing or does not match the %zu samples\n", name.c_str(), n);
+			return -1;
+		}
+		ArrowExportColumn col;
+		col.name = name;
+		col.format = "f";
+		col.set_data(it->second.data(), n * sizeof(float), owner);
+		auto attr = features.attributes.find(name);
+		if (attr != features.attributes.end())
+			col.metadata = encode_arrow_metadata({ { "normalized", to_string((int)attr->second.normalized) }, { "imputed", to_string((int)attr->second.imputed) },
+				{ "denorm_mean", float_str(attr->second.denorm_mean) }, { "denorm_sdv", float_str(attr->second.denorm_sdv) } });
+		cols.push_back(move(col));
+	}
+
+	export_arrow_columns(cols, (int64_t)n, schema, array, owner);
+	return 0;
+}
+
+//.......................................................................................
+int medial::arrow::export_samples(const MedSamples &samples, ArrowSchema *schema, ArrowArray *array)
+{
+	vector<MedSample> vec;
+	samples.export_to_sample_vec(vec);
+
+	vector<ArrowExportColumn> cols;
+	add_samples_columns(cols, vec);
+	export_arrow_columns(cols, (int64_t)vec.size(), schema, array);
+	return 0;
+}
+
+//.......................................................................................
+// Import : values of a primitive child column (offset includes the parent offset), nulls become 'missing'
+//.......................................................................................
+template <class T, class R> static void arrow_column_values(const ArrowArray *a, int64_t offset, int64_t n, vector<R> &out, R missing)
+{
+	const uint8_t *valid = (a->null_count != 0) ? (const uint8_t *)a->buffers[0] : NULL;
+	const T *vals = (const T *)a->buffers[1];
+	out.resize(n);
+	for (int64_t i = 0; i < n; i++) {
+		int64_t j = offset + i;
+		out[i] = (valid != NULL && !(valid[j >> 3] & (1 << (j & 7)))) ? missing : (R)vals[j];
+	}
+}
+
+template <class R> static int get_arrow_column(const ArrowSchema *s, const ArrowArray *a, int64_t parent_offset, int64_t n, vector<R> &out, R missing)
+{
+	int64_t offset = parent_offset + a->offset;
+	if (a->n_buffers != 2 || s->format == NULL || strlen(s->format) != 1) {
+		MERR("medial::arrow : column [%s] is not a primitive column\n", s->name);
+		return -1;
+	}
+	// the struct rows [parent_offset, parent_offset + n) are rows of the column
+	if (a->length < parent_offset + n || (n > 0 && a->buffers[1] == NULL)) {
+		MERR("medial::arrow : column [%s] has %lld values, %lld are needed\n", s->name, (long long)a->length, (long long)(parent_offset + n));
+		return -1;
+	}
+	switch (s->format[0]) {
+	case 'f': arrow_column_values<float>(a, offset, n, out, missing); break;
+	case 'g': arrow_column_values<double>(a, offset, n, out, missing); break;
+	case 'c': arrow_column_values<int8_t>(a, offset, n, out, missing); break;
+	case 'C': arrow_column_values<uint8_t>(a, offset, n, out, missing); break;
+	case 's': arrow_column_values<int16_t>(a, offset, n, out, missing); break;
+	case 'S': arrow_column_values<uint16_t>(a, offset, n, out, missing); break;
+	case 'i': arrow_column_values<int32_t>(a, offset, n, out, missing); break;
+	case 'I': arrow_column_values<uint32_t>(a, offset, n, out, missing); break;
+	case 'l': arrow_column_values<int64_t>(a, offset, n, out, missing); break;
+	case 'L': arrow_column_values<uint64_t>(a, offset, n, out, missing); break;
+	default:
+		MERR("medial::arrow : column [%s] has an unsupported format [%s]\n", s->name, s->format);
+		return -1;
+	}
+	return 0;
+}
+
+// samples columns go to samples, other columns to features (ignored, with a warning, when features is NULL)
+static int import_arrow_columns(ArrowSchema *schema, ArrowArray *array, vector<MedSample> &samples, MedFeatures *features)
+{
+	if (schema->release == NULL || array->release == NULL || schema->format == NULL || string(schema->format) != "+s" || schema->n_children != array->n_children ||
+		array->length < 0 || array->offset < 0 || (schema->n_children > 0 && (schema->children == NULL || array->children == NULL))) {
+		MERR("medial::arrow : expecting a struct array (a record batch)\n");
+		return -1;
+	}
+
+	int64_t n = array->length;
+	samples.clear();
+	samples.resize(n);
+	bool got_ids = false;
+	vector<int> ivals;
+	vector<float> fvals;
+	for (int64_t c = 0; c < schema->n_children; c++) {
+		const ArrowSchema *s = schema->children[c];
+		const ArrowArray *a = array->children[c];
+		string name = (s->name != NULL) ? s->name : "";
+		if (name == "id" || name == "time" || name == "outcomeTime" || name == "split") {
+			if (get_arrow_column(s, a, array->offset, n, ivals, -1) < 0)
+				return -1;
+			for (int64_t i = 0; i < n; i++) {
+				if (name == "id") samples[i].id = ivals[i];
+				else if (name == "time") samples[i].time = ivals[i];
+				else if (name == "outcomeTime") samples[i].outcomeTime = ivals[i];
+				else samples[i].split = ivals[i];
+			}
+			got_ids |= (name == "id");
+		}
+		else if (name == "outcome") {
+			if (get_arrow_column(s, a, array->offset, n, fvals, 0.0f) < 0)
+				return -1;
+			for (int64_t i = 0; i < n; i++)
+				samples[i].outcome = fvals[i];
+		}
+		else if (name.compare(0, 5, "pred_") == 0 && name.size() > 5 && isdigit(name[5])) {
+			size_t k = stoi(name.substr(5));
+			if (get_arrow_column(s, a, array->offset, n, fvals, (float)MED_MAT_MISSING_VALUE) < 0)
+				return -1;
+			for (int64_t i = 0; i < n; i++) {
+				if (samples[i].prediction.size() <= k)
+					samples[i].prediction.resize(k + 1, (float)MED_MAT_MISSING_VALUE);
+				samples[i].prediction[k] = fvals[i];
+			}
+		}
+		else if (features == NULL)
+			MWARN("medial::arrow : ignoring column [%s]\n", name.c_str());
+		else if (name == "weight") {
+			if (get_arrow_column(s, a, array->offset, n, features->weights, 1.0f) < 0)
+				return -1;
+		}
+		else {
+			if (name == "" || features->data.count(name)) {
+				MERR("medial::arrow : feature [%s] has no name or is given twice\n", name.c_str());
+				return -1;
+			}
+			if (get_arrow_column(s, a, array->offset, n, features->data[name], features->medf_missing_value) < 0)
+				return -1;
+			map<string, string> kv;
+			decode_arrow_metadata(s->metadata, kv);
+			FeatureAttr &attr = features->attributes[name];
+			if (kv.count("normalized")) attr.normalized = (stoi(kv["normalized"]) != 0);
+			if (kv.count("imputed")) attr.imputed = (stoi(kv["imputed"]) != 0);
+			if (kv.count("denorm_mean")) attr.denorm_mean = stof(kv["denorm_mean"]);
+			if (kv.count("denorm_sdv")) attr.denorm_sdv = stof(kv["denorm_sdv"]);
+		}
+	}
+
+	if (!got_ids) {
+		MERR("medial::arrow : no id column\n");
+		return -1;
+	}
+	return 0;
+}
+
+//.......................................................................................
+int medial::arrow::import_features(ArrowSchema *schema, ArrowArray *array, MedFeatures &features)
+{
+	features.clear();
+	int rc = import_arrow_columns(schema, array, features.samples, &features);
+	if (array->release != NULL) array->release(array);
+	if (schema->release != NULL) schema->release(schema);
+	if (rc < 0) {
+		features.clear();
+		return -1;
+	}
+
+	features.init_pid_pos_len();
+	return 0;
+}
+
+//.......................................................................................
+int medial::arrow::import_samples(ArrowSchema *schema, ArrowArray *array, MedSamples &samples)
+{
+	vector<MedSample> vec;
+	int rc = import_arrow_columns(schema, array, vec, NULL);
+	if (array->release != NULL) array->release(array);
+	if (schema->release != NULL) schema->release(schema);
+	if (rc < 0)
+		return -1;
+
+	samples.import_from_sample_vec(vec);
+	return 0;
+}
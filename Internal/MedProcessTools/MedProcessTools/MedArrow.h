@@ -0,0 +1,81 @@
+// MedArrow - exchanging MedFeatures and MedSamples through the Arrow C data interface
+// (https://arrow.apache.org/docs/format/CDataInterface.html). The interface is plain C structs,
+// so no arrow library is needed on our side.
+
+#ifndef __MED_ARROW_H__
+#define __MED_ARROW_H__
+
+#include <MedProcessTools/MedProcessTools/MedFeatures.h>
+#include <MedProcessTools/MedProcessTools/MedSamples.h>
+#include <memory>
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+	// Array type description
+	const char* format;
+	const char* name;
+	const char* metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema** children;
+	struct ArrowSchema* dictionary;
+
+	// Release callback
+	void(*release)(struct ArrowSchema*);
+	// Opaque producer-specific data
+	void* private_data;
+};
+
+struct ArrowArray {
+	// Array data description
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void** buffers;
+	struct ArrowArray** children;
+	struct ArrowArray* dictionary;
+
+	// Release callback
+	void(*release)(struct ArrowArray*);
+	// Opaque producer-specific data
+	void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+/**
+* \brief medial namespace for function
+*/
+namespace medial {
+	/*!
+	*  \brief arrow namespace - MedFeatures/MedSamples as an arrow struct array (a record batch)
+	*
+	*  samples are the columns id, time, outcome, outcomeTime, split and pred_0, pred_1, .. (when predictions are given),
+	*  features add a weight column (when weights are given) and a column per feature, with the FeatureAttr in the field metadata.
+	*  Exported feature columns point to the MedFeatures data (no copy) when an owner of the MedFeatures is given: each column
+	*  holds the owner until it is released, and the MedFeatures must not be changed meanwhile. Without an owner they are copied.
+	*  Samples columns are copied (they are not columnar in memory).
+	*  Importing copies the columns (once) into the destination and releases the given array and schema.
+	*/
+	namespace arrow {
+		/// \brief export the features in 'names' (all if empty) and the samples. owner (when given) keeps features alive, see above. returns -1 upon failure
+		int export_features(const MedFeatures &features, ArrowSchema *schema, ArrowArray *array, const vector<string> &names = {}, shared_ptr<const void> owner = nullptr);
+		/// \brief import a struct array into features (replacing its content). Float, double and integer feature columns are accepted, nulls become missing values
+		int import_features(ArrowSchema *schema, ArrowArray *array, MedFeatures &features);
+
+		/// \brief export the samples as a struct array
+		int export_samples(const MedSamples &samples, ArrowSchema *schema, ArrowArray *array);
+		/// \brief import samples from a struct array (replacing its content)
+		int import_samples(ArrowSchema *schema, ArrowArray *array, MedSamples &samples);
+	}
+}
+
+#endif
@@ -136,6 +136,52 @@ void MedFeatures::get_as_matrix(MedMat<float>& mat, vector<string>& names) const
 	*/
 	time_me.take_curr_time();
 	MLOG_D("Matrix transpose time is %f sec\n", time_me.diff_sec());
+
+	set_matrix_metadata(mat, namesToTake);
+}
+
+// Get subset of data (+attributes) as a feature-major matrix (transposed_flag = 1) : Only features in 'names'
+// each feature column is already contiguous, so this is a plain block copy per feature with no transpose
+//.......................................................................................
+void MedFeatures::get_as_feature_major_matrix(MedMat<float>& mat, vector<string>& names) const {
+
+	vector<string> namesToTake;
+	if (names.size())
+		namesToTake = names;
+	else
+		get_feature_names(namesToTake);
+
+	vector<const float *> datap(namesToTake.size());
+	for (size_t i = 0; i < namesToTake.size(); i++) {
+		auto it = data.find(namesToTake[i]);
+		if (it == data.end())
+			MTHROW_AND_ERR("MedFeatures::get_as_feature_major_matrix : unknown feature [%s]\n", namesToTake[i].c_str());
+		datap[i] = it->second.data();
+	}
+
+	int nftrs = (int)namesToTake.size();
+	int nsamples = (int)samples.size();
+
+	mat.resize(nftrs, nsamples);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < nftrs; i++) {
+		float *out = mat.data_ptr() + (size_t)i * nsamples;
+		for (int j = 0; j < nsamples; j++) {
+			if (!isfinite(datap[i][j])) {
+				MTHROW_AND_ERR("nan in col [%s] in record [%d]", namesToTake[i].c_str(), j);
+			}
+			out[j] = datap[i][j];
+		}
+	}
+	mat.transposed_flag = 1;
+
+	set_matrix_metadata(mat, namesToTake);
+}
+
+// Set matrix attributes (normalization flag, column names, records metadata) for features in 'names'
+//.......................................................................................
+void MedFeatures::set_matrix_metadata(MedMat<float>& mat, const vector<string>& namesToTake) const {
 	//Test:
 	for (const string& name : namesToTake)
 		if (attributes.find(name) == attributes.end())
@@ -94,6 +94,11 @@ public:
 	/// <summary> Get subset of data (+attributes) as a MetMat: Only features in 'names' and rows in 'idx' </summary>
 	void get_as_matrix(MedMat<float>& mat, const vector<string>& names, vector<int> &idx) const;
 
+	/// <summary> Get subset of data (+attributes) as a feature-major MedMat (transposed_flag=1) : Only features in 'names' (all if empty). Copies each column as is, no transpose </summary>
+	void get_as_feature_major_matrix(MedMat<float>& mat, vector<string>& names) const;
+	/// <summary> Set MedMat attributes (normalized flag, signals, records metadata) for the features in 'names' </summary>
+	void set_matrix_metadata(MedMat<float>& mat, const vector<string>& names) const;
+
 	/// <summary> Set data (+attributes) from MedMat </summary>
 	void set_as_matrix(const MedMat<float>& mat);
 
@@ -10,7 +10,10 @@
 #include <boost/regex.hpp>
 #include <boost/algorithm/string/regex.hpp>
 #include <cmath>
+#include <thread>
+#include <exception>
 #include <string>
+#include <mutex>
 #include "StripComments.h"
 #include "DuplicateProcessor.h"
 #include "medial_utilities/medial_utilities/globalRNG.h"
@@ -23,6 +26,9 @@
 
 using namespace boost::property_tree;
 
+// summaries report (and restart) counts kept in the processors, which concurrent applies of a model share
+static mutex summary_mutex;
+
 //=======================================================================================
 // MedModelStage
 //=======================================================================================
@@ -417,7 +423,21 @@ bool is_needed_post_processor(PostProcessor *p, const unordered_set<Effected_Fie
 
 void MedModel::no_init_apply_partial(MedPidRepository& rep, MedSamples& samples,
 	const vector<Effected_Field> &requested_outputs) {
-	no_init_apply(rep, samples, MED_MDL_APPLY_FTR_GENERATORS, MED_MDL_LEARN_PREDICTOR); //Stop before predictor
+	p_rep = &rep;
+	if (applied_generators_to_use.empty())
+		get_applied_generators(required_feature_generators, applied_generators_to_use);
+	apply_partial(rep, samples, requested_outputs, features, NULL);
+}
+
+void MedModel::no_init_apply_partial(MedModelApplyContext &ctx, MedPidRepository& rep, MedSamples& samples,
+	const vector<Effected_Field> &requested_outputs) const {
+	ctx.p_rep = &rep;
+	apply_partial(rep, samples, requested_outputs, ctx.features, &ctx.p_data);
+}
+
+void MedModel::apply_partial(MedPidRepository& rep, MedSamples& samples, const vector<Effected_Field> &requested_outputs,
+	MedFeatures &features, vector<vector<float *>> *gen_p_data) const {
+	apply_stages(rep, samples, MED_MDL_APPLY_FTR_GENERATORS, MED_MDL_LEARN_PREDICTOR, features, gen_p_data); //Stop before predictor
 
 	//test from post_processors end to begining and predictor what to apply:
 	vector<vector<char>> apply_pp(post_processors.size());
@@ -468,7 +488,7 @@ void MedModel::no_init_apply_partial(MedPidRepository& rep, MedSamples& samples,
 	}
 
 	if (predictor_needed) {
-		apply_predictor(samples);
+		apply_predictor(samples, features);
 		if (samples.insert_preds(features) != 0)
 			MTHROW_AND_ERR("Insertion of predictions to samples failed\n");
 	}
@@ -593,6 +613,153 @@ int MedModel::get_apply_batch_count() {
 	return (int)max_smp_batch;
 }
 
+//.......................................................................................
+// Streaming apply
+int MedModel::apply_streaming(const string &rep_conf, const string &samples_fname, const string &out_fname, long long mem_budget,
+	MedModelStage end_stage, int pred_precision, bool print_attributes) {
+
+	if (mem_budget <= 0)
+		mem_budget = (max_data_in_mem > 0) ? max_data_in_mem * (long long)sizeof(float) : (4LL << 30);
+
+	// two repositories : one is applied while the next chunk is loaded into the other
+	MedPidRepository reps[2];
+
+	// the model points into reps from init_model_for_apply on : on every exit (returns and exceptions), p_rep is
+	// restored and the features of the chunks are dropped, before reps go out of scope
+	struct ApplyStateGuard {
+		MedModel &model;
+		MedPidRepository *prev_rep;
+		~ApplyStateGuard() { model.features.clear(); model.p_rep = prev_rep; }
+	} state_guard{ *this, p_rep };
+
+	vector<string> req_sigs;
+	for (int i = 0; i < 2; i++) {
+		if (reps[i].init(rep_conf) < 0) {
+			MERR("MedModel::apply_streaming : could not init repository %s\n", rep_conf.c_str());
+			return -1;
+		}
+	}
+	fit_for_repository(reps[0]);
+	get_required_signal_names(req_sigs);
+	vector<int> req_sids;
+	for (string &sig : req_sigs) {
+		int sid = reps[0].sigs.sid(sig);
+		if (sid < 0) {
+			MERR("MedModel::apply_streaming : Unknown signal %s in repository\n", sig.c_str());
+			return -1;
+		}
+		req_sids.push_back(sid);
+	}
+	// initializing on both (identical) repositories - the second call leaves the model set to reps[0]
+	if (init_model_for_apply(reps[1], MED_MDL_APPLY_FTR_GENERATORS, end_stage) < 0 ||
+		init_model_for_apply(reps[0], MED_MDL_APPLY_FTR_GENERATORS, end_stage) < 0) {
+		MERR("MedModel::apply_streaming : Init model for apply failed\n");
+		return -1;
+	}
+
+	// chunk size : features are held twice (MedFeatures + predictor matrix), repository data for two chunks
+	long long num_of_features = model_feature_count_hint;
+	int max_model_feature_count = get_nfeatures();
+	if (num_of_features <= 0 || max_model_feature_count < model_feature_count_hint)
+		num_of_features = max_model_feature_count;
+	double ftr_bytes_per_sample = 2.0 * sizeof(float) * get_duplicate_factor() * max(num_of_features, 1LL);
+	double rep_bytes_per_sample = 0;
+	auto chunk_size = [&]() {
+		long long n = (long long)(0.9 * mem_budget / (ftr_bytes_per_sample + 2 * rep_bytes_per_sample));
+		return (int)max(1LL, min(n, (long long)INT_MAX / 2));
+	};
+
+	MedSamplesChunkReader reader;
+	if (reader.open(samples_fname) < 0)
+		return -1;
+	ofstream of(out_fname);
+	if (!of) {
+		MERR("MedModel::apply_streaming : can't open file %s for write\n", out_fname.c_str());
+		return -1;
+	}
+
+	MedSamples chunks[2];
+	unsigned long long loaded_bytes[2] = { 0, 0 };
+	// read next chunk and load its ids into reps[k]
+	auto read_and_load = [&](int k, int max_samples) {
+		if (reader.read_chunk(chunks[k], max_samples) < 0)
+			return -1;
+		if (chunks[k].idSamples.empty())
+			return 0;
+		vector<int> pids;
+		chunks[k].get_ids(pids);
+		if (reps[k].load(req_sids, pids) < 0) {
+			MERR("MedModel::apply_streaming : failed loading %zu ids from %s\n", pids.size(), rep_conf.c_str());
+			return -1;
+		}
+		loaded_bytes[k] = 0;
+		for (int sid : req_sids)
+			loaded_bytes[k] += reps[k].index.index_table[sid].tot_size;
+		return 0;
+	};
+
+	MedTimer timer;
+	timer.start();
+	int curr = 0, rc = 0;
+	long long n_done = 0;
+	bool first = true;
+	if (read_and_load(curr, chunk_size()) < 0)
+		return -1;
+
+	while (!chunks[curr].idSamples.empty()) {
+		int n_smp = chunks[curr].nSamples();
+		rep_bytes_per_sample = max(rep_bytes_per_sample, (double)loaded_bytes[curr] / n_smp);
+
+		// prefetch next chunk while applying the current one
+		int next = 1 - curr;
+		int next_rc = 0;
+		int next_size = chunk_size();
+		thread prefetch([&]() {
+			try { next_rc = read_and_load(next, next_size); }
+			catch (...) { next_rc = -1; }
+		});
+
+		// the prefetch thread must be joined before an exception leaves this scope
+		exception_ptr apply_error = NULL;
+		try {
+			if (no_init_apply(reps[curr], chunks[curr], MED_MDL_APPLY_FTR_GENERATORS, end_stage) < 0) {
+				MERR("MedModel::apply_streaming : apply failed on chunk starting with id %d\n", chunks[curr].idSamples[0].id);
+				rc = -1;
+			}
+			else {
+				chunks[curr].write_to_file(of, pred_precision, print_attributes, first);
+				first = false;
+			}
+		}
+		catch (...) {
+			apply_error = current_exception();
+		}
+		prefetch.join();
+		if (apply_error != NULL)
+			rethrow_exception(apply_error);
+		if (rc < 0 || next_rc < 0) {
+			rc = -1;
+			break;
+		}
+
+		n_done += n_smp;
+		reps[curr].free(req_sids);
+		chunks[curr].clear();
+		if (verbosity > 0) {
+			timer.take_curr_time();
+			MLOG("MedModel::apply_streaming : applied %lld samples (chunk of %d, %.1f rep bytes/sample) in %2.1f seconds\n",
+				n_done, n_smp, rep_bytes_per_sample, timer.diff_sec());
+		}
+		curr = next;
+	}
+
+	of.close();
+	reader.close();
+	if (rc == 0)
+		MLOG("MedModel::apply_streaming : wrote %lld samples to %s\n", n_done, out_fname.c_str());
+	return rc;
+}
+
 //-------------------------------------------------------------------------------------------------------------------------------
 int MedModel::init_model_for_apply(MedPidRepository &rep, MedModelStage start_stage, MedModelStage end_stage)
 {
@@ -665,7 +832,7 @@ int MedModel::init_model_for_apply(MedPidRepository &rep, MedModelStage start_st
 }
 
 //-------------------------------------------------------------------------------------------------------------------------------
-int MedModel::apply_predictor(MedSamples &samples) {
+int MedModel::apply_predictor(MedSamples &samples, MedFeatures &features) const {
 	if (verbosity > 0) MLOG("before predict: for MedFeatures of: %d x %d\n", features.data.size(), features.samples.size());
 	if (predictor != NULL) {
 		if (features.samples.size() == 1 && !predictor->predict_single_not_implemented()) {
@@ -697,6 +864,31 @@ int MedModel::apply_predictor(MedSamples &samples) {
 int MedModel::no_init_apply(MedPidRepository& rep, MedSamples& samples, MedModelStage start_stage, MedModelStage end_stage)
 {
 	p_rep = &rep;
+	if (start_stage <= MED_MDL_APPLY_FTR_GENERATORS && applied_generators_to_use.empty())
+		get_applied_generators(required_feature_generators, applied_generators_to_use);
+	return apply_stages(rep, samples, start_stage, end_stage, features, NULL);
+}
+
+int MedModel::no_init_apply(MedModelApplyContext &ctx, MedPidRepository& rep, MedSamples& samples, MedModelStage start_stage, MedModelStage end_stage) const
+{
+	ctx.p_rep = &rep;
+	return apply_stages(rep, samples, start_stage, end_stage, ctx.features, &ctx.p_data);
+}
+
+bool MedModel::supports_context_apply() const
+{
+	for (const FeatureGenerator *generator : generators)
+		if (generator->apply_keeps_state())
+			return false;
+	for (const PostProcessor *pp : post_processors)
+		if (pp->apply_keeps_state())
+			return false;
+	return true;
+}
+
+int MedModel::apply_stages(MedPidRepository& rep, MedSamples& samples, MedModelStage start_stage, MedModelStage end_stage, MedFeatures &features,
+	vector<vector<float *>> *gen_p_data) const
+{
 	// Stage Sanity
 	if (end_stage < MED_MDL_APPLY_FTR_GENERATORS) {
 		MERR("MedModel apply() : Illegal end stage %d\n", end_stage);
@@ -708,8 +900,15 @@ int MedModel::no_init_apply(MedPidRepository& rep, MedSamples& samples, MedModel
 		// Generate features
 		features.clear();
 		features.set_time_unit(samples.time_unit);
+		// the applied generators are set by init_model_for_apply (or by the first apply of the model itself)
+		if (applied_generators_to_use.empty() && !generators.empty()) {
+			MERR("MedModel apply() : ERROR: model is not initialized for apply\n");
+			return -1;
+		}
 		if (verbosity > 0) MLOG("MedModel apply() : before generate_all_features() samples of %d ids\n", samples.idSamples.size());
-		if (generate_all_features(rep, &samples, features, required_feature_generators) < 0) {
+		int rc_gen = generate_features(rep, &samples, applied_generators_to_use, features, gen_p_data);
+		make_rep_processors_summary();
+		if (rc_gen < 0) {
 			MERR("MedModel apply() : ERROR: Failed generate_all_features()\n");
 			return -1;
 		}
@@ -732,7 +931,8 @@ int MedModel::no_init_apply(MedPidRepository& rep, MedSamples& samples, MedModel
 	if (start_stage <= MED_MDL_APPLY_FTR_PROCESSORS) {
 		if (verbosity > 0) MLOG("MedModel apply() on %d samples : before applying feature processors : generate_masks = %d\n", samples.idSamples.size(), generate_masks_for_features);
 		if (generate_masks_for_features) features.mark_imputed_in_masks();
-		if (apply_feature_processors(features, required_features_vec, false) < 0) {
+		vector<unordered_set<string>> req_features_vec = required_features_vec;
+		if (apply_feature_processors(features, req_features_vec, false) < 0) {
 			MERR("MedModel::apply() : ERROR: Failed apply_feature_cleaners()\n");
 			return -1;
 		}
@@ -746,7 +946,7 @@ int MedModel::no_init_apply(MedPidRepository& rep, MedSamples& samples, MedModel
 	if (generate_masks_for_features) { features.mark_imputed_in_masks(); }
 	// Apply predictor
 	if (start_stage <= MED_MDL_APPLY_PREDICTOR) {
-		int rc_pred = apply_predictor(samples);
+		int rc_pred = apply_predictor(samples, features);
 		if (rc_pred != 0)
 			return rc_pred;
 	}
@@ -833,19 +1033,30 @@ int MedModel::generate_all_features(MedPidRepository &rep, MedSamples *samples,
 		get_applied_generators(req_feature_generators, applied_generators_to_use);
 
 	int res = generate_features(rep, samples, applied_generators_to_use, features);
-	//print rep_processors_summary:
+	make_rep_processors_summary();
+
+	return res;
+}
 
+//.......................................................................................
+void MedModel::make_rep_processors_summary() const {
 #ifdef VERBOSE_LOGGING_PREF
 	if (verbosity > 0) MLOG("generate_features :: make_summary rep_processors\n");
 #endif
+	lock_guard<mutex> guard(summary_mutex);
 	for (unsigned int i = 0; i < rep_processors.size(); i++)
 		rep_processors[i]->make_summary();
-
-	return res;
 }
 
 //.......................................................................................
 int MedModel::generate_features(MedPidRepository &rep, MedSamples *samples, vector<FeatureGenerator *>& _generators, MedFeatures &features)
+{
+	return generate_features(rep, samples, _generators, features, NULL);
+}
+
+//.......................................................................................
+int MedModel::generate_features(MedPidRepository &rep, MedSamples *samples, const vector<FeatureGenerator *>& _generators, MedFeatures &features,
+	vector<vector<float *>> *gen_p_data) const
 {
 #ifdef VERBOSE_LOGGING_PREF
 	if (verbosity > 0) MLOG("generate_features :: Collect required signals\n");
@@ -891,20 +1102,25 @@ int MedModel::generate_features(MedPidRepository &rep, MedSamples *samples, vect
 #ifdef VERBOSE_LOGGING_PREF
 	if (verbosity > 0) MLOG("generate_features :: get_p_data\n");
 #endif
-	// Resize data vectors and collect pointers
+	// Resize data vectors and collect pointers (kept in the generators, or in gen_p_data)
 	int samples_size = (int)features.samples.size();
-	for (auto &generator : _generators) {
-		generator->p_data.clear();
+	vector<vector<float *> *> p_data(_generators.size());
+	if (gen_p_data != NULL)
+		gen_p_data->resize(_generators.size());
+	for (size_t k = 0; k < _generators.size(); k++) {
+		FeatureGenerator *generator = _generators[k];
+		p_data[k] = (gen_p_data == NULL) ? &generator->p_data : &(*gen_p_data)[k];
+		p_data[k]->clear();
 		if (generator->iGenerateWeights) {
 			features.weights.resize(samples_size, 0);
 			if (generator->names.size() != 1)
 				MTHROW_AND_ERR("Cannot generate weights using a multi-feature generator (type %d generates %d features)\n", generator->generator_type, (int)generator->names.size());
-			generator->p_data.push_back(&(features.weights[0]));
+			p_data[k]->push_back(&(features.weights[0]));
 		}
 		else {
 			for (string& name : generator->names)
 				features.data[name].resize(samples_size, 0);
-			generator->get_p_data(features);
+			generator->get_p_data(features, *p_data[k]);
 		}
 	}
 
@@ -940,13 +1156,15 @@ int MedModel::generate_features(MedPidRepository &rep, MedSamples *samples, vect
 					if (rep_processors[i]->conditional_apply(idRec[n_th], pid_samples, current_req_signal_ids[i]) < 0) rc = -1;
 				}
 
-				// Generate Features
-				for (auto& generator : _generators)
-					if (generator->generate(idRec[n_th], features) < 0)	rc = -1;
-
+				// Generate Features (each generator writes straight into its precomputed p_data columns)
+				for (size_t k = 0; k < _generators.size(); k++)
+					if (_generators[k]->generate(idRec[n_th], features, *p_data[k]) < 0)	rc = -1;
 
+				// only failing ids synchronize
+				if (rc < 0) {
 #pragma omp critical 
-				if (rc < 0) RC = -1;
+					RC = -1;
+				}
 			}
 			catch (...) {
 				// have to catch each thread
@@ -964,8 +1182,11 @@ int MedModel::generate_features(MedPidRepository &rep, MedSamples *samples, vect
 	if (verbosity > 0) MLOG("generate_features :: make_summary\n");
 #endif
 	// call summary for generation
-	for (auto& generator : _generators)
-		generator->make_summary();
+	{
+		lock_guard<mutex> guard(summary_mutex);
+		for (auto& generator : _generators)
+			generator->make_summary();
+	}
 
 	if (thrown < 0) MTHROW_AND_ERR("Thrown in generate_features()\n");
 	//throw thrown; // throwing if needed
@@ -1043,7 +1264,7 @@ int MedModel::apply_feature_processors(MedFeatures &features, bool learning)
 
 }
 //.......................................................................................
-int MedModel::apply_feature_processors(MedFeatures &features, vector<unordered_set<string>>& req_features_vec, bool learning)
+int MedModel::apply_feature_processors(MedFeatures &features, vector<unordered_set<string>>& req_features_vec, bool learning) const
 {
 	int n = (int)feature_processors.size();
 	for (int i = 0; i < n; i++) {
@@ -1817,14 +2038,13 @@ void collect_and_add_virtual_signals_static(MedRepository &rep, vector<RepProces
 	for (const auto &vsig_name : all_virtual_signals_names) {
 		int vsig_id = rep.sigs.Name2Sid[vsig_name];
 		int add_section = rep.dict.section_id(vsig_name);
-		rep.dict.dicts[add_section].Name2Id[vsig_name] = vsig_id;
-		rep.dict.dicts[0].Name2Id[vsig_name] = vsig_id;
-		rep.dict.dicts[add_section].Id2Name[vsig_id] = vsig_name;
-		rep.dict.dicts[add_section].Id2Names[vsig_id] = { vsig_name };
+		rep.dict.push_new_signal_def(vsig_name, vsig_id);
 		rep.sigs.Sid2Info[vsig_id].time_unit = rep.sigs.my_repo->time_unit;
 		//rep.dict.SectionName2Id[vsig_name] = 0;
 		MLOG_D("updated dict %d : %d\n", add_section, rep.dict.dicts[add_section].id(vsig_name));
 	}
+	if (!all_virtual_signals_names.empty())
+		rep.dict.compile();
 
 }
 
@@ -52,6 +52,18 @@ public:
 		ADD_SERIALIZATION_FUNCS(change_name, object_type_name, json_query_whitelist, json_query_blacklist, change_command,
 			verbose_level)
 };
+/// The state of a single apply of a model : the created matrix, the repository and the generators' column pointers.
+/// An apply through a context (see MedModel::no_init_apply(MedModelApplyContext &, ...)) does not change the model,
+/// so a model initialized for apply can be applied by several threads at once, each with its own context.
+class MedModelApplyContext {
+public:
+	MedFeatures features; ///< the created matrix
+	MedPidRepository *p_rep = NULL; ///< the repository of the last apply
+	vector<vector<float *>> p_data; ///< per applied generator : pointers to its columns in features
+
+	void clear() { features.clear(); p_rep = NULL; p_data.clear(); }
+};
+
 /// A model = repCleaner + featureGenerator + featureProcessor + MedPredictor
 class MedModel final : public SerializableObject {
 public:
@@ -237,10 +249,24 @@ public:
 
 	void no_init_apply_partial(MedPidRepository& rep, MedSamples& samples, const vector<Effected_Field> &requested_outputs);
 
+	/// Streaming apply in bounded memory : reads samples_fname in chunks of whole ids, loads only those ids' required signals from
+	/// the repository, applies and appends the results to out_fname. The chunk size is derived from mem_budget (bytes, <= 0 : max_data_in_mem
+	/// floats, or 4GB if not set) and adapted to the measured repository data size. The next chunk is read and loaded while the current one is applied.
+	/// The repositories are internal : on return (or exception) p_rep is as before the call and features are cleared.
+	int apply_streaming(const string &rep_conf, const string &samples_fname, const string &out_fname, long long mem_budget = 0,
+		MedModelStage end_stage = MED_MDL_END, int pred_precision = -1, bool print_attributes = true);
+
 	// follows are apply methods separating the initialization of the model from the actual apply
 	int init_model_for_apply(MedPidRepository &rep, MedModelStage start_stage, MedModelStage end_stage);
 	int no_init_apply(MedPidRepository& rep, MedSamples& samples, MedModelStage start_stage, MedModelStage end_stage);
 
+	/// same as no_init_apply/no_init_apply_partial, with the state of the apply (features, repository) kept in ctx rather than in the model.
+	/// the model must be initialized for apply first. Concurrent applies, each with its own context, are safe if supports_context_apply()
+	int no_init_apply(MedModelApplyContext &ctx, MedPidRepository& rep, MedSamples& samples, MedModelStage start_stage, MedModelStage end_stage) const;
+	void no_init_apply_partial(MedModelApplyContext &ctx, MedPidRepository& rep, MedSamples& samples, const vector<Effected_Field> &requested_outputs) const;
+	/// false if a generator or post processor keeps the state of an apply in itself (see FeatureGenerator::apply_keeps_state())
+	bool supports_context_apply() const;
+
 	// Learn with a vector of samples - one for the actual learning, and additional one for each post-processor.
 	// PostProcessors that do not require samples, can be assigned empty samples.
 	int learn(MedPidRepository& rep, MedSamples& model_learning_set, vector<MedSamples>& post_processors_learning_sets) {
@@ -274,7 +300,7 @@ public:
 	int learn_and_apply_feature_processors(MedFeatures &features);
 	int learn_feature_processors(MedFeatures &features);
 	int apply_feature_processors(MedFeatures &features, bool learning);
-	int apply_feature_processors(MedFeatures &features, vector<unordered_set<string>>& req_features_vec, bool learning);
+	int apply_feature_processors(MedFeatures &features, vector<unordered_set<string>>& req_features_vec, bool learning) const;
 	void build_req_features_vec(vector<unordered_set<string>>& req_features_vec) const;
 	void get_applied_generators(unordered_set<string>& req_feature_generators, vector<FeatureGenerator *>& _generators) const;
 
@@ -309,7 +335,15 @@ private:
 	void insert_environment_params_to_json(string& json_content);
 	string json_file_to_string(int recursion_level, const string& main_file, vector<string>& alterations, const string& small_file = "", bool add_change_path = false);
 	void parse_action(basic_ptree<string, string>& action, vector<vector<string>>& all_action_attrs, int& duplicate, ptree& root, const string& fname);
-	int apply_predictor(MedSamples &samples);
+	int apply_predictor(MedSamples &samples, MedFeatures &features) const;
+	// the apply stages, writing to features. gen_p_data : columns of the applied generators, NULL to keep them in the generators
+	int apply_stages(MedPidRepository& rep, MedSamples& samples, MedModelStage start_stage, MedModelStage end_stage, MedFeatures &features,
+		vector<vector<float *>> *gen_p_data) const;
+	void apply_partial(MedPidRepository& rep, MedSamples& samples, const vector<Effected_Field> &requested_outputs, MedFeatures &features,
+		vector<vector<float *>> *gen_p_data) const;
+	int generate_features(MedPidRepository &rep, MedSamples *samples, const vector<FeatureGenerator *>& _generators, MedFeatures &features,
+		vector<vector<float *>> *gen_p_data) const;
+	void make_rep_processors_summary() const;
 
 	// Handle learning sets for model/post-processors
 	void split_learning_set(MedSamples& inSamples, vector<MedSamples>& post_processors_learning_sets, MedSamples& model_learning_set);
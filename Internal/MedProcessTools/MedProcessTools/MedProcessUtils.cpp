@@ -78,7 +78,7 @@ void get_all_required_signal_names(unordered_set<string>& signalNames,
 		rep_processors[i]->get_required_signal_names(signalNames, signalNames);
 }
 
-void get_all_required_signal_ids(unordered_set<int>& signalIds, vector<RepProcessor *>& rep_processors, int position, vector<FeatureGenerator *>& generators) {
+void get_all_required_signal_ids(unordered_set<int>& signalIds, const vector<RepProcessor *>& rep_processors, int position, const vector<FeatureGenerator *>& generators) {
 
 
 	// Collect from generators
@@ -25,7 +25,7 @@ string int_to_string_digits(int i, int ndigits);
 
 // Required signals
 void get_all_required_signal_names(unordered_set<string>& signalNames, const vector<RepProcessor *>& rep_processors, int position, vector<FeatureGenerator *>& generators);
-void get_all_required_signal_ids(unordered_set<int>& signalIds, vector<RepProcessor *>& rep_processors, int position, vector<FeatureGenerator *>& generators);
+void get_all_required_signal_ids(unordered_set<int>& signalIds, const vector<RepProcessor *>& rep_processors, int position, const vector<FeatureGenerator *>& generators);
 void handle_required_signals(vector<RepProcessor *>& processors, vector<FeatureGenerator *>& generators, unordered_set<int>& extra_req_signal_ids,
 	vector<int>& all_req_signal_ids_v, vector<unordered_set<int> >& current_required_signal_ids);
 
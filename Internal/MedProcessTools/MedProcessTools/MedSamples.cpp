@@ -637,6 +637,114 @@ int MedSamples::read_from_file(const string &fname, bool sort_rows)
 	return 0;
 }
 
+//=======================================================================================
+// MedSamplesChunkReader
+//=======================================================================================
+//-------------------------------------------------------------------------------------------
+int MedSamplesChunkReader::open(const string &_fname)
+{
+	close();
+	fname = _fname;
+	inf.open(fname);
+	MLOG("MedSamplesChunkReader: reading %s\n", fname.c_str());
+	if (!inf) {
+		MERR("MedSamplesChunkReader: can't open file %s for read\n", fname.c_str());
+		return -1;
+	}
+	read_records = 0; skipped_records = 0; curr_id = -1;
+	pos.clear(); pred_pos.clear(); attr_pos.clear(); str_attr_pos.clear();
+	has_pending = false;
+	done = false;
+	time_unit = global_default_time_unit;
+	return 0;
+}
+
+// same line handling as MedSamples::read_from_file, one sample at a time
+//-------------------------------------------------------------------------------------------
+int MedSamplesChunkReader::next_sample(MedSample &sample)
+{
+	string curr_line;
+	while (!done && getline(inf, curr_line)) {
+		if ((curr_line.size() <= 1) || (curr_line[0] == '#'))
+			continue;
+		if (curr_line[curr_line.size() - 1] == '\r')
+			curr_line.erase(curr_line.size() - 1);
+		read_records++;
+		vector<string> fields;
+		split(fields, curr_line, boost::is_any_of("\t"));
+		if (fields.size() < 2)
+			continue;
+		if (fields[0] == "NAME" || fields[0] == "DESC" || fields[0] == "TYPE" || fields[0] == "NCATEG") continue;
+		else if (fields[0] == "RAW_FORMAT") raw_format = stoi(fields[1]);
+		else if (fields[0] == "TIME_UNIT") time_unit = med_time_converter.string_to_type(fields[1]);
+		else if ((fields[0] == "EVENT_FIELDS" || fields[0] == "pid" || fields[0] == "id") && read_records == 1)
+			extract_field_pos_from_header(fields, pos, pred_pos, attr_pos, str_attr_pos);
+		else {
+			sample = MedSample();
+			if (sample.parse_from_string(curr_line, pos, pred_pos, attr_pos, str_attr_pos, time_unit, raw_format) < 0) {
+				MWARN("skipping [%s]\n", curr_line.c_str());
+				skipped_records++;
+				if (read_records > 30 && skipped_records > read_records / 2)
+					MTHROW_AND_ERR("skipped %d/%d first records, exiting\n", skipped_records, read_records);
+				continue;
+			}
+			return 1;
+		}
+	}
+	done = true;
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------
+int MedSamplesChunkReader::read_chunk(MedSamples &chunk, int max_samples)
+{
+	chunk.clear();
+	chunk.time_unit = time_unit;
+	chunk.raw_format = raw_format;
+	if (!inf.is_open() && !has_pending)
+		return 0;
+
+	int n_read = 0;
+	unordered_set<int> seen_ids;
+	MedSample sample;
+	while (true) {
+		if (has_pending) {
+			sample = move(pending);
+			has_pending = false;
+		}
+		else if (next_sample(sample) == 0)
+			break;
+
+		if (sample.id != curr_id) {
+			// chunk is closed only at an id boundary
+			if (n_read >= max_samples) {
+				pending = move(sample);
+				has_pending = true;
+				break;
+			}
+			if (seen_ids.find(sample.id) != seen_ids.end())
+				MTHROW_AND_ERR("MedSamplesChunkReader: Sample id [%d] records are not consecutive in %s\n", sample.id, fname.c_str());
+			seen_ids.insert(sample.id);
+			MedIdSamples mis;
+			mis.id = sample.id;
+			mis.split = sample.split;
+			curr_id = sample.id;
+			chunk.idSamples.push_back(mis);
+		}
+		else if (chunk.idSamples.empty() || chunk.idSamples.back().split != sample.split) {
+			MERR("MedSamplesChunkReader: Got conflicting split for id %d in %s\n", sample.id, fname.c_str());
+			return -1;
+		}
+		chunk.idSamples.back().samples.push_back(move(sample));
+		n_read++;
+	}
+	chunk.time_unit = time_unit;
+	chunk.raw_format = raw_format;
+	chunk.sort_by_id_date();
+
+	return n_read;
+}
+
 // Get predictions vector size. Return -1 if not-consistent
 //-------------------------------------------------------------------------------------------
 int MedSamples::get_predictions_size(int& nPreds) {
@@ -250,6 +250,47 @@ public:
 		ADD_SERIALIZATION_FUNCS(time_unit, idSamples)
 };
 
+//.......................................................................................
+/**  MedSamplesChunkReader reads a samples text file (same format as MedSamples::read_from_file) in chunks <br>
+*   of whole ids, allowing to stream over samples files that do not fit in memory. <br>
+*   Ids are expected to be consecutive in the file. Each chunk is sorted by id and date.
+*/
+//.......................................................................................
+class MedSamplesChunkReader {
+public:
+	int time_unit = MedTime::Date; ///< time unit of the file (TIME_UNIT line, default : global default)
+	int raw_format = 0;
+
+	MedSamplesChunkReader() { time_unit = global_default_time_unit; }
+	~MedSamplesChunkReader() { close(); }
+
+	/// <summary> open the file for reading </summary>
+	/// <returns> -1 upon failure to open file, 0 upon success </returns>
+	int open(const string &fname);
+	/// <summary> read the next ids into chunk until at least max_samples samples were read (an id is never split between chunks) </summary>
+	/// <returns> number of samples read (0 at end of file), -1 upon error </returns>
+	int read_chunk(MedSamples &chunk, int max_samples);
+	void close() { if (inf.is_open()) inf.close(); }
+
+	/// <summary> true once all samples were returned </summary>
+	bool eof() const { return done && !has_pending; }
+
+private:
+	ifstream inf;
+	string fname;
+	int read_records = 0, skipped_records = 0, curr_id = -1;
+	map<string, int> pos;
+	vector<int> pred_pos;
+	map<string, int> attr_pos;
+	map<string, int> str_attr_pos;
+	MedSample pending; ///< first sample of the next id, read ahead while closing the previous chunk
+	bool has_pending = false;
+	bool done = false;
+
+	/// read the next sample line : 1 if read, 0 at end of file
+	int next_sample(MedSample &sample);
+};
+
 /**
 * \brief medial namespace for function
 */
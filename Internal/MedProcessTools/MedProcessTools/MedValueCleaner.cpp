@@ -15,14 +15,8 @@ int MedValueCleaner::get_quantile_min_max(vector<float>& values) {
 
 	if (values.size() == 0)
 		MTHROW_AND_ERR("Trying to get quantiles of an empty array\n");
-	if (params.take_log) {
-		for (unsigned int i = 0; i < values.size(); i++) {
-			if (values[i] <= 0)
-				values[i] = params.missing_value;
-			else if (values[i] != params.missing_value)
-				values[i] = log(values[i]);
-		}
-	}
+	if (params.take_log)
+		log_transform(values);
 	sort(values.begin(), values.end());
 
 	float median = values[(int)(values.size() * 0.5)];
@@ -34,6 +28,29 @@ int MedValueCleaner::get_quantile_min_max(vector<float>& values) {
 	float lower = values[lower_access_ind];
 	num_samples_after_cleaning = access_ind - lower_access_ind;
 
+	return quantile_min_max(median, lower, upper);
+};
+
+//.......................................................................................
+// Quantile cleaning from a sketch
+int MedValueCleaner::get_quantile_min_max(const ValueQuantileSketch& sketch) {
+
+	if (sketch.size() == 0)
+		MTHROW_AND_ERR("Trying to get quantiles of an empty sketch\n");
+
+	float median = sketch.get_quantile(0.5);
+	float upper = sketch.get_quantile(1.0 - params.quantile);
+	float lower = sketch.get_quantile(params.quantile);
+	long long access_ind = min((long long)(sketch.size() * (1.0 - params.quantile)), sketch.size() - 1);
+	num_samples_after_cleaning = (int)(access_ind - (long long)(sketch.size() * params.quantile));
+
+	return quantile_min_max(median, lower, upper);
+}
+
+//.......................................................................................
+// Bounds from median and quantiles
+int MedValueCleaner::quantile_min_max(float median, float lower, float upper) {
+
 	if (params.take_log) {
 		if (median <= 0.0 || lower <= 0.0 || upper <= 0.0) {
 			MERR("Cannot take log of non-positive quantile\n");
@@ -52,25 +69,39 @@ int MedValueCleaner::get_quantile_min_max(vector<float>& values) {
 	nbrsMin = median + (lower - median)*params.nbrs_quantile_factor; if (params.take_log) nbrsMin = exp(nbrsMin);
 
 	return 0;
-};
+}
 
 //.......................................................................................
 // Iterative cleaning
 int MedValueCleaner::get_iterative_min_max(vector<float>& values) {
 
+	// Take Log if required
+	if (params.take_log)
+		log_transform(values);
+
+	return iterative_min_max(values, NULL);
+}
+
+//.......................................................................................
+// Iterative cleaning from a sketch : the moments are calculated on the weighted items of the sketch
+int MedValueCleaner::get_iterative_min_max(const ValueQuantileSketch& sketch) {
+
+	vector<float> values, weights;
+	sketch.get_items(values, weights);
+
+	return iterative_min_max(values, &weights);
+}
+
+//.......................................................................................
+// Iterative approximation of moments on (possibly weighted, already transformed) values
+int MedValueCleaner::iterative_min_max(vector<float>& values, const vector<float> *weights) {
+
 	float max_range = params.range_max;
 	float min_range = params.range_min;
 	float trim_max_range = params.trim_range_max;
 	float trim_min_range = params.trim_range_min;
 
-	// Take Log if required
 	if (params.take_log) {
-		for (unsigned int i = 0; i < values.size(); i++) {
-			if (values[i] <= 0)
-				values[i] = params.missing_value;
-			else if (values[i] != params.missing_value)
-				values[i] = log(values[i]);
-		}
 		if (max_range <= 0) max_range = 1;
 		if (min_range <= 0) min_range = (float)0.01;
 		max_range = log(max_range);
@@ -88,7 +119,7 @@ int MedValueCleaner::get_iterative_min_max(vector<float>& values) {
 
 	while (need_to_clean) {
 		need_to_clean = false;
-		medial::stats::get_mean_and_std(values, params.missing_value, num_samples_after_cleaning, mean, sd);
+		medial::stats::get_mean_and_std(values, params.missing_value, num_samples_after_cleaning, mean, sd, weights);
 		if (num_samples_after_cleaning == 0) {
 			MWARN("EMPTY_VECTOR:: learning cleaning parameters from an empty vector\n");
 			trimMax = 0;
@@ -120,6 +151,15 @@ int MedValueCleaner::get_iterative_min_max(vector<float>& values) {
 		}
 	}
 
+	// Number of values (rather than sketch items)
+	if (weights != NULL) {
+		double n = 0;
+		for (unsigned int i = 0; i < values.size(); i++)
+			if (values[i] != params.missing_value)
+				n += (*weights)[i];
+		num_samples_after_cleaning = (int)n;
+	}
+
 	trimMax = vmax; if (params.take_log) trimMax = exp(trimMax);
 	trimMin = vmin; if (params.take_log) trimMin = exp(trimMin);
 	removeMax = mean + params.removing_sd_num * sd; if (params.take_log) removeMax = exp(removeMax);
@@ -139,6 +179,124 @@ int MedValueCleaner::get_iterative_min_max(vector<float>& values) {
 	return 0;
 }
 
+//.......................................................................................
+// Log transform (non positive values are considered missing)
+void MedValueCleaner::log_transform(vector<float>& values) {
+
+	for (unsigned int i = 0; i < values.size(); i++) {
+		if (values[i] <= 0)
+			values[i] = params.missing_value;
+		else if (values[i] != params.missing_value)
+			values[i] = log(values[i]);
+	}
+}
+
+//.......................................................................................
+void MedValueCleaner::add_to_sketch(vector<float>& values, ValueQuantileSketch& sketch) {
+
+	if (params.take_log)
+		log_transform(values);
+	sketch.add(values);
+}
+
+//=======================================================================================
+// ValueQuantileSketch
+//=======================================================================================
+ValueQuantileSketch::ValueQuantileSketch(float rank_error) {
+
+	if (rank_error <= 0 || rank_error >= 1)
+		MTHROW_AND_ERR("ValueQuantileSketch: rank_error should be in (0,1), got %f\n", rank_error);
+	k = max(16, (int)ceil(1.0 / rank_error));
+	levels.resize(1);
+}
+
+//.......................................................................................
+void ValueQuantileSketch::add(float val) {
+
+	levels[0].push_back(val);
+	n++;
+	if (levels[0].size() >= capacity())
+		compact(0);
+}
+
+//.......................................................................................
+// Compact full levels : sort and promote every other item (alternating offsets, to balance the errors).
+// A compaction at level h moves any rank by at most 2^h, and level h is compacted at most n/(2^h*capacity) times,
+// so with a capacity of k times the number of levels the error summed over the levels is at most n/k
+void ValueQuantileSketch::compact(size_t level) {
+
+	while (level < levels.size() && levels[level].size() >= capacity()) {
+		if (level + 1 == levels.size())
+			levels.resize(level + 2);
+
+		vector<float>& curr = levels[level];
+		sort(curr.begin(), curr.end());
+
+		// An odd item stays, so weights sum exactly to n
+		float left = curr.back();
+		bool odd = (curr.size() % 2 == 1);
+		size_t len = curr.size() - (odd ? 1 : 0);
+
+		vector<float>& next = levels[level + 1];
+		for (size_t i = (n_compactions++) % 2; i < len; i += 2)
+			next.push_back(curr[i]);
+
+		curr.clear();
+		if (odd)
+			curr.push_back(left);
+		level++;
+	}
+}
+
+//.......................................................................................
+void ValueQuantileSketch::merge(const ValueQuantileSketch& other) {
+
+	if (other.levels.size() > levels.size())
+		levels.resize(other.levels.size());
+	for (size_t i = 0; i < other.levels.size(); i++)
+		levels[i].insert(levels[i].end(), other.levels[i].begin(), other.levels[i].end());
+	n += other.n;
+
+	for (size_t i = 0; i < levels.size(); i++)
+		compact(i);
+}
+
+//.......................................................................................
+void ValueQuantileSketch::get_items(vector<float>& vals, vector<float>& weights) const {
+
+	vector<pair<float, float>> items;
+	for (size_t i = 0; i < levels.size(); i++)
+		for (float val : levels[i])
+			items.push_back({ val, (float)(1LL << i) });
+	sort(items.begin(), items.end());
+
+	vals.resize(items.size());
+	weights.resize(items.size());
+	for (size_t i = 0; i < items.size(); i++) {
+		vals[i] = items[i].first;
+		weights[i] = items[i].second;
+	}
+}
+
+//.......................................................................................
+float ValueQuantileSketch::get_quantile(double q) const {
+
+	if (n == 0)
+		MTHROW_AND_ERR("ValueQuantileSketch: Trying to get quantiles of an empty sketch\n");
+
+	long long rank = min((long long)(n * q), n - 1);
+
+	vector<float> vals, weights;
+	get_items(vals, weights);
+	double cum = 0;
+	for (size_t i = 0; i < vals.size(); i++) {
+		cum += weights[i];
+		if (cum > rank)
+			return vals[i];
+	}
+	return vals.back();
+}
+
 // Init
 //.......................................................................................
 int MedValueCleaner::init(void *_in_params)
@@ -156,6 +314,7 @@ int MedValueCleaner::init(void *_in_params)
 	params.removing_quantile_factor = in_params->removing_quantile_factor;
 	params.doTrim = in_params->doTrim;
 	params.doRemove = in_params->doRemove;
+	params.sketch_eps = in_params->sketch_eps;
 
 
 	return 0;
@@ -189,6 +348,7 @@ int MedValueCleaner::init(map<string, string>& mapper) {
 		else if (field == "trim_range_min") params.trim_range_min = med_stof(entry.second);
 		else if (field == "trim_range_max") params.trim_range_max = med_stof(entry.second);
 		else if (field == "max_samples") params.max_samples = med_stoi(entry.second);
+		else if (field == "sketch_eps") params.sketch_eps = med_stof(entry.second);
 		else if (remove_me.find(field) == remove_me.end()) MWARN("MedValueCleaner:: Warn Unknown param \"%s\"\n", field.c_str());
 		//! [MedValueCleaner::init]
 
@@ -39,6 +39,9 @@ public:
 	/// Utility : maximum number of samples to take for moments calculations
 	int max_samples = 10000;
 
+	/// Learning in bounded memory : if > 0, learn from a quantile sketch with this approximate rank error instead of all values
+	float sketch_eps = 0;
+
 	ValueCleanerParams() {
 		//defautls
 		quantile = 0;
@@ -55,6 +58,41 @@ public:
 
 };
 
+/**
+* A mergeable quantile sketch (KLL style) for learning cleaning bounds in bounded memory.\n
+* Values are kept in levels of compactors, an item at level h standing for 2^h values. A full level is sorted and every
+* other item is promoted to the next level. The capacity of a level is k times the number of levels, so memory is
+* O(k*log^2(n/k)) and the rank error is at most 1/k
+*/
+class ValueQuantileSketch {
+public:
+	/// <summary> rank_error : approximate allowed error in rank, as a fraction of the number of values </summary>
+	ValueQuantileSketch(float rank_error = (float)0.001);
+
+	void add(float val);
+	void add(const vector<float>& vals) { for (float val : vals) add(val); }
+	/// <summary> merge another sketch (e.g. of another thread) into this one </summary>
+	void merge(const ValueQuantileSketch& other);
+
+	/// <summary> drop all values, keeping the rank error </summary>
+	void clear() { n = 0; n_compactions = 0; levels.assign(1, vector<float>()); }
+	/// <summary> number of values added </summary>
+	long long size() const { return n; }
+	/// <summary> all kept items, sorted, with their weights </summary>
+	void get_items(vector<float>& vals, vector<float>& weights) const;
+	/// <summary> approximation of the value at index (int)(q*size()) of the sorted values </summary>
+	float get_quantile(double q) const;
+
+private:
+	int k;
+	long long n = 0;
+	int n_compactions = 0;
+	vector<vector<float>> levels;
+
+	size_t capacity() const { return (size_t)k * levels.size(); }
+	void compact(size_t level);
+};
+
 /** @file
 *  A parent class for single-value cleaners
 */
@@ -79,6 +117,11 @@ public:
 	/// Learning 
 	int get_quantile_min_max(vector<float>& values);
 	int get_iterative_min_max(vector<float>& values);
+	/// Learning from a sketch of the values (filled by add_to_sketch)
+	int get_quantile_min_max(const ValueQuantileSketch& sketch);
+	int get_iterative_min_max(const ValueQuantileSketch& sketch);
+	/// Add values to sketch (values are transformed in place as required by params)
+	void add_to_sketch(vector<float>& values, ValueQuantileSketch& sketch);
 
 	// Init
 	virtual void init_defaults() { return; }
@@ -99,6 +142,11 @@ public:
 		nbrsMin = numeric_limits<float>().min();
 		nbrsMax = numeric_limits<float>().max();
 	}
+
+private:
+	void log_transform(vector<float>& values);
+	int quantile_min_max(float median, float lower, float upper);
+	int iterative_min_max(vector<float>& values, const vector<float> *weights);
 };
 
 #endif
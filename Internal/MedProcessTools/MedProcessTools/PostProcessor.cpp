@@ -142,6 +142,13 @@ void MultiPostProcessor::init_post_processor(MedModel& model) {
 
 }
 
+bool MultiPostProcessor::apply_keeps_state() const {
+	for (const PostProcessor *pp : post_processors)
+		if (pp->apply_keeps_state())
+			return true;
+	return false;
+}
+
 void MultiPostProcessor::Learn(const MedFeatures &matrix) {
 	if (call_parallel_learn) {
 #pragma omp parallel for
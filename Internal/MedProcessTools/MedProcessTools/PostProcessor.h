@@ -53,6 +53,9 @@ public:
 	virtual void get_output_fields(vector<Effected_Field> &fields) const {};
 
 	virtual void init_post_processor(MedModel& mdl) {};
+	/// true if Apply keeps its state in the post processor (or uses the repository of init_post_processor), so concurrent applies
+	/// can't share it (see MedModelApplyContext)
+	virtual bool apply_keeps_state() const { return false; }
 	virtual void Learn(const MedFeatures &matrix);
 	virtual void Apply(MedFeatures &matrix);
 
@@ -93,6 +96,7 @@ public:
 	void get_output_fields(vector<Effected_Field> &fields) const;
 
 	void init_post_processor(MedModel& mdl);
+	bool apply_keeps_state() const;
 
 	void dprint(const string &pref) const;
 
@@ -29,6 +29,7 @@ public:
 	ProbAdjustPostProcessor() { processor_type = PostProcessorTypes::FTR_POSTPROCESS_ADJUST; };
 	~ProbAdjustPostProcessor() { delete priorsModel; };
 	void init_post_processor(MedModel& mdl) { p_rep = mdl.p_rep; inherited_verbosity = mdl.verbosity; }
+	bool apply_keeps_state() const { return true; }
 
 	void get_input_fields(vector<Effected_Field> &fields) const;
 	void get_output_fields(vector<Effected_Field> &fields) const;
@@ -877,10 +877,7 @@ void ConstantValueCalculator::fit_for_repository(MedPidRepository& rep, vector<p
 
 		int vsig_id = rep.sigs.Name2Sid[vsig_name];
 		int add_section = rep.dict.section_id(vsig_name);
-		rep.dict.dicts[add_section].Name2Id[vsig_name] = vsig_id;
-		rep.dict.dicts[0].Name2Id[vsig_name] = vsig_id;
-		rep.dict.dicts[add_section].Id2Name[vsig_id] = vsig_name;
-		rep.dict.dicts[add_section].Id2Names[vsig_id] = { vsig_name };
+		rep.dict.push_new_signal_def(vsig_name, vsig_id);
 		rep.sigs.Sid2Info[vsig_id].time_unit = rep.sigs.my_repo->time_unit;
 		//rep.dict.SectionName2Id[vsig_name] = 0;
 		MLOG_D("updated dict %d : %d\n", add_section, rep.dict.dicts[add_section].id(vsig_name));
@@ -899,6 +896,7 @@ void ConstantValueCalculator::fit_for_repository(MedPidRepository& rep, vector<p
 		++max_id;
 		rep.dict.dicts[section_id].push_new_def(additional_dict_vals[i], max_id);
 	}
+	rep.dict.compile();
 }
 
 //.......................................................................................
@@ -3,6 +3,9 @@
 #define LOCAL_SECTION LOG_REPCLEANER
 #define LOCAL_LEVEL LOG_DEF_LEVEL
 
+#define SKETCH_BUFFER_SIZE 100000 ///< values collected per chunk before adding to the chunk's sketch in get_values_sketch
+#define SKETCH_CHUNK_IDS 1024 ///< ids per sketch in get_values_sketch, fixed so that the result does not depend on the threads
+
 #include "RepProcess.h"
 #include <MedUtils/MedUtils/MedUtils.h>
 #include "RepCreateRegistry.h"
@@ -586,10 +589,16 @@ int RepMultiProcessor::_learn(MedPidRepository &rep, MedSamples &samples, vector
 
 	vector<int> rc(processors.size(), 0);
 
+	// Processors learning from signal values only - single pass
+	vector<bool> done(processors.size(), false);
+	if (shared_learn && shared_values_learn(rep, samples, prev_processors, NULL, done) < 0)
+		return -1;
+
 #pragma omp parallel for schedule(dynamic)
 	for (int j = 0; j < processors.size(); j++)
 	{
-		rc[j] = processors[j]->learn(rep, samples, prev_processors);
+		if (!done[j])
+			rc[j] = processors[j]->learn(rep, samples, prev_processors);
 	}
 
 	for (int r : rc)
@@ -605,10 +614,16 @@ int RepMultiProcessor::_conditional_learn(MedPidRepository &rep, MedSamples &sam
 
 	vector<int> rc(processors.size(), 0);
 
+	// Processors learning from signal values only - single pass
+	vector<bool> done(processors.size(), false);
+	if (shared_learn && shared_values_learn(rep, samples, prev_processors, &neededSignalIds, done) < 0)
+		return -1;
+
 #pragma omp parallel for schedule(dynamic)
 	for (int j = 0; j < processors.size(); j++)
 	{
-		rc[j] = processors[j]->conditional_learn(rep, samples, prev_processors, neededSignalIds);
+		if (!done[j])
+			rc[j] = processors[j]->conditional_learn(rep, samples, prev_processors, neededSignalIds);
 	}
 
 	for (int r : rc)
@@ -617,6 +632,62 @@ int RepMultiProcessor::_conditional_learn(MedPidRepository &rep, MedSamples &sam
 	return 0;
 }
 
+// Learn processors that only need the values of a signal (see RepProcessor::get_learn_values_request) from a single
+// pass over the samples, instead of each processor reading (and processing) the repository on its own
+//.......................................................................................
+int RepMultiProcessor::shared_values_learn(MedPidRepository &rep, MedSamples &samples, vector<RepProcessor *> &prev_processors, const unordered_set<int> *neededSignalIds, vector<bool> &done)
+{
+
+	vector<int> shared;
+	vector<ValuesLearnRequest> requests;
+	for (int j = 0; j < processors.size(); j++)
+	{
+		if (neededSignalIds != NULL)
+		{
+			bool needed = false;
+			for (int signalId : *neededSignalIds)
+				if (processors[j]->is_signal_affected(signalId))
+				{
+					needed = true;
+					break;
+				}
+			if (!needed)
+				continue;
+		}
+
+		ValuesLearnRequest req;
+		if (processors[j]->get_learn_values_request(req))
+		{
+			shared.push_back(j);
+			requests.push_back(req);
+		}
+	}
+
+	// Nothing to share
+	if (shared.size() < 2)
+		return 0;
+
+	vector<vector<float>> values;
+	if (get_values_multi(rep, samples, requests, values, prev_processors) < 0)
+		return -1;
+
+	vector<int> rc(shared.size(), 0);
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < shared.size(); i++)
+	{
+		rc[i] = processors[shared[i]]->learn_from_values(values[i]);
+		vector<float>().swap(values[i]);
+	}
+
+	for (int i = 0; i < shared.size(); i++)
+	{
+		if (rc[i] < 0)
+			return -1;
+		done[shared[i]] = true;
+	}
+	return 0;
+}
+
 // Apply processors
 //.......................................................................................
 int RepMultiProcessor::_apply(PidDynamicRec &rec, vector<int> &time_points, vector<vector<float>> &attributes_mat)
@@ -962,15 +1033,21 @@ int RepBasicOutlierCleaner::iterativeLearn(MedPidRepository &rep, MedSamples &sa
 		return -1;
 	}
 
+	// Bounded memory learning
+	if (params.sketch_eps > 0)
+	{
+		ValueQuantileSketch sketch(params.sketch_eps);
+		get_values_sketch(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, *this, sketch, prev_cleaners);
+		return get_iterative_min_max(sketch);
+	}
+
 	// Get all values
 	vector<float> values;
 	get_values(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, values, prev_cleaners);
 	// MLOG("basic Iterative clean Learn: signalName %s signalId %d :: got %d values()\n", signalName.c_str(), signalId, values.size());
 
 	// Iterative approximation of moments
-	int rc = get_iterative_min_max(values);
-
-	return rc;
+	return learn_from_values(values);
 }
 
 // Learning : learn cleaning boundaries using MedValueCleaner's quantile approximation of moments
@@ -985,17 +1062,59 @@ int RepBasicOutlierCleaner::quantileLearn(MedPidRepository &rep, MedSamples &sam
 		return -1;
 	}
 
+	// Bounded memory learning
+	if (params.sketch_eps > 0)
+	{
+		ValueQuantileSketch sketch(params.sketch_eps);
+		get_values_sketch(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, *this, sketch, prev_cleaners);
+		if (sketch.size() == 0)
+		{
+			MWARN("RepBasicOutlierCleaner::quantileLearn WARNING signal [%d] = [%s] is empty, will not clean outliers\n", signalId,
+				  this->signalName.c_str());
+			return 0;
+		}
+		return get_quantile_min_max(sketch);
+	}
+
 	// Get all values
 	vector<float> values;
 	get_values(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, values, prev_cleaners);
 
+	// Quantile approximation of moments
+	return learn_from_values(values);
+}
+
+// Shared learning : the values learning is based on
+//.......................................................................................
+bool RepBasicOutlierCleaner::get_learn_values_request(ValuesLearnRequest &req)
+{
+
+	// Sketch learning does not hold all values
+	if (signalId == -1 || params.sketch_eps > 0 || (params.type != VAL_CLNR_ITERATIVE && params.type != VAL_CLNR_QUANTILE))
+		return false;
+
+	req.signalId = signalId;
+	req.time_channel = time_channel;
+	req.val_channel = val_channel;
+	req.range_min = params.range_min;
+	req.range_max = params.range_max;
+	return true;
+}
+
+// Learn cleaning boundaries from the collected values
+//.......................................................................................
+int RepBasicOutlierCleaner::learn_from_values(vector<float> &values)
+{
+
+	if (params.type == VAL_CLNR_ITERATIVE)
+		return get_iterative_min_max(values);
+
 	if (values.empty())
 	{
 		MWARN("RepBasicOutlierCleaner::quantileLearn WARNING signal [%d] = [%s] is empty, will not clean outliers\n", signalId,
 			  this->signalName.c_str());
 		return 0;
 	}
-	// Quantile approximation of moments
 	return get_quantile_min_max(values);
 }
 
@@ -1315,6 +1434,70 @@ void RepConfiguredOutlierCleaner::set_signal_ids(MedSignals &sigs)
 	RepBasicOutlierCleaner::set_signal_ids(sigs); // call base class init
 }
 
+// Shared learning : only the "learned" method needs values
+//.......................................................................................
+bool RepConfiguredOutlierCleaner::get_learn_values_request(ValuesLearnRequest &req)
+{
+
+	if (signalId == -1 || cleanMethod != "learned" || (outlierParam.distHigh == "none" && outlierParam.distLow == "none"))
+		return false;
+
+	req.signalId = signalId;
+	req.time_channel = time_channel;
+	req.val_channel = outlierParam.val_channel;
+	req.range_min = outlierParam.logicalLow;
+	req.range_max = outlierParam.logicalHigh;
+	return true;
+}
+
+// Learn bounds of the "learned" method from the values within the logical range
+//.......................................................................................
+int RepConfiguredOutlierCleaner::learn_from_values(vector<float> &values)
+{
+
+	trimMax = outlierParam.trimHigh;
+	trimMin = outlierParam.trimLow;
+	val_channel = outlierParam.val_channel;
+	removeMax = outlierParam.logicalHigh;
+	removeMin = outlierParam.logicalLow;
+	string thisDistHi = outlierParam.distHigh;
+	string thisDistLo = outlierParam.distLow;
+
+	vector<float> filteredValues;
+
+	float borderHi = numeric_limits<float>::max(), borderLo = -99999, logBorderHi = 9999, logBorderLo = -99999;
+	for (auto &el : values)
+		if (el != 0)
+			filteredValues.push_back(el);
+	sort(filteredValues.begin(), filteredValues.end());
+	if (thisDistHi == "norm" || thisDistLo == "norm")
+		learnDistributionBorders(borderHi, borderLo, filteredValues);
+	if (thisDistHi == "lognorm" || thisDistLo == "lognorm")
+	{
+		for (auto &el : filteredValues)
+			if (el > 0)
+				el = log(el);
+			else
+				return (-1);
+
+		learnDistributionBorders(logBorderHi, logBorderLo, filteredValues);
+	}
+	if (thisDistHi == "norm")
+		removeMax = borderHi;
+	else if (thisDistHi == "lognorm")
+		removeMax = expf(logBorderHi);
+	else if (thisDistHi == "manual")
+		removeMax = outlierParam.confirmedHigh;
+	if (thisDistLo == "norm")
+		removeMin = borderLo;
+	else if (thisDistLo == "lognorm")
+		removeMin = expf(logBorderLo);
+	else if (thisDistLo == "manual")
+		removeMin = outlierParam.confirmedLow;
+
+	return (0);
+}
+
 // Learn bounds
 //.......................................................................................
 int RepConfiguredOutlierCleaner::_learn(MedPidRepository &rep, MedSamples &samples, vector<RepProcessor *> &prev_cleaners)
@@ -1340,54 +1523,14 @@ int RepConfiguredOutlierCleaner::_learn(MedPidRepository &rep, MedSamples &sampl
 	{
 		removeMax = outlierParam.logicalHigh;
 		removeMin = outlierParam.logicalLow;
-		string thisDistHi = outlierParam.distHigh;
-		string thisDistLo = outlierParam.distLow;
-		if (thisDistHi == "none" && thisDistLo == "none")
+		if (outlierParam.distHigh == "none" && outlierParam.distLow == "none")
 			return (0); // nothing to learn
 
 		else
 		{
-
-			vector<float> values, filteredValues;
-
-			float borderHi = numeric_limits<float>::max(), borderLo = -99999, logBorderHi = 9999, logBorderLo = -99999;
+			vector<float> values;
 			get_values(rep, samples, signalId, time_channel, val_channel, removeMin, removeMax, values, prev_cleaners);
-			for (auto &el : values)
-				if (el != 0)
-					filteredValues.push_back(el);
-			sort(filteredValues.begin(), filteredValues.end());
-			if (thisDistHi == "norm" || thisDistLo == "norm")
-				learnDistributionBorders(borderHi, borderLo, filteredValues);
-			if (thisDistHi == "lognorm" || thisDistLo == "lognorm")
-			{
-				/*	ofstream dFile;
-				dFile.open("DFILE");
-				for (auto& el : filteredValues)dFile << el << "\n";
-				dFile.close();
-				*/
-
-				for (auto &el : filteredValues)
-					if (el > 0)
-						el = log(el);
-					else
-						return (-1);
-
-				learnDistributionBorders(logBorderHi, logBorderLo, filteredValues);
-			}
-			if (thisDistHi == "norm")
-				removeMax = borderHi;
-			else if (thisDistHi == "lognorm")
-				removeMax = expf(logBorderHi);
-			else if (thisDistHi == "manual")
-				removeMax = outlierParam.confirmedHigh;
-			if (thisDistLo == "norm")
-				removeMin = borderLo;
-			else if (thisDistLo == "lognorm")
-				removeMin = expf(logBorderLo);
-			else if (thisDistLo == "manual")
-				removeMin = outlierParam.confirmedLow;
-
-			return (0);
+			return learn_from_values(values);
 		}
 	}
 
@@ -2178,12 +2321,19 @@ int RepNbrsOutlierCleaner::iterativeLearn(MedPidRepository &rep, MedSamples &sam
 		return -1;
 	}
 
+	// Bounded memory learning
+	if (params.sketch_eps > 0)
+	{
+		ValueQuantileSketch sketch(params.sketch_eps);
+		get_values_sketch(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, *this, sketch, prev_cleaners);
+		return get_iterative_min_max(sketch);
+	}
+
 	// Get all values
 	vector<float> values;
 	get_values(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, values, prev_cleaners);
 
-	int rc = get_iterative_min_max(values);
-	return rc;
+	return learn_from_values(values);
 }
 
 //.......................................................................................
@@ -2197,10 +2347,44 @@ int RepNbrsOutlierCleaner::quantileLearn(MedPidRepository &rep, MedSamples &samp
 		return -1;
 	}
 
+	// Bounded memory learning
+	if (params.sketch_eps > 0)
+	{
+		ValueQuantileSketch sketch(params.sketch_eps);
+		get_values_sketch(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, *this, sketch, prev_cleaners);
+		return get_quantile_min_max(sketch);
+	}
+
 	// Get all values
 	vector<float> values;
 	get_values(rep, samples, signalId, time_channel, val_channel, params.range_min, params.range_max, values, prev_cleaners);
 
+	return learn_from_values(values);
+}
+
+// Shared learning : the values learning is based on
+//.......................................................................................
+bool RepNbrsOutlierCleaner::get_learn_values_request(ValuesLearnRequest &req)
+{
+
+	// Sketch learning does not hold all values
+	if (signalId == -1 || params.sketch_eps > 0 || (params.type != VAL_CLNR_ITERATIVE && params.type != VAL_CLNR_QUANTILE))
+		return false;
+
+	req.signalId = signalId;
+	req.time_channel = time_channel;
+	req.val_channel = val_channel;
+	req.range_min = params.range_min;
+	req.range_max = params.range_max;
+	return true;
+}
+
+//.......................................................................................
+int RepNbrsOutlierCleaner::learn_from_values(vector<float> &values)
+{
+
+	if (params.type == VAL_CLNR_ITERATIVE)
+		return get_iterative_min_max(values);
 	return get_quantile_min_max(values);
 }
 
@@ -5213,10 +5397,12 @@ int RepHistoryLimit::get_sub_usv_data(UniversalSigVec &usv, int from_time, int t
 			int tr_time = usv.Time(i, truncate_time_channel);
 			if (i_time > from_time && i_time <= to_time)
 			{
-				if (tr_time > to_time)
-					usv.setTime(i, truncate_time_channel, to_time);
+				size_t start = data.size();
 				for (int j = element_size * i; j < element_size * (i + 1); j++)
 					data.push_back(udata[j]);
+				// truncating our copy, the record data may be the (read only) repository memory
+				if (tr_time > to_time)
+					usv.setTime(0, truncate_time_channel, to_time, (void *)&data[start]);
 				++len;
 			}
 		}
@@ -5368,6 +5554,27 @@ int RepNumericNoiser::_learn(MedPidRepository &rep, MedSamples &samples, vector<
 	vector<float> v;
 	get_values(rep, samples, signalId, time_channel, val_channel, -FLT_MAX, FLT_MAX, v, prev_cleaners);
 
+	return learn_from_values(v);
+}
+//---------------------------------------------------------------------------------------------------------------
+
+bool RepNumericNoiser::get_learn_values_request(ValuesLearnRequest &req)
+{
+	if (signalId == -1)
+		return false;
+
+	req.signalId = signalId;
+	req.time_channel = time_channel;
+	req.val_channel = val_channel;
+	req.range_min = -FLT_MAX;
+	req.range_max = FLT_MAX;
+	return true;
+}
+//---------------------------------------------------------------------------------------------------------------
+
+int RepNumericNoiser::learn_from_values(vector<float> &v)
+{
+
 	if (v.empty())
 	{
 		MTHROW_AND_ERR("RepNumericNoiser::_learn WARNING signal [%d] = [%s] is empty, will not calculate std\n", signalId,
@@ -5511,6 +5718,58 @@ int RepNumericNoiser::_apply(PidDynamicRec &rec, vector<int> &time_points, vecto
 //=======================================================================================
 // Utility Functions
 //=======================================================================================
+//.......................................................................................
+// Collect values of a (non virtual) signal for a single id, given its time points (in usv), applying preceeding processors
+static void get_id_values(MedRepository &rep, int id, int signalId, int val_channel, float range_min, float range_max, vector<float> &values, vector<RepProcessor *> &prev_processors,
+						  vector<int> &req_signal_ids_v, vector<unordered_set<int>> &current_required_signal_ids, vector<int> &time_points, PidDynamicRec &rec, UniversalSigVec &usv)
+{
+
+	if (prev_processors.size())
+	{
+
+		// Init Dynamic Rec
+		rec.init_from_rep(std::addressof(rep), id, req_signal_ids_v, (int)time_points.size());
+
+		// Process at all time-points
+		vector<vector<float>> dummy_attributes_mat;
+		for (size_t i = 0; i < prev_processors.size(); i++)
+			prev_processors[i]->conditional_apply(rec, time_points, current_required_signal_ids[i], dummy_attributes_mat);
+
+		// Collect
+		int iVersion = 0;
+		rec.uget(signalId, iVersion, rec.usv);
+
+		for (int i = 0; i < usv.len; i++)
+		{
+			// Get a new version if we past the current one
+			if (usv.Time(i) > time_points[iVersion])
+			{
+				iVersion++;
+				if (iVersion == rec.get_n_versions())
+					break;
+				rec.uget(signalId, iVersion, rec.usv);
+			}
+
+			// the version may have less records (e.g. removed by a cleaner)
+			if (i >= rec.usv.len)
+				continue;
+			float ival = rec.usv.Val(i, val_channel);
+			if (ival >= range_min && ival <= range_max)
+				values.push_back(ival);
+		}
+	}
+	else
+	{
+		// Collect
+		for (int i = 0; i < usv.len; i++)
+		{
+			float ival = usv.Val(i, val_channel);
+			if (ival >= range_min && ival <= range_max)
+				values.push_back(ival);
+		}
+	}
+}
+
 //.......................................................................................
 // Get values of a signal from a set of ids
 int get_values(MedRepository &rep, MedSamples &samples, int signalId, int time_channel, int val_channel, float range_min, float range_max, vector<float> &values, vector<RepProcessor *> &prev_processors)
@@ -5525,6 +5784,8 @@ int get_values(MedRepository &rep, MedSamples &samples, int signalId, int time_c
 
 	PidDynamicRec rec;
 	UniversalSigVec usv;
+	// usv points into the signal while the record is initialized
+	MedRepositoryPins pins(rep, { signalId });
 
 	bool signalIsVirtual = (bool)(rep.sigs.Sid2Info[signalId].virtual_sig != 0);
 
@@ -5557,66 +5818,226 @@ int get_values(MedRepository &rep, MedSamples &samples, int signalId, int time_c
 			if (time_points.empty())
 				continue;
 
-			if (prev_processors.size())
-			{
+			get_id_values(rep, id, signalId, val_channel, range_min, range_max, values, prev_processors, req_signal_ids_v, current_required_signal_ids, time_points, rec, usv);
+		}
+	}
+	return 0;
+}
+//.......................................................................................
+int get_values(
+	MedRepository &rep,
+	MedSamples &samples,
+	int signalId,
+	int time_channel,
+	int val_channel,
+	float range_min,
+	float range_max,
+	vector<float> &values)
+{
+	vector<RepProcessor *> temp;
+	return get_values(rep, samples, signalId, time_channel, val_channel, range_min, range_max, values, temp);
+}
+//.......................................................................................
+// Get a sketch of the values of a signal from a set of ids, in bounded memory.
+// Ids are split to fixed chunks, each filling its own sketch (chunks are handled in parallel), and the sketches are merged
+// in chunk order, so the result is the same for any number of threads
+int get_values_sketch(MedRepository &rep, MedSamples &samples, int signalId, int time_channel, int val_channel, float range_min, float range_max, MedValueCleaner &cleaner,
+					  ValueQuantileSketch &sketch, vector<RepProcessor *> &prev_processors)
+{
 
-				// Init Dynamic Rec
-				rec.init_from_rep(std::addressof(rep), id, req_signal_ids_v, (int)time_points.size());
+	// Required signals
+	vector<int> req_signal_ids_v;
+	vector<unordered_set<int>> current_required_signal_ids(prev_processors.size());
+	vector<FeatureGenerator *> noGenerators;
+	unordered_set<int> extra_req_signal_ids = {signalId};
+	handle_required_signals(prev_processors, noGenerators, extra_req_signal_ids, req_signal_ids_v, current_required_signal_ids);
 
-				// Process at all time-points
-				vector<vector<float>> dummy_attributes_mat;
-				for (size_t i = 0; i < prev_processors.size(); i++)
-					prev_processors[i]->conditional_apply(rec, time_points, current_required_signal_ids[i], dummy_attributes_mat);
+	// Virtual signals have no values to collect (see get_values)
+	if (rep.sigs.Sid2Info[signalId].virtual_sig != 0)
+		return 0;
 
-				// If virtual - we need to get the signal now
-				if (signalIsVirtual)
-					rec.uget(signalId, 0, usv);
+	int n_th = omp_get_max_threads();
+	int nids = (int)samples.idSamples.size();
+	int n_chunks = (nids + SKETCH_CHUNK_IDS - 1) / SKETCH_CHUNK_IDS;
+	ValueQuantileSketch empty_sketch = sketch;
+	empty_sketch.clear();
+	MedRepositoryPins pins(rep, { signalId });
 
-				// Collect
-				int iVersion = 0;
-				rec.uget(signalId, iVersion, rec.usv);
+	// a wave of chunks at a time, bounding the number of sketches kept
+	int wave = 4 * n_th;
+	for (int from = 0; from < n_chunks; from += wave)
+	{
+		int to = min(n_chunks, from + wave);
+		vector<ValueQuantileSketch> chunk_sketches(to - from, empty_sketch);
 
-				for (int i = 0; i < usv.len; i++)
+#pragma omp parallel num_threads(n_th)
+		{
+			PidDynamicRec rec;
+			UniversalSigVec usv;
+			vector<int> time_points;
+			vector<float> buffer;
+
+#pragma omp for schedule(static, 1)
+			for (int c = from; c < to; c++)
+			{
+				ValueQuantileSketch &chunk_sketch = chunk_sketches[c - from];
+				buffer.clear();
+				int last = min(nids, (c + 1) * SKETCH_CHUNK_IDS);
+				for (int i = c * SKETCH_CHUNK_IDS; i < last; i++)
 				{
-					// Get a new version if we past the current one
-					if (usv.Time(i) > time_points[iVersion])
+					int id = samples.idSamples[i].id;
+					rep.uget(id, signalId, usv);
+					if (usv.len == 0)
+						continue;
+
+					time_points.resize(usv.len);
+					for (int j = 0; j < usv.len; j++)
+						time_points[j] = usv.Time(j, time_channel);
+
+					get_id_values(rep, id, signalId, val_channel, range_min, range_max, buffer, prev_processors, req_signal_ids_v, current_required_signal_ids, time_points, rec, usv);
+					if (buffer.size() >= SKETCH_BUFFER_SIZE)
 					{
-						iVersion++;
-						if (iVersion == rec.get_n_versions())
-							break;
-						rec.uget(signalId, iVersion, rec.usv);
+						cleaner.add_to_sketch(buffer, chunk_sketch);
+						buffer.clear();
 					}
+				}
+				cleaner.add_to_sketch(buffer, chunk_sketch);
+			}
+		}
+
+		for (ValueQuantileSketch &chunk_sketch : chunk_sketches)
+			sketch.merge(chunk_sketch);
+	}
 
-					float ival = rec.usv.Val(i, val_channel);
-					if (ival >= range_min && ival <= range_max)
-						values.push_back(ival);
+	return 0;
+}
+//.......................................................................................
+// Get values for a set of requests in a single pass over the samples.
+// Preceeding processors are applied once per id at the union of the time-points of all requested signals. Values of each
+// request are read as get_values reads them (the version at each time point is the one at the same time in the union),
+// so they are identical to get_values of each request. Values are ordered by samples.idSamples as in get_values
+int get_values_multi(MedRepository &rep, MedSamples &samples, const vector<ValuesLearnRequest> &requests, vector<vector<float>> &values, vector<RepProcessor *> &prev_processors)
+{
+
+	values.assign(requests.size(), vector<float>());
+	if (requests.empty())
+		return 0;
+
+	// Required signals
+	vector<int> req_signal_ids_v;
+	vector<unordered_set<int>> current_required_signal_ids(prev_processors.size());
+	vector<FeatureGenerator *> noGenerators;
+	unordered_set<int> extra_req_signal_ids;
+	for (const ValuesLearnRequest &req : requests)
+		extra_req_signal_ids.insert(req.signalId);
+	handle_required_signals(prev_processors, noGenerators, extra_req_signal_ids, req_signal_ids_v, current_required_signal_ids);
+
+	// Virtual signals have no values to collect (see get_values)
+	vector<int> active, active_ids;
+	for (int k = 0; k < requests.size(); k++)
+		if (rep.sigs.Sid2Info[requests[k].signalId].virtual_sig == 0) {
+			active.push_back(k);
+			active_ids.push_back(requests[k].signalId);
+		}
+	MedRepositoryPins pins(rep, active_ids);
+
+	// Per thread collection. A static schedule hands each thread a contiguous block of ids, in thread order
+	int n_th = omp_get_max_threads();
+	vector<vector<vector<float>>> th_values(n_th, vector<vector<float>>(requests.size()));
+	int nids = (int)samples.idSamples.size();
+
+#pragma omp parallel num_threads(n_th)
+	{
+		vector<vector<float>> &my_values = th_values[omp_get_thread_num()];
+		PidDynamicRec rec;
+		UniversalSigVec usv;
+		vector<int> time_points;
+		vector<vector<float>> dummy_attributes_mat;
+
+#pragma omp for schedule(static)
+		for (int i = 0; i < nids; i++)
+		{
+			int id = samples.idSamples[i].id;
+
+			if (prev_processors.empty())
+			{
+				for (int k : active)
+				{
+					const ValuesLearnRequest &req = requests[k];
+					rep.uget(id, req.signalId, usv);
+					for (int j = 0; j < usv.len; j++)
+					{
+						float ival = usv.Val(j, req.val_channel);
+						if (ival >= req.range_min && ival <= req.range_max)
+							my_values[k].push_back(ival);
+					}
 				}
+				continue;
 			}
-			else
+
+			// Union of time points
+			time_points.clear();
+			for (int k : active)
+			{
+				rep.uget(id, requests[k].signalId, usv);
+				for (int j = 0; j < usv.len; j++)
+					time_points.push_back(usv.Time(j, requests[k].time_channel));
+			}
+			if (time_points.empty())
+				continue;
+			sort(time_points.begin(), time_points.end());
+			time_points.erase(unique(time_points.begin(), time_points.end()), time_points.end());
+
+			// Process at all time-points
+			rec.init_from_rep(std::addressof(rep), id, req_signal_ids_v, (int)time_points.size());
+			for (size_t p = 0; p < prev_processors.size(); p++)
+				prev_processors[p]->conditional_apply(rec, time_points, current_required_signal_ids[p], dummy_attributes_mat);
+
+			// Collect - as get_id_values : record i is read (by its index) from the version of the request's time point iVersion,
+			// which is the version at the same time in the union
+			for (int k : active)
 			{
-				// Collect
+				const ValuesLearnRequest &req = requests[k];
+				rep.uget(id, req.signalId, usv);
+				if (usv.len == 0)
+					continue;
+				auto union_version = [&](int iv) { return (int)(lower_bound(time_points.begin(), time_points.end(), usv.Time(iv, req.time_channel)) - time_points.begin()); };
+
+				int iVersion = 0;
+				rec.uget(req.signalId, union_version(iVersion), rec.usv);
 				for (int i = 0; i < usv.len; i++)
 				{
-					float ival = usv.Val(i, val_channel);
-					if (ival >= range_min && ival <= range_max)
-						values.push_back(ival);
+					// Get a new version if we past the current one
+					if (usv.Time(i) > usv.Time(iVersion, req.time_channel))
+					{
+						iVersion++;
+						if (iVersion == usv.len)
+							break;
+						rec.uget(req.signalId, union_version(iVersion), rec.usv);
+					}
+
+					if (i >= rec.usv.len)
+						continue;
+					float ival = rec.usv.Val(i, req.val_channel);
+					if (ival >= req.range_min && ival <= req.range_max)
+						my_values[k].push_back(ival);
 				}
 			}
 		}
 	}
+
+	for (int k : active)
+	{
+		size_t size = 0;
+		for (auto &th : th_values)
+			size += th[k].size();
+		values[k].reserve(size);
+		for (auto &th : th_values)
+		{
+			values[k].insert(values[k].end(), th[k].begin(), th[k].end());
+			vector<float>().swap(th[k]);
+		}
+	}
+
 	return 0;
 }
-//.......................................................................................
-int get_values(
-	MedRepository &rep,
-	MedSamples &samples,
-	int signalId,
-	int time_channel,
-	int val_channel,
-	float range_min,
-	float range_max,
-	vector<float> &values)
-{
-	vector<RepProcessor *> temp;
-	return get_values(rep, samples, signalId, time_channel, val_channel, range_min, range_max, values, temp);
-}
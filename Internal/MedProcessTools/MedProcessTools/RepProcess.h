@@ -10,6 +10,7 @@
 #include <MedMat/MedMat/MedMat.h>
 #include <omp.h>
 #include <cmath>
+#include <cfloat>
 
 #define DEFAULT_REP_CLNR_NTHREADS 8
 
@@ -45,6 +46,16 @@ typedef enum {
 	REP_PROCESS_LAST
 } RepProcessorTypes;
 
+/// The values a processor learns from (see RepProcessor::get_learn_values_request) : the values of one signal channel, within a range,
+/// as get_values() collects them
+struct ValuesLearnRequest {
+	int signalId = -1;
+	int time_channel = 0;
+	int val_channel = 0;
+	float range_min = -FLT_MAX;
+	float range_max = FLT_MAX;
+};
+
 /** @file
 * RepProcessor is the parent class for processing a MedRepository or PidDynamicRec\n
 * Basic functionalities:\n
@@ -174,6 +185,13 @@ public:
 	/// <summary> learn processing model on a subset of ids only if required without preceesing processors </summary>
 	int conditional_learn(MedPidRepository& rep, MedSamples& samples, unordered_set<int>& neededSignalIds) { vector<RepProcessor *> temp;  return _conditional_learn(rep, samples, temp, neededSignalIds); }
 
+	// Shared learning
+	/// <summary> processors whose learning depends only on the values of a single signal return true and fill req. 
+	/// RepMultiProcessor then collects the values of all such processors in a single pass and calls learn_from_values </summary>
+	virtual bool get_learn_values_request(ValuesLearnRequest& req) { return false; }
+	/// <summary> learn from the values described by get_learn_values_request </summary>
+	virtual int learn_from_values(vector<float>& values) { return -1; }
+
 	// Applying
 	/// <summary> apply processing on a single PidDynamicRec at a set of time-points : Should be implemented for all inheriting classes.
 	/// <summary> if time_points is empty, processinng is done for each version for all times </summary>
@@ -245,6 +263,8 @@ public:
 
 	vector<vector<int>> attributes_map; ///< A map from the index of an attribute in the list of attributes of each processor to the index in the list of attributes of the multi-processor
 
+	bool shared_learn = true; ///< if true, processors that learn from signal values (get_learn_values_request) are fed from a single pass over the samples. not serialized
+
 	/// <summary> Constructor </summary>
 	RepMultiProcessor() { processor_type = REP_PROCESS_MULTI; };
 	~RepMultiProcessor() { clear(); };
@@ -293,6 +313,9 @@ public:
 	/// <summary> learn processors </summary>
 	int _learn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processors);
 	int _conditional_learn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processors, unordered_set<int>& neededSignalIds);
+	/// <summary> learn processors that only need signal values from a single pass over the samples (if neededSignalIds is given - only those affecting them).
+	/// learned processors are marked in done </summary>
+	int shared_values_learn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processors, const unordered_set<int> *neededSignalIds, vector<bool>& done);
 
 	/// <summary> Apply processors </summary>
 	int _apply(PidDynamicRec& rec, vector<int>& time_points, vector<vector<float>>& attributes_vals);
@@ -404,6 +427,9 @@ public:
 	int iterativeLearn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processor);
 	/// <summary> Learning : learn cleaning boundaries using MedValueCleaner's quantile approximation of moments </summary>
 	int quantileLearn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processor);
+	/// <summary> Shared learning : the signal values in [range_min, range_max] </summary>
+	bool get_learn_values_request(ValuesLearnRequest& req);
+	int learn_from_values(vector<float>& values);
 
 	/// <summary> Apply cleaning model </summary>
 	int _apply(PidDynamicRec& rec, vector<int>& time_points, vector<vector<float>>& attributes_mat);
@@ -467,6 +493,9 @@ public:
 
 	/// <summary> learn cleaning boundaries </summary>
 	int _learn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processor);
+	/// <summary> Shared learning : only the "learned" method needs values (within the logical range) </summary>
+	bool get_learn_values_request(ValuesLearnRequest& req);
+	int learn_from_values(vector<float>& values);
 
 	/// The parsed fields from init command.
 	/// @snippet RepProcess.cpp RepConfiguredOutlierCleaner::init
@@ -701,6 +730,9 @@ public:
 	int iterativeLearn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processor);
 	/// <summary> Learning : learn cleaning boundaries using MedValueCleaner's quantile approximation of moments </summary>
 	int quantileLearn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processor);
+	/// <summary> Shared learning : the signal values in [range_min, range_max] </summary>
+	bool get_learn_values_request(ValuesLearnRequest& req);
+	int learn_from_values(vector<float>& values);
 
 	/// <summary> Apply cleaning model </summary>
 	int _apply(PidDynamicRec& rec, vector<int>& time_points, vector<vector<float>>& attributes_mat);
@@ -1976,6 +2008,9 @@ public:
 
 	// learn - nothing to do
 	int _learn(MedPidRepository& rep, MedSamples& samples, vector<RepProcessor *>& prev_processor);
+	// shared learning - std of all signal values
+	bool get_learn_values_request(ValuesLearnRequest& req);
+	int learn_from_values(vector<float>& values);
 
 	// apply
 	int _apply(PidDynamicRec& rec, vector<int>& time_points, vector<vector<float>>& attributes_mat);
@@ -2030,6 +2065,14 @@ int get_values(MedRepository& rep, MedSamples& samples, int signalId, int time_c
 	vector<RepProcessor *>& prev_cleaners);
 /// <summary> Get values of a signal from a set of samples </summary>
 int get_values(MedRepository& rep, MedSamples& samples, int signalId, int time_channel, int val_channel, float range_min, float range_max, vector<float>& values);
+/// <summary> Get a (mergeable, bounded memory) sketch of the values of a signal from a set of samples applying a set of preceeding cleaners.
+/// values are transformed as required by the cleaner before being added </summary>
+int get_values_sketch(MedRepository& rep, MedSamples& samples, int signalId, int time_channel, int val_channel, float range_min, float range_max, MedValueCleaner& cleaner,
+	ValueQuantileSketch& sketch, vector<RepProcessor *>& prev_cleaners);
+/// <summary> Get values for a set of requests in a single pass over the samples, applying a set of preceeding processors once per id.
+/// values[i] holds the values for requests[i] </summary>
+int get_values_multi(MedRepository& rep, MedSamples& samples, const vector<ValuesLearnRequest>& requests, vector<vector<float>>& values,
+	vector<RepProcessor *>& prev_processors);
 
 //=======================================
 // Joining the MedSerialze wagon
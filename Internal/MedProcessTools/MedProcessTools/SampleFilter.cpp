@@ -566,6 +566,7 @@ int MatchingSampleFilter::addToSampleSignature(MedSample& sample, matchingParams
 		signature += to_string(bin) + ":";
 	}
 	else if (stratum.match_type == SMPL_MATCH_SIGNAL) {
+		MedRepositoryPins pins(rep, { stratum.signalId });
 		rep.uget(sample.id, stratum.signalId, usv);
 		if (!stratum.isTimeDependent) {
 			// Signal is not time dependent - take binned value
@@ -663,6 +664,7 @@ int RequiredSignalFilter::_filter(MedRepository& rep, MedSamples& inSamples, Med
 	int signalTimeUnit = rep.sigs.Sid2Info[signalId].time_unit;
 
 	UniversalSigVec usv;
+	MedRepositoryPins pins(rep, { signalId });
 	for (auto& idSamples : inSamples.idSamples) {
 		MedIdSamples outIdSamples(idSamples.id);
 
@@ -754,6 +756,7 @@ int BasicFilteringParams::test_filter(MedSample &sample, MedRepository &rep, int
 
 	UniversalSigVec usv;
 
+	MedRepositoryPins pins(rep, { sig_id });
 	rep.uget(sample.id, sig_id, usv);
 	//MLOG("id %d sig_id %d len %d %f\n", sample.id, sig_id, usv.len, usv.Val(0));
 	//MLOG("id %d sig_id %d len %d\n", sample.id, sig_id, usv.len);
@@ -1020,6 +1023,7 @@ int SanitySimpleFilter::test_filter(MedSample &sample, MedRepository &rep, int &
 
 		UniversalSigVec usv;
 
+		MedRepositoryPins pins(rep, { sig_id });
 		rep.uget(sample.id, sig_id, usv);
 #if SANITY_FILTER_DBG
 		MLOG("SanitySimpleFilter::test_filter(3.5) id %d sig %s sig_id %d\n", sample.id, sig_name.c_str(), sig_id);
@@ -0,0 +1,179 @@
+#include "SigWindowIndex.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <cmath>
+
+//.......................................................................................
+void SigWindowIndex::init(const UniversalSigVec &usv, int time_chan, int val_chan)
+{
+	len = usv.len;
+	usable = true;
+	max_table.clear();
+	min_table.clear();
+
+	times.resize(len);
+	vals.resize(len);
+	psum.resize(len + 1);
+	psum_sq.resize(len + 1);
+
+	psum[0] = 0;
+	psum_sq[0] = 0;
+	dispatch_typed_sig_view(usv, [&](const auto &sv) {
+		for (int i = 0; i < len; i++) {
+			times[i] = sv.Time(i, time_chan);
+			vals[i] = sv.Val(i, val_chan);
+		}
+	});
+
+	center = 0;
+	for (int i = 0; i < len; i++) {
+		if ((i > 0 && times[i] < times[i - 1]) || !isfinite(vals[i])) {
+			usable = false;
+			return;
+		}
+		center += vals[i];
+	}
+	if (len > 0)
+		center /= len;
+
+	for (int i = 0; i < len; i++) {
+		double dval = (double)vals[i] - center;
+		psum[i + 1] = psum[i] + dval;
+		psum_sq[i + 1] = psum_sq[i] + dval * dval;
+	}
+}
+
+//.......................................................................................
+void SigWindowIndex::bounds(int min_time, int max_time, int n, int &from, int &to) const
+{
+	if (n > len) n = len;
+	from = (int)(lower_bound(times.begin(), times.begin() + n, min_time) - times.begin());
+	to = (int)(upper_bound(times.begin() + from, times.begin() + n, max_time) - times.begin());
+}
+
+//.......................................................................................
+// table[k][i] holds the max (min) of vals[i .. i+2^k-1]
+void SigWindowIndex::build_table(vector<vector<float>> &table, bool is_max)
+{
+	table.clear();
+	table.push_back(vals);
+	for (int k = 1; (1 << k) <= len; k++) {
+		const vector<float> &prev = table[k - 1];
+		int half = 1 << (k - 1);
+		int n = len - (1 << k) + 1;
+		vector<float> curr(n);
+		for (int i = 0; i < n; i++)
+			curr[i] = is_max ? std::max(prev[i], prev[i + half]) : std::min(prev[i], prev[i + half]);
+		table.push_back(move(curr));
+	}
+}
+
+//.......................................................................................
+float SigWindowIndex::max(int from, int to)
+{
+	if (max_table.empty()) build_table(max_table, true);
+	int k = 31 - __builtin_clz((unsigned int)(to - from));
+	return std::max(max_table[k][from], max_table[k][to - (1 << k)]);
+}
+
+//.......................................................................................
+float SigWindowIndex::min(int from, int to)
+{
+	if (min_table.empty()) build_table(min_table, false);
+	int k = 31 - __builtin_clz((unsigned int)(to - from));
+	return std::min(min_table[k][from], min_table[k][to - (1 << k)]);
+}
+
+//=======================================================================================
+// SigWindowSweep
+//=======================================================================================
+bool SigWindowSweep::init(const UniversalSigVec &usv, int time_chan, int val_chan, float _min_value, float _max_value)
+{
+	len = usv.len;
+	min_value = _min_value;
+	max_value = _max_value;
+	from = to = 0;
+	sum = sum_sq = 0;
+	n_in_range = 0;
+	max_q.clear();
+	min_q.clear();
+
+	times.resize(len);
+	vals.resize(len);
+	dispatch_typed_sig_view(usv, [&](const auto &sv) {
+		for (int i = 0; i < len; i++) {
+			times[i] = sv.Time(i, time_chan);
+			vals[i] = sv.Val(i, val_chan);
+		}
+	});
+
+	for (int i = 0; i < len; i++)
+		if ((i > 0 && times[i] < times[i - 1]) || !isfinite(vals[i]))
+			return false;
+
+	return true;
+}
+
+//.......................................................................................
+void SigWindowSweep::advance(int min_time, int max_time)
+{
+	// elements entering the window
+	while (to < len && times[to] <= max_time) {
+		float ival = vals[to];
+		sum += ival;
+		sum_sq += ival * ival;
+		if (ival >= min_value && ival <= max_value) n_in_range++;
+		while (!max_q.empty() && vals[max_q.back()] <= ival) max_q.pop_back();
+		max_q.push_back(to);
+		while (!min_q.empty() && vals[min_q.back()] >= ival) min_q.pop_back();
+		min_q.push_back(to);
+		to++;
+	}
+
+	// elements leaving the window
+	while (from < to && times[from] < min_time) {
+		float ival = vals[from];
+		sum -= ival;
+		sum_sq -= ival * ival;
+		if (ival >= min_value && ival <= max_value) n_in_range--;
+		from++;
+	}
+	while (!max_q.empty() && max_q.front() < from) max_q.pop_front();
+	while (!min_q.empty() && min_q.front() < from) min_q.pop_front();
+
+	// avoid accumulated rounding on an empty window
+	if (from == to) sum = sum_sq = 0;
+}
+
+//=======================================================================================
+// per thread cache
+//=======================================================================================
+namespace {
+	struct WindowIndexCache {
+		const PidDynamicRec *rec = NULL;
+		unsigned long long mod_serial = 0;
+		map<tuple<const void *, int, int, int>, SigWindowIndex> indexes; // (data, sid, time_chan, val_chan) -> index
+	};
+	thread_local WindowIndexCache window_index_cache;
+}
+
+SigWindowIndex *medial::window_index::get(PidDynamicRec &rec, int sid, const UniversalSigVec &usv, int time_chan, int val_chan)
+{
+	if (usv.len <= 0 || time_chan >= usv.n_time_channels() || val_chan >= usv.n_val_channels())
+		return NULL;
+
+	WindowIndexCache &cache = window_index_cache;
+	if (cache.rec != &rec || cache.mod_serial != rec.mod_serial) {
+		cache.indexes.clear();
+		cache.rec = &rec;
+		cache.mod_serial = rec.mod_serial;
+	}
+
+	// versions that are a prefix of the same data share the index built for the longest one seen
+	SigWindowIndex &widx = cache.indexes[make_tuple((const void *)usv.data, sid, time_chan, val_chan)];
+	if (widx.len < usv.len)
+		widx.init(usv, time_chan, val_chan);
+
+	return widx.usable ? &widx : NULL;
+}
@@ -0,0 +1,92 @@
+// SigWindowIndex : fast time window aggregations over a (time channel, value channel) pair of a signal.
+// Window bounds are found with a binary search on the (sorted) time channel, sum/count/avg/std are answered
+// from prefix sums and min/max from sparse tables, so each query is O(log len) instead of a scan of the signal.
+// The prefix sums are of the values centered by their mean, which keeps the differences (and the variance of a
+// window) from cancelling over long histories. Sums may still differ from a linear scan in the last float bits.
+// Indexes are cached per thread for the current PidDynamicRec and shared by all generators using the same
+// signal data and channels (versions pointing to the same data share a single index).
+
+#ifndef _SIG_WINDOW_INDEX_H_
+#define _SIG_WINDOW_INDEX_H_
+
+#include <InfraMed/InfraMed/MedPidRepository.h>
+#include <vector>
+#include <deque>
+#include <cfloat>
+
+using namespace std;
+
+class SigWindowIndex {
+public:
+	int len = 0;			///< number of indexed elements
+	bool usable = false;	///< false if the time channel is not sorted or values are not finite (linear scans should be used then)
+
+	/// build the index for the first len elements of usv
+	void init(const UniversalSigVec &usv, int time_chan, int val_chan);
+
+	/// [from, to) is the range of elements with min_time <= time <= max_time among the first n elements
+	void bounds(int min_time, int max_time, int n, int &from, int &to) const;
+
+	/// sum over [from, to)
+	double sum(int from, int to) const { return (psum[to] - psum[from]) + (to - from) * center; }
+	/// (population) variance over a non empty [from, to)
+	double var(int from, int to) const {
+		double n = to - from, mean = (psum[to] - psum[from]) / n;
+		return (psum_sq[to] - psum_sq[from]) / n - mean * mean;
+	}
+
+	/// min/max over a non empty [from, to) , tables are built on first use
+	float max(int from, int to);
+	float min(int from, int to);
+
+private:
+	vector<int> times;
+	vector<float> vals;
+	double center = 0;				///< mean of all values, subtracted before summing
+	vector<double> psum, psum_sq;	///< prefix sums of (val - center) and (val - center)^2
+	vector<vector<float>> max_table, min_table;
+
+	void build_table(vector<vector<float>> &table, bool is_max);
+};
+
+//=======================================================================================
+// SigWindowSweep : running aggregations over a window moving forward in time.
+// Used when all samples of a pid see the same signal data and their windows [min_time, max_time] are
+// non decreasing : each element enters and leaves the window once, so a whole pid is generated in linear time.
+//=======================================================================================
+class SigWindowSweep {
+public:
+	int from = 0, to = 0;			///< current window is [from, to)
+	double sum = 0, sum_sq = 0;		///< running sums over the window
+	int n_in_range = 0;				///< number of window values in [min_value, max_value]
+
+	/// load the data of usv. returns false if the time channel is not sorted or values are not finite
+	bool init(const UniversalSigVec &usv, int time_chan, int val_chan, float _min_value = -FLT_MAX, float _max_value = FLT_MAX);
+
+	/// move the window to [min_time, max_time] , both must be non decreasing between calls
+	void advance(int min_time, int max_time);
+
+	int count() const { return to - from; }
+	float first() const { return vals[from]; }
+	float last() const { return vals[to - 1]; }
+	/// min/max over a non empty window
+	float max() const { return vals[max_q.front()]; }
+	float min() const { return vals[min_q.front()]; }
+
+private:
+	int len = 0;
+	float min_value = -FLT_MAX, max_value = FLT_MAX;
+	vector<int> times;
+	vector<float> vals;
+	deque<int> max_q, min_q;	///< monotonic queues of window positions (decreasing values for max, increasing for min)
+};
+
+namespace medial {
+	namespace window_index {
+		/// get the thread's cached index for the signal data currently in usv (rec.uget'ed from sid).
+		/// returns NULL if the index can't be used for this data (unsorted times, non finite values)
+		SigWindowIndex *get(PidDynamicRec &rec, int sid, const UniversalSigVec &usv, int time_chan, int val_chan);
+	}
+}
+
+#endif
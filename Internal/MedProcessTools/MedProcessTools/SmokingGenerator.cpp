@@ -600,13 +600,13 @@ int SmokingGenerator::_generate(PidDynamicRec& rec, MedFeatures& features, int i
 //.......................................................................................
 void SmokingGenerator::get_p_data(MedFeatures& features, vector<float *> &_p_data) {
 
-	p_data.resize(SMX_LAST, NULL);
+	_p_data.resize(SMX_LAST, NULL);
 
 	if (iGenerateWeights) {
 		if (names.size() != 1)
 			MTHROW_AND_ERR("Cannot generate weights using a multi-feature generator (type %d generates %d features)\n", generator_type, (int)names.size())
 		else
-			p_data[0] = &(features.weights[0]);
+			_p_data[0] = &(features.weights[0]);
 	}
 
 	for (string &name : names) {
@@ -1,8 +1,9 @@
 #include "MPFeatures.h"
 #include "MedProcessTools/MedProcessTools/MedFeatures.h"
+#include "MedProcessTools/MedProcessTools/MedArrow.h"
 
-MPFeatures::MPFeatures() { o = new MedFeatures(); }
-MPFeatures::MPFeatures(int _time_unit) { o = new MedFeatures(_time_unit); }
+MPFeatures::MPFeatures() { o = new MedFeatures(); o_shared.reset(o); }
+MPFeatures::MPFeatures(int _time_unit) { o = new MedFeatures(_time_unit); o_shared.reset(o); }
 MPFeatures::MPFeatures(MedFeatures* from_ptr) { o_owned = false; o = from_ptr; }
 MPFeatures::MPFeatures(const MPFeatures& other)
 {
@@ -12,11 +13,13 @@ MPFeatures::MPFeatures(const MPFeatures& other)
 	}
 	else {
 		o = new MedFeatures();
+		o_shared.reset(o);
 		*o = *other.o;
 	}
 };
 
-MPFeatures::~MPFeatures() { if (o_owned) delete o; }
+// an owned o is freed by o_shared, once exported arrow columns pointing to it were released too
+MPFeatures::~MPFeatures() {}
 
 int MPFeatures::MEDPY_GET_global_serial_id_cnt() { return MedFeatures::global_serial_id_cnt; };
 void MPFeatures::MEDPY_SET_global_serial_id_cnt(int newval) { MedFeatures::global_serial_id_cnt = newval; };
@@ -196,3 +199,12 @@ MPStringFeatureAttrMapAdaptor& MPStringFeatureAttrMapAdaptor::operator=(const MP
 	return *this;
 }
 
+
+int MPFeatures::export_arrow(unsigned long long schema_address, unsigned long long array_address, const std::vector<std::string>& names) {
+	// features we don't own (e.g. of a model) can't be kept alive by the columns, they are copied
+	return medial::arrow::export_features(*o, (ArrowSchema *)schema_address, (ArrowArray *)array_address, names, o_shared);
+}
+
+int MPFeatures::import_arrow(unsigned long long schema_address, unsigned long long array_address) {
+	return medial::arrow::import_features((ArrowSchema *)schema_address, (ArrowArray *)array_address, *o);
+}
@@ -48,6 +48,7 @@ public:
 
 class MPFeatures {
 	bool o_owned = true;
+	std::shared_ptr<MedFeatures> o_shared; // owns o when o_owned, also held by exported arrow columns
 public:
 	MEDPY_IGNORE(MedFeatures* o);
 
@@ -101,6 +102,17 @@ public:
 	MPSerializableObject asSerializable();
 
 	void split_by_fold(MPFeatures& outMatrix, int iFold, bool isLearning);
+
+	MEDPY_DOC(export_arrow, "export_arrow(schema_address, array_address, list_String names) -> int\n"
+		"  Fills the given ArrowSchema and ArrowArray (Arrow C data interface) with the samples and the features in names (all if empty).\n"
+		"  Feature columns are not copied (they keep the features alive until released), the Features must not be changed while the array is used.\n"
+		"  Features not owned by this object (e.g. the features of a model) are copied");
+	int export_arrow(unsigned long long schema_address, unsigned long long array_address, const std::vector<std::string>& names);
+	MEDPY_DOC(import_arrow, "import_arrow(schema_address, array_address) -> int\n"
+		"  Replaces the content with the given ArrowSchema and ArrowArray (Arrow C data interface) and releases them");
+	int import_arrow(unsigned long long schema_address, unsigned long long array_address);
+	MEDPY_DOC_Dyn("void to_arrow(list_String names=None) -> pyarrow.RecordBatch, feature columns are not copied (see export_arrow)");
+	MEDPY_DOC_Dyn("void from_arrow(batch) -> None, batch is a pyarrow RecordBatch/Table or a pandas DataFrame");
 };
 
 #endif //!__MED__MPFEATURES__H__
@@ -1,5 +1,6 @@
 #include "MPPidRepository.h"
 #include "MPSigExporter.h"
+#include "MPSigView.h"
 #include "MPDictionary.h"
 
 #include <time.h>
@@ -125,6 +126,16 @@ int MPPidRepository::free(string signame)
 {
 	return o->free(signame);
 }
+
+int MPPidRepository::fold_overlays()
+{
+	return o->fold_overlays();
+}
+
+MPSigView MPPidRepository::view_sig(const std::string &signame)
+{
+	return MPSigView(*this, signame);
+}
 #endif
 
 void MPPidRepository::get_sig_structure(string &sig, int &n_time_channels, int &n_val_channels, int *&is_categ)
@@ -12,6 +12,7 @@ class MedPidRepository;
 class MedConvert;
 //class UniversalSigVec;
 class MPSigExporter;
+class MPSigView;
 
 class MPPidRepository {
 private:
@@ -20,6 +21,9 @@ private:
 	void AddData(int patient_id, const char *signalName, int TimeStamps_len, long long* TimeStamps, int Values_len, float* Values);
 	int _load_single_json(void *_js);
 	bool data_load_sorted = false;
+	std::map<int, int> view_refs;		// number of live MPSigView objects per sid
+	std::map<int, bool> view_locked;	// sids the views locked, unlocked when their last view is released
+	friend class MPSigView;
 public:
 	MEDPY_IGNORE(MedPidRepository* o);
 	MPDictionary dict;
@@ -105,6 +109,14 @@ public:
 		"  Free the signal data specified by signame");
 	int free(string signame);
 
+	MEDPY_DOC(fold_overlays, "fold_overlays() -> int\n"
+		"  Writes the repository merged with its overlays (delta repositories) as the new base files, and removes the overlays from its config");
+	int fold_overlays();
+
+	MEDPY_DOC(view_sig, "view_sig(str_signame) -> SigView\n"
+		"  Returns a no copy view of the signal data, loading the signal if needed. The signal is locked while views on it exist");
+	MPSigView view_sig(const std::string& signame);
+
 	MEDPY_DOC_Dyn("void get_sig(const char * sig_name_str, bool translate=true, std::vector<int> * pids=nullptr, bool float32to64=true, bool free_signal=true, const char * regex_str=nullptr, const char * regex_filter=nullptr)");
 
 #endif
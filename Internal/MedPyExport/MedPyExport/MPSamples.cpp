@@ -9,6 +9,7 @@
 #include "InfraMed/InfraMed/MedPidRepository.h"
 #include "MedProcessTools/MedProcessTools/MedModel.h"
 #include "MedProcessTools/MedProcessTools/SampleFilter.h"
+#include "MedProcessTools/MedProcessTools/MedArrow.h"
 #include "MedProcessTools/MedProcessTools/MedSamples.h"
 
 
@@ -410,6 +411,12 @@ void MPSamples::normalize() { o->normalize(); };
 bool MPSamples::same_as(MPSamples &other, int mode) { return o->same_as(*(other.o), mode); };
 int MPSamples::nSamples() { return o->nSamples(); };
 int MPSamples::nSplits() { return o->nSplits(); };
+int MPSamples::export_arrow(unsigned long long schema_address, unsigned long long array_address) {
+	return medial::arrow::export_samples(*o, (ArrowSchema *)schema_address, (ArrowArray *)array_address);
+}
+int MPSamples::import_arrow(unsigned long long schema_address, unsigned long long array_address) {
+	return medial::arrow::import_samples((ArrowSchema *)schema_address, (ArrowArray *)array_address, *o);
+}
 
 void MPSamples::insertRec(int pid, int time, float outcome, int outcomeTime) { o->insertRec(pid, time, outcome, outcomeTime); };
 void MPSamples::insertRec(int pid, int time, float outcome, int outcomeTime, float pred) { o->insertRec(pid, time, outcome, outcomeTime, pred); };
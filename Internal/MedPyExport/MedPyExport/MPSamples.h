@@ -150,6 +150,15 @@ public:
 	MPPandasAdaptor MEDPY__from_df_adaptor();
 	MPPandasAdaptor MEDPY__to_df();
 
+	MEDPY_DOC(export_arrow, "export_arrow(schema_address, array_address) -> int\n"
+		"  Fills the given ArrowSchema and ArrowArray (Arrow C data interface) with the samples columns");
+	int export_arrow(unsigned long long schema_address, unsigned long long array_address);
+	MEDPY_DOC(import_arrow, "import_arrow(schema_address, array_address) -> int\n"
+		"  Replaces the samples with the given ArrowSchema and ArrowArray (Arrow C data interface) and releases them");
+	int import_arrow(unsigned long long schema_address, unsigned long long array_address);
+	MEDPY_DOC_Dyn("void to_arrow() -> pyarrow.RecordBatch");
+	MEDPY_DOC_Dyn("void from_arrow(batch) -> None, batch is a pyarrow RecordBatch/Table or a pandas DataFrame");
+
 
 	void sort_by_id_date();
 	void normalize();
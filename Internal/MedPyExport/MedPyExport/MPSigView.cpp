@@ -0,0 +1,104 @@
+#include "MPSigView.h"
+
+#include "InfraMed/InfraMed/InfraMed.h"
+#include "InfraMed/InfraMed/MedPidRepository.h"
+
+#ifndef AM_API_FOR_CLIENT
+
+// numpy type codes (native sizes) of the generic signal channel types
+static std::string convert_sv_type_to_npy_format(int sv_type)
+{
+	switch (sv_type)
+	{
+	case GenericSigVec::type_enc::INT32: return "i";
+	case GenericSigVec::type_enc::INT64: return "q";
+	case GenericSigVec::type_enc::UINT16: return "H";
+	case GenericSigVec::type_enc::UINT8: return "B";
+	case GenericSigVec::type_enc::UINT32: return "I";
+	case GenericSigVec::type_enc::UINT64: return "Q";
+	case GenericSigVec::type_enc::INT8: return "b";
+	case GenericSigVec::type_enc::INT16: return "h";
+	case GenericSigVec::type_enc::FLOAT32: return "f";
+	case GenericSigVec::type_enc::FLOAT64: return "d";
+	case GenericSigVec::type_enc::FLOAT80: return "g";
+	}
+	throw runtime_error("MedPy: unknown channel type " + to_string(sv_type));
+}
+
+MPSigView::MPSigView(MPPidRepository& _rep, const std::string& signame) : rep(nullptr), data(nullptr), offsets(1, 0), sig_name(signame)
+{
+	MedPidRepository *o = _rep.o;
+	if (o->in_mem_mode_active())
+		throw runtime_error("MedPy: view_sig() is not supported for an in mem repository, use get_sig()");
+	sig_id = o->sigs.sid(signame);
+	if (sig_id <= 0 || sig_id >= (int)o->index.index_table.size())
+		throw runtime_error("MedPy: unknown signal " + signame);
+
+	IndexTable &itable = o->index.index_table[sig_id];
+	if (!itable.is_loaded && o->load(sig_id) < 0)
+		throw runtime_error("MedPy: failed loading signal " + signame);
+
+	UniversalSigVec usv;
+	usv.init_from_repo(*o, sig_id);
+	record_size = (int)usv.size();
+	if (record_size != (int)itable.factor)
+		throw runtime_error("MedPy: signal " + signame + " record size " + to_string(record_size) + " does not match its data " + to_string(itable.factor));
+	for (int tchan = 0; tchan < usv.n_time; tchan++) {
+		names.push_back(string("time") + to_string(tchan));
+		formats.push_back(convert_sv_type_to_npy_format(usv.time_channel_types[tchan]));
+		offsets_in_record.push_back(usv.time_channel_offsets[tchan]);
+	}
+	for (int vchan = 0; vchan < usv.n_val; vchan++) {
+		names.push_back(string("val") + to_string(vchan));
+		formats.push_back(convert_sv_type_to_npy_format(usv.val_channel_types[vchan]));
+		offsets_in_record.push_back(usv.val_channel_offsets[vchan]);
+	}
+
+	if (itable.get_block(data, pids, offsets) < 0)
+		throw runtime_error("MedPy: failed getting the data block of signal " + signame);
+
+	rep = &_rep;
+	acquire();
+}
+
+MPSigView::MPSigView(const MPSigView& other) : rep(other.rep), data(other.data), pids(other.pids), offsets(other.offsets), names(other.names),
+	formats(other.formats), offsets_in_record(other.offsets_in_record), sig_name(other.sig_name), sig_id(other.sig_id), record_size(other.record_size)
+{
+	if (rep != nullptr)
+		acquire();
+}
+
+MPSigView::~MPSigView() { release(); }
+
+void MPSigView::acquire()
+{
+	if (rep->view_refs[sig_id]++ > 0)
+		return;
+	if (!rep->o->index.index_table[sig_id].is_locked) {
+		rep->o->lock(sig_id);
+		rep->view_locked[sig_id] = true;
+	}
+}
+
+void MPSigView::release()
+{
+	if (rep == nullptr)
+		return;
+	if (--rep->view_refs[sig_id] == 0) {
+		rep->view_refs.erase(sig_id);
+		if (rep->view_locked.count(sig_id)) {
+			rep->o->unlock(sig_id);
+			rep->view_locked.erase(sig_id);
+		}
+	}
+	rep = nullptr;
+	data = nullptr;
+	pids.clear();
+	offsets.assign(1, 0);
+}
+
+void MPSigView::get_pids(MEDPY_NP_OUTPUT(int** pids_buf, unsigned long long* pids_buf_len)) { vector_to_buf(pids, pids_buf, pids_buf_len); }
+
+void MPSigView::get_offsets(MEDPY_NP_OUTPUT(unsigned long long** offsets_buf, unsigned long long* offsets_buf_len)) { vector_to_buf(offsets, offsets_buf, offsets_buf_len); }
+
+#endif
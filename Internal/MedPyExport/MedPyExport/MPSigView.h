@@ -0,0 +1,65 @@
+#ifndef __MP_SigView_H
+#define __MP_SigView_H
+
+#include "MedPyCommon.h"
+#include "MPPidRepository.h"
+#ifndef AM_API_FOR_CLIENT
+
+// A read only, no copy view of a loaded signal: the records of all pids are one block in the
+// repository memory (pids order), described by the record layout and the records offsets of each pid.
+// The signal is locked (can't be freed) as long as a view on it exists, numpy arrays on the view keep it.
+class MPSigView {
+	MPPidRepository* rep;
+	unsigned char* data;
+	std::vector<int> pids;
+	std::vector<unsigned long long> offsets;
+	std::vector<std::string> names;
+	std::vector<std::string> formats;
+	std::vector<int> offsets_in_record;
+	void acquire();
+	void release(); // by the destructor only : numpy arrays on the view hold it, so it is released with the last of them
+public:
+	std::string sig_name;
+	int sig_id = -1;
+	int record_size = 0;
+
+	MEDPY_IGNORE(MPSigView(MPPidRepository& _rep, const std::string& signame));
+	MPSigView(const MPSigView& other);
+	~MPSigView();
+
+	MEDPY_DOC(n_records, "n_records ; property(read) -> int\n"
+		"  number of records of all pids");
+	unsigned long long MEDPY_GET_n_records() { return offsets.back(); };
+
+	MEDPY_DOC(address, "address ; property(read) -> int\n"
+		"  the address of the first record (0 if there are none)");
+	unsigned long long MEDPY_GET_address() { return (unsigned long long)data; };
+
+	MEDPY_DOC(field_names, "field_names() -> list_String\n"
+		"  names of the record fields: time0.. for time channels and val0.. for value channels");
+	std::vector<std::string> field_names() { return names; };
+
+	MEDPY_DOC(field_formats, "field_formats() -> list_String\n"
+		"  numpy type codes of the record fields");
+	std::vector<std::string> field_formats() { return formats; };
+
+	MEDPY_DOC(field_offsets, "field_offsets() -> list_Int\n"
+		"  byte offsets of the record fields");
+	std::vector<int> field_offsets() { return offsets_in_record; };
+
+	MEDPY_DOC(get_pids, "get_pids() -> numpy array\n"
+		"  the pids of the signal, sorted");
+	void get_pids(MEDPY_NP_OUTPUT(int** pids_buf, unsigned long long* pids_buf_len));
+
+	MEDPY_DOC(get_offsets, "get_offsets() -> numpy array\n"
+		"  the records of pids[i] are records[offsets[i]:offsets[i+1]]");
+	void get_offsets(MEDPY_NP_OUTPUT(unsigned long long** offsets_buf, unsigned long long* offsets_buf_len));
+
+	MEDPY_DOC_Dyn("void get_view(int from_pid_index=0, int to_pid_index=None) -> numpy structured array, no copy, of the records of pids[from_pid_index:to_pid_index]");
+	MEDPY_DOC_Dyn("void iter_pids(int batch_size=10000) -> iterator of (pids, offsets, records) batches, records are no copy views");
+	MEDPY_DOC_Dyn("void to_df() -> Pandas DataFrame with a pid column and the record fields as no copy columns");
+};
+
+#endif
+
+#endif //__MP_SigView_H
@@ -12,6 +12,7 @@
 #include "MPPidRepository.h"
 #include "MPDictionary.h"
 #include "MPSigExporter.h"
+#include "MPSigView.h"
 #include "MPModel.h"
 #include "MPSplit.h"
 #include "MPTime.h"
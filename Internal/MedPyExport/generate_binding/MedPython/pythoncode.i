@@ -182,6 +182,60 @@ def __export_to_pandas(self, sig_name_str:str, translate:bool=True, pids:list[in
         df[fld] = pd.Categorical.from_codes(codes=df[fld],categories=cat_dict[fld])
     return df
 
+def __sig_view_records(view, start, stop):
+    import ctypes
+    import numpy as np
+    dt = np.dtype({'names': list(view.field_names()), 'formats': list(view.field_formats()),
+                   'offsets': list(view.field_offsets()), 'itemsize': view.record_size})
+    if stop <= start:
+      return np.empty(0, dtype=dt)
+    buf = (ctypes.c_char * (int(stop - start) * view.record_size)).from_address(view.address + int(start) * view.record_size)
+    buf._view = view # the array keeps the view alive, and the view keeps the repository alive
+    arr = np.frombuffer(buf, dtype=dt)
+    arr.flags.writeable = False
+    return arr
+
+def __sig_view_get_view(self, from_pid_index:int=0, to_pid_index:int|None=None) -> 'np.ndarray':
+    """get_view([from_pid_index=0][, to_pid_index=None]) -> numpy structured array
+         A read only view (no copy) of the records of pids[from_pid_index:to_pid_index], all pids by default
+    """
+    offsets = self.get_offsets()
+    fr, to, _ = slice(from_pid_index, to_pid_index).indices(len(offsets) - 1)
+    return __sig_view_records(self, offsets[fr], offsets[max(fr, to)])
+
+def __sig_view_iter_pids(self, batch_size:int=10000):
+    """iter_pids([batch_size=10000]) -> iterator of (pids, offsets, records)
+         Iterates batch_size pids at a time, the records of pids[i] are records[offsets[i]:offsets[i+1]]
+         records is a read only view (no copy) of the batch records
+    """
+    import numpy as np
+    pids = self.get_pids()
+    offsets = self.get_offsets().astype(np.int64)
+    for i in range(0, len(pids), batch_size):
+      j = min(i + batch_size, len(pids))
+      yield pids[i:j], offsets[i:j + 1] - offsets[i], __sig_view_records(self, offsets[i], offsets[j])
+
+def __sig_view_to_df(self) -> 'pd.DataFrame':
+    """to_df() -> Pandas DataFrame
+         pid column and one column per record field. Field columns are not copied (values are not translated)
+    """
+    import pandas as pd
+    import numpy as np
+    records = self.get_view()
+    cols = {'pid': np.repeat(self.get_pids(), np.diff(self.get_offsets().astype(np.int64)))}
+    for name in records.dtype.names:
+      cols[name] = records[name]
+    return pd.DataFrame(cols, copy=False)
+
+def __view_sig(self, sig_name_str:str) -> 'SigView':
+    """view_sig(signame) -> SigView
+         No copy view of the signal data, loading the signal if needed. The signal is locked while views on it exist
+         Use view.get_view(), view.iter_pids() or view.to_df()
+    """
+    view = self._view_sig(sig_name_str)
+    view._rep = self
+    return view
+
 def __features__to_df_imp(self):
     import pandas as pd
     featMatFull = Mat()
@@ -211,6 +265,50 @@ def __features__from_df_imp(self, features_df):
     samples.from_df(features_df.loc[:,features_df.columns[ind_sampes]])
     self.append_samples(samples)
 
+def __arrow_c_structs():
+    from pyarrow.cffi import ffi
+    c_schema = ffi.new('struct ArrowSchema*')
+    c_array = ffi.new('struct ArrowArray*')
+    return c_schema, c_array, int(ffi.cast('uintptr_t', c_schema)), int(ffi.cast('uintptr_t', c_array))
+
+def __arrow_export(self, *args):
+    import pyarrow as pa
+    c_schema, c_array, schema_ptr, array_ptr = __arrow_c_structs()
+    if self.export_arrow(schema_ptr, array_ptr, *args) < 0:
+      raise Exception('export_arrow failed')
+    return pa.RecordBatch._import_from_c(array_ptr, schema_ptr)
+
+def __arrow_import(self, batch):
+    import pyarrow as pa
+    if not isinstance(batch, (pa.RecordBatch, pa.Table)):
+      batch = pa.RecordBatch.from_pandas(batch, preserve_index=False)
+    if isinstance(batch, pa.Table):
+      batch = batch.combine_chunks().to_batches()[0] if batch.num_rows > 0 else pa.RecordBatch.from_pylist([], schema=batch.schema)
+    c_schema, c_array, schema_ptr, array_ptr = __arrow_c_structs()
+    batch._export_to_c(array_ptr, schema_ptr)
+    if self.import_arrow(schema_ptr, array_ptr) < 0:
+      raise Exception('import_arrow failed')
+
+def __features_to_arrow(self, names:list[str]|None=None) -> 'pa.RecordBatch':
+    """to_arrow([names=None]) -> pyarrow.RecordBatch
+         Samples columns (id, time, outcome, outcomeTime, split, pred_N), weight and the features in names (all if None).
+         Feature columns are not copied and keep the features alive: don't change the Features while the batch is used. to_pandas(split_blocks=True) keeps them uncopied
+    """
+    return __arrow_export(self, list() if names is None else list(names))
+
+def __samples_to_arrow(self) -> 'pa.RecordBatch':
+    """to_arrow() -> pyarrow.RecordBatch
+         Samples columns: id, time, outcome, outcomeTime, split, pred_N
+    """
+    return __arrow_export(self)
+
+def __arrow_from_arrow(self, batch) -> None:
+    """from_arrow(batch)
+         Replaces the content with a pyarrow RecordBatch/Table or a pandas DataFrame, columns are copied once.
+         id column is required, time, outcome, outcomeTime, split, pred_N (and weight for Features) are optional, other columns are features
+    """
+    __arrow_import(self, batch)
+
 def __bootstrapResult_to_df(self):
     import pandas as pd
     dict_obj={'Cohort' : [], 'Measurement': [], 'Value': []}
@@ -267,8 +365,17 @@ def __btsimple_to_df(self):
 
 def __bind_external_methods():
     setattr(globals()['PidRepository'],'get_sig', __export_to_pandas)
+    setattr(globals()['PidRepository'],'_view_sig', globals()['PidRepository'].view_sig)
+    setattr(globals()['PidRepository'],'view_sig', __view_sig)
+    setattr(globals()['SigView'],'get_view', __sig_view_get_view)
+    setattr(globals()['SigView'],'iter_pids', __sig_view_iter_pids)
+    setattr(globals()['SigView'],'to_df', __sig_view_to_df)
     setattr(globals()['Features'],'to_df', __features__to_df_imp)
     setattr(globals()['Features'],'from_df', __features__from_df_imp)
+    setattr(globals()['Features'],'to_arrow', __features_to_arrow)
+    setattr(globals()['Features'],'from_arrow', __arrow_from_arrow)
+    setattr(globals()['Samples'],'to_arrow', __samples_to_arrow)
+    setattr(globals()['Samples'],'from_arrow', __arrow_from_arrow)
     setattr(globals()['StringBtResultMap'],'to_df', __bootstrapResult_to_df)
     setattr(globals()['StringFloatMapAdaptor'],'to_df', __btsimple_to_df)
     setattr(globals()['Bootstrap'],'bootstrap', __bootstrap_wrapper)
@@ -833,6 +833,7 @@ int get_diabetes_dates(MedRepository &rep, int pid, string data_mode, int &last_
 		if (dtype == T_DateShort2) data_mode = "thin";
 	}
 
+	MedRepositoryPins pins(rep, { rep.sigs.sid("Glucose"), rep.sigs.sid("HbA1C"), rep.sigs.sid("Drug") });
 	int glu_len, hba1c_len;
 	SDateVal *glu_sdv = (SDateVal *)rep.get(pid, "Glucose", glu_len);
 	SDateVal *hba1c_sdv = (SDateVal *)rep.get(pid, "HbA1C", hba1c_len);
@@ -576,6 +576,7 @@ void MedSamplingStick::init_sampler(MedRepository &rep) {
 	}
 
 	//use p_rep to fetch signals as candidate dates for patient:
+	MedRepositoryPins pins(*p_rep, sig_ids);
 	for (size_t i = 0; i < p_rep->pids.size(); ++i)
 	{
 		int pid = p_rep->pids[i];
@@ -1936,6 +1936,7 @@ int QRF_Forest::transfer_to_forest(vector<QRF_Tree> &trees, QuantizedRF &qrf, in
 	for (int i = 0; i < trees.size(); i++) {
 		transfer_tree_to_res_tree(qrf, trees[i], qtrees[i], mode, all_values);
 	}
+	compile();
 
 	return 0;
 }
@@ -2104,6 +2105,7 @@ int QRF_Forest::get_forest_trees_all_modes(float *x, void *y, const float *w, in
 
 		if (collect_oob) trees[i] = tree;
 	}
+	compile();
 
 #if DEBUG
 	fprintf(stderr, "%d trees transffered\n", ntrees); fflush(stderr);
@@ -2147,35 +2149,101 @@ int QRF_Forest::get_forest_trees_all_modes(float *x, void *y, const float *w, in
 	return 0;
 }
 
-//---------------------------------------------------------------------------------------------
-void get_scoring_thread_params(vector<qrf_scoring_thread_params> &tp, const vector<QRF_ResTree> *qtrees, float *res, int nsamples, int nfeat, float *x, int nsplit, int mode, int n_categ, int get_counts,
-	vector<float> *quantiles, const vector<float> *sorted_values, bool sparse_values)
+//-----------------------------------------------------------------------------------------------------------------------------------
+// QRF_CompiledForest
+//-----------------------------------------------------------------------------------------------------------------------------------
+#define QRF_SCORING_BLOCK	64		// rows scored together, tree by tree
+
+void QRF_CompiledForest::clear()
+{
+	roots.clear(); feat.clear(); split_val.clear(); left.clear(); right.clear();
+	leaf_pred.clear(); leaf_size.clear(); leaf_n_values.clear(); leaf_majority.clear();
+	counts_stride = 0; leaf_counts.clear(); leaf_values_start.clear(); values_idx.clear(); values_cnt.clear();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------------
+void QRF_CompiledForest::compile(const vector<QRF_ResTree> &trees)
+{
+	clear();
+
+	size_t n_nodes = 0, n_leaves = 0, n_values = 0;
+	for (auto &tree : trees) {
+		n_nodes += tree.qnodes.size();
+		for (auto &qn : tree.qnodes) {
+			if (!qn.is_leaf) continue;
+			n_leaves++;
+			counts_stride = max(counts_stride, (int)qn.counts.size());
+			n_values += (qn.value_counts.size() > 0) ? qn.value_counts.size() : qn.values.size();
+		}
+	}
+
+	roots.reserve(trees.size());
+	feat.reserve(n_nodes); split_val.reserve(n_nodes); left.reserve(n_nodes); right.reserve(n_nodes);
+	leaf_pred.reserve(n_leaves); leaf_size.reserve(n_leaves); leaf_n_values.reserve(n_leaves); leaf_majority.reserve(n_leaves);
+	leaf_counts.reserve(n_leaves * counts_stride);
+	leaf_values_start.reserve(n_leaves + 1);
+	values_idx.reserve(n_values); values_cnt.reserve(n_values);
+
+	for (auto &tree : trees) {
+		int root = (int)feat.size();
+		roots.push_back(root);
+		for (auto &qn : tree.qnodes) {
+			split_val.push_back(qn.split_val);
+			if (!qn.is_leaf) {
+				feat.push_back(qn.ifeat);
+				left.push_back(root + qn.left);
+				right.push_back(root + qn.right);
+				continue;
+			}
+
+			feat.push_back(-1);
+			left.push_back((int)leaf_pred.size());
+			right.push_back(-1);
+
+			leaf_pred.push_back(qn.pred);
+			leaf_size.push_back(qn.n_size);
+			leaf_n_values.push_back(qn.tot_n_values);
+			leaf_majority.push_back(qn.majority);
+			for (int k = 0; k < counts_stride; k++)
+				leaf_counts.push_back((k < qn.counts.size()) ? qn.counts[k] : 0);
+
+			// values are kept sparse (zero counts add nothing)
+			leaf_values_start.push_back((int)values_idx.size());
+			if (qn.value_counts.size() > 0) {
+				for (auto &rec : qn.value_counts) {
+					values_idx.push_back(rec.first);
+					values_cnt.push_back(rec.second);
+				}
+			}
+			else {
+				for (unsigned int iVal = 0; iVal < qn.values.size(); iVal++) {
+					if (qn.values[iVal] != 0) {
+						values_idx.push_back(iVal);
+						values_cnt.push_back((unsigned int)qn.values[iVal]);
+					}
+				}
+			}
+		}
+	}
+	leaf_values_start.push_back((int)values_idx.size());
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------------
+void QRF_CompiledForest::get_leaves(const float *x, int nfeat, size_t from, size_t to, vector<int> &leaves) const
 {
-	tp.clear();
-	tp.resize(nsplit);
-	int jump = nsamples / nsplit;
-	int leftover = nsamples - jump * nsplit;
-	int prev = -1;
-	for (int i = 0; i < nsplit; i++) {
-		tp[i].x = x;
-		tp[i].trees = qtrees;
-		tp[i].nfeat = nfeat;
-		tp[i].nsamples = nsamples;
-		tp[i].from = prev + 1; //i*jump;
-		tp[i].to = prev + jump; //(i+1)*jump-1;
-		if (leftover > 0) { leftover--; tp[i].to++; }
-		prev = tp[i].to;
-		tp[i].serial = i;
-		tp[i].state = 0;
-		tp[i].res = res;
-		tp[i].mode = mode;
-		tp[i].n_categ = n_categ;
-		tp[i].get_counts = get_counts;
-		tp[i].quantiles = quantiles;
-		tp[i].sorted_values = sorted_values;
-		tp[i].sparse_values = sparse_values;
-	}
-	tp[nsplit - 1].to = nsamples - 1;
+	int ntrees = n_trees();
+	leaves.resize((to - from + 1) * ntrees);
+
+	for (int j = 0; j < ntrees; j++) {
+		int root = roots[j];
+		for (size_t i = from; i <= to; i++) {
+			const float *xr = &x[i*(size_t)nfeat];
+			int node = root;
+			while (feat[node] >= 0)
+				node = (xr[feat[node]] <= split_val[node]) ? left[node] : right[node];
+			leaves[(i - from)*ntrees + j] = left[node];
+		}
+	}
 }
 
 void QRF_ResNode::get_scores(int mode, int get_counts_flag, int n_categ, vector<float> &scores) const {
@@ -2244,151 +2312,138 @@ void QRF_ResNode::get_scores(int mode, int get_counts_flag, int n_categ, vector<
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------------
-void get_score_thread(void *p)
+// Score rows tp.from..tp.to (inclusive) using the compiled forest, a block of rows at a time
+void score_rows(qrf_scoring_thread_params &tp)
 {
-	qrf_scoring_thread_params *tp = (qrf_scoring_thread_params *)p;
-
-	//	fprintf(stderr,"Starting scoring thread %d :: from %d to %d mode %d n_categ %d\n",tp->serial, tp->from, tp->to, tp->mode, tp->n_categ); fflush(stderr);
+	const QRF_CompiledForest &cf = *(tp.compiled);
+	const float *xf = tp.x;
 
-	const float *xf = tp->x;
-
-	int node;
-	int nfeat = tp->nfeat;
-	const vector<QRF_ResTree> *trees = tp->trees;
-	vector<float> *quantiles = tp->quantiles;
+	int nfeat = tp.nfeat;
+	int ntrees = cf.n_trees();
+	vector<float> *quantiles = tp.quantiles;
 	int n_quantiles = (int)(*quantiles).size();
-	int n_categ = tp->n_categ;
+	int n_categ = tp.n_categ;
+	int n_counts = min(n_categ, cf.counts_stride);
 	vector<float> cnts(n_categ);
+	vector<float> values((*(tp.sorted_values)).size());
+	vector<int> sizes(ntrees);
+	vector<int> leaves;
 
 	// Mat must be FLOAT & REGULAR transposed
-	for (size_t i = tp->from; i <= tp->to; i++) {
-		float sum = 0;
-		float norm = 0;
-
-
-		vector<float> values((*(tp->sorted_values)).size());
-		vector<int> sizes((*(tp->trees)).size());
-		float totWeight = 0, totUnweighted = 0;
-
-		fill(cnts.begin(), cnts.end(), (float)0);
-
-		for (size_t j = 0; j < (*(tp->trees)).size(); j++) {
-			node = 0;
-
-			// Find relevant leaf
-			while (!(*trees)[j].qnodes[node].is_leaf) {
-				if (xf[i*(size_t)nfeat + (size_t)((*trees)[j].qnodes[node].ifeat)] <= (*trees)[j].qnodes[node].split_val)
-					node = (*trees)[j].qnodes[node].left;
-				else
-					node = (*trees)[j].qnodes[node].right;
-			}
-
-			// Add to counts
-			if (tp->mode == QRF_REGRESSION_TREE) {
-				if (tp->get_counts == PREDS_REGRESSION_AVG) { // Average on predictions
-					sum += (*trees)[j].qnodes[node].pred;
-					norm++;
-				}
-				else if (tp->get_counts == PREDS_REGRESSION_WEIGHTED_AVG) { // Weighted average on predictions
-					sum += (*trees)[j].qnodes[node].pred * (*trees)[j].qnodes[node].n_size;
-					norm += (*trees)[j].qnodes[node].n_size;
-				}
-				else { // Quantile Regression or sampling
-					float w = (tp->get_counts == PREDS_REGRESSION_QUANTILE || tp->get_counts == PREDS_REGRESSION_SAMPLE) ? (1.0F) : (1.0F / (*trees)[j].qnodes[node].tot_n_values);
-					if (tp->sparse_values) {
-						for (auto& rec : (*trees)[j].qnodes[node].value_counts)
-							values[rec.first] += w * rec.second;
+	for (size_t block = tp.from; block <= tp.to; block += QRF_SCORING_BLOCK) {
+		size_t block_end = min(block + QRF_SCORING_BLOCK - 1, (size_t)tp.to);
+		cf.get_leaves(xf, nfeat, block, block_end, leaves);
+
+		for (size_t i = block; i <= block_end; i++) {
+			const int *row_leaves = &leaves[(i - block)*ntrees];
+			float sum = 0;
+			float norm = 0;
+			float totWeight = 0, totUnweighted = 0;
+
+			fill(cnts.begin(), cnts.end(), (float)0);
+			fill(values.begin(), values.end(), (float)0);
+
+			for (int j = 0; j < ntrees; j++) {
+				int leaf = row_leaves[j];
+
+				// Add to counts
+				if (tp.mode == QRF_REGRESSION_TREE) {
+					if (tp.get_counts == PREDS_REGRESSION_AVG) { // Average on predictions
+						sum += cf.leaf_pred[leaf];
+						norm++;
 					}
-					else {
-						for (unsigned int iVal = 0; iVal < (*trees)[j].qnodes[node].values.size(); iVal++)
-							values[iVal] += w * (*trees)[j].qnodes[node].values[iVal];
+					else if (tp.get_counts == PREDS_REGRESSION_WEIGHTED_AVG) { // Weighted average on predictions
+						sum += cf.leaf_pred[leaf] * cf.leaf_size[leaf];
+						norm += cf.leaf_size[leaf];
+					}
+					else { // Quantile Regression or sampling
+						float w = (tp.get_counts == PREDS_REGRESSION_QUANTILE || tp.get_counts == PREDS_REGRESSION_SAMPLE) ? (1.0F) : (1.0F / cf.leaf_n_values[leaf]);
+						for (int p = cf.leaf_values_start[leaf]; p < cf.leaf_values_start[leaf + 1]; p++)
+							values[cf.values_idx[p]] += w * cf.values_cnt[p];
+						sizes[j] = cf.leaf_n_values[leaf];
+						totWeight += w * sizes[j];
+						totUnweighted += sizes[j];
 					}
-					sizes[j] = (*trees)[j].qnodes[node].tot_n_values;
-					totWeight += w * sizes[j];
-					totUnweighted += sizes[j];
-				}
-			}
-			else {
-				if (tp->get_counts == PROBS_CATEG_MAJORITY_AVG || tp->get_counts == PREDS_CATEG_MAJORITY_AVG) { // Majority
-					cnts[(*trees)[j].qnodes[node].majority]++;
-					norm++;
-				}
-				else if (tp->get_counts == PROBS_CATEG_AVG_PROBS || tp->get_counts == PREDS_CATEG_AVG_PROBS) { // Average on probabilities
-					assert(((*trees)[j].qnodes[node].n_size) > 0);
-					for (int k = 0; k < n_categ; k++)
-						cnts[k] += ((float)(*trees)[j].qnodes[node].counts[k]) / ((float)(*trees)[j].qnodes[node].n_size);
-					norm++;
 				}
-				else { // Average on counts
-					for (int k = 0; k < n_categ; k++)
-						cnts[k] += (float)(*trees)[j].qnodes[node].counts[k];
-					norm += (*trees)[j].qnodes[node].n_size;
+				else {
+					const int *counts = &cf.leaf_counts[(size_t)leaf * cf.counts_stride];
+					if (tp.get_counts == PROBS_CATEG_MAJORITY_AVG || tp.get_counts == PREDS_CATEG_MAJORITY_AVG) { // Majority
+						cnts[cf.leaf_majority[leaf]]++;
+						norm++;
+					}
+					else if (tp.get_counts == PROBS_CATEG_AVG_PROBS || tp.get_counts == PREDS_CATEG_AVG_PROBS) { // Average on probabilities
+						assert(cf.leaf_size[leaf] > 0);
+						for (int k = 0; k < n_counts; k++)
+							cnts[k] += ((float)counts[k]) / ((float)cf.leaf_size[leaf]);
+						norm++;
+					}
+					else { // Average on counts
+						for (int k = 0; k < n_counts; k++)
+							cnts[k] += (float)counts[k];
+						norm += cf.leaf_size[leaf];
+					}
 				}
 			}
-		}
 
-		if (tp->mode == QRF_REGRESSION_TREE) {
-			if (tp->get_counts == PREDS_REGRESSION_WEIGHTED_AVG || tp->get_counts == PREDS_REGRESSION_AVG)
-				tp->res[i] = sum / norm;
-			else if (tp->get_counts == PREDS_REGRESSION_QUANTILE || tp->get_counts == PREDS_REGRESSION_WEIGHTED_QUANTILE) {
-
-				int ptr = 0;
-				float sumWeight = 0.0F;
-				for (int k = 0; k < n_quantiles; k++) {
-					float q = (*quantiles)[k];
-
-					// -2 >=  q  > -(nTrees + 2) : size of relevant node in tree -(q+2)
-					if ((-q - 2) >= 0 && (-q - 2) < (*(tp->trees)).size())
-						tp->res[i*n_quantiles + k] = (float)sizes[(int)(-q - 2)];
-					else if (q == -1)
-						// Total number of  values
-						tp->res[i*n_quantiles + k] = totUnweighted;
-					else {
-						// Quantile
-						while (sumWeight / totWeight < q && ptr < values.size())
-							sumWeight += values[ptr++];
-						if (ptr > 0) {
-							ptr--;
-							sumWeight -= values[ptr];
+			if (tp.mode == QRF_REGRESSION_TREE) {
+				if (tp.get_counts == PREDS_REGRESSION_WEIGHTED_AVG || tp.get_counts == PREDS_REGRESSION_AVG)
+					tp.res[i] = sum / norm;
+				else if (tp.get_counts == PREDS_REGRESSION_QUANTILE || tp.get_counts == PREDS_REGRESSION_WEIGHTED_QUANTILE) {
+
+					int ptr = 0;
+					float sumWeight = 0.0F;
+					for (int k = 0; k < n_quantiles; k++) {
+						float q = (*quantiles)[k];
+
+						// -2 >=  q  > -(nTrees + 2) : size of relevant node in tree -(q+2)
+						if ((-q - 2) >= 0 && (-q - 2) < ntrees)
+							tp.res[i*n_quantiles + k] = (float)sizes[(int)(-q - 2)];
+						else if (q == -1)
+							// Total number of  values
+							tp.res[i*n_quantiles + k] = totUnweighted;
+						else {
+							// Quantile
+							while (sumWeight / totWeight < q && ptr < values.size())
+								sumWeight += values[ptr++];
+							if (ptr > 0) {
+								ptr--;
+								sumWeight -= values[ptr];
+							}
+							tp.res[i*n_quantiles + k] = (*(tp.sorted_values))[ptr];
 						}
-						tp->res[i*n_quantiles + k] = (*(tp->sorted_values))[ptr];
 					}
 				}
-			}
-			else if (tp->get_counts == PREDS_REGRESSION_SAMPLE) {
-				float p = (0.0 + QRFglobalRNG::rand()) / QRFglobalRNG::max();
-				float sumWeight = 0;
-				for (size_t j = 0; j < values.size(); j++) {
-					sumWeight += values[j];
-					if (sumWeight / totWeight >= p) {
-						tp->res[i] = (*(tp->sorted_values))[j];
-						break;
+				else if (tp.get_counts == PREDS_REGRESSION_SAMPLE) {
+					float p = (0.0 + QRFglobalRNG::rand()) / QRFglobalRNG::max();
+					float sumWeight = 0;
+					for (size_t j = 0; j < values.size(); j++) {
+						sumWeight += values[j];
+						if (sumWeight / totWeight >= p) {
+							tp.res[i] = (*(tp.sorted_values))[j];
+							break;
+						}
 					}
 				}
 			}
-		}
-		else if (tp->get_counts == PREDS_CATEG_MAJORITY_AVG || tp->get_counts == PREDS_CATEG_AVG_COUNTS || tp->get_counts == PREDS_CATEG_AVG_PROBS) {
+			else if (tp.get_counts == PREDS_CATEG_MAJORITY_AVG || tp.get_counts == PREDS_CATEG_AVG_COUNTS || tp.get_counts == PREDS_CATEG_AVG_PROBS) {
 
-			// collapse cnts/norm to a single prediction by expectation
-			tp->res[i] = 0;
-			for (int k = 0; k < n_categ; k++)
-				tp->res[i] += (cnts[k] / norm)*(float)k;
+				// collapse cnts/norm to a single prediction by expectation
+				tp.res[i] = 0;
+				for (int k = 0; k < n_categ; k++)
+					tp.res[i] += (cnts[k] / norm)*(float)k;
 
-		}
-		else {
-			for (int k = 0; k < n_categ; k++)
-				tp->res[i*n_categ + k] = cnts[k] / norm;
+			}
+			else {
+				for (int k = 0; k < n_categ; k++)
+					tp.res[i*n_categ + k] = cnts[k] / norm;
+			}
 		}
 	}
-
-	tp->state = 1; // signing we end the thread
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------------
 void QRF_Forest::score_with_threads(float *x, int nfeat, int nsamples, float *res) const
 {
-	vector<qrf_scoring_thread_params> stp;
-
 	// order quantilers (keeping original order)
 	vector<pair<float, int>> indexd_quantiles(quantiles.size());
 	vector<float> sorted_quantiles(quantiles.size());
@@ -2399,25 +2454,32 @@ void QRF_Forest::score_with_threads(float *x, int nfeat, int nsamples, float *re
 		for (unsigned int i = 0; i < quantiles.size(); i++) sorted_quantiles[i] = indexd_quantiles[i].first;
 	}
 
-	// handle case where nthreads is larger than nsamples
-	int eff_nthreads = MIN(nthreads, nsamples);
-
-	//	fprintf(stderr, "QRF: mode %d get_counts_flag %d n_categ %d\n", mode, get_counts_flag, n_categ);
-	get_scoring_thread_params(stp, &qtrees, res, nsamples, nfeat, x, eff_nthreads, mode, n_categ, get_counts_flag, &sorted_quantiles, &sorted_values, sparse_values);
-	vector<thread> th_handle(eff_nthreads);
-	for (int i = 0; i < eff_nthreads; i++) {
-		th_handle[i] = thread(get_score_thread, (void *)&stp[i]);
-	}
-
-	int n_state = 0;
-	while (n_state < eff_nthreads) {
-		this_thread::sleep_for(chrono::milliseconds(10));
-		n_state = 0;
-		for (int i = 0; i < eff_nthreads; i++)
-			n_state += stp[i].state;
+	qrf_scoring_thread_params tp;
+	tp.x = x;
+	tp.trees = &qtrees;
+	tp.nfeat = nfeat;
+	tp.nsamples = nsamples;
+	tp.serial = 0;
+	tp.state = 0;
+	tp.res = res;
+	tp.mode = mode;
+	tp.n_categ = n_categ;
+	tp.get_counts = get_counts_flag;
+	tp.quantiles = &sorted_quantiles;
+	tp.sorted_values = &sorted_values;
+	tp.sparse_values = sparse_values;
+	tp.compiled = &compiled;	// compiled after learning/deserialization
+
+	// Blocks of rows in parallel
+	int eff_nthreads = MAX(1, MIN(nthreads, nsamples));
+	int n_blocks = (nsamples + QRF_SCORING_BLOCK - 1) / QRF_SCORING_BLOCK;
+#pragma omp parallel for schedule(dynamic) num_threads(eff_nthreads)
+	for (int b = 0; b < n_blocks; b++) {
+		qrf_scoring_thread_params block_tp = tp;
+		block_tp.from = b * QRF_SCORING_BLOCK;
+		block_tp.to = MIN(nsamples, (b + 1) * QRF_SCORING_BLOCK) - 1;
+		score_rows(block_tp);
 	}
-	for (int i = 0; i < eff_nthreads; i++)
-		th_handle[i].join();
 
 	// Reorderd quantiles to original orderd.diff 
 	if (get_counts_flag == PREDS_REGRESSION_WEIGHTED_QUANTILE) {
@@ -2441,7 +2503,9 @@ void QRF_Forest::get_single_score_fast(qrf_scoring_thread_params &params, const
 	params.x = x.data();
 	params.res = preds.data();
 
-	get_score_thread(&params);
+	params.compiled = &compiled;
+
+	score_rows(params);
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------------
@@ -151,6 +151,37 @@ public:
 		ADD_SERIALIZATION_FUNCS(qnodes)
 };
 
+//============================================================================================================================
+// Compiled inference layout of a forest : all trees packed into contiguous node tables, and all leaf payloads in one arena.
+// Built from the QRF_ResTree's after learning/deserialization (not serialized)
+class QRF_CompiledForest {
+public:
+	vector<int> roots;				// first node of each tree
+	vector<int> feat;				// split feature, -1 for leaves
+	vector<float> split_val;
+	vector<int> left;				// children as global node indices. For leaves, left is the leaf index
+	vector<int> right;
+
+	// leaves
+	vector<float> leaf_pred;
+	vector<int> leaf_size;			// n_size
+	vector<int> leaf_n_values;		// tot_n_values
+	vector<int> leaf_majority;
+	int counts_stride = 0;			// counts per leaf (n_categ, 0 for regression)
+	vector<int> leaf_counts;
+	vector<int> leaf_values_start;	// learning values of leaf l are at [leaf_values_start[l], leaf_values_start[l+1])
+	vector<int> values_idx;			// index in sorted_values
+	vector<unsigned int> values_cnt;
+
+	void compile(const vector<QRF_ResTree> &trees);
+	void clear();
+	bool empty() const { return roots.empty(); }
+	int n_trees() const { return (int)roots.size(); }
+
+	// leaves reached by rows from..to (inclusive), tree by tree for locality : leaves[(i-from)*n_trees() + j]
+	void get_leaves(const float *x, int nfeat, size_t from, size_t to, vector<int> &leaves) const;
+};
+
 class QuantizedRF {
 
 public:
@@ -246,6 +277,7 @@ struct qrf_scoring_thread_params {
 	vector<float> *quantiles;
 	const vector<float> *sorted_values;
 	bool sparse_values;
+	const QRF_CompiledForest *compiled;
 
 	int get_counts; // for CATEGORICAL runs there's such an option, 0 - don't get, 1 - sum counts 2 - sum probs
 					//	thread th_handle;
@@ -270,6 +302,7 @@ public:
 							// this is important when we randomize elements to each tree and when we test oob.
 
 	vector<QRF_ResTree> qtrees;		// actual collection of trees built or deserialized
+	QRF_CompiledForest compiled;	// inference layout of qtrees
 
 	// out of bag related arrays
 	int collect_oob;
@@ -326,6 +359,10 @@ public:
 	//int collect_Tree_oob_scores_threaded(float *x, int nfeat, QRF_ResTree &resTree, vector<int>& sample_ids);
 
 
+	// compile qtrees for scoring. should be called whenever qtrees change
+	void compile() { compiled.compile(qtrees); }
+	void post_deserialization() { compile(); }
+
 	// serialization
 	ADD_CLASS_NAME(QRF_Forest)
 		ADD_SERIALIZATION_FUNCS(qtrees, mode, min_node_size, min_spread, n_categ, get_counts_flag, get_only_this_categ, keep_all_values, sparse_values, quantiles, sorted_values, nthreads, take_all_samples, max_depth)
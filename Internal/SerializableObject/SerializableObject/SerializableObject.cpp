@@ -7,6 +7,7 @@
 #include <thread>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 #include "MedIO/MedIO/MedIO.h"
 #include "MedUtils/MedUtils/MedRunPath.h"
 #include <cctype>
@@ -40,18 +41,248 @@ int med_stoi(const string& _Str) {
 }
 
 
+//===================================================================================================================
+// MedSerialize::SerialStream
+//===================================================================================================================
+#define SERIAL_STREAM_CHUNK	(4 << 20)
+
+#ifdef _MSC_VER
+#define serial_fseek _fseeki64
+#define serial_ftell _ftelli64
+#else
+#define serial_fseek fseeko
+#define serial_ftell ftello
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------
+int MedSerialize::SerialStream::open_write(const string &fname)
+{
+	close();
+	f = fopen(fname.c_str(), "wb");
+	if (f == NULL) {
+		SRL_ERR("SerialStream: can't open file %s for write\n", fname.c_str());
+		return -1;
+	}
+	writing = true;
+	buf.reserve(SERIAL_STREAM_CHUNK);
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+int MedSerialize::SerialStream::open_read(const string &fname)
+{
+	close();
+	f = fopen(fname.c_str(), "rb");
+	if (f == NULL) {
+		SRL_ERR("SerialStream: can't open file %s for read\n", fname.c_str());
+		return -1;
+	}
+	writing = false;
+	if (serial_fseek(f, 0, SEEK_END) != 0) {
+		SRL_ERR("SerialStream: can't seek in file %s\n", fname.c_str());
+		close();
+		return -1;
+	}
+	fsize = (unsigned long long)serial_ftell(f);
+	serial_fseek(f, 0, SEEK_SET);
+	next.resize(SERIAL_STREAM_CHUNK);
+	start_fetch();
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+int MedSerialize::SerialStream::close()
+{
+	if (f == NULL)
+		return 0;
+	if (writing)
+		flush();
+	else if (pending.valid())
+		pending.wait();
+	if (fclose(f) != 0)
+		failed = true;
+	f = NULL;
+	int rc = failed ? -1 : 0;
+
+	writing = failed = eof = false;
+	fsize = buf_start = 0;
+	pos = 0;
+	buf.clear(); buf.shrink_to_fit();
+	next.clear(); next.shrink_to_fit();
+	pending = future<size_t>();
+	crc.reset();
+	return rc;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+void MedSerialize::SerialStream::flush()
+{
+	if (!buf.empty() && fwrite(&buf[0], 1, buf.size(), f) != buf.size())
+		failed = true;
+	buf_start += buf.size();
+	buf.clear();
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+size_t MedSerialize::SerialStream::write(const void *data, size_t n)
+{
+	if (f == NULL || !writing || failed) {
+		failed = true;
+		return 0;
+	}
+	if (buf.size() + n > SERIAL_STREAM_CHUNK)
+		flush();
+	if (n >= SERIAL_STREAM_CHUNK) {
+		if (fwrite(data, 1, n, f) != n)
+			failed = true;
+		buf_start += n;
+	}
+	else
+		buf.insert(buf.end(), (const unsigned char *)data, (const unsigned char *)data + n);
+	return n;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+// bytes already flushed are rewritten in the file, the file position is returned to its end
+void MedSerialize::SerialStream::patch(unsigned long long at, const void *data, size_t n)
+{
+	if (f == NULL || !writing || at + n > tell()) {
+		failed = true;
+		return;
+	}
+	const unsigned char *p = (const unsigned char *)data;
+	if (at < buf_start) {
+		size_t in_file = (size_t)min((unsigned long long)n, buf_start - at);
+		if (serial_fseek(f, at, SEEK_SET) != 0 || fwrite(p, 1, in_file, f) != in_file || serial_fseek(f, buf_start, SEEK_SET) != 0)
+			failed = true;
+		at += in_file; p += in_file; n -= in_file;
+	}
+	if (n > 0)
+		memcpy(&buf[at - buf_start], p, n);
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+// reads the next chunk (and adds it to the crc) in the background
+void MedSerialize::SerialStream::start_fetch()
+{
+	pending = async(launch::async, [this]() {
+		size_t n = fread(&next[0], 1, next.size(), f);
+		crc.process_bytes(&next[0], n);
+		return n;
+	});
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+// appends the prefetched chunk to the unconsumed part of buf, returns false at the end of the file
+bool MedSerialize::SerialStream::fetch()
+{
+	if (eof || !pending.valid())
+		return false;
+	size_t n = pending.get();
+
+	if (pos > 0) {
+		buf.erase(buf.begin(), buf.begin() + pos);
+		buf_start += pos;
+		pos = 0;
+	}
+	buf.insert(buf.end(), next.begin(), next.begin() + n);
+
+	if (n < next.size())
+		eof = true;
+	else
+		start_fetch();
+	return n > 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+size_t MedSerialize::SerialStream::read(void *data, size_t n)
+{
+	if (f == NULL || writing || failed) {
+		failed = true;
+		return 0;
+	}
+	unsigned char *p = (unsigned char *)data;
+	size_t done = 0;
+	while (done < n) {
+		if (pos == buf.size() && !fetch()) {
+			failed = true;
+			break;
+		}
+		size_t take = min(n - done, buf.size() - pos);
+		if (p != NULL)
+			memcpy(p + done, &buf[pos], take);
+		pos += take;
+		done += take;
+	}
+	return done;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+size_t MedSerialize::SerialStream::skip(size_t n)
+{
+	return read(NULL, n);
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+// avail may be larger than what is left in the file : then the rest of the file is given
+const unsigned char *MedSerialize::SerialStream::peek(size_t n)
+{
+	if (f == NULL || writing || failed)
+		return NULL;
+	while (buf.size() - pos < n && fetch());
+	if (buf.size() == pos)
+		return NULL;
+	return &buf[pos];
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+void MedSerialize::SerialStream::consume(size_t n)
+{
+	if (n > buf.size() - pos) {
+		failed = true;
+		n = buf.size() - pos;
+	}
+	pos += n;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+unsigned int MedSerialize::SerialStream::checksum()
+{
+	if (f == NULL || writing)
+		return 0;
+	while (!eof && fetch()) {
+		buf_start += buf.size();
+		buf.clear();
+		pos = 0;
+	}
+	return crc.checksum();
+}
+
+//===================================================================================================================
+// SerializableObject streaming : through a blob of the object, ADD_SERIALIZATION_FUNCS overrides these
+//===================================================================================================================
+size_t SerializableObject::serialize_to_stream(MedSerialize::SerialStream &s)
+{
+	return MedSerialize::serialize_blob_stream(s, get_size(), [this](unsigned char *blob) { return serialize(blob); });
+}
+
+size_t SerializableObject::deserialize_from_stream(MedSerialize::SerialStream &s, size_t avail)
+{
+	return MedSerialize::deserialize_blob_stream(s, avail, [this](unsigned char *blob) { return deserialize(blob); });
+}
+
+//===================================================================================================================
+// files are read and written through a SerialStream, only a bounded buffer is kept in memory
 void SerializableObject::_read_from_file(const string &fname, bool throw_on_version_error) {
-	unsigned char *blob;
-	unsigned long long final_size;
+	MedSerialize::SerialStream s;
 
-	if (MedSerialize::read_binary_data_alloc(fname, blob, final_size) < 0)
+	if (s.open_read(fname) < 0)
 		MTHROW_AND_ERR("Error reading model from file %s\n", fname.c_str());
+	unsigned long long final_size = s.file_size();
 
-	boost::crc_32_type checksum_agent;
-	checksum_agent.process_bytes(blob, final_size);
-	MLOG("read_from_file [%s] with crc32 [%d] and size [%ld]\n", fname.c_str(), checksum_agent.checksum(), final_size);
-
-	int vers = *((int*)blob);
+	int vers = 0;
+	if (s.read(&vers, sizeof(int)) != sizeof(int))
+		MTHROW_AND_ERR("Error reading model from file %s : file is too short\n", fname.c_str());
 	if (vers != version()) {
 		if (throw_on_version_error) {
 			if (abs(vers - version()) <= 3) {
@@ -68,12 +299,11 @@ void SerializableObject::_read_from_file(const string &fname, bool throw_on_vers
 				version(), vers);
 		}
 	}
-	unsigned char *blob_without_version = blob + sizeof(int);
 
-	size_t serSize = deserialize(blob_without_version);
-	if (serSize + sizeof(int) != final_size)
+	size_t serSize = deserialize_from_stream(s, final_size - sizeof(int));
+	if (!s.good() || serSize + sizeof(int) != final_size || s.tell() != final_size)
 		MTHROW_AND_ERR("final_size=%lld, serSize=%d\n", final_size, (int)serSize);
-	if (final_size > 0) delete[] blob;
+	MLOG("read_from_file [%s] with crc32 [%d] and size [%ld]\n", fname.c_str(), s.checksum(), final_size);
 }
 
 //read unsafe without checking version:
@@ -89,31 +319,38 @@ int SerializableObject::read_from_file(const string &fname) {
 }
 
 // serialize model and write to file
+// written to a temporary file that replaces fname only when complete : a failure leaves fname as it was
 int SerializableObject::write_to_file(const string &fname)
 {
-	unsigned char *blob;
-	size_t size;
-
-	size = get_size();
+	MedSerialize::SerialStream s;
+	string tmp_fname = fname + ".tmp";
 
-	blob = new unsigned char[size + sizeof(int)];
-	*((int*)blob) = version(); //save version
-	size_t serSize = serialize(blob + sizeof(int));
-	if (size != serSize)
-		MTHROW_AND_ERR("size=%zu, serSize=%d\n", size, (int)serSize);
-
-	size_t final_size = serSize + sizeof(int);
-
-	boost::crc_32_type checksum_agent;
-	checksum_agent.process_bytes(blob, final_size);
-	MLOG("write_to_file [%s] with crc32 [%d]\n", fname.c_str(), checksum_agent.checksum());
-
-	if (MedSerialize::write_binary_data(fname, blob, final_size) < 0) {
+	if (s.open_write(tmp_fname) < 0) {
 		MERR("Error writing model to file %s\n", fname.c_str());
 		return -1;
 	}
+	int vers = version(); //save version
+	s.write(&vers, sizeof(int));
+	size_t serSize = serialize_to_stream(s);
+	unsigned long long size = s.tell() - sizeof(int);
+	boost::system::error_code ec;
+	if (s.close() < 0) {
+		MERR("Error writing model to file %s\n", fname.c_str());
+		boost::filesystem::remove(tmp_fname, ec);
+		return -1;
+	}
+	if (size != serSize) {
+		boost::filesystem::remove(tmp_fname, ec);
+		MTHROW_AND_ERR("size=%llu, serSize=%d\n", size, (int)serSize);
+	}
 
-	if (size > 0) delete[] blob;
+	boost::filesystem::rename(tmp_fname, fname, ec);
+	if (ec) {
+		MERR("Error writing model to file %s : %s\n", fname.c_str(), ec.message().c_str());
+		boost::filesystem::remove(tmp_fname, ec);
+		return -1;
+	}
+	MLOG("write_to_file [%s] with size [%llu]\n", fname.c_str(), size + sizeof(int));
 	return 0;
 }
 
@@ -18,6 +18,8 @@
 #include <map>
 #include <vector>
 #include <regex>
+#include <cstdio>
+#include <future>
 
 using namespace std;
 
@@ -29,6 +31,55 @@ using namespace std;
 * An Abstract class that can be serialized and written/read from file
 */
 
+namespace MedSerialize {
+
+	/// Buffered binary file stream for streaming (de)serialization. The format is the same as the blob serialization,
+	/// but only a bounded buffer is kept in memory. Sizes known only after writing are filled with patch().
+	/// Files are byte-identical to the version followed by the blob, so blob readers read them as before.
+	/// Reading prefetches the next chunk (and its crc) on another thread while the current one is decoded.
+	class SerialStream {
+	public:
+		SerialStream() {}
+		SerialStream(const SerialStream &) = delete;
+		SerialStream &operator=(const SerialStream &) = delete;
+		~SerialStream() { close(); }
+
+		int open_write(const string &fname);
+		int open_read(const string &fname);
+		int close();
+		bool good() const { return f != NULL && !failed; }
+		void set_failed() { failed = true; }
+		unsigned long long file_size() const { return fsize; }
+
+		// writing
+		size_t write(const void *data, size_t n);
+		unsigned long long tell() const { return writing ? buf_start + buf.size() : buf_start + pos; }	///< bytes written (or read) so far
+		void patch(unsigned long long at, const void *data, size_t n);				///< overwrite bytes already written
+
+		// reading
+		size_t read(void *data, size_t n);
+		size_t skip(size_t n);
+		const unsigned char *peek(size_t n);	///< the next n bytes as one block (valid until the next call), NULL if not available
+		void consume(size_t n);
+		unsigned int checksum();				///< crc32 of the whole file (reading: after the file was read to its end)
+
+	private:
+		FILE *f = NULL;
+		bool writing = false, failed = false, eof = false;
+		unsigned long long fsize = 0;
+		vector<unsigned char> buf;				// reading : [pos, buf.size()) is not consumed yet
+		size_t pos = 0;
+		unsigned long long buf_start = 0;		// file offset of buf[0]
+		vector<unsigned char> next;				// chunk being prefetched
+		future<size_t> pending;
+		boost::crc_32_type crc;
+
+		void flush();
+		void start_fetch();
+		bool fetch();
+	};
+}
+
 class SerializableObject {
 public:
 	///Relevant for serializations. if changing serialization, increase version number for the 
@@ -63,6 +114,11 @@ public:
 	virtual size_t serialize(vector<unsigned char> &blob) { return serialize_vec(blob); }
 	virtual size_t deserialize(vector<unsigned char> &blob) { return deserialize_vec(blob); }
 
+	// Streaming serialization (same format) : by default through a blob of the object,
+	// classes with ADD_SERIALIZATION_FUNCS stream their fields one by one. avail : bytes available for the object
+	virtual size_t serialize_to_stream(MedSerialize::SerialStream &s);
+	virtual size_t deserialize_from_stream(MedSerialize::SerialStream &s, size_t avail);
+
 
 
 	/// read and deserialize model
@@ -111,6 +167,8 @@ namespace MedSerialize {																							\
 	template<> inline size_t serialize<Type>(unsigned char *blob, Type &elem) { return elem.serialize(blob); }		\
 	template<> inline size_t deserialize<Type>(unsigned char *blob, Type &elem) { return elem.deserialize(blob); }	\
     template<> inline string object_json<const Type>(const Type &elem) { return elem.object_json(); }	\
+	template<> inline size_t serialize_stream<Type>(SerialStream &s, Type &elem) { return serialize_object_stream(s, elem, 0); }	\
+	template<> inline size_t deserialize_stream<Type>(SerialStream &s, size_t avail, Type &elem) { return deserialize_object_stream(s, avail, elem, 0); }	\
 }
 
 /*! @def ADD_SERIALIZATION_FUNCS(...)
@@ -123,6 +181,12 @@ namespace MedSerialize {																							\
 	virtual size_t get_size() { pre_serialization(); return MedSerialize::get_size_top(#__VA_ARGS__, __VA_ARGS__); }								\
 	virtual size_t serialize(unsigned char *blob) { pre_serialization(); return MedSerialize::serialize_top(blob,  #__VA_ARGS__, __VA_ARGS__); }		\
 	virtual size_t deserialize(unsigned char *blob) { size_t size = MedSerialize::deserialize_top(blob, #__VA_ARGS__, __VA_ARGS__); post_deserialization(); return size;} \
+	virtual size_t serialize_to_stream(MedSerialize::SerialStream &serial_stream) { \
+		if (typeid(*this) != typeid(decltype(*this))) return MedSerialize::serialize_blob_stream(serial_stream, get_size(), [this](unsigned char *blob) { return serialize(blob); }); \
+		pre_serialization(); return MedSerialize::serialize_top_stream(serial_stream, #__VA_ARGS__, __VA_ARGS__); } \
+	virtual size_t deserialize_from_stream(MedSerialize::SerialStream &serial_stream, size_t serial_avail) { \
+		if (typeid(*this) != typeid(decltype(*this))) return MedSerialize::deserialize_blob_stream(serial_stream, serial_avail, [this](unsigned char *blob) { return deserialize(blob); }); \
+		size_t size = MedSerialize::deserialize_top_stream(serial_stream, serial_avail, #__VA_ARGS__, __VA_ARGS__); post_deserialization(); return size; } \
 	virtual void serialized_fields_name(vector<string> &field_names) const { MedSerialize::get_list_names(#__VA_ARGS__, field_names); } \
     virtual string object_json() const { return MedSerialize::object_json_start(my_class_name(), this->version(), #__VA_ARGS__, __VA_ARGS__); }
 
@@ -132,6 +196,8 @@ namespace MedSerialize {																							\
 	virtual size_t get_size(); \
 	virtual size_t serialize(unsigned char *blob); \
 	virtual size_t deserialize(unsigned char *blob); \
+	virtual size_t serialize_to_stream(MedSerialize::SerialStream &serial_stream); \
+	virtual size_t deserialize_from_stream(MedSerialize::SerialStream &serial_stream, size_t serial_avail); \
 	virtual void serialized_fields_name(vector<string> &field_names) const; \
     virtual string object_json() const;
 
@@ -139,6 +205,12 @@ namespace MedSerialize {																							\
 	size_t ClassName::get_size() { pre_serialization(); return MedSerialize::get_size_top(#__VA_ARGS__, __VA_ARGS__); }								\
 	size_t ClassName::serialize(unsigned char *blob) { pre_serialization(); return MedSerialize::serialize_top(blob,  #__VA_ARGS__, __VA_ARGS__); }		\
 	size_t ClassName::deserialize(unsigned char *blob) { return MedSerialize::deserialize_top(blob, #__VA_ARGS__, __VA_ARGS__); post_deserialization();} \
+	size_t ClassName::serialize_to_stream(MedSerialize::SerialStream &serial_stream) { \
+		if (typeid(*this) != typeid(ClassName)) return MedSerialize::serialize_blob_stream(serial_stream, get_size(), [this](unsigned char *blob) { return serialize(blob); }); \
+		pre_serialization(); return MedSerialize::serialize_top_stream(serial_stream, #__VA_ARGS__, __VA_ARGS__); } \
+	size_t ClassName::deserialize_from_stream(MedSerialize::SerialStream &serial_stream, size_t serial_avail) { \
+		if (typeid(*this) != typeid(ClassName)) return MedSerialize::deserialize_blob_stream(serial_stream, serial_avail, [this](unsigned char *blob) { return deserialize(blob); }); \
+		return MedSerialize::deserialize_top_stream(serial_stream, serial_avail, #__VA_ARGS__, __VA_ARGS__); } \
 	void  ClassName::serialized_fields_name(vector<string> &field_names) const { MedSerialize::get_list_names(#__VA_ARGS__, field_names); } \
     string ClassName::object_json() const { return MedSerialize::object_json_start(my_class_name(), this->version(), #__VA_ARGS__, __VA_ARGS__); }
 
@@ -1266,6 +1266,425 @@ namespace MedSerialize {
 		return tot_size;
 	}
 
+	//====================================================================================================
+	// Streaming serialization : writes and reads exactly the blob format above, through a SerialStream,
+	// so that a whole object never has to be held in memory as one blob.
+	// deserialize_stream gets avail : the number of bytes the element may take (used for sanity checks,
+	// and by elements that can only be deserialized from a contiguous blob).
+	// Types with MEDSERIALIZE_SUPPORT are streamed through their serialize_to_stream / deserialize_from_stream.
+	//====================================================================================================
+	template <class T> size_t serialize_stream(SerialStream &s, T &elem);
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, T &elem);
+	template <class T> size_t serialize_stream(SerialStream &s, T *&v);
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, T *&v);
+	template <class T> size_t serialize_stream(SerialStream &s, unique_ptr<T> &v);
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, unique_ptr<T> &v);
+	template <class T> size_t serialize_stream(SerialStream &s, vector<T> &v);
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, vector<T> &v);
+	template <class T, class S> size_t serialize_stream(SerialStream &s, pair<T, S> &v);
+	template <class T, class S> size_t deserialize_stream(SerialStream &s, size_t avail, pair<T, S> &v);
+	template <class T, class S> size_t serialize_stream(SerialStream &s, map<T, S> &v);
+	template <class T, class S> size_t deserialize_stream(SerialStream &s, size_t avail, map<T, S> &v);
+	template <class T, class S> size_t serialize_stream(SerialStream &s, unordered_map<T, S> &v);
+	template <class T, class S> size_t deserialize_stream(SerialStream &s, size_t avail, unordered_map<T, S> &v);
+	template <class T> size_t serialize_stream(SerialStream &s, set<T> &v);
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, set<T> &v);
+	template <class T> size_t serialize_stream(SerialStream &s, unordered_set<T> &v);
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, unordered_set<T> &v);
+
+	inline size_t stream_left(size_t avail, size_t pos) { return (avail > pos) ? avail - pos : 0; }
+
+	//.........................................................................................
+	// simple types : as is
+	//.........................................................................................
+	template <class T> size_t serialize_stream(SerialStream &s, T &elem)
+	{
+		return s.write(&elem, sizeof(T));
+	}
+
+	//.........................................................................................
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, T &elem)
+	{
+		if (sizeof(T) > avail) { s.set_failed(); return 0; }
+		return s.read(&elem, sizeof(T));
+	}
+
+	//.........................................................................................
+	// objects with their own blob serialization : size is their get_size(), ser/deser call their (de)serialize(blob).
+	// the blob has no length of its own, so deserializing holds avail bytes in memory : the enclosing field
+	// (exactly the object when it is a field of an ADD_SERIALIZATION_FUNCS class), or what is left of a container field
+	//.........................................................................................
+	template <class F> size_t serialize_blob_stream(SerialStream &s, size_t size, F ser)
+	{
+		if (size == 0)
+			return 0;
+		vector<unsigned char> blob(size);
+		size = ser(&blob[0]);
+		return s.write(&blob[0], size);
+	}
+
+	//.........................................................................................
+	template <class F> size_t deserialize_blob_stream(SerialStream &s, size_t avail, F deser)
+	{
+		if (avail == 0)
+			return 0;
+		unsigned char *blob = (unsigned char *)s.peek(avail);
+		if (blob == NULL) { s.set_failed(); return 0; }
+		size_t size = deser(blob);
+		if (size > avail) { s.set_failed(); return 0; }
+		s.consume(size);
+		return size;
+	}
+
+	//.........................................................................................
+	// MEDSERIALIZE_SUPPORT types : their serialize_to_stream / deserialize_from_stream when accessible, otherwise (a private SerializableObject base) their blob functions
+	//.........................................................................................
+	template <class T> auto serialize_object_stream(SerialStream &s, T &elem, int) -> decltype(elem.serialize_to_stream(s))
+	{
+		return elem.serialize_to_stream(s);
+	}
+
+	template <class T> size_t serialize_object_stream(SerialStream &s, T &elem, long)
+	{
+		return serialize_blob_stream(s, elem.get_size(), [&elem](unsigned char *blob) { return elem.serialize(blob); });
+	}
+
+	//.........................................................................................
+	template <class T> auto deserialize_object_stream(SerialStream &s, size_t avail, T &elem, int) -> decltype(elem.deserialize_from_stream(s, avail))
+	{
+		return elem.deserialize_from_stream(s, avail);
+	}
+
+	template <class T> size_t deserialize_object_stream(SerialStream &s, size_t avail, T &elem, long)
+	{
+		return deserialize_blob_stream(s, avail, [&elem](unsigned char *blob) { return elem.deserialize(blob); });
+	}
+
+	//.........................................................................................
+	// string
+	//.........................................................................................
+	template<> inline size_t serialize_stream<string>(SerialStream &s, string &str)
+	{
+		size_t len = str.length();
+		size_t pos = s.write(&len, sizeof(size_t));
+		pos += s.write(str.c_str(), len + 1);
+		return pos;
+	}
+
+	//.........................................................................................
+	template<> inline size_t deserialize_stream<string>(SerialStream &s, size_t avail, string &str)
+	{
+		size_t len = 0;
+		size_t pos = MedSerialize::deserialize_stream(s, avail, len);
+		if (!s.good() || len + 1 > stream_left(avail, pos)) { s.set_failed(); return pos; }
+		str.resize(len + 1);
+		pos += s.read(&str[0], len + 1);
+		str.resize(strlen(str.c_str())); // as in the blob version, up to the first 0
+		return pos;
+	}
+
+	//.........................................................................................
+	// T * and unique_ptr<T> : class name ("NULL" for NULL) and the object
+	//.........................................................................................
+	template <class T> size_t serialize_stream(SerialStream &s, T *&elem)
+	{
+		string cname = "NULL";
+		if (elem != NULL)
+			cname = elem->my_class_name();
+		size_t pos = MedSerialize::serialize_stream<string>(s, cname);
+		if (elem != NULL)
+			pos += MedSerialize::serialize_stream(s, (*elem));
+		return pos;
+	}
+
+	//.........................................................................................
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, T *&elem)
+	{
+		string cname;
+		size_t pos = MedSerialize::deserialize_stream<string>(s, avail, cname);
+		if (!s.good())
+			return pos;
+		if (cname == "NULL") {
+			elem = NULL;
+		}
+		else {
+			T dummy;
+			elem = (T *)dummy.new_polymorphic(cname);
+			if (elem == NULL)
+				elem = new T;
+			pos += MedSerialize::deserialize_stream(s, stream_left(avail, pos), (*elem));
+		}
+		return pos;
+	}
+
+	//.........................................................................................
+	template <class T> size_t serialize_stream(SerialStream &s, unique_ptr<T> &elem)
+	{
+		string cname = "NULL";
+		if (elem.get() != NULL)
+			cname = elem->my_class_name();
+		size_t pos = MedSerialize::serialize_stream<string>(s, cname);
+		if (elem.get() != NULL)
+			pos += MedSerialize::serialize_stream(s, (*elem));
+		return pos;
+	}
+
+	//.........................................................................................
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, unique_ptr<T> &elem)
+	{
+		string cname;
+		size_t pos = MedSerialize::deserialize_stream<string>(s, avail, cname);
+		if (!s.good())
+			return pos;
+		if (cname == "NULL") {
+			elem = NULL;
+		}
+		else {
+			T dummy;
+			elem = unique_ptr<T>((T *)dummy.new_polymorphic(cname));
+			if (elem.get() == NULL)
+				elem = unique_ptr<T>(new T);
+			pos += MedSerialize::deserialize_stream(s, stream_left(avail, pos), (*elem.get()));
+		}
+		return pos;
+	}
+
+	//.........................................................................................
+	// vector<T> : simple types are written in one piece
+	//.........................................................................................
+	template <class T> size_t serialize_stream(SerialStream &s, vector<T> &v)
+	{
+		size_t len = v.size();
+		size_t pos = s.write(&len, sizeof(size_t));
+		if (len > 0) {
+			if (std::is_arithmetic<T>::value)
+				pos += s.write(&v[0], len * sizeof(T));
+			else
+				for (T &elem : v)
+					pos += MedSerialize::serialize_stream(s, elem);
+		}
+		return pos;
+	}
+
+	//.........................................................................................
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, vector<T> &v)
+	{
+		size_t len = 0;
+		size_t pos = MedSerialize::deserialize_stream(s, avail, len);
+		if (!s.good())
+			return pos;
+		if (len != v.size()) v.clear();
+		if (len > 0) {
+			if (std::is_arithmetic<T>::value) {
+				if (len > stream_left(avail, pos) / sizeof(T)) { s.set_failed(); return pos; }
+				v.resize(len);
+				pos += s.read(&v[0], len * sizeof(T));
+			}
+			else {
+				v.resize(len);
+				for (T &elem : v) {
+					pos += MedSerialize::deserialize_stream(s, stream_left(avail, pos), elem);
+					if (!s.good()) break;
+				}
+			}
+		}
+		return pos;
+	}
+
+	//.........................................................................................
+	// pair<T,S>
+	//.........................................................................................
+	template <class T, class S> size_t serialize_stream(SerialStream &s, pair<T, S> &v)
+	{
+		size_t pos = 0;
+		pos += MedSerialize::serialize_stream(s, *((T *)&v.first));
+		pos += MedSerialize::serialize_stream(s, *((S *)&v.second));
+		return pos;
+	}
+
+	//.........................................................................................
+	template <class T, class S> size_t deserialize_stream(SerialStream &s, size_t avail, pair<T, S> &v)
+	{
+		size_t pos = 0;
+		T t{};
+		S sv{};
+		pos += MedSerialize::deserialize_stream(s, avail, t);
+		if (pos > avail) { s.set_failed(); return pos; }
+		pos += MedSerialize::deserialize_stream(s, avail - pos, sv);
+		if (pos > avail) { s.set_failed(); return pos; }
+		v.first = t;
+		v.second = sv;
+		return pos;
+	}
+
+	//.........................................................................................
+	// map<T,S> and unordered_map<T,S>
+	//.........................................................................................
+	template <class M, class T, class S> size_t serialize_map_stream(SerialStream &s, M &v)
+	{
+		size_t len = v.size();
+		size_t pos = s.write(&len, sizeof(size_t));
+		for (auto &elem : v) {
+			pos += MedSerialize::serialize_stream(s, *((T *)&elem.first));
+			pos += MedSerialize::serialize_stream(s, *((S *)&elem.second));
+		}
+		return pos;
+	}
+
+	//.........................................................................................
+	template <class M, class T, class S> size_t deserialize_map_stream(SerialStream &s, size_t avail, M &v)
+	{
+		size_t len = 0;
+		size_t pos = MedSerialize::deserialize_stream(s, avail, len);
+		v.clear();
+		T t;
+		S sv;
+		for (size_t i = 0; i < len && s.good(); i++) {
+			pos += MedSerialize::deserialize_stream(s, stream_left(avail, pos), t);
+			pos += MedSerialize::deserialize_stream(s, stream_left(avail, pos), sv);
+			v[t] = sv;
+		}
+		return pos;
+	}
+
+	template <class T, class S> size_t serialize_stream(SerialStream &s, map<T, S> &v) { return MedSerialize::serialize_map_stream<map<T, S>, T, S>(s, v); }
+	template <class T, class S> size_t deserialize_stream(SerialStream &s, size_t avail, map<T, S> &v) { return MedSerialize::deserialize_map_stream<map<T, S>, T, S>(s, avail, v); }
+	template <class T, class S> size_t serialize_stream(SerialStream &s, unordered_map<T, S> &v) { return MedSerialize::serialize_map_stream<unordered_map<T, S>, T, S>(s, v); }
+	template <class T, class S> size_t deserialize_stream(SerialStream &s, size_t avail, unordered_map<T, S> &v) { return MedSerialize::deserialize_map_stream<unordered_map<T, S>, T, S>(s, avail, v); }
+
+	//.........................................................................................
+	// set<T> and unordered_set<T>
+	//.........................................................................................
+	template <class C, class T> size_t serialize_set_stream(SerialStream &s, C &v)
+	{
+		size_t len = v.size();
+		size_t pos = s.write(&len, sizeof(size_t));
+		for (auto it = v.begin(); it != v.end(); ++it)
+			pos += MedSerialize::serialize_stream(s, (T &)(*it));
+		return pos;
+	}
+
+	//.........................................................................................
+	template <class C, class T> size_t deserialize_set_stream(SerialStream &s, size_t avail, C &v)
+	{
+		size_t len = 0;
+		size_t pos = MedSerialize::deserialize_stream(s, avail, len);
+		v.clear();
+		T elem;
+		for (size_t i = 0; i < len && s.good(); i++) {
+			pos += MedSerialize::deserialize_stream(s, stream_left(avail, pos), elem);
+			v.insert(elem);
+		}
+		return pos;
+	}
+
+	template <class T> size_t serialize_stream(SerialStream &s, set<T> &v) { return MedSerialize::serialize_set_stream<set<T>, T>(s, v); }
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, set<T> &v) { return MedSerialize::deserialize_set_stream<set<T>, T>(s, avail, v); }
+	template <class T> size_t serialize_stream(SerialStream &s, unordered_set<T> &v) { return MedSerialize::serialize_set_stream<unordered_set<T>, T>(s, v); }
+	template <class T> size_t deserialize_stream(SerialStream &s, size_t avail, unordered_set<T> &v) { return MedSerialize::deserialize_set_stream<unordered_set<T>, T>(s, avail, v); }
+
+	//.........................................................................................
+	// fields : size, name, element. The size is patched once the element was written.
+	//.........................................................................................
+	template<class T> size_t serializer_stream(SerialStream &s, int counter, vector<string> &names, T &elem)
+	{
+		unsigned long long start = s.tell();
+		size_t pos = 0;
+		pos += s.write(&pos, sizeof(size_t));
+		pos += MedSerialize::serialize_stream<string>(s, names[counter]);
+		pos += MedSerialize::serialize_stream(s, elem);
+		s.patch(start, &pos, sizeof(size_t));
+		return pos;
+	}
+
+	template<class T, class... Ts> size_t serializer_stream(SerialStream &s, int counter, vector<string> &names, T &elem, Ts&...args)
+	{
+		size_t pos = MedSerialize::serializer_stream(s, counter, names, elem);
+		pos += MedSerialize::serializer_stream(s, counter + 1, names, args...);
+		return pos;
+	}
+
+	template<class... Ts> size_t serialize_top_stream(SerialStream &s, char *list_of_args, Ts&...args)
+	{
+		vector<string> names;
+		MedSerialize::get_list_names(list_of_args, names);
+
+		unsigned long long start = s.tell();
+		size_t pos = 0;
+		pos += s.write(&pos, sizeof(size_t));
+		pos += MedSerialize::serializer_stream(s, 0, names, args...);
+		s.patch(start, &pos, sizeof(size_t));
+		return pos;
+	}
+
+	// deserializing field number i of the args
+	template<class T> size_t deserializer_stream(SerialStream &s, size_t avail, int i, int counter, T &elem)
+	{
+		return (i == counter) ? MedSerialize::deserialize_stream(s, avail, elem) : 0;
+	}
+
+	template<class T, class... Ts> size_t deserializer_stream(SerialStream &s, size_t avail, int i, int counter, T &elem, Ts&...args)
+	{
+		if (i == counter)
+			return MedSerialize::deserialize_stream(s, avail, elem);
+		return MedSerialize::deserializer_stream(s, avail, i, counter + 1, args...);
+	}
+
+	// warning on fields that were not in the stream, as in deserializer()
+	template<class T> void missing_stream(vector<string> &names, vector<bool> &found, int counter, T &elem)
+	{
+		if (!found[counter]) {
+			string cl_name = get_name<T>();
+			cerr << "WARNING: In \"" << cl_name << "\" element " << names[counter] << " not serialized... will be deserialized to its default\n";
+		}
+	}
+
+	template<class T, class... Ts> void missing_stream(vector<string> &names, vector<bool> &found, int counter, T &elem, Ts&...args)
+	{
+		MedSerialize::missing_stream(names, found, counter, elem);
+		MedSerialize::missing_stream(names, found, counter + 1, args...);
+	}
+
+	// fields are read in the order they were written, unknown fields are skipped
+	template<class... Ts> size_t deserialize_top_stream(SerialStream &s, size_t avail, char *list_of_args, Ts&...args)
+	{
+		vector<string> names;
+		MedSerialize::get_list_names(list_of_args, names);
+		vector<bool> found(names.size(), false);
+
+		size_t tot_size = 0, pos = 0;
+		pos += MedSerialize::deserialize_stream(s, avail, tot_size);
+		if (tot_size > avail) s.set_failed();
+
+		while (pos < tot_size && s.good()) {
+			size_t curr_size = 0, orig_curr_pos = pos;
+			pos += MedSerialize::deserialize_stream(s, tot_size - pos, curr_size);
+			string name;
+			pos += MedSerialize::deserialize_stream<string>(s, stream_left(tot_size, pos), name);
+			if (!s.good() || curr_size < pos - orig_curr_pos || curr_size > tot_size - orig_curr_pos) {
+				s.set_failed();
+				break;
+			}
+
+			size_t end_pos = orig_curr_pos + curr_size;
+			for (int i = 0; i < (int)names.size(); i++)
+				if (names[i] == name) {
+					pos += MedSerialize::deserializer_stream(s, end_pos - pos, i, 0, args...);
+					found[i] = true;
+					break;
+				}
+			if (pos > end_pos) {
+				s.set_failed();
+				break;
+			}
+			pos += s.skip(end_pos - pos);
+		}
+
+		if (s.good())
+			MedSerialize::missing_stream(names, found, 0, args...);
+		return tot_size;
+	}
+
 	template<class T> string object_json_rec(int counter, vector<string> &names, T &elem) {
 		stringstream str;
 		//need to print only names[counter] elemet. the value is stored in elem